@@ -0,0 +1,94 @@
+# paranoixa_add_shaders(<target> [NAMESPACE <namespace>]
+#                       SOURCES <shader>...)
+#
+# Compiles shaders to SPIR-V at build time and embeds each one in a generated
+# header as a constexpr paranoixa::EmbeddedShader with its content hash and
+# reflected resource counts, so the target loads no shader files at startup.
+#
+# The stage comes from the file name and the compiler from the extension:
+#   name.vert.glsl / name.frag.glsl    glslangValidator
+#   name.vert.hlsl / name.frag.hlsl    dxc
+#   name.vert.slang / name.frag.slang  slangc
+# The entry point is always main. res/shader.vert.glsl is included as
+#   #include <shaders/shader_vert.hpp>
+# and defines <namespace>::shader_vert. The namespace defaults to shaders.
+#
+# When cross-compiling, set PARANOIXA_SHADER_EMBED_EXECUTABLE to a
+# paranoixa_shader_embed built for the host.
+
+set(PARANOIXA_SHADER_EMBED_EXECUTABLE "" CACHE FILEPATH
+  "Host build of paranoixa_shader_embed, used when cross-compiling")
+
+function(paranoixa_add_shaders target)
+  cmake_parse_arguments(ARG "" "NAMESPACE" "SOURCES" ${ARGN})
+  if(NOT ARG_NAMESPACE)
+    set(ARG_NAMESPACE shaders)
+  endif()
+
+  if(PARANOIXA_SHADER_EMBED_EXECUTABLE)
+    set(embed ${PARANOIXA_SHADER_EMBED_EXECUTABLE})
+  elseif(TARGET paranoixa_shader_embed)
+    set(embed paranoixa_shader_embed)
+  else()
+    message(FATAL_ERROR "paranoixa_add_shaders: "
+      "set PARANOIXA_SHADER_EMBED_EXECUTABLE when cross-compiling")
+  endif()
+
+  set(output_dir ${CMAKE_CURRENT_BINARY_DIR}/${target}_shaders)
+  set(headers)
+  foreach(source ${ARG_SOURCES})
+    get_filename_component(source ${source} ABSOLUTE)
+    get_filename_component(name ${source} NAME)
+    if(NOT name MATCHES "^(.+)\\.(vert|frag)\\.(glsl|hlsl|slang)$")
+      message(FATAL_ERROR "paranoixa_add_shaders: ${name} is not named "
+        "<name>.<vert|frag>.<glsl|hlsl|slang>")
+    endif()
+    set(stage ${CMAKE_MATCH_2})
+    set(language ${CMAKE_MATCH_3})
+    set(symbol "${CMAKE_MATCH_1}_${stage}")
+    string(MAKE_C_IDENTIFIER ${symbol} symbol)
+    set(spirv ${output_dir}/${symbol}.spv)
+    set(header ${output_dir}/shaders/${symbol}.hpp)
+
+    if(language STREQUAL "glsl")
+      find_program(PARANOIXA_GLSLANG glslangValidator REQUIRED
+        HINTS $ENV{VULKAN_SDK}/bin)
+      set(compile ${PARANOIXA_GLSLANG} -S ${stage} --target-env vulkan1.0
+        -o ${spirv} ${source})
+    elseif(language STREQUAL "hlsl")
+      find_program(PARANOIXA_DXC dxc REQUIRED HINTS $ENV{VULKAN_SDK}/bin)
+      if(stage STREQUAL "vert")
+        set(profile vs_6_0)
+      else()
+        set(profile ps_6_0)
+      endif()
+      set(compile ${PARANOIXA_DXC} -spirv -T ${profile} -E main
+        -Fo ${spirv} ${source})
+    else()
+      find_program(PARANOIXA_SLANGC slangc REQUIRED
+        HINTS $ENV{VULKAN_SDK}/bin)
+      if(stage STREQUAL "vert")
+        set(slang_stage vertex)
+      else()
+        set(slang_stage fragment)
+      endif()
+      set(compile ${PARANOIXA_SLANGC} ${source} -target spirv
+        -stage ${slang_stage} -entry main -o ${spirv})
+    endif()
+
+    add_custom_command(
+      OUTPUT ${header}
+      COMMAND ${CMAKE_COMMAND} -E make_directory ${output_dir}/shaders
+      COMMAND ${compile}
+      COMMAND ${embed} ${spirv} ${header} ${ARG_NAMESPACE} ${symbol} main
+      DEPENDS ${source} ${embed}
+      BYPRODUCTS ${spirv}
+      COMMENT "Embedding shader ${name}"
+      VERBATIM
+    )
+    list(APPEND headers ${header})
+  endforeach()
+
+  target_sources(${target} PRIVATE ${headers})
+  target_include_directories(${target} PRIVATE ${output_dir})
+endfunction()
@@ -0,0 +1,105 @@
+#ifndef PARANOIXA_ASYNC_READBACK_HPP
+#define PARANOIXA_ASYNC_READBACK_HPP
+#include "paranoixa.hpp"
+
+#include <future>
+
+namespace paranoixa {
+/**
+ * @brief Downloads buffer and texture data without stalling the frame.
+ *
+ * Downloads are recorded into a copy pass of their own and submitted by
+ * Flush(). Update() polls the submit fences and hands the mapped data to a
+ * callback or a future once the GPU has finished. Call everything from the
+ * rendering thread, after the frame that produced the data was submitted.
+ */
+class AsyncReadback {
+public:
+  struct CreateInfo {
+    Allocator *allocator;
+    Ptr<Device> device;
+  };
+  // Tickets increase monotonically per download
+  using Ticket = std::uint64_t;
+
+  /**
+   * @brief Mapped view of downloaded data. Texture data is tightly packed.
+   */
+  class Result {
+  public:
+    Result(Ptr<TransferBuffer> transferBuffer, uint32 size);
+    ~Result();
+    Result(const Result &) = delete;
+    Result &operator=(const Result &) = delete;
+
+    const void *GetData() const { return data; }
+    uint32 GetSize() const { return size; }
+
+  private:
+    Ptr<TransferBuffer> transferBuffer;
+    const void *data;
+    uint32 size;
+  };
+  // The view is only valid during the call. Callbacks may record new
+  // downloads but must not call Flush(), Update() or Wait().
+  using Callback = std::function<void(const Result &result)>;
+
+  AsyncReadback(const CreateInfo &createInfo);
+  ~AsyncReadback();
+
+  Ticket ReadBuffer(const BufferRegion &src, Callback callback);
+  Ticket ReadTexture(const TextureRegion &src, Callback callback);
+  std::future<Ptr<Result>> ReadBuffer(const BufferRegion &src);
+  std::future<Ptr<Result>> ReadTexture(const TextureRegion &src);
+
+  /**
+   * @brief Submit all recorded downloads
+   */
+  void Flush();
+  /**
+   * @brief Run the callbacks and resolve the futures of finished downloads
+   */
+  void Update();
+  bool IsComplete(Ticket ticket) const;
+  /**
+   * @return true if the download could not be submitted. Its callback never
+   * runs and its future resolves to nullptr.
+   */
+  bool HasFailed(Ticket ticket) const;
+  /**
+   * @brief Block until the download has finished and its callback has run,
+   * or until it has failed
+   */
+  void Wait(Ticket ticket);
+
+private:
+  struct Request {
+    Ticket ticket;
+    Ptr<TransferBuffer> transferBuffer;
+    uint32 size;
+    Callback callback;
+    std::promise<Ptr<Result>> promise;
+    bool hasPromise;
+  };
+  struct Batch {
+    Ptr<Fence> fence;
+    Array<Request> requests;
+  };
+  Ticket Record(const BufferRegion *buffer, const TextureRegion *texture,
+                Callback callback, std::promise<Ptr<Result>> *promise);
+  Ptr<TransferBuffer> AcquireTransferBuffer(uint32 size);
+  void Retire(Batch &batch);
+  void Fail(Batch &batch);
+
+  CreateInfo createInfo;
+  Ptr<CommandBuffer> command;
+  Ptr<CopyPass> copyPass;
+  Array<Request> pending;
+  Array<Batch> inFlight;
+  Array<Ptr<TransferBuffer>> freeTransferBuffers;
+  Array<Ticket> failedTickets;
+  Ticket nextTicket;
+  Ticket completedTicket;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_ASYNC_READBACK_HPP
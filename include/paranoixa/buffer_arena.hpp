@@ -0,0 +1,64 @@
+#ifndef PARANOIXA_BUFFER_ARENA_HPP
+#define PARANOIXA_BUFFER_ARENA_HPP
+#include "offset_allocator.hpp"
+#include "paranoixa.hpp"
+
+namespace paranoixa {
+/**
+ * @brief Sub-allocates vertex, index and indirect data from a few large GPU
+ * buffers.
+ *
+ * Each block is one Buffer managed by an OffsetAllocator, so allocating and
+ * freeing are O(1) and draws from the same block can share a buffer binding.
+ * A new block is created when no existing block has room.
+ */
+class BufferArena {
+public:
+  struct CreateInfo {
+    Allocator *allocator;
+    Ptr<Device> device;
+    BufferUsage usage;
+    // Size of each block. Larger requests get a dedicated block.
+    uint32 blockSize;
+    // Alignment of every offset. Must be a power of two.
+    uint32 alignment;
+    uint32 maxAllocationsPerBlock;
+  };
+  struct Allocation {
+    BufferRegion region;
+    uint32 block;
+    OffsetAllocator::Allocation allocation;
+
+    BufferBinding GetBinding() const { return {region.buffer, region.offset}; }
+  };
+  struct Statistics {
+    uint32 numBlocks;
+    uint32 numAllocations;
+    std::uint64_t allocatedBytes;
+    std::uint64_t reservedBytes;
+  };
+
+  BufferArena(const CreateInfo &createInfo);
+
+  /**
+   * @return Allocation with a null region.buffer if size is 0 or the device
+   * is out of memory
+   */
+  Allocation Allocate(uint32 size);
+  void Free(const Allocation &allocation);
+
+  Statistics GetStatistics() const { return statistics; }
+
+private:
+  struct Block {
+    Ptr<Buffer> buffer;
+    OffsetAllocator offsetAllocator;
+  };
+  Ptr<Block> CreateBlock(uint32 size);
+
+  CreateInfo createInfo;
+  Array<Ptr<Block>> blocks;
+  Statistics statistics;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_BUFFER_ARENA_HPP
@@ -0,0 +1,73 @@
+#ifndef PARANOIXA_EMBEDDED_SHADER_HPP
+#define PARANOIXA_EMBEDDED_SHADER_HPP
+#include "paranoixa.hpp"
+
+namespace paranoixa {
+/**
+ * @brief FNV-1a of SPIR-V words, read as little-endian bytes, and the
+ * entry point name
+ */
+constexpr std::uint64_t HashShaderCode(const uint32 *words, size_t numWords,
+                                       const char *entrypoint) {
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  auto mix = [&](std::uint64_t byte) {
+    hash ^= byte;
+    hash *= 0x100000001b3ull;
+  };
+  for (size_t i = 0; i < numWords; ++i) {
+    for (uint32 shift = 0; shift < 32; shift += 8)
+      mix((words[i] >> shift) & 0xFF);
+  }
+  // Keeps entry points of the same module apart
+  mix(0);
+  for (; entrypoint != nullptr && *entrypoint != '\0'; ++entrypoint)
+    mix(static_cast<unsigned char>(*entrypoint));
+  return hash;
+}
+
+/**
+ * @brief SPIR-V shader compiled and reflected at build time by
+ * paranoixa_add_shaders(), see cmake/ParanoixaShaders.cmake
+ *
+ * The generated header defines one of these as a constexpr variable, so
+ * creating the shader needs no file I/O or runtime reflection.
+ */
+struct EmbeddedShader {
+  struct VertexInput {
+    uint32 location;
+    VertexElementFormat format;
+  };
+  const uint32 *code;
+  // In bytes
+  size_t size;
+  // HashShaderCode() of the code and entry point
+  std::uint64_t hash;
+  const char *entrypoint;
+  ShaderStage stage;
+  uint32 numSamplers;
+  uint32 numStorageTextures;
+  uint32 numStorageBuffers;
+  uint32 numUniformBuffers;
+  // Sorted by location, empty for fragment shaders
+  const VertexInput *vertexInputs;
+  uint32 numVertexInputs;
+
+  Shader::CreateInfo GetCreateInfo(Allocator *allocator) const {
+    // Value-initialized first, so that fields added to CreateInfo later are
+    // zeroed without -Wmissing-field-initializers in user code
+    Shader::CreateInfo createInfo{};
+    createInfo.allocator = allocator;
+    createInfo.size = size;
+    createInfo.data = code;
+    createInfo.entrypoint = entrypoint;
+    createInfo.format = ShaderFormat::SPIRV;
+    createInfo.stage = stage;
+    createInfo.numSamplers = numSamplers;
+    createInfo.numStorageBuffers = numStorageBuffers;
+    createInfo.numStorageTextures = numStorageTextures;
+    createInfo.numUniformBuffers = numUniformBuffers;
+    return createInfo;
+  }
+};
+} // namespace paranoixa
+#endif // PARANOIXA_EMBEDDED_SHADER_HPP
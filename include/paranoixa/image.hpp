@@ -0,0 +1,74 @@
+#ifndef PARANOIXA_IMAGE_HPP
+#define PARANOIXA_IMAGE_HPP
+#include "paranoixa.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace paranoixa::image {
+/**
+ * Pixel conversion kernels for texture upload paths.
+ *
+ * Every kernel converts a run of pixels and may write straight into
+ * TransferBuffer::Map() memory. Rows are independent, so an image is
+ * converted row by row and the rows can be split across threads with
+ * ParallelForRows(). The fastest of AVX2, SSE2 and NEON is chosen at runtime.
+ * dst and src must not overlap unless stated otherwise.
+ */
+
+// Swap the R and B channels of 8-bit four-channel pixels. Converts BGRA to
+// RGBA and back. dst may equal src.
+void SwizzleBGRAToRGBA(void *dst, const void *src, std::size_t numPixels);
+inline void SwizzleRGBAToBGRA(void *dst, const void *src,
+                              std::size_t numPixels) {
+  SwizzleBGRAToRGBA(dst, src, numPixels);
+}
+// Expand 8-bit RGB to RGBA with a constant alpha
+void ExpandRGBToRGBA(void *dst, const void *src, std::size_t numPixels,
+                     uint8 alpha = 0xFF);
+// Multiply the color channels of 8-bit RGBA or BGRA pixels by alpha.
+// dst may equal src.
+void PremultiplyAlpha(void *dst, const void *src, std::size_t numPixels);
+// Decode 8-bit sRGB channels to linear floats
+void SRGBToLinear(float *dst, const uint8 *src, std::size_t count);
+// Encode linear floats, clamped to [0, 1], as 8-bit sRGB channels
+void LinearToSRGB(uint8 *dst, const float *src, std::size_t count);
+// Convert between 32-bit and IEEE 754 half precision floats. Rounds to
+// nearest even.
+void FloatToHalf(std::uint16_t *dst, const float *src, std::size_t count);
+void HalfToFloat(float *dst, const std::uint16_t *src, std::size_t count);
+
+// Threads worth starting for a conversion that writes numBytes. Small images
+// get one, starting a thread costs more than converting them.
+uint32 GetThreadCount(std::size_t numBytes);
+
+/**
+ * @brief Run func(y) for every row in [0, height), splitting the rows into
+ * contiguous bands across numThreads threads. The calling thread processes
+ * the first band, with one thread no thread is started.
+ */
+template <class RowFunc>
+void ParallelForRows(uint32 height, uint32 numThreads, RowFunc &&func) {
+  numThreads = std::clamp(numThreads, 1u, std::max(height, 1u));
+  if (numThreads == 1) {
+    for (uint32 y = 0; y < height; ++y) {
+      func(y);
+    }
+    return;
+  }
+  auto rowsPerBand = (height + numThreads - 1) / numThreads;
+  auto band = [&](uint32 first) {
+    auto last = std::min(first + rowsPerBand, height);
+    for (auto y = first; y < last; ++y) {
+      func(y);
+    }
+  };
+  std::vector<std::jthread> threads;
+  threads.reserve(numThreads - 1);
+  for (uint32 i = 1; i < numThreads; ++i) {
+    threads.emplace_back(band, i * rowsPerBand);
+  }
+  band(0);
+}
+} // namespace paranoixa::image
+#endif // PARANOIXA_IMAGE_HPP
@@ -0,0 +1,37 @@
+#ifndef PARANOIXA_KTX2_LOADER_HPP
+#define PARANOIXA_KTX2_LOADER_HPP
+#include "paranoixa.hpp"
+
+namespace paranoixa {
+/**
+ * @brief Creates textures from KTX2 containers.
+ *
+ * Every mip level, layer and face is staged in a single transfer buffer and
+ * uploaded in one copy pass. Only formats in TextureFormat and files without
+ * supercompression are supported. Every level must be stored in the file,
+ * and 3D textures can't be layered.
+ */
+class KTX2Loader {
+public:
+  struct CreateInfo {
+    Allocator *allocator;
+    Ptr<Device> device;
+  };
+
+  KTX2Loader(const CreateInfo &createInfo);
+
+  /**
+   * @brief Create a texture and record the upload of its contents
+   * @param copyPass Copy pass the uploads are recorded into. The texture is
+   * ready once its command buffer has executed.
+   * @return nullptr if the file can't be read or is not supported
+   */
+  Ptr<Texture> Load(const char *filePath, Ptr<CopyPass> copyPass);
+  Ptr<Texture> Load(const void *data, std::size_t size,
+                    Ptr<CopyPass> copyPass);
+
+private:
+  CreateInfo createInfo;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_KTX2_LOADER_HPP
@@ -0,0 +1,45 @@
+#ifndef PARANOIXA_MAPPED_FILE_HPP
+#define PARANOIXA_MAPPED_FILE_HPP
+#include "paranoixa.hpp"
+
+namespace paranoixa {
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * The contents are paged in straight from the OS file cache, so copying them
+ * into TransferBuffer::Map() memory is the only copy between disk and the
+ * staging buffer.
+ */
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool Open(const char *filePath);
+  void Close();
+
+  bool IsOpen() const { return isOpen; }
+  const std::byte *GetData() const { return data; }
+  std::size_t GetSize() const { return size; }
+
+  /**
+   * @brief Copy the file into a new upload transfer buffer
+   * @return nullptr if the file is not open or is too large for a transfer
+   * buffer
+   */
+  Ptr<TransferBuffer> CreateTransferBuffer(Allocator *allocator,
+                                           Ptr<Device> device) const;
+
+private:
+  const std::byte *data;
+  std::size_t size;
+  bool isOpen;
+#ifdef PARANOIXA_PLATFORM_WINDOWS
+  void *fileHandle;
+  void *mappingHandle;
+#endif
+};
+} // namespace paranoixa
+#endif // PARANOIXA_MAPPED_FILE_HPP
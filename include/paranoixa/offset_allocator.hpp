@@ -0,0 +1,63 @@
+#ifndef PARANOIXA_OFFSET_ALLOCATOR_HPP
+#define PARANOIXA_OFFSET_ALLOCATOR_HPP
+#include "paranoixa.hpp"
+
+namespace paranoixa {
+/**
+ * @brief O(1) allocator of ranges inside a [0, size) space, such as a GPU
+ * buffer.
+ *
+ * Free ranges are kept in 256 TLSF-style bins keyed by a small floating point
+ * encoding of their size, with two levels of bitmasks to find a fitting bin.
+ * Neighboring free ranges are merged on Free(). No memory is allocated after
+ * construction.
+ */
+class OffsetAllocator {
+public:
+  static constexpr uint32 NO_SPACE = 0xFFFFFFFF;
+  struct Allocation {
+    uint32 offset = NO_SPACE;
+    // Internal node index, needed to free the allocation
+    uint32 metadata = NO_SPACE;
+  };
+
+  OffsetAllocator(Allocator *allocator, uint32 size, uint32 maxAllocations);
+
+  /**
+   * @return Allocation with offset NO_SPACE if no free range is large enough
+   */
+  Allocation Allocate(uint32 size);
+  void Free(const Allocation &allocation);
+
+  uint32 GetSize() const { return size; }
+  uint32 GetFreeSize() const { return freeStorage; }
+  uint32 GetLargestFreeRegion() const;
+
+private:
+  static constexpr uint32 NUM_TOP_BINS = 32;
+  static constexpr uint32 BINS_PER_LEAF = 8;
+  static constexpr uint32 NUM_LEAF_BINS = NUM_TOP_BINS * BINS_PER_LEAF;
+  static constexpr uint32 UNUSED = 0xFFFFFFFF;
+
+  struct Node {
+    uint32 dataOffset;
+    uint32 dataSize;
+    uint32 binListPrev;
+    uint32 binListNext;
+    uint32 neighborPrev;
+    uint32 neighborNext;
+    bool used;
+  };
+  uint32 InsertNodeIntoBin(uint32 size, uint32 dataOffset);
+  void RemoveNodeFromBin(uint32 nodeIndex);
+
+  uint32 size;
+  uint32 freeStorage;
+  uint32 usedBinsTop;
+  uint8 usedBins[NUM_TOP_BINS];
+  uint32 binIndices[NUM_LEAF_BINS];
+  Array<Node> nodes;
+  Array<uint32> freeNodes;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_OFFSET_ALLOCATOR_HPP
@@ -9,6 +9,7 @@
 #include <memory_resource>
 #include <print>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -64,6 +65,59 @@ template <typename T> using Array = std::pmr::vector<T>;
 
 using String = std::pmr::string;
 
+// Logs an InlineArray growing past its capacity
+void ReportInlineArrayOverflow(uint32 size, uint32 capacity);
+
+// Fixed-capacity array stored inline. Trivially copyable when T is, so
+// descriptions holding it are copied without allocating. Elements past the
+// capacity are logged and dropped.
+template <typename T, uint32 Capacity> class InlineArray {
+public:
+  using value_type = T;
+
+  void push_back(const T &value) {
+    if (count >= Capacity) {
+      ReportInlineArrayOverflow(count + 1, Capacity);
+      return;
+    }
+    elements[count++] = value;
+  }
+  void resize(uint32 size) {
+    if (size > Capacity) {
+      ReportInlineArrayOverflow(size, Capacity);
+      size = Capacity;
+    }
+    for (uint32 i = count; i < size; ++i) {
+      elements[i] = T{};
+    }
+    count = size;
+  }
+  void clear() { count = 0; }
+
+  uint32 size() const { return count; }
+  bool empty() const { return count == 0; }
+  static constexpr uint32 capacity() { return Capacity; }
+
+  T &operator[](uint32 index) {
+    assert(index < count);
+    return elements[index];
+  }
+  const T &operator[](uint32 index) const {
+    assert(index < count);
+    return elements[index];
+  }
+  T *data() { return elements; }
+  const T *data() const { return elements; }
+  T *begin() { return elements; }
+  T *end() { return elements + count; }
+  const T *begin() const { return elements; }
+  const T *end() const { return elements + count; }
+
+private:
+  T elements[Capacity] = {};
+  uint32 count = 0;
+};
+
 // Hash map class
 template <typename K, typename V, typename Hash = std::hash<K>,
           typename Equal = std::equal_to<K>>
@@ -78,6 +132,10 @@ enum class GraphicsAPI {
   SDLGPU,
 };
 
+// Fifo waits for vsync. Mailbox replaces the queued image instead of
+// waiting, Immediate does not wait and may tear.
+enum class PresentMode { Fifo, Mailbox, Immediate };
+
 enum class ShaderFormat { SPIRV };
 enum class ShaderStage { Vertex, Fragment };
 enum class TransferBufferUsage { Upload, Download };
@@ -86,6 +144,11 @@ enum class TextureFormat {
   R8G8B8A8_UNORM,
   B8G8R8A8_UNORM,
   R32G32B32A32_FLOAT,
+  BC1_RGBA_UNORM,
+  BC3_RGBA_UNORM,
+  BC4_R_UNORM,
+  BC5_RG_UNORM,
+  BC7_RGBA_UNORM,
   D32_FLOAT_S8_UINT
 };
 enum class TextureUsage { Sampler, ColorTarget, DepthStencilTarget };
@@ -96,7 +159,7 @@ enum class TextureType {
   Cube,
   CubeArray
 };
-enum class BufferUsage { Vertex, Index, Indirect };
+enum class BufferUsage { Vertex, Index, Indirect, Storage };
 enum class SampleCount {
   x1,
   x2,
@@ -132,6 +195,25 @@ enum VertexInputRate {
   Vertex,
   Instance,
 };
+
+// Texel block layout of a texture format. Uncompressed formats have 1x1
+// blocks.
+struct TextureFormatInfo {
+  uint32 blockSize;
+  uint32 blockWidth;
+  uint32 blockHeight;
+};
+TextureFormatInfo GetTextureFormatInfo(TextureFormat format);
+/**
+ * @brief Get the byte size of a tightly packed region, rounding the extent up
+ * to whole texel blocks
+ */
+uint32 CalculateTextureSize(TextureFormat format, uint32 width, uint32 height,
+                            uint32 depth);
+/**
+ * @brief Get the number of levels of a full mip chain down to 1x1
+ */
+uint32 CalculateMipLevelCount(uint32 width, uint32 height);
 struct VertexBufferDescription {
   uint32 slot;
   uint32 pitch;
@@ -147,11 +229,14 @@ struct VertexAttribute {
   VertexElementFormat format;
   uint32 offset;
 };
+// API limits of a graphics pipeline
+constexpr uint32 MAX_VERTEX_BUFFERS = 16;
+constexpr uint32 MAX_VERTEX_ATTRIBUTES = 16;
+constexpr uint32 MAX_COLOR_TARGETS = 8;
 struct VertexInputState {
-  VertexInputState(Allocator *allocator)
-      : vertexBufferDescriptions(allocator), vertexAttributes(allocator) {}
-  Array<VertexBufferDescription> vertexBufferDescriptions;
-  Array<VertexAttribute> vertexAttributes;
+  InlineArray<VertexBufferDescription, MAX_VERTEX_BUFFERS>
+      vertexBufferDescriptions;
+  InlineArray<VertexAttribute, MAX_VERTEX_ATTRIBUTES> vertexAttributes;
 };
 enum class PrimitiveType {
   TriangleList,
@@ -252,14 +337,13 @@ struct ColorTargetDescription {
   ColorTargetBlendState blendState;
 };
 struct TargetInfo {
-  TargetInfo(Allocator *allocator)
-      : colorTargetDescriptions(allocator),
-        depthStencilTargetFormat(TextureFormat::Invalid),
-        hasDepthStencilTarget(false) {}
-  Array<ColorTargetDescription> colorTargetDescriptions;
-  TextureFormat depthStencilTargetFormat;
-  bool hasDepthStencilTarget;
+  InlineArray<ColorTargetDescription, MAX_COLOR_TARGETS>
+      colorTargetDescriptions;
+  TextureFormat depthStencilTargetFormat = TextureFormat::Invalid;
+  bool hasDepthStencilTarget = false;
 };
+static_assert(std::is_trivially_copyable_v<VertexInputState> &&
+              std::is_trivially_copyable_v<TargetInfo>);
 class Device;
 class Texture {
 public:
@@ -273,6 +357,9 @@ public:
     uint32 layerCountOrDepth;
     uint32 numLevels;
     SampleCount sampleCount;
+    // Allow CommandBuffer::GenerateMipmaps() on the texture. The format must
+    // be renderable on backends that render the levels.
+    bool generateMipmaps = false;
   };
   virtual ~Texture() = default;
 
@@ -287,6 +374,10 @@ private:
 struct TextureTransferInfo {
   Ptr<class TransferBuffer> transferBuffer;
   uint32 offset;
+  // Row length and image height of the source data in texels, so that
+  // block-compressed rows are laid out per block row. 0 means tightly packed.
+  uint32 pixelsPerRow;
+  uint32 rowsPerLayer;
 };
 struct TextureRegion {
   Ptr<class Texture> texture;
@@ -305,6 +396,22 @@ struct TextureLocation {
   uint32 y;
   uint32 z;
 };
+struct BlitRegion {
+  Ptr<Texture> texture;
+  uint32 mipLevel;
+  uint32 layerOrDepthPlane;
+  uint32 x;
+  uint32 y;
+  uint32 width;
+  uint32 height;
+};
+struct BlitInfo {
+  BlitRegion source;
+  BlitRegion destination;
+  LoadOp loadOp;
+  Filter filter;
+  bool cycle;
+};
 struct BufferTransferInfo {
   Ptr<class TransferBuffer> transferBuffer;
   uint32 offset;
@@ -408,6 +515,11 @@ private:
   CreateInfo createInfo;
 };
 
+struct SpecializationConstant {
+  uint32 constantID;
+  // Raw bits of a bool, int, uint or float constant; std::bit_cast floats
+  uint32 value;
+};
 class Shader {
 public:
   struct CreateInfo {
@@ -417,10 +529,14 @@ public:
     const char *entrypoint;
     ShaderFormat format;
     ShaderStage stage;
+    // Resource counts are reflected from SPIR-V, so they may be left 0
     uint32 numSamplers;
     uint32 numStorageBuffers;
     uint32 numStorageTextures;
     uint32 numUniformBuffers;
+    // Override the defaults of specialization constants by constant ID
+    const SpecializationConstant *specializationConstants;
+    uint32 numSpecializationConstants;
   };
   virtual ~Shader() = default;
 
@@ -431,17 +547,59 @@ private:
   CreateInfo createInfo;
 };
 
+// Descriptor set of the bindless table in shaders, after the four sets used
+// by SDL_gpu
+constexpr uint32 BINDLESS_DESCRIPTOR_SET = 4;
+constexpr uint32 MAX_BINDLESS_TEXTURES = 16384;
+constexpr uint32 MAX_BINDLESS_SAMPLERS = 256;
+constexpr uint32 MAX_BINDLESS_BUFFERS = 16384;
+/**
+ * @brief Table of resources that shaders index directly, so that draws bind
+ * no textures or buffers of their own
+ *
+ * Shaders declare the table in BINDLESS_DESCRIPTOR_SET: binding 0 is an array
+ * of 2D textures, binding 1 of samplers and binding 2 of storage buffers.
+ * Indices are stable while registered and reach shaders through uniform data.
+ */
+class BindlessTable {
+public:
+  static constexpr uint32 INVALID_INDEX = UINT32_MAX;
+  struct CreateInfo {
+    Allocator *allocator;
+  };
+  virtual ~BindlessTable() = default;
+
+  const CreateInfo &GetCreateInfo() const { return createInfo; }
+
+  // Register returns INVALID_INDEX when the table is full or the resource
+  // cannot be sampled by shaders
+  virtual uint32 RegisterTexture(Ptr<Texture> texture) = 0;
+  virtual uint32 RegisterSampler(Ptr<Sampler> sampler) = 0;
+  // The buffer needs BufferUsage::Storage
+  virtual uint32 RegisterBuffer(Ptr<Buffer> buffer) = 0;
+  // Indices are reused only after command buffers submitted before have
+  // completed
+  virtual void UnregisterTexture(uint32 index) = 0;
+  virtual void UnregisterSampler(uint32 index) = 0;
+  virtual void UnregisterBuffer(uint32 index) = 0;
+
+protected:
+  BindlessTable(const CreateInfo &createInfo) : createInfo(createInfo) {}
+
+private:
+  CreateInfo createInfo;
+};
+
 class GraphicsPipeline {
 public:
   struct CreateInfo {
     CreateInfo(Allocator *allocator)
-        : allocator(allocator), vertexInputState(allocator),
-          targetInfo(allocator), vertexShader(nullptr), fragmentShader(nullptr),
-          primitiveType(PrimitiveType::TriangleList),
+        : allocator(allocator), vertexShader(nullptr), fragmentShader(nullptr),
+          vertexInputState(), primitiveType(PrimitiveType::TriangleList),
           rasterizerState{FillMode::Fill, CullMode::None, FrontFace::Clockwise,
                           0.0f,           0.0f,           0.0f,
                           false,          false},
-          multiSampleState(), depthStencilState() {}
+          multiSampleState(), depthStencilState(), targetInfo() {}
     Allocator *allocator;
     Ptr<Shader> vertexShader;
     Ptr<Shader> fragmentShader;
@@ -503,11 +661,18 @@ struct Viewport {
   float minDepth;
   float maxDepth;
 };
+class AsyncGraphicsPipeline;
 class RenderPass {
 public:
   virtual ~RenderPass() = default;
 
   virtual void BindGraphicsPipeline(Ptr<GraphicsPipeline> graphicsPipeline) = 0;
+  /**
+   * @brief Bind the pipeline once it is compiled, and fallback until then
+   * @return false if nothing was bound. Skip the draws of the pipeline.
+   */
+  bool BindAsyncGraphicsPipeline(const AsyncGraphicsPipeline &pipeline,
+                                 Ptr<GraphicsPipeline> fallback = nullptr);
   virtual void BindVertexBuffers(uint32 slot,
                                  const Array<BufferBinding> &bindings) = 0;
   virtual void BindIndexBuffer(const BufferBinding &binding,
@@ -515,6 +680,11 @@ public:
   virtual void
   BindFragmentSamplers(uint32 slot,
                        const Array<TextureSamplerBinding> &bindings) = 0;
+  /**
+   * @brief Bind the table for pipelines whose shaders use
+   * BINDLESS_DESCRIPTOR_SET. It stays bound across pipeline changes.
+   */
+  virtual void BindBindlessTable(Ptr<BindlessTable> bindlessTable) = 0;
   virtual void SetViewport(const Viewport &viewport) = 0;
   virtual void SetScissor(int32 x, int32 y, int32 width, int32 height) = 0;
   virtual void DrawPrimitives(uint32 numVertices, uint32 numInstances,
@@ -527,6 +697,14 @@ protected:
   RenderPass() = default;
 };
 
+class Fence {
+public:
+  virtual ~Fence() = default;
+
+protected:
+  Fence() = default;
+};
+
 class CommandBuffer {
 public:
   struct CreateInfo {
@@ -547,6 +725,18 @@ public:
 
   virtual void PushUniformData(uint32 slot, const void *data, size_t size) = 0;
 
+  /**
+   * @brief Fill every mip level below level 0 by repeated downsampling. Must
+   * be recorded outside of any pass, the texture must have been created with
+   * generateMipmaps.
+   */
+  virtual void GenerateMipmaps(Ptr<Texture> texture) = 0;
+  /**
+   * @brief Copy a region of one texture into another with scaling and
+   * filtering. Must be recorded outside of any pass.
+   */
+  virtual void Blit(const BlitInfo &blitInfo) = 0;
+
   const CreateInfo &getCreateInfo() const { return createInfo; }
 
 protected:
@@ -556,26 +746,70 @@ private:
   CreateInfo createInfo;
 };
 
+// Memory of one heap in bytes
+struct MemoryHeapBudget {
+  // Memory blocks allocated from the heap by the device, and the part of
+  // them in use by resources
+  std::uint64_t blockBytes;
+  std::uint64_t allocationBytes;
+  // Usage of the whole process and the most it can use before the driver
+  // starts paging. Estimates when the driver reports no budget.
+  std::uint64_t usage;
+  std::uint64_t budget;
+  bool deviceLocal;
+};
+
 class Device : public std::enable_shared_from_this<Device> {
 public:
   struct CreateInfo {
     Allocator *allocator;
     bool debugMode;
+    // Directory in which driver pipeline caches persist across runs. nullptr
+    // disables persistence.
+    const char *cacheDirectory;
+    // Frames the CPU may record ahead of the GPU, from 1 to 3. Fewer frames
+    // lower input latency at the cost of throughput. 0 selects 2.
+    uint32 framesInFlight;
+    // Falls back to Fifo when the window does not support it
+    PresentMode presentMode;
   };
   virtual ~Device() = default;
   const CreateInfo &GetCreateInfo() const { return createInfo; }
+  /**
+   * @brief framesInFlight of the create info, clamped to 1 to 3
+   */
+  uint32 GetFramesInFlight() const {
+    auto count = createInfo.framesInFlight;
+    return count == 0 ? 2 : (count > 3 ? 3 : count);
+  }
 
   /**
    * @brief Claim the SDL_Window for the device
    * @param window SDL_Window pointer
    */
   virtual void ClaimWindow(void *window) = 0;
+  /**
+   * @brief Render into offscreen textures instead of a window, for machines
+   * without a display. AcquireSwapchainTexture hands them out in turn and
+   * waits on the fence of the frame that last used the next one instead of
+   * on vsync. They are R8G8B8A8_UNORM color targets, which can be sampled
+   * and downloaded.
+   * @return false if a window has been claimed or creating the textures
+   * failed
+   */
+  virtual bool ClaimOffscreen(uint32 width, uint32 height) = 0;
   virtual Ptr<Buffer> CreateBuffer(const Buffer::CreateInfo &createInfo) = 0;
   virtual Ptr<Texture> CreateTexture(const Texture::CreateInfo &createInfo) = 0;
   virtual Ptr<Sampler> CreateSampler(const Sampler::CreateInfo &createInfo) = 0;
   virtual Ptr<TransferBuffer>
   CreateTransferBuffer(const TransferBuffer::CreateInfo &createInfo) = 0;
   virtual Ptr<Shader> CreateShader(const Shader::CreateInfo &createInfo) = 0;
+  /**
+   * @brief Create a bindless resource table
+   * @return nullptr if the device does not support bindless resources
+   */
+  virtual Ptr<BindlessTable>
+  CreateBindlessTable(const BindlessTable::CreateInfo &createInfo) = 0;
   virtual Ptr<GraphicsPipeline>
   CreateGraphicsPipeline(const GraphicsPipeline::CreateInfo &createInfo) = 0;
   virtual Ptr<ComputePipeline>
@@ -583,10 +817,41 @@ public:
   virtual Ptr<CommandBuffer>
   AcquireCommandBuffer(const CommandBuffer::CreateInfo &createInfo) = 0;
   virtual void SubmitCommandBuffer(Ptr<CommandBuffer> commandBuffer) = 0;
+  /**
+   * @brief Submit the command buffer and acquire a fence that is signaled
+   * when the GPU has finished executing it
+   * @param commandBuffer Command buffer to submit
+   */
+  virtual Ptr<Fence>
+  SubmitCommandBufferAndAcquireFence(Ptr<CommandBuffer> commandBuffer) = 0;
+  virtual bool QueryFence(Ptr<Fence> fence) = 0;
+  virtual void WaitForFences(const Array<Ptr<Fence>> &fences,
+                             bool waitAll) = 0;
   virtual Ptr<Texture>
   AcquireSwapchainTexture(Ptr<CommandBuffer> commandBuffer) = 0;
+  /**
+   * @brief Acquire a swapchain texture without blocking on vsync or on
+   * frames in flight
+   * @return nullptr if no texture is ready yet. The frame is then meant to
+   * be skipped and the command buffer submitted as is.
+   */
+  virtual Ptr<Texture>
+  TryAcquireSwapchainTexture(Ptr<CommandBuffer> commandBuffer) = 0;
   virtual TextureFormat GetSwapchainFormat() const = 0;
   virtual void WaitForGPUIdle() = 0;
+  /**
+   * @brief Get the memory budget of every heap. Budgets are refreshed once
+   * per acquired swapchain texture.
+   * @return false if the backend does not report memory budgets
+   */
+  virtual bool GetMemoryBudgets(Array<MemoryHeapBudget> &budgets) = 0;
+  /**
+   * @brief Move render targets to release partly used memory blocks, for at
+   * most timeBudgetMs of CPU time. Meant to be called once per frame while
+   * no command buffer is being recorded, each call continues the work of
+   * the previous one.
+   */
+  virtual void DefragmentMemory(float timeBudgetMs) = 0;
 
   virtual String GetDriver() const = 0;
 
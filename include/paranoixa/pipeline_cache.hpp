@@ -0,0 +1,80 @@
+#ifndef PARANOIXA_PIPELINE_CACHE_HPP
+#define PARANOIXA_PIPELINE_CACHE_HPP
+#include "paranoixa.hpp"
+
+#include <mutex>
+
+namespace paranoixa {
+struct EmbeddedShader;
+/**
+ * @brief Deduplicates shaders and graphics pipelines by their content.
+ *
+ * Create infos are serialized into a canonical key that skips state the
+ * driver ignores, e.g. blend factors with blending disabled, so equivalent
+ * permutations share one native object. Shaders are keyed by their bytecode,
+ * and pipelines by the identity of those deduplicated shaders plus all fixed
+ * function state. Cached objects live as long as the cache. Thread-safe.
+ */
+class PipelineCache {
+public:
+  struct CreateInfo {
+    Allocator *allocator;
+    Ptr<Device> device;
+  };
+  struct Statistics {
+    std::uint64_t numShaderHits;
+    std::uint64_t numShaderMisses;
+    std::uint64_t numPipelineHits;
+    std::uint64_t numPipelineMisses;
+  };
+
+  PipelineCache(const CreateInfo &createInfo);
+
+  /**
+   * @return Existing shader with the same bytecode and resource counts, or a
+   * newly created one
+   */
+  Ptr<Shader> GetOrCreateShader(const Shader::CreateInfo &shaderCI);
+  /**
+   * @brief Keyed by the hash computed at build time, so the bytecode is
+   * neither copied nor hashed
+   */
+  Ptr<Shader> GetOrCreateShader(const EmbeddedShader &shader);
+  /**
+   * @return Existing pipeline with equivalent state, or a newly created one
+   */
+  Ptr<GraphicsPipeline>
+  GetOrCreateGraphicsPipeline(const GraphicsPipeline::CreateInfo &pipelineCI);
+  /**
+   * @brief Release all cached objects. Objects still referenced elsewhere
+   * stay alive.
+   */
+  void Clear();
+
+  Statistics GetStatistics();
+
+  /**
+   * @brief Append the canonical key of a pipeline to key
+   */
+  static void SerializeKey(const GraphicsPipeline::CreateInfo &pipelineCI,
+                           Array<std::byte> &key);
+  static std::uint64_t HashKey(const Array<std::byte> &key);
+
+private:
+  template <class T> struct Entry {
+    Array<std::byte> key;
+    Ptr<T> object;
+  };
+  template <class T>
+  Ptr<T> Find(const HashMap<std::uint64_t, Array<Entry<T>>> &map,
+              std::uint64_t hash, const Array<std::byte> &key) const;
+
+  CreateInfo createInfo;
+  std::mutex mutex;
+  HashMap<std::uint64_t, Array<Entry<Shader>>> shaders;
+  HashMap<std::uint64_t, Ptr<Shader>> embeddedShaders;
+  HashMap<std::uint64_t, Array<Entry<GraphicsPipeline>>> pipelines;
+  Statistics statistics;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_PIPELINE_CACHE_HPP
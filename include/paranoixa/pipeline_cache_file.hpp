@@ -0,0 +1,34 @@
+#ifndef PARANOIXA_PIPELINE_CACHE_FILE_HPP
+#define PARANOIXA_PIPELINE_CACHE_FILE_HPP
+#include "paranoixa.hpp"
+
+#include <filesystem>
+
+namespace paranoixa {
+/**
+ * @brief Device and driver build that produced a driver pipeline cache blob.
+ * A blob is only reused by the exact same identity.
+ */
+struct PipelineCacheIdentity {
+  uint32 vendorID;
+  uint32 deviceID;
+  uint32 driverVersion;
+  uint8 uuid[16];
+};
+/**
+ * @brief Load the pipeline cache blob of a device from directory
+ * @return false if there is no blob for the device, or it was written by
+ * another driver build or is corrupted
+ */
+bool LoadPipelineCache(const std::filesystem::path &directory,
+                       const PipelineCacheIdentity &identity,
+                       Array<std::byte> &data);
+/**
+ * @brief Store the pipeline cache blob of a device in directory. The file is
+ * replaced atomically, so a crash never leaves a truncated cache behind.
+ */
+bool SavePipelineCache(const std::filesystem::path &directory,
+                       const PipelineCacheIdentity &identity, const void *data,
+                       size_t size);
+} // namespace paranoixa
+#endif // PARANOIXA_PIPELINE_CACHE_FILE_HPP
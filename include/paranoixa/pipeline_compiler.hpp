@@ -0,0 +1,90 @@
+#ifndef PARANOIXA_PIPELINE_COMPILER_HPP
+#define PARANOIXA_PIPELINE_COMPILER_HPP
+#include "paranoixa.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+namespace paranoixa {
+/**
+ * @brief Graphics pipeline that is compiled by a PipelineCompiler.
+ * Bind it with RenderPass::BindAsyncGraphicsPipeline().
+ */
+class AsyncGraphicsPipeline {
+public:
+  bool IsReady() const { return ready.load(std::memory_order_acquire); }
+  /**
+   * @return nullptr while compiling or if compiling failed
+   */
+  Ptr<GraphicsPipeline> Get() const { return IsReady() ? pipeline : nullptr; }
+
+private:
+  friend class PipelineCompiler;
+  Ptr<GraphicsPipeline> pipeline;
+  std::atomic<bool> ready = false;
+};
+
+/**
+ * @brief Compiles graphics pipelines on a pool of worker threads, so that
+ * the first use of a material does not stall the frame on the driver
+ * compiler.
+ */
+class PipelineCompiler {
+public:
+  struct CreateInfo {
+    Allocator *allocator;
+    Ptr<Device> device;
+    uint32 numThreads;
+  };
+  struct Statistics {
+    // Successful compiles only, failures are counted in numFailed
+    uint32 numCompiled;
+    // Failed compiles and pipelines abandoned on destruction
+    uint32 numFailed;
+    uint32 numPending;
+    // Summed over all compiles, including those Wait() runs itself
+    double compileSeconds;
+    // Time callers were blocked in Wait() on a worker's compile
+    double waitSeconds;
+  };
+
+  PipelineCompiler(const CreateInfo &createInfo);
+  ~PipelineCompiler();
+
+  /**
+   * @brief Queue a pipeline for compilation. The create info is copied and
+   * the job keeps its own references to the shaders, so the caller may drop
+   * them right away.
+   */
+  Ptr<AsyncGraphicsPipeline>
+  CreateGraphicsPipelineAsync(const GraphicsPipeline::CreateInfo &pipelineCI);
+  /**
+   * @brief Block until the pipeline is compiled. A pipeline no worker has
+   * picked up yet is compiled on the calling thread.
+   * @return nullptr if compiling failed
+   */
+  Ptr<GraphicsPipeline> Wait(const Ptr<AsyncGraphicsPipeline> &pipeline);
+
+  Statistics GetStatistics();
+
+private:
+  struct Job {
+    Ptr<AsyncGraphicsPipeline> pipeline;
+    GraphicsPipeline::CreateInfo createInfo;
+  };
+  void WorkerMain(std::stop_token stopToken);
+  void Compile(Job &job);
+
+  CreateInfo createInfo;
+  std::mutex mutex;
+  std::condition_variable_any jobAvailable;
+  std::condition_variable_any jobCompleted;
+  Array<Job> jobs;
+  Array<std::jthread> workers;
+  Statistics statistics;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_PIPELINE_COMPILER_HPP
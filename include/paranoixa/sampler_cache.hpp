@@ -0,0 +1,66 @@
+#ifndef PARANOIXA_SAMPLER_CACHE_HPP
+#define PARANOIXA_SAMPLER_CACHE_HPP
+#include "paranoixa.hpp"
+
+#include <mutex>
+
+namespace paranoixa {
+/**
+ * @brief Shares one Sampler between all requests with the same state.
+ *
+ * Scenes use a handful of distinct sampler states, while drivers cap the
+ * number of live samplers. Create infos are packed into a compact key that
+ * drops state the driver ignores, e.g. the compare op with comparison
+ * disabled. Cached samplers live as long as the cache. Thread-safe.
+ */
+class SamplerCache {
+public:
+  struct CreateInfo {
+    Allocator *allocator;
+    Ptr<Device> device;
+  };
+  struct Statistics {
+    uint32 numSamplers;
+    std::uint64_t numHits;
+    std::uint64_t numMisses;
+  };
+  /**
+   * @brief Canonical packed sampler state
+   */
+  struct Key {
+    // Filters, mipmap mode, address modes, compare op and enable flags
+    uint32 state;
+    float mipLodBias;
+    float maxAnisotropy;
+    float minLod;
+    float maxLod;
+    bool operator==(const Key &) const = default;
+  };
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+
+  SamplerCache(const CreateInfo &createInfo);
+
+  /**
+   * @return Existing sampler with the same state, or a newly created one
+   */
+  Ptr<Sampler> GetOrCreateSampler(const Sampler::CreateInfo &samplerCI);
+  /**
+   * @brief Release all cached samplers. Samplers still referenced elsewhere
+   * stay alive.
+   */
+  void Clear();
+
+  Statistics GetStatistics();
+
+  static Key PackKey(const Sampler::CreateInfo &samplerCI);
+
+private:
+  CreateInfo createInfo;
+  std::mutex mutex;
+  HashMap<Key, Ptr<Sampler>, KeyHash> samplers;
+  Statistics statistics;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_SAMPLER_CACHE_HPP
@@ -0,0 +1,72 @@
+#ifndef PARANOIXA_SHADER_VARIANTS_HPP
+#define PARANOIXA_SHADER_VARIANTS_HPP
+#include "paranoixa.hpp"
+
+#include <initializer_list>
+#include <mutex>
+
+namespace paranoixa {
+/**
+ * @brief Variants of one SPIR-V module that differ only in specialization
+ * constants, e.g. material feature toggles.
+ *
+ * The module is stored once and each constant set is compiled lazily on
+ * first use. Constant sets are canonicalized against the defaults of the
+ * module, so sets that only spell out defaults or list IDs in another order
+ * share one Shader. Because each variant is a unique Shader, a PipelineCache
+ * keys pipelines by (shader, constant set) without further help.
+ * Thread-safe.
+ */
+class ShaderVariants {
+public:
+  struct CreateInfo {
+    Allocator *allocator;
+    Ptr<Device> device;
+    // Code and entry point are copied. Specialization constants given here
+    // become the defaults of every variant.
+    Shader::CreateInfo shader;
+  };
+  struct Statistics {
+    uint32 numVariants;
+    std::uint64_t numHits;
+    std::uint64_t numMisses;
+  };
+
+  ShaderVariants(const CreateInfo &createInfo);
+
+  /**
+   * @return The variant for these constant values, created on first use.
+   * nullptr if the module is not valid SPIR-V or creating the shader failed.
+   */
+  Ptr<Shader> Get(const SpecializationConstant *constants,
+                  uint32 numConstants);
+  Ptr<Shader> Get(std::initializer_list<SpecializationConstant> constants) {
+    return Get(constants.begin(), static_cast<uint32>(constants.size()));
+  }
+  /**
+   * @return Specialization constants of the module with their defaults,
+   * sorted by constant ID
+   */
+  const Array<SpecializationConstant> &GetDefaults() const {
+    return defaults;
+  }
+
+  Statistics GetStatistics();
+
+private:
+  struct Variant {
+    Array<uint32> values;
+    Ptr<Shader> shader;
+  };
+
+  CreateInfo createInfo;
+  Array<uint32> code;
+  String entrypoint;
+  Array<SpecializationConstant> defaults;
+  bool valid;
+  std::mutex mutex;
+  HashMap<std::uint64_t, Array<Variant>> variants;
+  Statistics statistics;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_SHADER_VARIANTS_HPP
@@ -0,0 +1,66 @@
+#ifndef PARANOIXA_SPIRV_REFLECTION_HPP
+#define PARANOIXA_SPIRV_REFLECTION_HPP
+#include "paranoixa.hpp"
+
+namespace paranoixa {
+/**
+ * @brief Resources and vertex inputs of one SPIR-V entry point
+ */
+struct ShaderReflection {
+  struct VertexInput {
+    uint32 location;
+    VertexElementFormat format;
+  };
+  ShaderReflection(Allocator *allocator)
+      : allocator(allocator), stage(ShaderStage::Vertex), numSamplers(0),
+        numStorageTextures(0), numStorageBuffers(0), numUniformBuffers(0),
+        usesBindlessTable(false), vertexInputs(allocator) {}
+  Allocator *allocator;
+  ShaderStage stage;
+  uint32 numSamplers;
+  uint32 numStorageTextures;
+  uint32 numStorageBuffers;
+  uint32 numUniformBuffers;
+  // Whether any resource is declared in BINDLESS_DESCRIPTOR_SET
+  bool usesBindlessTable;
+  // Sorted by location. Inputs without a VertexElementFormat equivalent are
+  // left out.
+  Array<VertexInput> vertexInputs;
+};
+/**
+ * @brief Reflect an entry point of a SPIR-V module in a single pass over
+ * the binary
+ *
+ * Resources are counted the way SDL_gpu binds them: combined image samplers
+ * and sampled images as samplers, storage images as storage textures, and
+ * Block/BufferBlock structs as uniform/storage buffers. Arrays count each
+ * element. Only resources the entry point's call tree refers to are counted,
+ * and not those of BINDLESS_DESCRIPTOR_SET.
+ * @return false if the binary is malformed or has no vertex or fragment
+ * entry point of that name
+ */
+bool ReflectSPIRV(const void *code, size_t size, const char *entrypoint,
+                  ShaderReflection &reflection);
+/**
+ * @brief List the specialization constants of a SPIR-V module with their
+ * default values, sorted by constant ID
+ *
+ * Only bool and 32-bit constants are listed.
+ * @return false if the binary is malformed
+ */
+bool ReflectSpecializationConstants(const void *code, size_t size,
+                                    Array<SpecializationConstant> &constants);
+/**
+ * @brief Copy a SPIR-V module with the default values of its
+ * specialization constants replaced
+ *
+ * This is how constants reach backends without native specialization
+ * support. The driver still sees constant values and folds them. IDs the
+ * module does not declare are ignored, as are 64-bit constants.
+ * @return false if the binary is malformed
+ */
+bool SpecializeSPIRV(const void *code, size_t size,
+                     const SpecializationConstant *constants,
+                     uint32 numConstants, Array<uint32> &specialized);
+} // namespace paranoixa
+#endif // PARANOIXA_SPIRV_REFLECTION_HPP
@@ -0,0 +1,99 @@
+#ifndef PARANOIXA_TEXTURE_ATLAS_HPP
+#define PARANOIXA_TEXTURE_ATLAS_HPP
+#include "paranoixa.hpp"
+#include "upload_batcher.hpp"
+
+namespace paranoixa {
+/**
+ * @brief Packs many small images into the layers of one Texture2DArray so
+ * that draws using them share a single sampler binding.
+ *
+ * Each layer is packed with a bottom-left skyline. Images are uploaded as
+ * partial region updates when they are added. Space is reclaimed per layer:
+ * a layer is reset once all its entries are removed, and when an image does
+ * not fit anywhere the least recently used layer is evicted.
+ */
+class TextureAtlas {
+public:
+  using Handle = uint32;
+  static constexpr Handle INVALID_HANDLE = 0;
+
+  struct CreateInfo {
+    Allocator *allocator;
+    Ptr<Device> device;
+    // Must be an uncompressed format
+    TextureFormat format;
+    uint32 width;
+    uint32 height;
+    uint32 numLayers;
+    // Texels around each entry, filled with its edge texels so that linear
+    // filtering does not bleed between neighbors
+    uint32 padding;
+  };
+  struct UVRect {
+    float u0, v0;
+    float u1, v1;
+  };
+  struct Entry {
+    uint32 layer;
+    uint32 x, y;
+    uint32 width, height;
+    UVRect uv;
+  };
+  struct Statistics {
+    uint32 numEntries;
+    uint32 numEvictions;
+    std::uint64_t usedArea;
+    std::uint64_t totalArea;
+  };
+
+  TextureAtlas(const CreateInfo &createInfo);
+
+  /**
+   * @brief Pack an image and queue the upload of its tightly packed texels,
+   * extruded into the padding
+   * @return INVALID_HANDLE if the image is larger than a layer or every layer
+   * was used in the current frame
+   */
+  Handle Add(const void *data, uint32 width, uint32 height);
+  void Remove(Handle handle);
+  /**
+   * @brief Get the placement of an entry and mark its layer as used in this
+   * frame
+   * @return nullptr if the entry was removed or evicted
+   */
+  const Entry *Get(Handle handle);
+  Ptr<Texture> GetTexture() const { return texture; }
+  /**
+   * @brief Submit the queued uploads and start a new frame. Call once per
+   * frame before drawing with the atlas.
+   */
+  void Update();
+
+  Statistics GetStatistics() const { return statistics; }
+
+private:
+  struct SkylineNode {
+    uint32 x;
+    uint32 y;
+    uint32 width;
+  };
+  struct Layer {
+    Array<SkylineNode> skyline;
+    uint32 numEntries;
+    std::uint64_t lastUsedFrame;
+  };
+  bool Pack(Layer &layer, uint32 width, uint32 height, uint32 &x, uint32 &y);
+  void ResetLayer(uint32 layerIndex);
+
+  CreateInfo createInfo;
+  UploadBatcher uploadBatcher;
+  Ptr<Texture> texture;
+  Array<Layer> layers;
+  HashMap<Handle, Entry> entries;
+  Handle nextHandle;
+  std::uint64_t frame;
+  Statistics statistics;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_TEXTURE_ATLAS_HPP
@@ -0,0 +1,147 @@
+#ifndef PARANOIXA_TEXTURE_STREAMER_HPP
+#define PARANOIXA_TEXTURE_STREAMER_HPP
+#include "paranoixa.hpp"
+#include "upload_batcher.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+namespace paranoixa {
+/**
+ * @brief Streams 2D textures mip by mip on background threads.
+ *
+ * Mip levels are loaded coarsest first in priority order and uploaded within a
+ * per-frame byte budget, so a texture becomes usable as soon as its smallest
+ * mip arrives and sharpens as finer mips follow. When resident texture memory
+ * exceeds the budget, the finest mips of the least recently used textures are
+ * dropped.
+ */
+class TextureStreamer {
+public:
+  /**
+   * @brief Produces the tightly packed texels of one mip level. Called on a
+   * worker thread.
+   */
+  using MipLoader =
+      std::function<bool(uint32 mipLevel, Array<std::byte> &texels)>;
+  using Handle = uint32;
+
+  struct CreateInfo {
+    Allocator *allocator;
+    Ptr<Device> device;
+    uint32 numThreads;
+    std::uint64_t uploadBudgetPerFrame;
+    std::uint64_t memoryBudget;
+  };
+  struct StreamInfo {
+    TextureFormat format;
+    uint32 width;
+    uint32 height;
+    uint32 numLevels;
+    float priority;
+    MipLoader loader;
+  };
+  struct Statistics {
+    std::uint64_t residentBytes;
+    std::uint64_t uploadedBytes;
+    uint32 numEvictions;
+    uint32 numPendingLoads;
+  };
+
+  TextureStreamer(const CreateInfo &createInfo);
+  ~TextureStreamer();
+
+  Handle Stream(const StreamInfo &streamInfo);
+  void Release(Handle handle);
+  void SetPriority(Handle handle, float priority);
+  /**
+   * @brief Get the texture holding the finest mips resident so far and mark
+   * it as used in this frame
+   * @return nullptr until the coarsest mip has been uploaded
+   */
+  Ptr<Texture> GetTexture(Handle handle);
+  /**
+   * @brief Get the source mip level that level 0 of GetTexture() holds
+   */
+  uint32 GetResidentMip(Handle handle);
+  /**
+   * @brief Upload loaded mips within the frame budget and evict over the
+   * memory budget. Call once per frame on the rendering thread.
+   */
+  void Update();
+
+  Statistics GetStatistics();
+
+private:
+  struct StreamState {
+    StreamInfo info;
+    Ptr<Texture> texture;
+    // Finest source mip held by texture. info.numLevels while nothing is
+    // resident.
+    uint32 residentMip;
+    // Finest source mip the stream should load up to
+    uint32 targetMip;
+    // Finest source mip that can be loaded. Raised past a mip whose loader
+    // failed, so that the mip is not retried.
+    uint32 minMip;
+    std::uint64_t lastUsedFrame;
+    bool loading;
+  };
+  struct LoadJob {
+    Handle handle;
+    uint32 mipLevel;
+    float priority;
+  };
+  struct LoadedMip {
+    Handle handle;
+    uint32 mipLevel;
+    float priority;
+    Array<std::byte> texels;
+  };
+  // Replaces the texture of a stream by one holding the source mips from
+  // newResidentMip on. Planned under the lock, recorded without it.
+  struct ResizeJob {
+    Handle handle;
+    TextureFormat format;
+    uint32 width;
+    uint32 height;
+    uint32 numLevels;
+    // Texture and finest mip of the stream when the job was planned
+    Ptr<Texture> texture;
+    uint32 residentMip;
+    uint32 newResidentMip;
+    // Texels of newResidentMip to upload, empty for evictions
+    Array<std::byte> texels;
+  };
+  void WorkerMain(std::stop_token stopToken);
+  void QueueLoad(Handle handle, StreamState &stream);
+  ResizeJob MakeResizeJob(Handle handle, const StreamState &stream,
+                          uint32 newResidentMip) const;
+  // Returns the new texture, nullptr if it could not be created
+  Ptr<Texture> Resize(Ptr<CommandBuffer> &command, Ptr<CopyPass> &copyPass,
+                      const ResizeJob &resize, const Ptr<Texture> &oldTexture,
+                      uint32 oldResidentMip);
+  // Queue the evictions that bring the resident size within the memory
+  // budget. plannedMips holds the finest mips of streams resized so far.
+  void PlanEvictions(HashMap<Handle, uint32> &plannedMips,
+                     Array<ResizeJob> &resizes);
+  std::uint64_t GetResidentSize(const StreamState &stream,
+                                uint32 residentMip) const;
+
+  CreateInfo createInfo;
+  UploadBatcher uploadBatcher;
+  std::mutex mutex;
+  std::condition_variable_any jobAvailable;
+  HashMap<Handle, StreamState> streams;
+  Array<LoadJob> jobs;
+  Array<LoadedMip> loaded;
+  Array<std::jthread> workers;
+  Handle nextHandle;
+  std::uint64_t frame;
+  Statistics statistics;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_TEXTURE_STREAMER_HPP
@@ -0,0 +1,119 @@
+#ifndef PARANOIXA_UPLOAD_BATCHER_HPP
+#define PARANOIXA_UPLOAD_BATCHER_HPP
+#include "paranoixa.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace paranoixa {
+/**
+ * @brief Coalesces many small buffer/texture uploads into large shared
+ * staging buffers that are recorded into a single copy pass per Flush().
+ * Upload requests may be issued from any thread.
+ */
+class UploadBatcher {
+public:
+  struct CreateInfo {
+    Allocator *allocator;
+    Ptr<Device> device;
+    // Size of each shared staging buffer. Uploads larger than this get a
+    // dedicated staging buffer.
+    uint32 stagingBufferSize;
+  };
+  // Completion token. Tokens increase monotonically per Flush().
+  using Token = std::uint64_t;
+  struct Statistics {
+    std::uint64_t numUploads;
+    std::uint64_t numBytes;
+    std::uint64_t numCopyPasses;
+    std::uint64_t numStagingBuffers;
+  };
+
+  UploadBatcher(const CreateInfo &createInfo);
+  ~UploadBatcher();
+
+  /**
+   * @brief Queue a buffer upload. The data is copied into staging memory
+   * before this returns.
+   * @return Token that completes once the upload has executed on the GPU
+   */
+  Token UploadBuffer(const void *data, const BufferRegion &dst);
+  /**
+   * @brief Queue a texture upload. The data must be tightly packed.
+   * @return Token that completes once the upload has executed on the GPU
+   */
+  Token UploadTexture(const void *data, uint32 size, const TextureRegion &dst);
+  /**
+   * @brief Queue a texture upload whose texels are written in place. writer
+   * receives size bytes of mapped staging memory and fills them before this
+   * returns, so conversions can run without an intermediate copy.
+   * @return Token that completes once the upload has executed on the GPU
+   */
+  Token UploadTexture(uint32 size, const TextureRegion &dst,
+                      const std::function<void(void *staging)> &writer);
+  /**
+   * @brief Record all queued uploads into one copy pass and submit it
+   * @return Token of the submitted batch
+   */
+  Token Flush();
+  /**
+   * @return false until the upload has executed, and forever if it failed
+   */
+  bool IsComplete(Token token);
+  /**
+   * @return true if the batch of the token could not be submitted. Its
+   * uploads never execute.
+   */
+  bool HasFailed(Token token);
+  /**
+   * @brief Block until the upload has executed or has failed
+   */
+  void Wait(Token token);
+
+  Statistics GetStatistics();
+
+private:
+  struct Page {
+    Ptr<TransferBuffer> transferBuffer;
+    std::byte *mapped;
+    uint32 size;
+    uint32 used;
+    uint32 writers;
+  };
+  struct Copy {
+    Page *page;
+    uint32 offset;
+    BufferRegion buffer;
+    TextureRegion texture;
+    bool isTexture;
+  };
+  struct Batch {
+    Token token;
+    Ptr<Fence> fence;
+    Array<Page *> pages;
+  };
+  Token Upload(uint32 size, const Copy &copy,
+               const std::function<void(void *staging)> &writer);
+  Page *AcquirePage(uint32 size);
+  void ReleasePage(Page *page);
+  void Retire();
+  bool IsFailed(Token token) const;
+
+  CreateInfo createInfo;
+  std::mutex mutex;
+  std::condition_variable writersDone;
+  Array<Ptr<Page>> pages;
+  Array<Page *> freePages;
+  Array<Page *> openPages;
+  Page *currentPage;
+  Array<Copy> copies;
+  Array<Batch> inFlight;
+  // Tokens of batches whose submit failed
+  Array<Token> failedTokens;
+  Token nextToken;
+  Token completedToken;
+  Statistics statistics;
+};
+} // namespace paranoixa
+#endif // PARANOIXA_UPLOAD_BATCHER_HPP
@@ -40,19 +40,11 @@ static void Imgui_ImplParanoixa_CreateShaders() {
   vertex_shader_info.allocator = v->Allocator;
   vertex_shader_info.entrypoint = "main";
   vertex_shader_info.stage = px::ShaderStage::Vertex;
-  vertex_shader_info.numUniformBuffers = 1;
-  vertex_shader_info.numStorageBuffers = 0;
-  vertex_shader_info.numStorageTextures = 0;
-  vertex_shader_info.numSamplers = 0;
 
   px::Shader::CreateInfo fragment_shader_info = {};
   fragment_shader_info.allocator = v->Allocator;
   fragment_shader_info.entrypoint = "main";
   fragment_shader_info.stage = px::ShaderStage::Fragment;
-  fragment_shader_info.numSamplers = 1;
-  fragment_shader_info.numStorageBuffers = 0;
-  fragment_shader_info.numStorageTextures = 0;
-  fragment_shader_info.numUniformBuffers = 0;
 
   if (driver == "vulkan") {
     vertex_shader_info.format = px::ShaderFormat::SPIRV;
@@ -92,14 +84,15 @@ static void ImGui_ImplParanoixa_CreateGraphicsPipeline() {
   ImGui_ImplParanoixa_InitInfo *v = &bd->InitInfo;
   Imgui_ImplParanoixa_CreateShaders();
 
-  px::Array<px::VertexBufferDescription> vertex_buffer_desc(v->Allocator);
+  px::VertexInputState vertex_input_state{};
+  auto &vertex_buffer_desc = vertex_input_state.vertexBufferDescriptions;
   vertex_buffer_desc.resize(1);
   vertex_buffer_desc[0].slot = 0;
   vertex_buffer_desc[0].inputRate = px::VertexInputRate::Vertex;
   vertex_buffer_desc[0].instanceStepRate = 0;
   vertex_buffer_desc[0].pitch = sizeof(ImDrawVert);
 
-  px::Array<px::VertexAttribute> vertex_attributes(v->Allocator);
+  auto &vertex_attributes = vertex_input_state.vertexAttributes;
   vertex_attributes.resize(3);
   vertex_attributes[0].bufferSlot = 0;
   vertex_attributes[0].format = px::VertexElementFormat::Float2;
@@ -116,10 +109,6 @@ static void ImGui_ImplParanoixa_CreateGraphicsPipeline() {
   vertex_attributes[2].location = 2;
   vertex_attributes[2].offset = offsetof(ImDrawVert, col);
 
-  px::VertexInputState vertex_input_state{v->Allocator};
-  vertex_input_state.vertexAttributes = vertex_attributes;
-  vertex_input_state.vertexBufferDescriptions = vertex_buffer_desc;
-
   px::RasterizerState rasterizer_state = {};
   rasterizer_state.fillMode = px::FillMode::Fill;
   rasterizer_state.cullMode = px::CullMode::None;
@@ -147,13 +136,11 @@ static void ImGui_ImplParanoixa_CreateGraphicsPipeline() {
   blend_state.colorWriteMask = px::ColorComponent::R | px::ColorComponent::G |
                                px::ColorComponent::B | px::ColorComponent::A;
 
-  px::Array<px::ColorTargetDescription> color_target_desc(v->Allocator);
+  px::TargetInfo target_info = {};
+  auto &color_target_desc = target_info.colorTargetDescriptions;
   color_target_desc.resize(1);
   color_target_desc[0].format = v->ColorTargetFormat;
   color_target_desc[0].blendState = blend_state;
-
-  px::TargetInfo target_info = {v->Allocator};
-  target_info.colorTargetDescriptions = color_target_desc;
   target_info.hasDepthStencilTarget = false;
 
   px::GraphicsPipeline::CreateInfo pipeline_info = {v->Allocator};
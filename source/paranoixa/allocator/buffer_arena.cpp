@@ -0,0 +1,74 @@
+#include "buffer_arena.hpp"
+
+#include <bit>
+
+namespace paranoixa {
+BufferArena::BufferArena(const CreateInfo &createInfo)
+    : createInfo(createInfo), blocks(createInfo.allocator), statistics() {
+  assert(createInfo.device != nullptr);
+  assert(createInfo.blockSize > 0);
+  assert(std::has_single_bit(createInfo.alignment));
+  assert(createInfo.maxAllocationsPerBlock > 0);
+}
+
+BufferArena::Allocation BufferArena::Allocate(uint32 size) {
+  if (size == 0) {
+    // The offset allocator fails zero-sized requests in every block, so
+    // each call would create a new one
+    return {};
+  }
+  auto alignment = createInfo.alignment;
+  // Every size is a multiple of the alignment, so every offset is aligned
+  auto alignedSize = (size + alignment - 1) & ~(alignment - 1);
+  for (uint32 i = 0; i < blocks.size(); ++i) {
+    auto allocation = blocks[i]->offsetAllocator.Allocate(alignedSize);
+    if (allocation.offset != OffsetAllocator::NO_SPACE) {
+      statistics.numAllocations++;
+      statistics.allocatedBytes += alignedSize;
+      return {{blocks[i]->buffer, allocation.offset, size}, i, allocation};
+    }
+  }
+
+  auto block = CreateBlock(std::max(alignedSize, createInfo.blockSize));
+  if (block == nullptr) {
+    return {};
+  }
+  auto allocation = block->offsetAllocator.Allocate(alignedSize);
+  assert(allocation.offset != OffsetAllocator::NO_SPACE);
+  blocks.push_back(block);
+  statistics.numAllocations++;
+  statistics.allocatedBytes += alignedSize;
+  return {{block->buffer, allocation.offset, size},
+          static_cast<uint32>(blocks.size() - 1),
+          allocation};
+}
+
+void BufferArena::Free(const Allocation &allocation) {
+  if (allocation.region.buffer == nullptr) {
+    return;
+  }
+  auto alignment = createInfo.alignment;
+  auto alignedSize =
+      (allocation.region.size + alignment - 1) & ~(alignment - 1);
+  blocks[allocation.block]->offsetAllocator.Free(allocation.allocation);
+  statistics.numAllocations--;
+  statistics.allocatedBytes -= alignedSize;
+}
+
+Ptr<BufferArena::Block> BufferArena::CreateBlock(uint32 size) {
+  Buffer::CreateInfo bufferCI{
+      .allocator = createInfo.allocator,
+      .usage = createInfo.usage,
+      .size = size,
+  };
+  auto buffer = createInfo.device->CreateBuffer(bufferCI);
+  if (buffer == nullptr) {
+    return nullptr;
+  }
+  statistics.numBlocks++;
+  statistics.reservedBytes += size;
+  return MakePtr<Block>(createInfo.allocator, buffer,
+                        OffsetAllocator(createInfo.allocator, size,
+                                        createInfo.maxAllocationsPerBlock));
+}
+} // namespace paranoixa
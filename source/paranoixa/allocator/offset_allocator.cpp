@@ -0,0 +1,231 @@
+#include "offset_allocator.hpp"
+
+#include <bit>
+
+namespace paranoixa {
+namespace {
+constexpr uint32 MANTISSA_BITS = 3;
+constexpr uint32 MANTISSA_VALUE = 1 << MANTISSA_BITS;
+constexpr uint32 MANTISSA_MASK = MANTISSA_VALUE - 1;
+constexpr uint32 TOP_BINS_INDEX_SHIFT = 3;
+constexpr uint32 LEAF_BINS_INDEX_MASK = 0x7;
+
+// Sizes are encoded as tiny floats with a 3 bit mantissa and a 5 bit
+// exponent. Rounding up when allocating guarantees that every range in the
+// chosen bin fits, rounding down when inserting keeps ranges in the bin
+// whose lower bound they reach.
+uint32 SizeToBin(uint32 size, bool roundUp) {
+  if (size < MANTISSA_VALUE) {
+    return size;
+  }
+  uint32 highestSetBit = 31 - std::countl_zero(size);
+  uint32 mantissaStartBit = highestSetBit - MANTISSA_BITS;
+  uint32 exponent = mantissaStartBit + 1;
+  uint32 mantissa = (size >> mantissaStartBit) & MANTISSA_MASK;
+  uint32 lowBitsMask = (1u << mantissaStartBit) - 1;
+  if (roundUp && (size & lowBitsMask) != 0) {
+    // Overflowing the mantissa carries into the exponent
+    mantissa++;
+  }
+  return (exponent << MANTISSA_BITS) + mantissa;
+}
+uint32 BinToSize(uint32 bin) {
+  uint32 exponent = bin >> MANTISSA_BITS;
+  uint32 mantissa = bin & MANTISSA_MASK;
+  if (exponent == 0) {
+    return mantissa;
+  }
+  return (mantissa | MANTISSA_VALUE) << (exponent - 1);
+}
+uint32 FindLowestSetBitAfter(uint32 mask, uint32 startBit) {
+  if (startBit >= 32) {
+    return OffsetAllocator::NO_SPACE;
+  }
+  uint32 maskAfter = mask & ~((1u << startBit) - 1);
+  if (maskAfter == 0) {
+    return OffsetAllocator::NO_SPACE;
+  }
+  return std::countr_zero(maskAfter);
+}
+} // namespace
+
+OffsetAllocator::OffsetAllocator(Allocator *allocator, uint32 size,
+                                 uint32 maxAllocations)
+    : size(size), freeStorage(0), usedBinsTop(0), usedBins{},
+      nodes(allocator), freeNodes(allocator) {
+  assert(maxAllocations > 0);
+  for (auto &binIndex : binIndices) {
+    binIndex = UNUSED;
+  }
+  // One more node than allocations for the trailing free range
+  nodes.resize(maxAllocations + 1);
+  freeNodes.reserve(maxAllocations + 1);
+  for (uint32 i = 0; i < maxAllocations + 1; ++i) {
+    freeNodes.push_back(maxAllocations - i);
+  }
+  InsertNodeIntoBin(size, 0);
+}
+
+OffsetAllocator::Allocation OffsetAllocator::Allocate(uint32 size) {
+  // Splitting off the remainder needs a spare node
+  if (freeNodes.empty() || size == 0) {
+    return {};
+  }
+  uint32 minBinIndex = SizeToBin(size, true);
+  uint32 minTopBinIndex = minBinIndex >> TOP_BINS_INDEX_SHIFT;
+  uint32 minLeafBinIndex = minBinIndex & LEAF_BINS_INDEX_MASK;
+
+  uint32 topBinIndex = minTopBinIndex;
+  uint32 leafBinIndex = NO_SPACE;
+  if (usedBinsTop & (1u << topBinIndex)) {
+    leafBinIndex =
+        FindLowestSetBitAfter(usedBins[topBinIndex], minLeafBinIndex);
+  }
+  // Any bin of a larger top bin fits
+  if (leafBinIndex == NO_SPACE) {
+    topBinIndex = FindLowestSetBitAfter(usedBinsTop, minTopBinIndex + 1);
+    if (topBinIndex == NO_SPACE) {
+      return {};
+    }
+    leafBinIndex = std::countr_zero(static_cast<uint32>(usedBins[topBinIndex]));
+  }
+  uint32 binIndex = (topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex;
+
+  uint32 nodeIndex = binIndices[binIndex];
+  auto &node = nodes[nodeIndex];
+  uint32 nodeTotalSize = node.dataSize;
+  node.dataSize = size;
+  node.used = true;
+  binIndices[binIndex] = node.binListNext;
+  if (node.binListNext != UNUSED) {
+    nodes[node.binListNext].binListPrev = UNUSED;
+  }
+  freeStorage -= nodeTotalSize;
+  if (binIndices[binIndex] == UNUSED) {
+    usedBins[topBinIndex] &= ~(1u << leafBinIndex);
+    if (usedBins[topBinIndex] == 0) {
+      usedBinsTop &= ~(1u << topBinIndex);
+    }
+  }
+
+  // Return the rest of the range to the bins
+  uint32 remainder = nodeTotalSize - size;
+  if (remainder > 0) {
+    uint32 newNodeIndex = InsertNodeIntoBin(remainder, node.dataOffset + size);
+    if (node.neighborNext != UNUSED) {
+      nodes[node.neighborNext].neighborPrev = newNodeIndex;
+    }
+    nodes[newNodeIndex].neighborPrev = nodeIndex;
+    nodes[newNodeIndex].neighborNext = node.neighborNext;
+    node.neighborNext = newNodeIndex;
+  }
+  return {node.dataOffset, nodeIndex};
+}
+
+void OffsetAllocator::Free(const Allocation &allocation) {
+  if (allocation.metadata == NO_SPACE) {
+    return;
+  }
+  uint32 nodeIndex = allocation.metadata;
+  auto &node = nodes[nodeIndex];
+  assert(node.used);
+
+  uint32 offset = node.dataOffset;
+  uint32 size = node.dataSize;
+  // Merge with free neighbors
+  if (node.neighborPrev != UNUSED && !nodes[node.neighborPrev].used) {
+    auto &prevNode = nodes[node.neighborPrev];
+    offset = prevNode.dataOffset;
+    size += prevNode.dataSize;
+    RemoveNodeFromBin(node.neighborPrev);
+    node.neighborPrev = prevNode.neighborPrev;
+  }
+  if (node.neighborNext != UNUSED && !nodes[node.neighborNext].used) {
+    auto &nextNode = nodes[node.neighborNext];
+    size += nextNode.dataSize;
+    RemoveNodeFromBin(node.neighborNext);
+    node.neighborNext = nextNode.neighborNext;
+  }
+  uint32 neighborPrev = node.neighborPrev;
+  uint32 neighborNext = node.neighborNext;
+  node.used = false;
+  freeNodes.push_back(nodeIndex);
+
+  uint32 combinedNodeIndex = InsertNodeIntoBin(size, offset);
+  if (neighborNext != UNUSED) {
+    nodes[combinedNodeIndex].neighborNext = neighborNext;
+    nodes[neighborNext].neighborPrev = combinedNodeIndex;
+  }
+  if (neighborPrev != UNUSED) {
+    nodes[combinedNodeIndex].neighborPrev = neighborPrev;
+    nodes[neighborPrev].neighborNext = combinedNodeIndex;
+  }
+}
+
+uint32 OffsetAllocator::GetLargestFreeRegion() const {
+  if (usedBinsTop == 0) {
+    return 0;
+  }
+  uint32 topBinIndex = 31 - std::countl_zero(usedBinsTop);
+  uint32 leafBinIndex =
+      31 - std::countl_zero(static_cast<uint32>(usedBins[topBinIndex]));
+  // Lower bound of the largest bin in use
+  return BinToSize((topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex);
+}
+
+uint32 OffsetAllocator::InsertNodeIntoBin(uint32 size, uint32 dataOffset) {
+  uint32 binIndex = SizeToBin(size, false);
+  uint32 topBinIndex = binIndex >> TOP_BINS_INDEX_SHIFT;
+  uint32 leafBinIndex = binIndex & LEAF_BINS_INDEX_MASK;
+  if (binIndices[binIndex] == UNUSED) {
+    usedBins[topBinIndex] |= 1u << leafBinIndex;
+    usedBinsTop |= 1u << topBinIndex;
+  }
+
+  uint32 topNodeIndex = binIndices[binIndex];
+  uint32 nodeIndex = freeNodes.back();
+  freeNodes.pop_back();
+  nodes[nodeIndex] = {
+      .dataOffset = dataOffset,
+      .dataSize = size,
+      .binListPrev = UNUSED,
+      .binListNext = topNodeIndex,
+      .neighborPrev = UNUSED,
+      .neighborNext = UNUSED,
+      .used = false,
+  };
+  if (topNodeIndex != UNUSED) {
+    nodes[topNodeIndex].binListPrev = nodeIndex;
+  }
+  binIndices[binIndex] = nodeIndex;
+  freeStorage += size;
+  return nodeIndex;
+}
+
+void OffsetAllocator::RemoveNodeFromBin(uint32 nodeIndex) {
+  auto &node = nodes[nodeIndex];
+  if (node.binListPrev != UNUSED) {
+    nodes[node.binListPrev].binListNext = node.binListNext;
+    if (node.binListNext != UNUSED) {
+      nodes[node.binListNext].binListPrev = node.binListPrev;
+    }
+  } else {
+    // Head of its bin
+    uint32 binIndex = SizeToBin(node.dataSize, false);
+    uint32 topBinIndex = binIndex >> TOP_BINS_INDEX_SHIFT;
+    uint32 leafBinIndex = binIndex & LEAF_BINS_INDEX_MASK;
+    binIndices[binIndex] = node.binListNext;
+    if (node.binListNext != UNUSED) {
+      nodes[node.binListNext].binListPrev = UNUSED;
+    }
+    if (binIndices[binIndex] == UNUSED) {
+      usedBins[topBinIndex] &= ~(1u << leafBinIndex);
+      if (usedBins[topBinIndex] == 0) {
+        usedBinsTop &= ~(1u << topBinIndex);
+      }
+    }
+  }
+  freeNodes.push_back(nodeIndex);
+  freeStorage -= node.dataSize;
+}
+} // namespace paranoixa
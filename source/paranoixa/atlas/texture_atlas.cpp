@@ -0,0 +1,240 @@
+#include "texture_atlas.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace paranoixa {
+namespace {
+constexpr uint32 STAGING_BUFFER_SIZE = 1024 * 1024;
+} // namespace
+
+TextureAtlas::TextureAtlas(const CreateInfo &createInfo)
+    : createInfo(createInfo),
+      uploadBatcher({createInfo.allocator, createInfo.device,
+                     STAGING_BUFFER_SIZE}),
+      texture(nullptr), layers(createInfo.allocator),
+      entries(createInfo.allocator), nextHandle(1), frame(0), statistics() {
+  assert(createInfo.device != nullptr);
+  assert(createInfo.numLayers > 0);
+  assert(GetTextureFormatInfo(createInfo.format).blockWidth == 1);
+  // A single level, mips of a packed atlas would mix neighboring entries
+  Texture::CreateInfo textureCI{
+      .allocator = createInfo.allocator,
+      .type = TextureType::Texture2DArray,
+      .format = createInfo.format,
+      .usage = TextureUsage::Sampler,
+      .width = createInfo.width,
+      .height = createInfo.height,
+      .layerCountOrDepth = createInfo.numLayers,
+      .numLevels = 1,
+      .sampleCount = SampleCount::x1,
+  };
+  texture = createInfo.device->CreateTexture(textureCI);
+  assert(texture != nullptr);
+
+  for (uint32 i = 0; i < createInfo.numLayers; ++i) {
+    layers.push_back({Array<SkylineNode>(createInfo.allocator), 0, 0});
+    layers.back().skyline.push_back({0, 0, createInfo.width});
+  }
+  statistics.totalArea = static_cast<std::uint64_t>(createInfo.width) *
+                         createInfo.height * createInfo.numLayers;
+}
+
+TextureAtlas::Handle TextureAtlas::Add(const void *data, uint32 width,
+                                       uint32 height) {
+  assert(data != nullptr);
+  auto paddedWidth = width + 2 * createInfo.padding;
+  auto paddedHeight = height + 2 * createInfo.padding;
+  if (width == 0 || height == 0 || paddedWidth > createInfo.width ||
+      paddedHeight > createInfo.height) {
+    return INVALID_HANDLE;
+  }
+
+  uint32 layerIndex = 0;
+  uint32 x = 0, y = 0;
+  for (; layerIndex < layers.size(); ++layerIndex) {
+    if (Pack(layers[layerIndex], paddedWidth, paddedHeight, x, y))
+      break;
+  }
+  if (layerIndex == layers.size()) {
+    // Evict the least recently used layer that is not drawn this frame
+    auto it = std::min_element(layers.begin(), layers.end(),
+                               [](const Layer &a, const Layer &b) {
+                                 return a.lastUsedFrame < b.lastUsedFrame;
+                               });
+    if (it->lastUsedFrame == frame && it->numEntries > 0) {
+      return INVALID_HANDLE;
+    }
+    layerIndex = static_cast<uint32>(it - layers.begin());
+    statistics.numEvictions += it->numEntries;
+    ResetLayer(layerIndex);
+    [[maybe_unused]] bool packed =
+        Pack(layers[layerIndex], paddedWidth, paddedHeight, x, y);
+    assert(packed);
+  }
+
+  auto &layer = layers[layerIndex];
+  layer.numEntries++;
+  layer.lastUsedFrame = frame;
+  Entry entry{
+      .layer = layerIndex,
+      .x = x + createInfo.padding,
+      .y = y + createInfo.padding,
+      .width = width,
+      .height = height,
+  };
+  entry.uv = {
+      static_cast<float>(entry.x) / createInfo.width,
+      static_cast<float>(entry.y) / createInfo.height,
+      static_cast<float>(entry.x + width) / createInfo.width,
+      static_cast<float>(entry.y + height) / createInfo.height,
+  };
+  auto handle = nextHandle++;
+  entries[handle] = entry;
+  statistics.numEntries++;
+  statistics.usedArea += static_cast<std::uint64_t>(paddedWidth) *
+                         paddedHeight;
+
+  // The padding is uploaded too, filled with the edge texels of the image.
+  // Filtering at the edge then samples the image itself, not a neighbor or
+  // whatever a reset layer held before.
+  TextureRegion region{
+      .texture = texture,
+      .mipLevel = 0,
+      .layer = layerIndex,
+      .x = x,
+      .y = y,
+      .z = 0,
+      .width = paddedWidth,
+      .height = paddedHeight,
+      .depth = 1,
+  };
+  auto texelSize = GetTextureFormatInfo(createInfo.format).blockSize;
+  auto padding = createInfo.padding;
+  uploadBatcher.UploadTexture(
+      CalculateTextureSize(createInfo.format, paddedWidth, paddedHeight, 1),
+      region, [&](void *staging) {
+        auto *src = static_cast<const std::byte *>(data);
+        auto *dst = static_cast<std::byte *>(staging);
+        auto rowSize = width * texelSize;
+        for (uint32 row = 0; row < paddedHeight; ++row) {
+          auto srcRow = std::clamp(row, padding, padding + height - 1) -
+                        padding;
+          auto *srcTexels = src + srcRow * rowSize;
+          auto *dstTexels = dst + row * paddedWidth * texelSize;
+          for (uint32 i = 0; i < padding; ++i) {
+            std::memcpy(dstTexels + i * texelSize, srcTexels, texelSize);
+            std::memcpy(dstTexels + (padding + width + i) * texelSize,
+                        srcTexels + rowSize - texelSize, texelSize);
+          }
+          std::memcpy(dstTexels + padding * texelSize, srcTexels, rowSize);
+        }
+      });
+  return handle;
+}
+
+void TextureAtlas::Remove(Handle handle) {
+  auto it = entries.find(handle);
+  if (it == entries.end())
+    return;
+  auto layerIndex = it->second.layer;
+  auto paddedWidth = it->second.width + 2 * createInfo.padding;
+  auto paddedHeight = it->second.height + 2 * createInfo.padding;
+  entries.erase(it);
+  statistics.numEntries--;
+  statistics.usedArea -= static_cast<std::uint64_t>(paddedWidth) *
+                         paddedHeight;
+  // The skyline cannot reclaim single rectangles, only whole layers
+  if (--layers[layerIndex].numEntries == 0) {
+    ResetLayer(layerIndex);
+  }
+}
+
+const TextureAtlas::Entry *TextureAtlas::Get(Handle handle) {
+  auto it = entries.find(handle);
+  if (it == entries.end())
+    return nullptr;
+  layers[it->second.layer].lastUsedFrame = frame;
+  return &it->second;
+}
+
+void TextureAtlas::Update() {
+  uploadBatcher.Flush();
+  frame++;
+}
+
+bool TextureAtlas::Pack(Layer &layer, uint32 width, uint32 height, uint32 &x,
+                        uint32 &y) {
+  auto &skyline = layer.skyline;
+  uint32 bestIndex = 0;
+  uint32 bestY = std::numeric_limits<uint32>::max();
+  uint32 bestWidth = std::numeric_limits<uint32>::max();
+  for (uint32 i = 0; i < skyline.size(); ++i) {
+    if (skyline[i].x + width > createInfo.width)
+      break;
+    // The rectangle rests on the highest node it spans
+    uint32 top = 0;
+    uint32 remaining = width;
+    for (uint32 j = i; remaining > 0; ++j) {
+      top = std::max(top, skyline[j].y);
+      remaining -= std::min(remaining, skyline[j].width);
+    }
+    if (top + height > createInfo.height)
+      continue;
+    if (top < bestY || (top == bestY && skyline[i].width < bestWidth)) {
+      bestIndex = i;
+      bestY = top;
+      bestWidth = skyline[i].width;
+    }
+  }
+  if (bestY == std::numeric_limits<uint32>::max()) {
+    return false;
+  }
+  x = skyline[bestIndex].x;
+  y = bestY;
+
+  skyline.insert(skyline.begin() + bestIndex, {x, y + height, width});
+  // Trim the nodes now covered by the new one
+  for (uint32 i = bestIndex + 1; i < skyline.size();) {
+    auto &previous = skyline[i - 1];
+    auto previousEnd = previous.x + previous.width;
+    if (skyline[i].x >= previousEnd)
+      break;
+    auto overlap = previousEnd - skyline[i].x;
+    if (skyline[i].width <= overlap) {
+      skyline.erase(skyline.begin() + i);
+      continue;
+    }
+    skyline[i].x += overlap;
+    skyline[i].width -= overlap;
+    break;
+  }
+  // Merge neighbors of the same height
+  for (uint32 i = 0; i + 1 < skyline.size();) {
+    if (skyline[i].y == skyline[i + 1].y) {
+      skyline[i].width += skyline[i + 1].width;
+      skyline.erase(skyline.begin() + i + 1);
+    } else {
+      ++i;
+    }
+  }
+  return true;
+}
+
+void TextureAtlas::ResetLayer(uint32 layerIndex) {
+  std::erase_if(entries, [&](const auto &pair) {
+    if (pair.second.layer != layerIndex)
+      return false;
+    statistics.numEntries--;
+    statistics.usedArea -=
+        static_cast<std::uint64_t>(pair.second.width + 2 * createInfo.padding) *
+        (pair.second.height + 2 * createInfo.padding);
+    return true;
+  });
+  auto &layer = layers[layerIndex];
+  layer.skyline.clear();
+  layer.skyline.push_back({0, 0, createInfo.width});
+  layer.numEntries = 0;
+}
+} // namespace paranoixa
@@ -0,0 +1,438 @@
+#include "image.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <array>
+#include <bit>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PARANOIXA_IMAGE_SSE2
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define PARANOIXA_TARGET_AVX2
+#else
+#define PARANOIXA_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PARANOIXA_IMAGE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace paranoixa::image {
+namespace {
+#ifdef PARANOIXA_IMAGE_SSE2
+// Every AVX2 capable CPU also supports F16C
+bool HasAVX2() {
+  static const bool hasAVX2 = SDL_HasAVX2();
+  return hasAVX2;
+}
+#endif
+
+std::uint32_t Load32(const std::uint8_t *p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+void Store32(std::uint8_t *p, std::uint32_t value) {
+  std::memcpy(p, &value, sizeof(value));
+}
+// Exact round(value / 255) for value in [0, 255 * 255]
+std::uint32_t DivideBy255(std::uint32_t value) {
+  value += 128;
+  return (value + (value >> 8)) >> 8;
+}
+
+void SwizzleScalar(std::uint8_t *dst, const std::uint8_t *src,
+                   std::size_t numPixels) {
+  for (std::size_t i = 0; i < numPixels; ++i) {
+    auto pixel = Load32(src + i * 4);
+    Store32(dst + i * 4, (pixel & 0xFF00FF00) | ((pixel >> 16) & 0xFF) |
+                             ((pixel & 0xFF) << 16));
+  }
+}
+void ExpandScalar(std::uint8_t *dst, const std::uint8_t *src,
+                  std::size_t numPixels, uint8 alpha) {
+  for (std::size_t i = 0; i < numPixels; ++i) {
+    dst[i * 4 + 0] = src[i * 3 + 0];
+    dst[i * 4 + 1] = src[i * 3 + 1];
+    dst[i * 4 + 2] = src[i * 3 + 2];
+    dst[i * 4 + 3] = alpha;
+  }
+}
+void PremultiplyScalar(std::uint8_t *dst, const std::uint8_t *src,
+                       std::size_t numPixels) {
+  for (std::size_t i = 0; i < numPixels; ++i) {
+    std::uint32_t alpha = src[i * 4 + 3];
+    dst[i * 4 + 0] = static_cast<uint8>(DivideBy255(src[i * 4 + 0] * alpha));
+    dst[i * 4 + 1] = static_cast<uint8>(DivideBy255(src[i * 4 + 1] * alpha));
+    dst[i * 4 + 2] = static_cast<uint8>(DivideBy255(src[i * 4 + 2] * alpha));
+    dst[i * 4 + 3] = static_cast<uint8>(alpha);
+  }
+}
+std::uint16_t FloatToHalfScalar(float value) {
+  auto bits = std::bit_cast<std::uint32_t>(value);
+  std::uint32_t sign = (bits >> 16) & 0x8000;
+  std::uint32_t magnitude = bits & 0x7FFFFFFF;
+  // Inf and NaN. NaNs stay quiet.
+  if (magnitude >= 0x7F800000) {
+    return static_cast<std::uint16_t>(
+        sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+  }
+  // 65520 and above round to infinity
+  if (magnitude >= 0x477FF000) {
+    return static_cast<std::uint16_t>(sign | 0x7C00);
+  }
+  // Below 2^-14 the result is subnormal
+  if (magnitude < 0x38800000) {
+    if (magnitude < 0x33000000) {
+      return static_cast<std::uint16_t>(sign);
+    }
+    std::uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+    std::uint32_t shift = 126 - (magnitude >> 23);
+    std::uint32_t half = mantissa >> shift;
+    std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+    std::uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1))) {
+      half++;
+    }
+    return static_cast<std::uint16_t>(sign | half);
+  }
+  // Rebias the exponent from 127 to 15
+  std::uint32_t half = (magnitude - 0x38000000) >> 13;
+  std::uint32_t remainder = magnitude & 0x1FFF;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+    half++;
+  }
+  return static_cast<std::uint16_t>(sign | half);
+}
+float HalfToFloatScalar(std::uint16_t value) {
+  std::uint32_t sign = static_cast<std::uint32_t>(value & 0x8000) << 16;
+  std::uint32_t exponent = (value >> 10) & 0x1F;
+  std::uint32_t mantissa = value & 0x3FF;
+  if (exponent == 0) {
+    // Zero and subnormals are exact in single precision
+    auto magnitude = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+    return std::bit_cast<float>(sign | std::bit_cast<std::uint32_t>(magnitude));
+  }
+  if (exponent == 31) {
+    return std::bit_cast<float>(sign | 0x7F800000 | (mantissa << 13));
+  }
+  return std::bit_cast<float>(sign | ((exponent + 112) << 23) |
+                              (mantissa << 13));
+}
+
+#ifdef PARANOIXA_IMAGE_SSE2
+std::size_t SwizzleSSE2(std::uint8_t *dst, const std::uint8_t *src,
+                        std::size_t numPixels) {
+  const __m128i keep = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+  const __m128i low = _mm_set1_epi32(0xFF);
+  std::size_t i = 0;
+  for (; i + 4 <= numPixels; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+    __m128i r = _mm_and_si128(_mm_srli_epi32(v, 16), low);
+    __m128i b = _mm_slli_epi32(_mm_and_si128(v, low), 16);
+    v = _mm_or_si128(_mm_and_si128(v, keep), _mm_or_si128(r, b));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), v);
+  }
+  return i;
+}
+PARANOIXA_TARGET_AVX2
+std::size_t SwizzleAVX2(std::uint8_t *dst, const std::uint8_t *src,
+                        std::size_t numPixels) {
+  const __m256i shuffle =
+      _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2,
+                       1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  std::size_t i = 0;
+  for (; i + 8 <= numPixels; i += 8) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4),
+                        _mm256_shuffle_epi8(v, shuffle));
+  }
+  return i;
+}
+PARANOIXA_TARGET_AVX2
+std::size_t ExpandAVX2(std::uint8_t *dst, const std::uint8_t *src,
+                       std::size_t numPixels, uint8 alpha) {
+  // Spreads four RGB pixels over 16 bytes, leaving the alpha bytes zero
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1,
+                                        9, 10, 11, -1);
+  const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(alpha) << 24);
+  std::size_t i = 0;
+  for (; i + 16 <= numPixels; i += 16) {
+    auto *in = reinterpret_cast<const __m128i *>(src + i * 3);
+    auto *out = reinterpret_cast<__m128i *>(dst + i * 4);
+    __m128i a = _mm_loadu_si128(in + 0);
+    __m128i b = _mm_loadu_si128(in + 1);
+    __m128i c = _mm_loadu_si128(in + 2);
+    __m128i p0 = a;
+    __m128i p1 = _mm_alignr_epi8(b, a, 12);
+    __m128i p2 = _mm_alignr_epi8(c, b, 8);
+    __m128i p3 = _mm_srli_si128(c, 4);
+    _mm_storeu_si128(out + 0,
+                     _mm_or_si128(_mm_shuffle_epi8(p0, shuffle), alphaMask));
+    _mm_storeu_si128(out + 1,
+                     _mm_or_si128(_mm_shuffle_epi8(p1, shuffle), alphaMask));
+    _mm_storeu_si128(out + 2,
+                     _mm_or_si128(_mm_shuffle_epi8(p2, shuffle), alphaMask));
+    _mm_storeu_si128(out + 3,
+                     _mm_or_si128(_mm_shuffle_epi8(p3, shuffle), alphaMask));
+  }
+  return i;
+}
+__m128i PremultiplyHalfSSE2(__m128i pixels) {
+  // Alpha of each pixel in all four lanes, 255 in the alpha lane itself
+  const __m128i alphaLane = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+  __m128i alpha = _mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm_or_si128(alpha, alphaLane);
+  __m128i t =
+      _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+std::size_t PremultiplySSE2(std::uint8_t *dst, const std::uint8_t *src,
+                            std::size_t numPixels) {
+  const __m128i zero = _mm_setzero_si128();
+  std::size_t i = 0;
+  for (; i + 4 <= numPixels; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+    __m128i lo = PremultiplyHalfSSE2(_mm_unpacklo_epi8(v, zero));
+    __m128i hi = PremultiplyHalfSSE2(_mm_unpackhi_epi8(v, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4),
+                     _mm_packus_epi16(lo, hi));
+  }
+  return i;
+}
+PARANOIXA_TARGET_AVX2
+__m256i PremultiplyHalfAVX2(__m256i pixels) {
+  const __m256i alphaLane = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255,
+                                             0, 0, 0, 255, 0, 0, 0);
+  __m256i alpha = _mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm256_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm256_or_si256(alpha, alphaLane);
+  __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(pixels, alpha),
+                               _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+PARANOIXA_TARGET_AVX2
+std::size_t PremultiplyAVX2(std::uint8_t *dst, const std::uint8_t *src,
+                            std::size_t numPixels) {
+  const __m256i zero = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for (; i + 8 <= numPixels; i += 8) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+    // Unpack and pack both work per 128-bit lane, so pixel order is kept
+    __m256i lo = PremultiplyHalfAVX2(_mm256_unpacklo_epi8(v, zero));
+    __m256i hi = PremultiplyHalfAVX2(_mm256_unpackhi_epi8(v, zero));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4),
+                        _mm256_packus_epi16(lo, hi));
+  }
+  return i;
+}
+PARANOIXA_TARGET_AVX2
+std::size_t FloatToHalfAVX2(std::uint16_t *dst, const float *src,
+                            std::size_t count) {
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+                                   _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), half);
+  }
+  return i;
+}
+PARANOIXA_TARGET_AVX2
+std::size_t HalfToFloatAVX2(float *dst, const std::uint16_t *src,
+                            std::size_t count) {
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(half));
+  }
+  return i;
+}
+#endif // PARANOIXA_IMAGE_SSE2
+
+#ifdef PARANOIXA_IMAGE_NEON
+std::size_t SwizzleNEON(std::uint8_t *dst, const std::uint8_t *src,
+                        std::size_t numPixels) {
+  std::size_t i = 0;
+  for (; i + 16 <= numPixels; i += 16) {
+    uint8x16x4_t v = vld4q_u8(src + i * 4);
+    std::swap(v.val[0], v.val[2]);
+    vst4q_u8(dst + i * 4, v);
+  }
+  return i;
+}
+std::size_t ExpandNEON(std::uint8_t *dst, const std::uint8_t *src,
+                       std::size_t numPixels, uint8 alpha) {
+  std::size_t i = 0;
+  for (; i + 16 <= numPixels; i += 16) {
+    uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+    uint8x16x4_t rgba = {rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(alpha)};
+    vst4q_u8(dst + i * 4, rgba);
+  }
+  return i;
+}
+uint8x8_t MultiplyDivide255NEON(uint8x8_t color, uint8x8_t alpha) {
+  uint16x8_t product = vmull_u8(color, alpha);
+  return vrshrn_n_u16(vrsraq_n_u16(product, product, 8), 8);
+}
+std::size_t PremultiplyNEON(std::uint8_t *dst, const std::uint8_t *src,
+                            std::size_t numPixels) {
+  std::size_t i = 0;
+  for (; i + 16 <= numPixels; i += 16) {
+    uint8x16x4_t v = vld4q_u8(src + i * 4);
+    for (int c = 0; c < 3; ++c) {
+      v.val[c] = vcombine_u8(
+          MultiplyDivide255NEON(vget_low_u8(v.val[c]), vget_low_u8(v.val[3])),
+          MultiplyDivide255NEON(vget_high_u8(v.val[c]),
+                                vget_high_u8(v.val[3])));
+    }
+    vst4q_u8(dst + i * 4, v);
+  }
+  return i;
+}
+std::size_t FloatToHalfNEON(std::uint16_t *dst, const float *src,
+                            std::size_t count) {
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    float16x4_t half = vcvt_f16_f32(vld1q_f32(src + i));
+    vst1_u16(dst + i, vreinterpret_u16_f16(half));
+  }
+  return i;
+}
+std::size_t HalfToFloatNEON(float *dst, const std::uint16_t *src,
+                            std::size_t count) {
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    float16x4_t half = vreinterpret_f16_u16(vld1_u16(src + i));
+    vst1q_f32(dst + i, vcvt_f32_f16(half));
+  }
+  return i;
+}
+#endif // PARANOIXA_IMAGE_NEON
+
+float DecodeSRGB(float value) {
+  return value <= 0.04045f ? value / 12.92f
+                           : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+float EncodeSRGB(float value) {
+  return value <= 0.0031308f ? value * 12.92f
+                             : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+// Fine enough that every table entry rounds to the exact 8-bit encoding
+constexpr std::size_t LINEAR_TO_SRGB_TABLE_SIZE = 1 << 14;
+// Below this a thread converts too little to pay for its start
+constexpr std::size_t MIN_BYTES_PER_THREAD = 1 << 20;
+} // namespace
+
+uint32 GetThreadCount(std::size_t numBytes) {
+  auto numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  return static_cast<uint32>(
+      std::clamp<std::size_t>(numBytes / MIN_BYTES_PER_THREAD, 1, numThreads));
+}
+void SwizzleBGRAToRGBA(void *dst, const void *src, std::size_t numPixels) {
+  auto *out = static_cast<std::uint8_t *>(dst);
+  auto *in = static_cast<const std::uint8_t *>(src);
+  std::size_t done = 0;
+#if defined(PARANOIXA_IMAGE_SSE2)
+  done = HasAVX2() ? SwizzleAVX2(out, in, numPixels)
+                   : SwizzleSSE2(out, in, numPixels);
+#elif defined(PARANOIXA_IMAGE_NEON)
+  done = SwizzleNEON(out, in, numPixels);
+#endif
+  SwizzleScalar(out + done * 4, in + done * 4, numPixels - done);
+}
+
+void ExpandRGBToRGBA(void *dst, const void *src, std::size_t numPixels,
+                     uint8 alpha) {
+  auto *out = static_cast<std::uint8_t *>(dst);
+  auto *in = static_cast<const std::uint8_t *>(src);
+  std::size_t done = 0;
+#if defined(PARANOIXA_IMAGE_SSE2)
+  // SSE2 has no byte shuffle, so without AVX2 this stays scalar
+  if (HasAVX2()) {
+    done = ExpandAVX2(out, in, numPixels, alpha);
+  }
+#elif defined(PARANOIXA_IMAGE_NEON)
+  done = ExpandNEON(out, in, numPixels, alpha);
+#endif
+  ExpandScalar(out + done * 4, in + done * 3, numPixels - done, alpha);
+}
+
+void PremultiplyAlpha(void *dst, const void *src, std::size_t numPixels) {
+  auto *out = static_cast<std::uint8_t *>(dst);
+  auto *in = static_cast<const std::uint8_t *>(src);
+  std::size_t done = 0;
+#if defined(PARANOIXA_IMAGE_SSE2)
+  done = HasAVX2() ? PremultiplyAVX2(out, in, numPixels)
+                   : PremultiplySSE2(out, in, numPixels);
+#elif defined(PARANOIXA_IMAGE_NEON)
+  done = PremultiplyNEON(out, in, numPixels);
+#endif
+  PremultiplyScalar(out + done * 4, in + done * 4, numPixels - done);
+}
+
+// The sRGB transfer function is table driven. Gathers are no faster than
+// scalar loads on current CPUs, so these have no vector paths.
+void SRGBToLinear(float *dst, const uint8 *src, std::size_t count) {
+  static const auto table = [] {
+    std::array<float, 256> table;
+    for (std::size_t i = 0; i < table.size(); ++i) {
+      table[i] = DecodeSRGB(static_cast<float>(i) / 255.0f);
+    }
+    return table;
+  }();
+  for (std::size_t i = 0; i < count; ++i) {
+    dst[i] = table[src[i]];
+  }
+}
+
+void LinearToSRGB(uint8 *dst, const float *src, std::size_t count) {
+  static const auto table = [] {
+    std::array<uint8, LINEAR_TO_SRGB_TABLE_SIZE + 1> table;
+    for (std::size_t i = 0; i < table.size(); ++i) {
+      auto linear = static_cast<float>(i) / LINEAR_TO_SRGB_TABLE_SIZE;
+      table[i] = static_cast<uint8>(EncodeSRGB(linear) * 255.0f + 0.5f);
+    }
+    return table;
+  }();
+  for (std::size_t i = 0; i < count; ++i) {
+    // Also maps NaN to 0
+    auto value = src[i] > 0.0f ? std::min(src[i], 1.0f) : 0.0f;
+    dst[i] = table[static_cast<std::size_t>(
+        value * LINEAR_TO_SRGB_TABLE_SIZE + 0.5f)];
+  }
+}
+
+void FloatToHalf(std::uint16_t *dst, const float *src, std::size_t count) {
+  std::size_t done = 0;
+#if defined(PARANOIXA_IMAGE_SSE2)
+  if (HasAVX2()) {
+    done = FloatToHalfAVX2(dst, src, count);
+  }
+#elif defined(PARANOIXA_IMAGE_NEON)
+  done = FloatToHalfNEON(dst, src, count);
+#endif
+  for (auto i = done; i < count; ++i) {
+    dst[i] = FloatToHalfScalar(src[i]);
+  }
+}
+
+void HalfToFloat(float *dst, const std::uint16_t *src, std::size_t count) {
+  std::size_t done = 0;
+#if defined(PARANOIXA_IMAGE_SSE2)
+  if (HasAVX2()) {
+    done = HalfToFloatAVX2(dst, src, count);
+  }
+#elif defined(PARANOIXA_IMAGE_NEON)
+  done = HalfToFloatNEON(dst, src, count);
+#endif
+  for (auto i = done; i < count; ++i) {
+    dst[i] = HalfToFloatScalar(src[i]);
+  }
+}
+} // namespace paranoixa::image
@@ -0,0 +1,280 @@
+#include "ktx2_loader.hpp"
+#include "mapped_file.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace paranoixa {
+namespace {
+constexpr std::uint8_t KTX2_IDENTIFIER[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+// Satisfies the offset alignment of every texel block
+constexpr std::uint64_t STAGING_ALIGNMENT = 16;
+constexpr std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+struct KTX2Header {
+  std::uint8_t identifier[12];
+  uint32 vkFormat;
+  uint32 typeSize;
+  uint32 pixelWidth;
+  uint32 pixelHeight;
+  uint32 pixelDepth;
+  uint32 layerCount;
+  uint32 faceCount;
+  uint32 levelCount;
+  uint32 supercompressionScheme;
+  uint32 dfdByteOffset;
+  uint32 dfdByteLength;
+  uint32 kvdByteOffset;
+  uint32 kvdByteLength;
+  std::uint64_t sgdByteOffset;
+  std::uint64_t sgdByteLength;
+};
+static_assert(sizeof(KTX2Header) == 80);
+struct KTX2LevelIndex {
+  std::uint64_t byteOffset;
+  std::uint64_t byteLength;
+  std::uint64_t uncompressedByteLength;
+};
+
+// CalculateTextureSize in 64 bits, since the extent in a file is not
+// trusted. Every factor fits in 32 bits, so each product is checked before
+// the next one can wrap. Sizes past 32 bits come back as UINT64_MAX.
+std::uint64_t CalculateImageSize(TextureFormat format, uint32 width,
+                                 uint32 height, uint32 depth) {
+  constexpr std::uint64_t limit = std::numeric_limits<uint32>::max();
+  auto info = GetTextureFormatInfo(format);
+  std::uint64_t blocksPerRow =
+      (static_cast<std::uint64_t>(width) + info.blockWidth - 1) /
+      info.blockWidth;
+  std::uint64_t blocksPerColumn =
+      (static_cast<std::uint64_t>(height) + info.blockHeight - 1) /
+      info.blockHeight;
+  auto size = blocksPerRow * blocksPerColumn;
+  if (size > limit || (size *= depth) > limit ||
+      (size *= info.blockSize) > limit) {
+    return std::numeric_limits<std::uint64_t>::max();
+  }
+  return size;
+}
+
+TextureFormat TextureFormatFromVkFormat(uint32 vkFormat) {
+  // Values of VkFormat
+  switch (vkFormat) {
+  case 37: // VK_FORMAT_R8G8B8A8_UNORM
+    return TextureFormat::R8G8B8A8_UNORM;
+  case 44: // VK_FORMAT_B8G8R8A8_UNORM
+    return TextureFormat::B8G8R8A8_UNORM;
+  case 109: // VK_FORMAT_R32G32B32A32_SFLOAT
+    return TextureFormat::R32G32B32A32_FLOAT;
+  case 133: // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+    return TextureFormat::BC1_RGBA_UNORM;
+  case 137: // VK_FORMAT_BC3_UNORM_BLOCK
+    return TextureFormat::BC3_RGBA_UNORM;
+  case 139: // VK_FORMAT_BC4_UNORM_BLOCK
+    return TextureFormat::BC4_R_UNORM;
+  case 141: // VK_FORMAT_BC5_UNORM_BLOCK
+    return TextureFormat::BC5_RG_UNORM;
+  case 145: // VK_FORMAT_BC7_UNORM_BLOCK
+    return TextureFormat::BC7_RGBA_UNORM;
+  default:
+    return TextureFormat::Invalid;
+  }
+}
+} // namespace
+
+KTX2Loader::KTX2Loader(const CreateInfo &createInfo) : createInfo(createInfo) {
+  assert(createInfo.device != nullptr);
+}
+
+Ptr<Texture> KTX2Loader::Load(const char *filePath, Ptr<CopyPass> copyPass) {
+  MappedFile file;
+  if (!file.Open(filePath)) {
+    return nullptr;
+  }
+  return Load(file.GetData(), file.GetSize(), copyPass);
+}
+
+Ptr<Texture> KTX2Loader::Load(const void *data, std::size_t size,
+                              Ptr<CopyPass> copyPass) {
+  auto *bytes = static_cast<const std::byte *>(data);
+  KTX2Header header;
+  if (size < sizeof(KTX2Header)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "KTX2: file is too small");
+    return nullptr;
+  }
+  std::memcpy(&header, bytes, sizeof(KTX2Header));
+  if (std::memcmp(header.identifier, KTX2_IDENTIFIER,
+                  sizeof(KTX2_IDENTIFIER)) != 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "KTX2: invalid identifier");
+    return nullptr;
+  }
+  if (header.supercompressionScheme != 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "KTX2: supercompression scheme %u is not supported",
+                 header.supercompressionScheme);
+    return nullptr;
+  }
+  auto format = TextureFormatFromVkFormat(header.vkFormat);
+  if (format == TextureFormat::Invalid) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "KTX2: VkFormat %u is not supported", header.vkFormat);
+    return nullptr;
+  }
+  if (header.faceCount != 1 && header.faceCount != 6) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "KTX2: invalid face count");
+    return nullptr;
+  }
+  if (header.pixelWidth == 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "KTX2: invalid width");
+    return nullptr;
+  }
+  // Generating them would need a command buffer outside of the copy pass
+  if (header.levelCount == 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "KTX2: files that ask for generated mips are not supported");
+    return nullptr;
+  }
+  // There are no arrays or cube maps of 3D textures
+  if (header.pixelDepth > 0 &&
+      (header.layerCount > 1 || header.faceCount > 1)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "KTX2: layered 3D textures are not supported");
+    return nullptr;
+  }
+  auto numLevels = header.levelCount;
+  if (numLevels > 32) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "KTX2: invalid level count");
+    return nullptr;
+  }
+  auto levelIndexSize = sizeof(KTX2LevelIndex) * numLevels;
+  if (size < sizeof(KTX2Header) + levelIndexSize) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "KTX2: truncated level index");
+    return nullptr;
+  }
+  Array<KTX2LevelIndex> levels(numLevels, createInfo.allocator);
+  std::memcpy(levels.data(), bytes + sizeof(KTX2Header), levelIndexSize);
+
+  auto numLayers = std::max(header.layerCount, 1u);
+  auto depth = std::max(header.pixelDepth, 1u);
+  Texture::CreateInfo textureCI{
+      .allocator = createInfo.allocator,
+      .format = format,
+      .usage = TextureUsage::Sampler,
+      .width = header.pixelWidth,
+      .height = std::max(header.pixelHeight, 1u),
+      .numLevels = numLevels,
+      .sampleCount = SampleCount::x1,
+  };
+  if (header.pixelDepth > 0) {
+    textureCI.type = TextureType::Texture3D;
+    textureCI.layerCountOrDepth = depth;
+  } else if (header.faceCount == 6) {
+    textureCI.type =
+        header.layerCount > 0 ? TextureType::CubeArray : TextureType::Cube;
+    textureCI.layerCountOrDepth = numLayers * 6;
+  } else {
+    textureCI.type = header.layerCount > 0 ? TextureType::Texture2DArray
+                                           : TextureType::Texture2D;
+    textureCI.layerCountOrDepth = numLayers;
+  }
+
+  // Lay every level out in one staging allocation
+  Array<std::uint64_t> stagingOffsets(numLevels, createInfo.allocator);
+  std::uint64_t stagingSize = 0;
+  for (uint32 level = 0; level < numLevels; ++level) {
+    auto width = std::max(textureCI.width >> level, 1u);
+    auto height = std::max(textureCI.height >> level, 1u);
+    auto levelDepth = std::max(depth >> level, 1u);
+    auto imageSize = CalculateImageSize(format, width, height, levelDepth);
+    auto imageCount = static_cast<std::uint64_t>(numLayers) * header.faceCount;
+    if (imageSize > std::numeric_limits<uint32>::max() ||
+        imageCount > std::numeric_limits<uint32>::max() / imageSize) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "KTX2: texture is too large");
+      return nullptr;
+    }
+    std::uint64_t expected = imageSize * imageCount;
+    auto &index = levels[level];
+    if (index.byteLength < expected || index.byteOffset > size ||
+        index.byteLength > size - index.byteOffset) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "KTX2: level %u is out of bounds", level);
+      return nullptr;
+    }
+    stagingOffsets[level] = stagingSize;
+    stagingSize += AlignUp(expected, STAGING_ALIGNMENT);
+    if (stagingSize > std::numeric_limits<uint32>::max()) {
+      break;
+    }
+  }
+  if (stagingSize > std::numeric_limits<uint32>::max()) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "KTX2: texture is too large");
+    return nullptr;
+  }
+
+  auto &device = createInfo.device;
+  auto texture = device->CreateTexture(textureCI);
+  if (texture == nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "KTX2: failed to create the texture");
+    return nullptr;
+  }
+  TransferBuffer::CreateInfo transferBufferCI{
+      .allocator = createInfo.allocator,
+      .usage = TransferBufferUsage::Upload,
+      .size = static_cast<uint32>(stagingSize),
+  };
+  auto transferBuffer = device->CreateTransferBuffer(transferBufferCI);
+  if (transferBuffer == nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "KTX2: failed to create the staging buffer");
+    return nullptr;
+  }
+  auto *mapped = static_cast<std::byte *>(transferBuffer->Map(false));
+  if (mapped == nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "KTX2: failed to map the staging buffer");
+    return nullptr;
+  }
+  for (uint32 level = 0; level < numLevels; ++level) {
+    auto nextOffset =
+        level + 1 < numLevels ? stagingOffsets[level + 1] : stagingSize;
+    std::memcpy(mapped + stagingOffsets[level],
+                bytes + levels[level].byteOffset,
+                std::min(levels[level].byteLength,
+                         nextOffset - stagingOffsets[level]));
+  }
+  transferBuffer->Unmap();
+
+  for (uint32 level = 0; level < numLevels; ++level) {
+    auto width = std::max(textureCI.width >> level, 1u);
+    auto height = std::max(textureCI.height >> level, 1u);
+    auto levelDepth = std::max(depth >> level, 1u);
+    // Fits in 32 bits, the staging size has been checked
+    auto imageSize = static_cast<uint32>(
+        CalculateImageSize(format, width, height, levelDepth));
+    // Images are stored layer by layer, then face by face
+    for (uint32 image = 0; image < numLayers * header.faceCount; ++image) {
+      TextureTransferInfo src{
+          .transferBuffer = transferBuffer,
+          .offset = static_cast<uint32>(stagingOffsets[level]) +
+                    image * imageSize,
+      };
+      TextureRegion dst{
+          .texture = texture,
+          .mipLevel = level,
+          .layer = textureCI.type == TextureType::Texture3D ? 0 : image,
+          .width = width,
+          .height = height,
+          .depth = levelDepth,
+      };
+      copyPass->UploadTexture(src, dst, false);
+    }
+  }
+  return texture;
+}
+} // namespace paranoixa
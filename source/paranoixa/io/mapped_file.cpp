@@ -0,0 +1,167 @@
+#include "mapped_file.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <cstring>
+#include <limits>
+
+#ifdef PARANOIXA_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace paranoixa {
+MappedFile::MappedFile()
+    : data(nullptr), size(0), isOpen(false)
+#ifdef PARANOIXA_PLATFORM_WINDOWS
+      ,
+      fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile() { Close(); }
+
+#ifdef PARANOIXA_PLATFORM_WINDOWS
+bool MappedFile::Open(const char *filePath) {
+  Close();
+  fileHandle = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not open file: %s",
+                 filePath);
+    return false;
+  }
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(fileHandle, &fileSize)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not stat file: %s",
+                 filePath);
+    Close();
+    return false;
+  }
+  size = static_cast<std::size_t>(fileSize.QuadPart);
+  isOpen = true;
+  // Empty files can't be mapped
+  if (size == 0) {
+    return true;
+  }
+  mappingHandle =
+      CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mappingHandle == nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not map file: %s",
+                 filePath);
+    Close();
+    return false;
+  }
+  data = static_cast<const std::byte *>(
+      MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+  if (data == nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not map file: %s",
+                 filePath);
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data != nullptr) {
+    UnmapViewOfFile(data);
+  }
+  if (mappingHandle != nullptr) {
+    CloseHandle(mappingHandle);
+  }
+  if (fileHandle != INVALID_HANDLE_VALUE) {
+    CloseHandle(fileHandle);
+  }
+  data = nullptr;
+  size = 0;
+  isOpen = false;
+  mappingHandle = nullptr;
+  fileHandle = INVALID_HANDLE_VALUE;
+}
+#else
+bool MappedFile::Open(const char *filePath) {
+  Close();
+  int fd = open(filePath, O_RDONLY);
+  if (fd < 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not open file: %s",
+                 filePath);
+    return false;
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not stat file: %s",
+                 filePath);
+    close(fd);
+    return false;
+  }
+  size = static_cast<std::size_t>(fileStat.st_size);
+  isOpen = true;
+  // Empty files can't be mapped
+  if (size == 0) {
+    close(fd);
+    return true;
+  }
+  void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not map file: %s",
+                 filePath);
+    size = 0;
+    isOpen = false;
+    return false;
+  }
+#ifndef PARANOIXA_PLATFORM_EMSCRIPTEN
+  // Assets are consumed front to back exactly once. The advice values are
+  // not bit flags, so each one needs its own call. Failing to apply them
+  // only costs performance.
+  for (int advice : {POSIX_MADV_SEQUENTIAL, POSIX_MADV_WILLNEED}) {
+    int error = posix_madvise(mapped, size, advice);
+    if (error != 0) {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                  "Could not advise mapping of %s: %s", filePath,
+                  strerror(error));
+    }
+  }
+#endif
+  data = static_cast<const std::byte *>(mapped);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data != nullptr) {
+    munmap(const_cast<std::byte *>(data), size);
+  }
+  data = nullptr;
+  size = 0;
+  isOpen = false;
+}
+#endif
+
+Ptr<TransferBuffer> MappedFile::CreateTransferBuffer(Allocator *allocator,
+                                                     Ptr<Device> device) const {
+  if (!isOpen || size > std::numeric_limits<uint32>::max()) {
+    return nullptr;
+  }
+  TransferBuffer::CreateInfo transferBufferCI{
+      .allocator = allocator,
+      .usage = TransferBufferUsage::Upload,
+      .size = static_cast<uint32>(size),
+  };
+  auto transferBuffer = device->CreateTransferBuffer(transferBufferCI);
+  if (transferBuffer == nullptr) {
+    return nullptr;
+  }
+  // Page faults read the file straight from the OS cache into staging memory
+  std::memcpy(transferBuffer->Map(false), data, size);
+  transferBuffer->Unmap();
+  return transferBuffer;
+}
+} // namespace paranoixa
@@ -10,11 +10,14 @@
 
 #include "d3d12u/d3d12u_renderer.hpp"
 #include "sdlgpu/sdlgpu_backend.hpp"
+#include "vulkan/vulkan_backend.hpp"
 #include "vulkan/vulkan_renderer.hpp"
 #include "webgpu/webgpu_renderer.hpp"
 
 #include <SDL3/SDL.h>
 
+#include <algorithm>
+#include <bit>
 #include <fstream>
 #include <iostream>
 namespace paranoixa {
@@ -23,7 +26,8 @@ Ptr<Backend> Paranoixa::CreateBackend(Allocator *allocator,
 #ifndef __EMSCRIPTEN__
   switch (api) {
   case GraphicsAPI::Vulkan: {
-    // TODO
+    Ptr<Backend> p = MakePtr<vulkan::Backend>(allocator);
+    return p;
   }
 #ifdef _WIN32
   case GraphicsAPI::D3D12U: {
@@ -43,6 +47,41 @@ Ptr<Backend> Paranoixa::CreateBackend(Allocator *allocator,
 #endif
   return nullptr;
 }
+TextureFormatInfo GetTextureFormatInfo(TextureFormat format) {
+  switch (format) {
+  case TextureFormat::R8G8B8A8_UNORM:
+  case TextureFormat::B8G8R8A8_UNORM:
+    return {4, 1, 1};
+  case TextureFormat::R32G32B32A32_FLOAT:
+    return {16, 1, 1};
+  case TextureFormat::BC1_RGBA_UNORM:
+  case TextureFormat::BC4_R_UNORM:
+    return {8, 4, 4};
+  case TextureFormat::BC3_RGBA_UNORM:
+  case TextureFormat::BC5_RG_UNORM:
+  case TextureFormat::BC7_RGBA_UNORM:
+    return {16, 4, 4};
+  case TextureFormat::D32_FLOAT_S8_UINT:
+    return {8, 1, 1};
+  default:
+    return {0, 1, 1};
+  }
+}
+uint32 CalculateTextureSize(TextureFormat format, uint32 width, uint32 height,
+                            uint32 depth) {
+  auto info = GetTextureFormatInfo(format);
+  auto blocksPerRow = (width + info.blockWidth - 1) / info.blockWidth;
+  auto blocksPerColumn = (height + info.blockHeight - 1) / info.blockHeight;
+  return blocksPerRow * blocksPerColumn * depth * info.blockSize;
+}
+uint32 CalculateMipLevelCount(uint32 width, uint32 height) {
+  return static_cast<uint32>(std::bit_width(std::max(width, height)));
+}
+void ReportInlineArrayOverflow(uint32 size, uint32 capacity) {
+  SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+               "InlineArray of capacity %u cannot hold %u elements", capacity,
+               size);
+}
 Allocator *Paranoixa::CreateAllocator(size_t size) {
 #ifdef _MSC_VER
   return new TLSFAllocator(size);
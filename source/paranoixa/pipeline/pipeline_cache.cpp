@@ -0,0 +1,238 @@
+#include "pipeline_cache.hpp"
+#include "embedded_shader.hpp"
+
+#include <bit>
+
+namespace paranoixa {
+namespace {
+// Fields are written one by one so that struct padding never reaches the
+// key
+template <class T> void Write(Array<std::byte> &key, const T &value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  auto *bytes = reinterpret_cast<const std::byte *>(&value);
+  key.insert(key.end(), bytes, bytes + sizeof(T));
+}
+void WriteFloat(Array<std::byte> &key, float value) {
+  // -0.0f and 0.0f describe the same state
+  Write(key, value == 0.0f ? 0u : std::bit_cast<uint32>(value));
+}
+void WriteStencilOpState(Array<std::byte> &key, const StencilOpState &state) {
+  Write(key, state.failOp);
+  Write(key, state.passOp);
+  Write(key, state.depthFailOp);
+  Write(key, state.compareOp);
+}
+void SerializeShaderKey(const Shader::CreateInfo &shaderCI,
+                        Array<std::byte> &key) {
+  Write(key, shaderCI.format);
+  Write(key, shaderCI.stage);
+  Write(key, shaderCI.numSamplers);
+  Write(key, shaderCI.numStorageBuffers);
+  Write(key, shaderCI.numStorageTextures);
+  Write(key, shaderCI.numUniformBuffers);
+  Write(key, shaderCI.numSpecializationConstants);
+  for (uint32 i = 0; i < shaderCI.numSpecializationConstants; ++i) {
+    Write(key, shaderCI.specializationConstants[i].constantID);
+    Write(key, shaderCI.specializationConstants[i].value);
+  }
+  std::string_view entrypoint =
+      shaderCI.entrypoint != nullptr ? shaderCI.entrypoint : "";
+  Write(key, entrypoint.size());
+  auto *name = reinterpret_cast<const std::byte *>(entrypoint.data());
+  key.insert(key.end(), name, name + entrypoint.size());
+  auto *code = static_cast<const std::byte *>(shaderCI.data);
+  key.insert(key.end(), code, code + shaderCI.size);
+}
+} // namespace
+
+PipelineCache::PipelineCache(const CreateInfo &createInfo)
+    : createInfo(createInfo), shaders(createInfo.allocator),
+      embeddedShaders(createInfo.allocator), pipelines(createInfo.allocator),
+      statistics() {
+  assert(createInfo.device != nullptr);
+}
+
+template <class T>
+Ptr<T> PipelineCache::Find(const HashMap<std::uint64_t, Array<Entry<T>>> &map,
+                           std::uint64_t hash,
+                           const Array<std::byte> &key) const {
+  auto it = map.find(hash);
+  if (it == map.end())
+    return nullptr;
+  // Entries sharing a hash are told apart by their full key
+  for (const auto &entry : it->second) {
+    if (entry.key == key)
+      return entry.object;
+  }
+  return nullptr;
+}
+
+Ptr<Shader>
+PipelineCache::GetOrCreateShader(const Shader::CreateInfo &shaderCI) {
+  Array<std::byte> key(createInfo.allocator);
+  key.reserve(shaderCI.size + 64);
+  SerializeShaderKey(shaderCI, key);
+  auto hash = HashKey(key);
+
+  std::unique_lock lock(mutex);
+  if (auto shader = Find(shaders, hash, key)) {
+    statistics.numShaderHits++;
+    return shader;
+  }
+  statistics.numShaderMisses++;
+  auto shader = createInfo.device->CreateShader(shaderCI);
+  if (shader == nullptr) {
+    return nullptr;
+  }
+  auto [it, inserted] =
+      shaders.try_emplace(hash, Array<Entry<Shader>>(createInfo.allocator));
+  it->second.push_back({std::move(key), shader});
+  return shader;
+}
+
+Ptr<Shader> PipelineCache::GetOrCreateShader(const EmbeddedShader &shader) {
+  std::unique_lock lock(mutex);
+  if (auto it = embeddedShaders.find(shader.hash);
+      it != embeddedShaders.end()) {
+    statistics.numShaderHits++;
+    return it->second;
+  }
+  statistics.numShaderMisses++;
+  auto shaderCI = shader.GetCreateInfo(createInfo.allocator);
+  auto created = createInfo.device->CreateShader(shaderCI);
+  if (created == nullptr) {
+    return nullptr;
+  }
+  embeddedShaders.emplace(shader.hash, created);
+  return created;
+}
+
+Ptr<GraphicsPipeline> PipelineCache::GetOrCreateGraphicsPipeline(
+    const GraphicsPipeline::CreateInfo &pipelineCI) {
+  Array<std::byte> key(createInfo.allocator);
+  key.reserve(256);
+  SerializeKey(pipelineCI, key);
+  auto hash = HashKey(key);
+
+  std::unique_lock lock(mutex);
+  if (auto pipeline = Find(pipelines, hash, key)) {
+    statistics.numPipelineHits++;
+    return pipeline;
+  }
+  statistics.numPipelineMisses++;
+  // Compiled under the lock so that concurrent requests for the same
+  // permutation compile it only once
+  auto pipeline = createInfo.device->CreateGraphicsPipeline(pipelineCI);
+  if (pipeline == nullptr) {
+    return nullptr;
+  }
+  auto [it, inserted] = pipelines.try_emplace(
+      hash, Array<Entry<GraphicsPipeline>>(createInfo.allocator));
+  it->second.push_back({std::move(key), pipeline});
+  return pipeline;
+}
+
+void PipelineCache::Clear() {
+  std::unique_lock lock(mutex);
+  shaders.clear();
+  embeddedShaders.clear();
+  pipelines.clear();
+}
+
+PipelineCache::Statistics PipelineCache::GetStatistics() {
+  std::unique_lock lock(mutex);
+  return statistics;
+}
+
+void PipelineCache::SerializeKey(const GraphicsPipeline::CreateInfo &pipelineCI,
+                                 Array<std::byte> &key) {
+  // Shaders are compared by identity. Shaders from GetOrCreateShader() are
+  // already unique per bytecode.
+  Write(key, reinterpret_cast<std::uintptr_t>(pipelineCI.vertexShader.get()));
+  Write(key,
+        reinterpret_cast<std::uintptr_t>(pipelineCI.fragmentShader.get()));
+
+  const auto &vertexInput = pipelineCI.vertexInputState;
+  Write(key, vertexInput.vertexBufferDescriptions.size());
+  for (const auto &description : vertexInput.vertexBufferDescriptions) {
+    Write(key, description.slot);
+    Write(key, description.pitch);
+    Write(key, description.inputRate);
+    if (description.inputRate == VertexInputRate::Instance)
+      Write(key, description.instanceStepRate);
+  }
+  Write(key, vertexInput.vertexAttributes.size());
+  for (const auto &attribute : vertexInput.vertexAttributes) {
+    Write(key, attribute.location);
+    Write(key, attribute.bufferSlot);
+    Write(key, attribute.format);
+    Write(key, attribute.offset);
+  }
+
+  Write(key, pipelineCI.primitiveType);
+
+  const auto &rasterizer = pipelineCI.rasterizerState;
+  Write(key, rasterizer.fillMode);
+  Write(key, rasterizer.cullMode);
+  Write(key, rasterizer.frontFace);
+  Write(key, rasterizer.enableDepthClip);
+  Write(key, rasterizer.enableDepthBias);
+  if (rasterizer.enableDepthBias) {
+    WriteFloat(key, rasterizer.depthBiasConstantFactor);
+    WriteFloat(key, rasterizer.depthBiasClamp);
+    WriteFloat(key, rasterizer.depthBiasSlopeFactor);
+  }
+
+  const auto &multiSample = pipelineCI.multiSampleState;
+  Write(key, multiSample.sampleCount);
+  Write(key, multiSample.enableMask);
+  if (multiSample.enableMask)
+    Write(key, multiSample.sampleMask);
+
+  const auto &depthStencil = pipelineCI.depthStencilState;
+  Write(key, depthStencil.enableDepthTest);
+  if (depthStencil.enableDepthTest) {
+    Write(key, depthStencil.compareOp);
+    Write(key, depthStencil.enableDepthWrite);
+  }
+  Write(key, depthStencil.enableStencilTest);
+  if (depthStencil.enableStencilTest) {
+    WriteStencilOpState(key, depthStencil.frontStencilState);
+    WriteStencilOpState(key, depthStencil.backStencilState);
+    Write(key, depthStencil.compareMask);
+    Write(key, depthStencil.writeMask);
+  }
+
+  const auto &targetInfo = pipelineCI.targetInfo;
+  Write(key, targetInfo.colorTargetDescriptions.size());
+  for (const auto &description : targetInfo.colorTargetDescriptions) {
+    const auto &blend = description.blendState;
+    Write(key, description.format);
+    Write(key, blend.enableBlend);
+    if (blend.enableBlend) {
+      Write(key, blend.srcColorBlendFactor);
+      Write(key, blend.dstColorBlendFactor);
+      Write(key, blend.colorBlendOp);
+      Write(key, blend.srcAlphaBlendFactor);
+      Write(key, blend.dstAlphaBlendFactor);
+      Write(key, blend.alphaBlendOp);
+    }
+    Write(key, blend.enableColorWriteMask);
+    if (blend.enableColorWriteMask)
+      Write(key, blend.colorWriteMask);
+  }
+  Write(key, targetInfo.hasDepthStencilTarget);
+  if (targetInfo.hasDepthStencilTarget)
+    Write(key, targetInfo.depthStencilTargetFormat);
+}
+
+std::uint64_t PipelineCache::HashKey(const Array<std::byte> &key) {
+  // FNV-1a
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  for (auto byte : key) {
+    hash ^= static_cast<std::uint64_t>(byte);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+} // namespace paranoixa
@@ -0,0 +1,117 @@
+#include "pipeline_cache_file.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <cstring>
+#include <fstream>
+
+namespace paranoixa {
+namespace {
+constexpr uint32 MAGIC = 0x43505850; // "PXPC"
+constexpr uint32 VERSION = 1;
+// Driver caches stay far below this; anything larger is a corrupted header
+constexpr std::uint64_t MAX_DATA_SIZE = 256ull * 1024 * 1024;
+
+struct Header {
+  uint32 magic;
+  uint32 version;
+  PipelineCacheIdentity identity;
+  std::uint64_t dataSize;
+  std::uint64_t checksum;
+};
+
+std::uint64_t Checksum(const void *data, size_t size) {
+  // FNV-1a
+  auto *bytes = static_cast<const std::byte *>(data);
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<std::uint64_t>(bytes[i]);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+std::filesystem::path GetPath(const std::filesystem::path &directory,
+                              const PipelineCacheIdentity &identity) {
+  // One file per GPU, so that several GPUs in one machine do not evict each
+  // other
+  char name[64];
+  SDL_snprintf(name, sizeof(name), "pipeline_cache_%04x_%04x.bin",
+               identity.vendorID, identity.deviceID);
+  return directory / name;
+}
+} // namespace
+
+bool LoadPipelineCache(const std::filesystem::path &directory,
+                       const PipelineCacheIdentity &identity,
+                       Array<std::byte> &data) {
+  auto path = GetPath(directory, identity);
+  std::error_code error;
+  auto fileSize = std::filesystem::file_size(path, error);
+  if (error) {
+    return false;
+  }
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  Header header{};
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+    return false;
+  }
+  if (header.magic != MAGIC || header.version != VERSION ||
+      std::memcmp(&header.identity, &identity, sizeof(identity)) != 0) {
+    SDL_Log("Discarding pipeline cache of another device or driver");
+    return false;
+  }
+  // The size comes from disk, so check it before allocating for it
+  if (header.dataSize > MAX_DATA_SIZE ||
+      sizeof(header) + header.dataSize > fileSize) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Corrupted pipeline cache");
+    return false;
+  }
+  data.resize(header.dataSize);
+  if (!file.read(reinterpret_cast<char *>(data.data()), header.dataSize) ||
+      Checksum(data.data(), data.size()) != header.checksum) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Corrupted pipeline cache");
+    data.clear();
+    return false;
+  }
+  return true;
+}
+
+bool SavePipelineCache(const std::filesystem::path &directory,
+                       const PipelineCacheIdentity &identity, const void *data,
+                       size_t size) {
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  auto path = GetPath(directory, identity);
+  auto temporaryPath = path;
+  temporaryPath += ".tmp";
+  {
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    Header header{
+        .magic = MAGIC,
+        .version = VERSION,
+        .identity = identity,
+        .dataSize = size,
+        .checksum = Checksum(data, size),
+    };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(static_cast<const char *>(data), size);
+    if (!file) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Failed to write pipeline cache: %s",
+                   temporaryPath.string().c_str());
+      return false;
+    }
+  }
+  std::filesystem::rename(temporaryPath, path, error);
+  if (error) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to replace pipeline cache: %s",
+                 error.message().c_str());
+    return false;
+  }
+  return true;
+}
+} // namespace paranoixa
@@ -0,0 +1,127 @@
+#include "pipeline_compiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace paranoixa {
+bool RenderPass::BindAsyncGraphicsPipeline(
+    const AsyncGraphicsPipeline &pipeline, Ptr<GraphicsPipeline> fallback) {
+  if (auto compiled = pipeline.Get()) {
+    BindGraphicsPipeline(compiled);
+    return true;
+  }
+  if (fallback != nullptr) {
+    BindGraphicsPipeline(fallback);
+    return true;
+  }
+  return false;
+}
+
+PipelineCompiler::PipelineCompiler(const CreateInfo &createInfo)
+    : createInfo(createInfo), jobs(createInfo.allocator),
+      workers(createInfo.allocator), statistics() {
+  assert(createInfo.device != nullptr);
+  auto numThreads = std::max(createInfo.numThreads, 1u);
+  for (uint32 i = 0; i < numThreads; ++i) {
+    workers.emplace_back(
+        [this](std::stop_token stopToken) { WorkerMain(stopToken); });
+  }
+}
+
+PipelineCompiler::~PipelineCompiler() {
+  // Joins the workers before the state they read goes away. They stop
+  // without draining the queue.
+  workers.clear();
+  std::unique_lock lock(mutex);
+  for (auto &job : jobs) {
+    job.pipeline->ready.store(true, std::memory_order_release);
+    statistics.numPending--;
+    statistics.numFailed++;
+  }
+  jobs.clear();
+  jobCompleted.notify_all();
+}
+
+Ptr<AsyncGraphicsPipeline> PipelineCompiler::CreateGraphicsPipelineAsync(
+    const GraphicsPipeline::CreateInfo &pipelineCI) {
+  // Pipelines and their create infos are created and released on the
+  // workers, where the shared allocator must not be used
+  auto *threadSafeAllocator = std::pmr::new_delete_resource();
+  auto pipeline = MakePtr<AsyncGraphicsPipeline>(threadSafeAllocator);
+  Job job{pipeline, pipelineCI};
+  job.createInfo.allocator = threadSafeAllocator;
+
+  std::unique_lock lock(mutex);
+  jobs.push_back(std::move(job));
+  statistics.numPending++;
+  jobAvailable.notify_one();
+  return pipeline;
+}
+
+Ptr<GraphicsPipeline>
+PipelineCompiler::Wait(const Ptr<AsyncGraphicsPipeline> &pipeline) {
+  if (pipeline->IsReady()) {
+    return pipeline->Get();
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::unique_lock lock(mutex);
+  auto it = std::find_if(jobs.begin(), jobs.end(), [&](const Job &job) {
+    return job.pipeline == pipeline;
+  });
+  if (it != jobs.end()) {
+    // Counted in compileSeconds only
+    auto job = std::move(*it);
+    jobs.erase(it);
+    lock.unlock();
+    Compile(job);
+    return pipeline->Get();
+  }
+  jobCompleted.wait(lock, [&] { return pipeline->IsReady(); });
+  statistics.waitSeconds += std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+  return pipeline->Get();
+}
+
+PipelineCompiler::Statistics PipelineCompiler::GetStatistics() {
+  std::unique_lock lock(mutex);
+  return statistics;
+}
+
+void PipelineCompiler::WorkerMain(std::stop_token stopToken) {
+  while (true) {
+    std::unique_lock lock(mutex);
+    // Returns true with jobs still queued once stop is requested, which are
+    // abandoned rather than compiled
+    if (!jobAvailable.wait(lock, stopToken, [&] { return !jobs.empty(); }) ||
+        stopToken.stop_requested()) {
+      return;
+    }
+    // First requested, first compiled
+    auto job = std::move(jobs.front());
+    jobs.erase(jobs.begin());
+    lock.unlock();
+    Compile(job);
+  }
+}
+
+void PipelineCompiler::Compile(Job &job) {
+  auto start = std::chrono::steady_clock::now();
+  auto pipeline = createInfo.device->CreateGraphicsPipeline(job.createInfo);
+  auto seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+  std::unique_lock lock(mutex);
+  job.pipeline->pipeline = pipeline;
+  job.pipeline->ready.store(true, std::memory_order_release);
+  statistics.numPending--;
+  if (pipeline != nullptr) {
+    statistics.numCompiled++;
+  } else {
+    statistics.numFailed++;
+  }
+  statistics.compileSeconds += seconds;
+  jobCompleted.notify_all();
+}
+} // namespace paranoixa
@@ -0,0 +1,194 @@
+#include "async_readback.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+
+namespace paranoixa {
+AsyncReadback::Result::Result(Ptr<TransferBuffer> transferBuffer, uint32 size)
+    : transferBuffer(transferBuffer), data(transferBuffer->Map(false)),
+      size(size) {}
+
+AsyncReadback::Result::~Result() { transferBuffer->Unmap(); }
+
+AsyncReadback::AsyncReadback(const CreateInfo &createInfo)
+    : createInfo(createInfo), command(nullptr), copyPass(nullptr),
+      pending(createInfo.allocator), inFlight(createInfo.allocator),
+      freeTransferBuffers(createInfo.allocator),
+      failedTickets(createInfo.allocator), nextTicket(1), completedTicket(0) {
+  assert(createInfo.device != nullptr);
+}
+
+AsyncReadback::~AsyncReadback() {
+  // Outstanding futures still resolve
+  if (nextTicket > 1) {
+    Wait(nextTicket - 1);
+  }
+}
+
+AsyncReadback::Ticket AsyncReadback::ReadBuffer(const BufferRegion &src,
+                                                Callback callback) {
+  return Record(&src, nullptr, std::move(callback), nullptr);
+}
+
+AsyncReadback::Ticket AsyncReadback::ReadTexture(const TextureRegion &src,
+                                                 Callback callback) {
+  return Record(nullptr, &src, std::move(callback), nullptr);
+}
+
+std::future<Ptr<AsyncReadback::Result>>
+AsyncReadback::ReadBuffer(const BufferRegion &src) {
+  std::promise<Ptr<Result>> promise;
+  auto future = promise.get_future();
+  Record(&src, nullptr, nullptr, &promise);
+  return future;
+}
+
+std::future<Ptr<AsyncReadback::Result>>
+AsyncReadback::ReadTexture(const TextureRegion &src) {
+  std::promise<Ptr<Result>> promise;
+  auto future = promise.get_future();
+  Record(nullptr, &src, nullptr, &promise);
+  return future;
+}
+
+void AsyncReadback::Flush() {
+  if (pending.empty()) {
+    return;
+  }
+  command->EndCopyPass(copyPass);
+  auto fence = createInfo.device->SubmitCommandBufferAndAcquireFence(command);
+  command = nullptr;
+  copyPass = nullptr;
+
+  Batch batch{fence, Array<Request>(createInfo.allocator)};
+  batch.requests.swap(pending);
+  if (fence == nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "AsyncReadback: failed to submit the copy pass");
+    Fail(batch);
+    return;
+  }
+  inFlight.push_back(std::move(batch));
+}
+
+bool AsyncReadback::IsComplete(Ticket ticket) const {
+  return ticket <= completedTicket && !HasFailed(ticket);
+}
+
+bool AsyncReadback::HasFailed(Ticket ticket) const {
+  return std::find(failedTickets.begin(), failedTickets.end(), ticket) !=
+         failedTickets.end();
+}
+
+void AsyncReadback::Update() {
+  auto retired = inFlight.begin();
+  for (; retired != inFlight.end(); ++retired) {
+    if (!createInfo.device->QueryFence(retired->fence)) {
+      break;
+    }
+    Retire(*retired);
+  }
+  inFlight.erase(inFlight.begin(), retired);
+}
+
+void AsyncReadback::Wait(Ticket ticket) {
+  if (IsComplete(ticket) || HasFailed(ticket)) {
+    return;
+  }
+  if (!pending.empty() && ticket >= pending.front().ticket) {
+    Flush();
+  }
+  Array<Ptr<Fence>> fences(createInfo.allocator);
+  for (auto &batch : inFlight) {
+    if (batch.requests.front().ticket <= ticket) {
+      fences.push_back(batch.fence);
+    }
+  }
+  createInfo.device->WaitForFences(fences, true);
+  Update();
+}
+
+AsyncReadback::Ticket
+AsyncReadback::Record(const BufferRegion *buffer, const TextureRegion *texture,
+                      Callback callback, std::promise<Ptr<Result>> *promise) {
+  uint32 size = 0;
+  if (buffer != nullptr) {
+    size = buffer->size;
+  } else {
+    auto format = texture->texture->getCreateInfo().format;
+    size = CalculateTextureSize(format, texture->width, texture->height,
+                                std::max(texture->depth, 1u));
+  }
+  auto transferBuffer = AcquireTransferBuffer(size);
+
+  if (command == nullptr) {
+    command = createInfo.device->AcquireCommandBuffer({createInfo.allocator});
+    copyPass = command->BeginCopyPass();
+  }
+  if (buffer != nullptr) {
+    copyPass->DownloadBuffer(*buffer, {transferBuffer, 0});
+  } else {
+    copyPass->DownloadTexture(*texture, {transferBuffer, 0});
+  }
+
+  auto &request = pending.emplace_back();
+  request.ticket = nextTicket++;
+  request.transferBuffer = transferBuffer;
+  request.size = size;
+  request.callback = std::move(callback);
+  request.hasPromise = promise != nullptr;
+  if (promise != nullptr) {
+    request.promise = std::move(*promise);
+  }
+  return request.ticket;
+}
+
+Ptr<TransferBuffer> AsyncReadback::AcquireTransferBuffer(uint32 size) {
+  auto it = std::find_if(freeTransferBuffers.begin(), freeTransferBuffers.end(),
+                         [size](const Ptr<TransferBuffer> &transferBuffer) {
+                           return transferBuffer->GetCreateInfo().size >= size;
+                         });
+  if (it != freeTransferBuffers.end()) {
+    auto transferBuffer = *it;
+    freeTransferBuffers.erase(it);
+    return transferBuffer;
+  }
+  TransferBuffer::CreateInfo transferBufferCI{
+      .allocator = createInfo.allocator,
+      .usage = TransferBufferUsage::Download,
+      .size = size,
+  };
+  return createInfo.device->CreateTransferBuffer(transferBufferCI);
+}
+
+void AsyncReadback::Retire(Batch &batch) {
+  for (auto &request : batch.requests) {
+    completedTicket = request.ticket;
+    if (request.hasPromise) {
+      // The future owns its transfer buffer, so it isn't recycled
+      request.promise.set_value(MakePtr<Result>(
+          createInfo.allocator, request.transferBuffer, request.size));
+      continue;
+    }
+    {
+      Result result(request.transferBuffer, request.size);
+      if (request.callback) {
+        request.callback(result);
+      }
+    }
+    freeTransferBuffers.push_back(request.transferBuffer);
+  }
+}
+
+void AsyncReadback::Fail(Batch &batch) {
+  // Callbacks are not run, futures resolve to nullptr
+  for (auto &request : batch.requests) {
+    failedTickets.push_back(request.ticket);
+    if (request.hasPromise) {
+      request.promise.set_value(nullptr);
+    }
+    freeTransferBuffers.push_back(request.transferBuffer);
+  }
+}
+} // namespace paranoixa
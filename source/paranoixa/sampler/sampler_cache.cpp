@@ -0,0 +1,82 @@
+#include "sampler_cache.hpp"
+
+#include <bit>
+
+namespace paranoixa {
+namespace {
+// Adding 0 turns -0 into +0, so both pack the same
+float Canonical(float value) { return value + 0.0f; }
+} // namespace
+
+size_t SamplerCache::KeyHash::operator()(const Key &key) const {
+  // FNV-1a over the packed words
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  for (auto word :
+       {key.state, std::bit_cast<uint32>(key.mipLodBias),
+        std::bit_cast<uint32>(key.maxAnisotropy),
+        std::bit_cast<uint32>(key.minLod), std::bit_cast<uint32>(key.maxLod)}) {
+    hash ^= word;
+    hash *= 0x100000001b3ull;
+  }
+  return static_cast<size_t>(hash);
+}
+
+SamplerCache::SamplerCache(const CreateInfo &createInfo)
+    : createInfo(createInfo), samplers(createInfo.allocator), statistics() {
+  assert(createInfo.device != nullptr);
+}
+
+SamplerCache::Key SamplerCache::PackKey(const Sampler::CreateInfo &samplerCI) {
+  // Field widths of the enums: Filter and MipmapMode 1 bit, AddressMode
+  // 2 bits, CompareOp 4 bits
+  auto compareOp = samplerCI.enableCompare ? samplerCI.compareOp
+                                           : CompareOp::Invalid;
+  uint32 state = static_cast<uint32>(samplerCI.minFilter) |
+                 static_cast<uint32>(samplerCI.magFilter) << 1 |
+                 static_cast<uint32>(samplerCI.mipmapMode) << 2 |
+                 static_cast<uint32>(samplerCI.addressModeU) << 3 |
+                 static_cast<uint32>(samplerCI.addressModeV) << 5 |
+                 static_cast<uint32>(samplerCI.addressModeW) << 7 |
+                 static_cast<uint32>(compareOp) << 9 |
+                 static_cast<uint32>(samplerCI.enableAnisotropy) << 13 |
+                 static_cast<uint32>(samplerCI.enableCompare) << 14;
+  return {
+      .state = state,
+      .mipLodBias = Canonical(samplerCI.mipLodBias),
+      .maxAnisotropy =
+          samplerCI.enableAnisotropy ? Canonical(samplerCI.maxAnisotropy) : 0,
+      .minLod = Canonical(samplerCI.minLod),
+      .maxLod = Canonical(samplerCI.maxLod),
+  };
+}
+
+Ptr<Sampler>
+SamplerCache::GetOrCreateSampler(const Sampler::CreateInfo &samplerCI) {
+  auto key = PackKey(samplerCI);
+
+  std::unique_lock lock(mutex);
+  if (auto it = samplers.find(key); it != samplers.end()) {
+    statistics.numHits++;
+    return it->second;
+  }
+  statistics.numMisses++;
+  auto sampler = createInfo.device->CreateSampler(samplerCI);
+  if (sampler == nullptr) {
+    return nullptr;
+  }
+  samplers.emplace(key, sampler);
+  statistics.numSamplers = static_cast<uint32>(samplers.size());
+  return sampler;
+}
+
+void SamplerCache::Clear() {
+  std::unique_lock lock(mutex);
+  samplers.clear();
+  statistics.numSamplers = 0;
+}
+
+SamplerCache::Statistics SamplerCache::GetStatistics() {
+  std::unique_lock lock(mutex);
+  return statistics;
+}
+} // namespace paranoixa
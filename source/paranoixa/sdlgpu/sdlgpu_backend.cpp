@@ -3,6 +3,7 @@
 #ifndef EMSCRIPTEN
 #include "sdlgpu_backend.hpp"
 #include "sdlgpu_convert.hpp"
+#include "spirv_reflection.hpp"
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_gpu.h>
@@ -11,6 +12,8 @@
 
 namespace paranoixa::sdlgpu {
 Ptr<px::Device> Backend::CreateDevice(const Device::CreateInfo &createInfo) {
+  // SDL_gpu exposes no pipeline cache data, so createInfo.cacheDirectory is
+  // left to the shader caches of the drivers themselves.
   SDL_GPUDevice *device = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV,
                                               createInfo.debugMode, nullptr);
   if (!device) {
@@ -19,7 +22,12 @@ Ptr<px::Device> Backend::CreateDevice(const Device::CreateInfo &createInfo) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, SDL_GetError());
     return nullptr;
   }
-  return MakePtr<Device>(createInfo.allocator, createInfo, device);
+  auto result = MakePtr<Device>(createInfo.allocator, createInfo, device);
+  if (!SDL_SetGPUAllowedFramesInFlight(device, result->GetFramesInFlight())) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to set frames in flight: %s", SDL_GetError());
+  }
+  return result;
 }
 void CopyPass::UploadTexture(const TextureTransferInfo &src,
                              const TextureRegion &dst, bool cycle) {
@@ -27,6 +35,8 @@ void CopyPass::UploadTexture(const TextureTransferInfo &src,
       .transfer_buffer =
           DownCast<TransferBuffer>(src.transferBuffer)->GetNative(),
       .offset = src.offset,
+      .pixels_per_row = src.pixelsPerRow,
+      .rows_per_layer = src.rowsPerLayer,
   };
   SDL_GPUTextureRegion region = {
       .texture = DownCast<Texture>(dst.texture)->GetNative(),
@@ -48,10 +58,13 @@ void CopyPass::DownloadTexture(const TextureRegion &src,
       .transfer_buffer =
           DownCast<TransferBuffer>(dst.transferBuffer)->GetNative(),
       .offset = dst.offset,
+      .pixels_per_row = dst.pixelsPerRow,
+      .rows_per_layer = dst.rowsPerLayer,
   };
   SDL_GPUTextureRegion region = {
-
       .texture = DownCast<Texture>(src.texture)->GetNative(),
+      .mip_level = src.mipLevel,
+      .layer = src.layer,
       .x = src.x,
       .y = src.y,
       .z = src.z,
@@ -160,6 +173,10 @@ void RenderPass::BindFragmentSamplers(
   SDL_BindGPUFragmentSamplers(this->renderPass, startSlot,
                               samplerBindings.data(), samplerBindings.size());
 }
+void RenderPass::BindBindlessTable(Ptr<px::BindlessTable> bindlessTable) {
+  // CreateBindlessTable never succeeds on SDL_gpu
+  assert(bindlessTable == nullptr);
+}
 void RenderPass::SetViewport(const Viewport &viewport) {
   SDL_GPUViewport vp = {viewport.x,      viewport.y,        viewport.width,
                         viewport.height, viewport.minDepth, viewport.maxDepth};
@@ -232,12 +249,48 @@ void CommandBuffer::PushUniformData(uint32 slot, const void *data,
   SDL_PushGPUVertexUniformData(this->commandBuffer, slot, data, size);
   SDL_PushGPUFragmentUniformData(this->commandBuffer, slot, data, size);
 }
+void CommandBuffer::GenerateMipmaps(Ptr<px::Texture> texture) {
+  SDL_GenerateMipmapsForGPUTexture(this->commandBuffer,
+                                   DownCast<Texture>(texture)->GetNative());
+}
+void CommandBuffer::Blit(const BlitInfo &blitInfo) {
+  auto &src = blitInfo.source;
+  auto &dst = blitInfo.destination;
+  SDL_GPUBlitInfo info = {
+      .source =
+          {
+              .texture = DownCast<Texture>(src.texture)->GetNative(),
+              .mip_level = src.mipLevel,
+              .layer_or_depth_plane = src.layerOrDepthPlane,
+              .x = src.x,
+              .y = src.y,
+              .w = src.width,
+              .h = src.height,
+          },
+      .destination =
+          {
+              .texture = DownCast<Texture>(dst.texture)->GetNative(),
+              .mip_level = dst.mipLevel,
+              .layer_or_depth_plane = dst.layerOrDepthPlane,
+              .x = dst.x,
+              .y = dst.y,
+              .w = dst.width,
+              .h = dst.height,
+          },
+      .load_op = convert::LoadOpFrom(blitInfo.loadOp),
+      .flip_mode = SDL_FLIP_NONE,
+      .filter = convert::FilterFrom(blitInfo.filter),
+      .cycle = blitInfo.cycle,
+  };
+  SDL_BlitGPUTexture(this->commandBuffer, &info);
+}
 GraphicsPipeline::~GraphicsPipeline() {
   SDL_ReleaseGPUGraphicsPipeline(device->GetNative(), pipeline);
 }
 Device::~Device() {
   if (window)
     SDL_ReleaseWindowFromGPUDevice(device, window);
+  ReleaseOffscreenTargets();
   SDL_DestroyGPUDevice(device);
 }
 void Device::ClaimWindow(void *window) {
@@ -247,6 +300,77 @@ void Device::ClaimWindow(void *window) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, SDL_GetError());
   }
   this->window = static_cast<SDL_Window *>(window);
+  auto presentMode = convert::PresentModeFrom(GetCreateInfo().presentMode);
+  if (!SDL_WindowSupportsGPUPresentMode(device, this->window, presentMode)) {
+    // Vsync is supported everywhere
+    presentMode = SDL_GPU_PRESENTMODE_VSYNC;
+  }
+  if (!SDL_SetGPUSwapchainParameters(device, this->window,
+                                     SDL_GPU_SWAPCHAINCOMPOSITION_SDR,
+                                     presentMode)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to set swapchain parameters: %s", SDL_GetError());
+  }
+}
+bool Device::ClaimOffscreen(uint32 width, uint32 height) {
+  if (window) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to claim offscreen targets: a window has been "
+                 "claimed");
+    return false;
+  }
+  // Releasing is deferred by SDL_gpu until pending command buffers finish
+  ReleaseOffscreenTargets();
+  offscreenInfo = {
+      .allocator = GetCreateInfo().allocator,
+      .type = TextureType::Texture2D,
+      .format = TextureFormat::R8G8B8A8_UNORM,
+      .usage = TextureUsage::ColorTarget,
+      .width = width,
+      .height = height,
+      .layerCountOrDepth = 1,
+      .numLevels = 1,
+      .sampleCount = SampleCount::x1,
+  };
+  SDL_GPUTextureCreateInfo textureCreateInfo = {
+      .type = SDL_GPU_TEXTURETYPE_2D,
+      .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+      .usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER,
+      .width = width,
+      .height = height,
+      .layer_count_or_depth = 1,
+      .num_levels = 1,
+      .sample_count = SDL_GPU_SAMPLECOUNT_1,
+  };
+  for (uint32 i = 0; i < GetFramesInFlight(); ++i) {
+    auto *texture = SDL_CreateGPUTexture(device, &textureCreateInfo);
+    if (texture == nullptr) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Failed to create offscreen target: %s", SDL_GetError());
+      ReleaseOffscreenTargets();
+      return false;
+    }
+    offscreenTargets.push_back({.texture = texture});
+  }
+  return true;
+}
+void Device::ReleaseOffscreenTargets() {
+  for (auto &target : offscreenTargets) {
+    SDL_ReleaseGPUTexture(device, target.texture);
+  }
+  offscreenTargets.clear();
+  offscreenIndex = 0;
+}
+Ptr<SDL_GPUFence> Device::ShareFence(SDL_GPUFence *fence) {
+  if (fence == nullptr)
+    return nullptr;
+  return Ptr<SDL_GPUFence>(
+      fence,
+      [device = device](SDL_GPUFence *fence) {
+        SDL_ReleaseGPUFence(device, fence);
+      },
+      std::pmr::polymorphic_allocator<SDL_GPUFence>(
+          GetCreateInfo().allocator));
 }
 
 Ptr<px::TransferBuffer>
@@ -284,6 +408,19 @@ Ptr<px::Texture> Device::CreateTexture(const Texture::CreateInfo &createInfo) {
       .sample_count = convert::SampleCountFrom(createInfo.sampleCount),
   };
 
+  if (createInfo.generateMipmaps) {
+    // Mipmap generation renders into each level
+    if (!SDL_GPUTextureSupportsFormat(device, textureCreateInfo.format,
+                                      textureCreateInfo.type,
+                                      textureCreateInfo.usage |
+                                          SDL_GPU_TEXTUREUSAGE_COLOR_TARGET)) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Texture format can't be rendered to for mipmap generation");
+      return nullptr;
+    }
+    textureCreateInfo.usage |= SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
+  }
+
   SDL_GPUTexture *texture = SDL_CreateGPUTexture(device, &textureCreateInfo);
   return MakePtr<Texture>(createInfo.allocator, createInfo,
                           DownCast<Device>(GetPtr()), texture, false);
@@ -296,6 +433,13 @@ Ptr<px::Sampler> Device::CreateSampler(const Sampler::CreateInfo &createInfo) {
       .address_mode_u = convert::AddressModeFrom(createInfo.addressModeU),
       .address_mode_v = convert::AddressModeFrom(createInfo.addressModeV),
       .address_mode_w = convert::AddressModeFrom(createInfo.addressModeW),
+      .mip_lod_bias = createInfo.mipLodBias,
+      .max_anisotropy = createInfo.maxAnisotropy,
+      .compare_op = convert::CompareOpFrom(createInfo.compareOp),
+      .min_lod = createInfo.minLod,
+      .max_lod = createInfo.maxLod,
+      .enable_anisotropy = createInfo.enableAnisotropy,
+      .enable_compare = createInfo.enableCompare,
   };
   SDL_GPUSampler *sampler = SDL_CreateGPUSampler(device, &samplerCreateInfo);
   return MakePtr<Sampler>(createInfo.allocator, createInfo,
@@ -329,6 +473,53 @@ Ptr<px::Shader> Device::CreateShader(const Shader::CreateInfo &createInfo) {
   shaderCI.num_storage_buffers = createInfo.numStorageBuffers;
   shaderCI.num_storage_textures = createInfo.numStorageTextures;
   shaderCI.num_uniform_buffers = createInfo.numUniformBuffers;
+  // SDL_gpu takes no specialization info, so the constants are patched into
+  // the defaults of the module
+  Array<uint32> specialized(createInfo.allocator);
+  if (createInfo.numSpecializationConstants > 0) {
+    if (!SpecializeSPIRV(createInfo.data, createInfo.size,
+                         createInfo.specializationConstants,
+                         createInfo.numSpecializationConstants,
+                         specialized)) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Failed to specialize shader: invalid SPIR-V");
+      return nullptr;
+    }
+    shaderCI.code = reinterpret_cast<const Uint8 *>(specialized.data());
+  }
+  // Counts reflected from the bytecode win over hand-written ones, which are
+  // only checked
+  ShaderReflection reflection(createInfo.allocator);
+  if (ReflectSPIRV(createInfo.data, createInfo.size, createInfo.entrypoint,
+                   reflection)) {
+    if (reflection.usesBindlessTable) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Bindless tables are not supported by SDL_gpu");
+      return nullptr;
+    }
+    auto mismatch = [](uint32 given, uint32 reflected) {
+      return given != 0 && given != reflected;
+    };
+    if (mismatch(createInfo.numSamplers, reflection.numSamplers) ||
+        mismatch(createInfo.numStorageBuffers, reflection.numStorageBuffers) ||
+        mismatch(createInfo.numStorageTextures,
+                 reflection.numStorageTextures) ||
+        mismatch(createInfo.numUniformBuffers, reflection.numUniformBuffers)) {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                  "Shader resource counts differ from the SPIR-V, using "
+                  "%u samplers, %u storage textures, %u storage buffers and "
+                  "%u uniform buffers",
+                  reflection.numSamplers, reflection.numStorageTextures,
+                  reflection.numStorageBuffers, reflection.numUniformBuffers);
+    }
+    shaderCI.num_samplers = reflection.numSamplers;
+    shaderCI.num_storage_buffers = reflection.numStorageBuffers;
+    shaderCI.num_storage_textures = reflection.numStorageTextures;
+    shaderCI.num_uniform_buffers = reflection.numUniformBuffers;
+  } else {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to reflect shader, using the given resource counts");
+  }
 
   auto *shader = SDL_CreateGPUShader(device, &shaderCI);
 
@@ -337,6 +528,12 @@ Ptr<px::Shader> Device::CreateShader(const Shader::CreateInfo &createInfo) {
 
   return MakePtr<Shader>(createInfo.allocator, createInfo, p, shader);
 }
+Ptr<px::BindlessTable>
+Device::CreateBindlessTable(const BindlessTable::CreateInfo &createInfo) {
+  SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+               "Bindless tables are not supported by SDL_gpu");
+  return nullptr;
+}
 Ptr<px::CommandBuffer>
 Device::AcquireCommandBuffer(const CommandBuffer::CreateInfo &createInfo) {
   SDL_GPUCommandBuffer *commandBuffer = SDL_AcquireGPUCommandBuffer(device);
@@ -415,9 +612,9 @@ Device::CreateGraphicsPipeline(const GraphicsPipeline::CreateInfo &createInfo) {
   auto numColorTargets = createInfo.targetInfo.colorTargetDescriptions.size();
   pipelineCI.target_info.num_color_targets = numColorTargets;
 
-  Array<SDL_GPUColorTargetDescription> colorTargetDescs(createInfo.allocator);
-  colorTargetDescs.resize(numColorTargets);
-  for (int i = 0; i < numColorTargets; ++i) {
+  // Sized to the API limits, so translating a pipeline never allocates
+  SDL_GPUColorTargetDescription colorTargetDescs[MAX_COLOR_TARGETS];
+  for (uint32 i = 0; i < numColorTargets; ++i) {
     SDL_GPUColorTargetDescription colorTargetDesc{};
     colorTargetDesc.format = convert::TextureFormatFrom(
         createInfo.targetInfo.colorTargetDescriptions[i].format);
@@ -439,8 +636,7 @@ Device::CreateGraphicsPipeline(const GraphicsPipeline::CreateInfo &createInfo) {
     blend.enable_color_write_mask = pxBlend.enableColorWriteMask;
     colorTargetDescs[i] = colorTargetDesc;
   }
-  pipelineCI.target_info.color_target_descriptions = colorTargetDescs.data();
-  pipelineCI.target_info.num_color_targets = colorTargetDescs.size();
+  pipelineCI.target_info.color_target_descriptions = colorTargetDescs;
   pipelineCI.target_info.has_depth_stencil_target =
       createInfo.targetInfo.hasDepthStencilTarget;
   pipelineCI.target_info.depth_stencil_format = convert::TextureFormatFrom(
@@ -449,8 +645,8 @@ Device::CreateGraphicsPipeline(const GraphicsPipeline::CreateInfo &createInfo) {
       createInfo.vertexInputState.vertexAttributes.size();
   pipelineCI.vertex_input_state.num_vertex_buffers =
       createInfo.vertexInputState.vertexBufferDescriptions.size();
-  Array<SDL_GPUVertexAttribute> vertexAttributes(createInfo.allocator);
-  for (int i = 0; i < createInfo.vertexInputState.vertexAttributes.size();
+  SDL_GPUVertexAttribute vertexAttributes[MAX_VERTEX_ATTRIBUTES];
+  for (uint32 i = 0; i < createInfo.vertexInputState.vertexAttributes.size();
        ++i) {
     SDL_GPUVertexAttribute vertexAttribute = {};
     vertexAttribute.location =
@@ -461,11 +657,11 @@ Device::CreateGraphicsPipeline(const GraphicsPipeline::CreateInfo &createInfo) {
         createInfo.vertexInputState.vertexAttributes[i].format);
     vertexAttribute.offset =
         createInfo.vertexInputState.vertexAttributes[i].offset;
-    vertexAttributes.push_back(vertexAttribute);
+    vertexAttributes[i] = vertexAttribute;
   }
-  pipelineCI.vertex_input_state.vertex_attributes = vertexAttributes.data();
-  Array<SDL_GPUVertexBufferDescription> vbDescs(createInfo.allocator);
-  for (int i = 0;
+  pipelineCI.vertex_input_state.vertex_attributes = vertexAttributes;
+  SDL_GPUVertexBufferDescription vbDescs[MAX_VERTEX_BUFFERS];
+  for (uint32 i = 0;
        i < createInfo.vertexInputState.vertexBufferDescriptions.size(); i++) {
     auto &desc = createInfo.vertexInputState.vertexBufferDescriptions[i];
     SDL_GPUVertexBufferDescription vbDesc = {};
@@ -473,9 +669,9 @@ Device::CreateGraphicsPipeline(const GraphicsPipeline::CreateInfo &createInfo) {
     vbDesc.instance_step_rate = desc.instanceStepRate;
     vbDesc.pitch = desc.pitch;
     vbDesc.slot = desc.slot;
-    vbDescs.push_back(vbDesc);
+    vbDescs[i] = vbDesc;
   }
-  pipelineCI.vertex_input_state.vertex_buffer_descriptions = vbDescs.data();
+  pipelineCI.vertex_input_state.vertex_buffer_descriptions = vbDescs;
 
   auto *pipeline = SDL_CreateGPUGraphicsPipeline(device, &pipelineCI);
   return MakePtr<GraphicsPipeline>(createInfo.allocator, createInfo,
@@ -487,12 +683,56 @@ Device::CreateComputePipeline(const ComputePipeline::CreateInfo &createInfo) {
                                   DownCast<Device>(GetPtr()), nullptr);
 }
 void Device::SubmitCommandBuffer(Ptr<px::CommandBuffer> commandBuffer) {
-  SDL_SubmitGPUCommandBuffer(
-      DownCast<CommandBuffer>(commandBuffer)->GetNative());
+  auto raw = DownCast<CommandBuffer>(commandBuffer);
+  auto index = raw->GetOffscreenIndex();
+  if (index >= offscreenTargets.size()) {
+    SDL_SubmitGPUCommandBuffer(raw->GetNative());
+    return;
+  }
+  // The next frame that acquires the target waits on the fence
+  offscreenTargets[index].fence =
+      ShareFence(SDL_SubmitGPUCommandBufferAndAcquireFence(raw->GetNative()));
+}
+Ptr<px::Fence> Device::SubmitCommandBufferAndAcquireFence(
+    Ptr<px::CommandBuffer> commandBuffer) {
+  auto raw = DownCast<CommandBuffer>(commandBuffer);
+  auto *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(raw->GetNative());
+  if (fence == nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", SDL_GetError());
+    return nullptr;
+  }
+  auto shared = ShareFence(fence);
+  if (raw->GetOffscreenIndex() < offscreenTargets.size()) {
+    offscreenTargets[raw->GetOffscreenIndex()].fence = shared;
+  }
+  return MakePtr<Fence>(GetCreateInfo().allocator, DownCast<Device>(GetPtr()),
+                        shared);
+}
+bool Device::QueryFence(Ptr<px::Fence> fence) {
+  return SDL_QueryGPUFence(device, DownCast<Fence>(fence)->GetNative());
+}
+void Device::WaitForFences(const Array<Ptr<px::Fence>> &fences, bool waitAll) {
+  if (fences.empty())
+    return;
+  Array<SDL_GPUFence *> nativeFences(GetCreateInfo().allocator);
+  nativeFences.resize(fences.size());
+  for (int i = 0; i < fences.size(); ++i) {
+    nativeFences[i] = DownCast<Fence>(fences[i])->GetNative();
+  }
+  SDL_WaitForGPUFences(device, waitAll, nativeFences.data(),
+                       nativeFences.size());
 }
 Ptr<px::Texture>
 Device::AcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer) {
-
+  return AcquireSwapchainTexture(commandBuffer, true);
+}
+Ptr<px::Texture>
+Device::TryAcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer) {
+  return AcquireSwapchainTexture(commandBuffer, false);
+}
+Ptr<px::Texture>
+Device::AcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer,
+                                bool wait) {
   auto raw = DownCast<CommandBuffer>(commandBuffer);
   auto buffer = raw->GetNative();
   if (buffer == nullptr) {
@@ -500,13 +740,41 @@ Device::AcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer) {
                  "Command buffer is not valid for swapchain texture");
     return nullptr;
   }
+  if (!window && !offscreenTargets.empty()) {
+    auto index = offscreenIndex;
+    auto &target = offscreenTargets[index];
+    // Takes the place of vsync, the CPU stays at most one round of targets
+    // ahead of the GPU
+    auto *fence = target.fence.get();
+    if (fence) {
+      if (wait) {
+        SDL_WaitForGPUFences(device, true, &fence, 1);
+      } else if (!SDL_QueryGPUFence(device, fence)) {
+        return nullptr;
+      }
+    }
+    target.fence = nullptr;
+    offscreenIndex = (offscreenIndex + 1) % offscreenTargets.size();
+    raw->SetOffscreenIndex(index);
+    auto ci = offscreenInfo;
+    ci.allocator = commandBuffer->GetCreateInfo().allocator;
+    return MakePtr<Texture>(ci.allocator, ci, DownCast<Device>(GetPtr()),
+                            target.texture, true);
+  }
   SDL_GPUTexture *nativeTex = nullptr;
-  SDL_WaitAndAcquireGPUSwapchainTexture(buffer, window, &nativeTex, nullptr,
-                                        nullptr);
-  if (nativeTex == nullptr) {
+  bool acquired =
+      wait ? SDL_WaitAndAcquireGPUSwapchainTexture(buffer, window, &nativeTex,
+                                                   nullptr, nullptr)
+           : SDL_AcquireGPUSwapchainTexture(buffer, window, &nativeTex,
+                                            nullptr, nullptr);
+  if (!acquired) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", SDL_GetError());
     return nullptr;
   }
+  if (nativeTex == nullptr) {
+    // Minimized, or too many frames in flight when not waiting
+    return nullptr;
+  }
 
   Texture::CreateInfo ci{};
   ci.allocator = commandBuffer->GetCreateInfo().allocator;
@@ -515,6 +783,9 @@ Device::AcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer) {
   return texture;
 }
 px::TextureFormat Device::GetSwapchainFormat() const {
+  if (!window && !offscreenTargets.empty()) {
+    return offscreenInfo.format;
+  }
   auto format = SDL_GetGPUSwapchainTextureFormat(device, window);
   switch (format) {
   case SDL_GPU_TEXTUREFORMAT_B8G8R8A8_UNORM:
@@ -529,6 +800,12 @@ px::TextureFormat Device::GetSwapchainFormat() const {
   };
 }
 void Device::WaitForGPUIdle() { SDL_WaitForGPUIdle(device); }
+// SDL_gpu manages memory internally and reports nothing about it
+bool Device::GetMemoryBudgets(Array<MemoryHeapBudget> &budgets) {
+  budgets.clear();
+  return false;
+}
+void Device::DefragmentMemory(float timeBudgetMs) {}
 String Device::GetDriver() const {
   return String(SDL_GetGPUDeviceDriver(device), GetCreateInfo().allocator);
 }
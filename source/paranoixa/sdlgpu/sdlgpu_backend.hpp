@@ -13,10 +13,13 @@ namespace px = paranoixa;
 class Device : public px::Device {
 public:
   Device(const CreateInfo &createInfo, SDL_GPUDevice *device)
-      : px::Device(createInfo), device(device), window(nullptr) {}
+      : px::Device(createInfo), device(device), window(nullptr),
+        offscreenInfo(), offscreenTargets(createInfo.allocator),
+        offscreenIndex(0) {}
   SDL_GPUDevice *GetNative() { return device; }
   virtual ~Device() override;
   virtual void ClaimWindow(void *window) override;
+  virtual bool ClaimOffscreen(uint32 width, uint32 height) override;
   virtual Ptr<px::Buffer>
   CreateBuffer(const Buffer::CreateInfo &createInfo) override;
   virtual Ptr<px::Texture>
@@ -27,6 +30,8 @@ public:
   CreateTransferBuffer(const TransferBuffer::CreateInfo &createInfo) override;
   virtual Ptr<px::Shader>
   CreateShader(const Shader::CreateInfo &createInfo) override;
+  virtual Ptr<px::BindlessTable>
+  CreateBindlessTable(const BindlessTable::CreateInfo &createInfo) override;
   virtual Ptr<px::CommandBuffer>
   AcquireCommandBuffer(const CommandBuffer::CreateInfo &createInfo) override;
   virtual Ptr<px::GraphicsPipeline> CreateGraphicsPipeline(
@@ -35,18 +40,45 @@ public:
   CreateComputePipeline(const ComputePipeline::CreateInfo &createInfo) override;
   virtual void
   SubmitCommandBuffer(Ptr<px::CommandBuffer> commandBuffer) override;
+  virtual Ptr<px::Fence> SubmitCommandBufferAndAcquireFence(
+      Ptr<px::CommandBuffer> commandBuffer) override;
+  virtual bool QueryFence(Ptr<px::Fence> fence) override;
+  virtual void WaitForFences(const Array<Ptr<px::Fence>> &fences,
+                             bool waitAll) override;
   virtual Ptr<px::Texture>
   AcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer) override;
+  virtual Ptr<px::Texture>
+  TryAcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer) override;
   virtual px::TextureFormat GetSwapchainFormat() const override;
   virtual void WaitForGPUIdle() override;
+  virtual bool GetMemoryBudgets(Array<MemoryHeapBudget> &budgets) override;
+  virtual void DefragmentMemory(float timeBudgetMs) override;
   virtual String GetDriver() const override;
   std::shared_ptr<Device> Get() {
     return std::dynamic_pointer_cast<Device>(GetPtr());
   }
 
 private:
+  void ReleaseOffscreenTargets();
+  Ptr<px::Texture> AcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer,
+                                           bool wait);
+
   SDL_GPUDevice *device;
   SDL_Window *window;
+  // Stand in for the swapchain when no window is claimed, one per frame in
+  // flight
+  struct OffscreenTarget {
+    SDL_GPUTexture *texture = nullptr;
+    // Signaled by the frame that used the target last. Shared with the
+    // caller of SubmitCommandBufferAndAcquireFence, so dropping the returned
+    // fence doesn't end the pacing.
+    Ptr<SDL_GPUFence> fence;
+  };
+  // Releases the fence once the last owner drops it
+  Ptr<SDL_GPUFence> ShareFence(SDL_GPUFence *fence);
+  px::Texture::CreateInfo offscreenInfo;
+  Array<OffscreenTarget> offscreenTargets;
+  uint32 offscreenIndex;
 };
 class Texture : public px::Texture {
 public:
@@ -108,6 +140,18 @@ private:
   Ptr<Device> device;
   SDL_GPUBuffer *buffer;
 };
+class Fence : public px::Fence {
+public:
+  Fence(const Ptr<Device> &device, const Ptr<SDL_GPUFence> &fence)
+      : px::Fence(), device(device), fence(fence) {}
+
+  inline SDL_GPUFence *GetNative() { return fence.get(); }
+
+private:
+  // Keeps the device alive until the fence is released
+  Ptr<Device> device;
+  Ptr<SDL_GPUFence> fence;
+};
 class Backend : public px::Backend {
 public:
   virtual Ptr<px::Device>
@@ -169,6 +213,7 @@ public:
   void
   BindFragmentSamplers(uint32 startSlot,
                        const Array<TextureSamplerBinding> &bindings) override;
+  void BindBindlessTable(Ptr<px::BindlessTable> bindlessTable) override;
   void SetViewport(const Viewport &viewport) override;
   void SetScissor(int32 x, int32 y, int32 width, int32 height) override;
   void DrawPrimitives(uint32 vertexCount, uint32 instanceCount,
@@ -190,6 +235,9 @@ public:
       : px::CommandBuffer(createInfo), commandBuffer(commandBuffer) {}
 
   SDL_GPUCommandBuffer *GetNative() { return commandBuffer; }
+  // Offscreen target acquired by the command buffer, UINT32_MAX if none
+  uint32 GetOffscreenIndex() const { return offscreenIndex; }
+  void SetOffscreenIndex(uint32 index) { offscreenIndex = index; }
 
   Ptr<px::CopyPass> BeginCopyPass() override;
   void EndCopyPass(Ptr<px::CopyPass> copyPass) override;
@@ -201,8 +249,12 @@ public:
 
   void PushUniformData(uint32 slot, const void *data, size_t size) override;
 
+  void GenerateMipmaps(Ptr<px::Texture> texture) override;
+  void Blit(const BlitInfo &blitInfo) override;
+
 private:
   SDL_GPUCommandBuffer *commandBuffer;
+  uint32 offscreenIndex = UINT32_MAX;
 };
 
 class GraphicsPipeline : public px::GraphicsPipeline {
@@ -78,6 +78,16 @@ SDL_GPUTextureFormat TextureFormatFrom(TextureFormat textureFormat) {
     return SDL_GPU_TEXTUREFORMAT_B8G8R8A8_UNORM;
   case TextureFormat::R32G32B32A32_FLOAT:
     return SDL_GPU_TEXTUREFORMAT_R32G32B32A32_FLOAT;
+  case TextureFormat::BC1_RGBA_UNORM:
+    return SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+  case TextureFormat::BC3_RGBA_UNORM:
+    return SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+  case TextureFormat::BC4_R_UNORM:
+    return SDL_GPU_TEXTUREFORMAT_BC4_R_UNORM;
+  case TextureFormat::BC5_RG_UNORM:
+    return SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM;
+  case TextureFormat::BC7_RGBA_UNORM:
+    return SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM;
   case TextureFormat::D32_FLOAT_S8_UINT:
     return SDL_GPU_TEXTUREFORMAT_D32_FLOAT_S8_UINT;
   default:
@@ -238,6 +248,8 @@ SDL_GPUBufferUsageFlags BufferUsageFrom(BufferUsage bufferUsage) {
     return SDL_GPU_BUFFERUSAGE_INDEX;
   case BufferUsage::Indirect:
     return SDL_GPU_BUFFERUSAGE_INDIRECT;
+  case BufferUsage::Storage:
+    return SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
   default:
     return SDL_GPU_BUFFERUSAGE_VERTEX;
   }
@@ -302,6 +314,18 @@ SDL_GPUBlendOp BlendOpFrom(BlendOp blendOp) {
     return SDL_GPU_BLENDOP_ADD;
   }
 }
+SDL_GPUPresentMode PresentModeFrom(PresentMode presentMode) {
+  switch (presentMode) {
+  case PresentMode::Fifo:
+    return SDL_GPU_PRESENTMODE_VSYNC;
+  case PresentMode::Mailbox:
+    return SDL_GPU_PRESENTMODE_MAILBOX;
+  case PresentMode::Immediate:
+    return SDL_GPU_PRESENTMODE_IMMEDIATE;
+  default:
+    return SDL_GPU_PRESENTMODE_VSYNC;
+  }
+}
 
 } // namespace convert
 } // namespace paranoixa::sdlgpu
\ No newline at end of file
@@ -27,6 +27,7 @@ SDL_GPUTransferBufferUsage
 TransferBufferUsageFrom(TransferBufferUsage transferBufferUsage);
 SDL_GPUBlendFactor BlendFactorFrom(BlendFactor blendFactor);
 SDL_GPUBlendOp BlendOpFrom(BlendOp blendOp);
+SDL_GPUPresentMode PresentModeFrom(PresentMode presentMode);
 } // namespace convert
 } // namespace paranoixa::sdlgpu
 #endif // !PARANOIXA_SDLGPU_CONVERT_HPP
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "shader_variants.hpp"
+#include "spirv_reflection.hpp"
+
+#include <algorithm>
+
+#include <SDL3/SDL.h>
+
+namespace paranoixa {
+namespace {
+std::uint64_t HashValues(const Array<uint32> &values) {
+  // FNV-1a
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  for (auto value : values) {
+    hash ^= value;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+} // namespace
+
+ShaderVariants::ShaderVariants(const CreateInfo &createInfo)
+    : createInfo(createInfo), code(createInfo.allocator),
+      entrypoint(createInfo.shader.entrypoint != nullptr
+                     ? createInfo.shader.entrypoint
+                     : "main",
+                 createInfo.allocator),
+      defaults(createInfo.allocator), valid(false),
+      variants(createInfo.allocator), statistics() {
+  assert(createInfo.device != nullptr);
+  const auto &shaderCI = createInfo.shader;
+  // Constants given with the module are folded into the stored copy, so
+  // they act as defaults
+  valid = SpecializeSPIRV(shaderCI.data, shaderCI.size,
+                          shaderCI.specializationConstants,
+                          shaderCI.numSpecializationConstants, code) &&
+          ReflectSpecializationConstants(
+              code.data(), code.size() * sizeof(uint32), defaults);
+  if (!valid) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "ShaderVariants: invalid SPIR-V module");
+  }
+  this->createInfo.shader.data = nullptr;
+  this->createInfo.shader.entrypoint = nullptr;
+  this->createInfo.shader.specializationConstants = nullptr;
+  this->createInfo.shader.numSpecializationConstants = 0;
+}
+
+Ptr<Shader> ShaderVariants::Get(const SpecializationConstant *constants,
+                                uint32 numConstants) {
+  if (!valid) {
+    return nullptr;
+  }
+  // The effective value of every constant of the module, in ID order
+  Array<uint32> values(defaults.size(), 0, createInfo.allocator);
+  for (size_t i = 0; i < defaults.size(); ++i) {
+    values[i] = defaults[i].value;
+  }
+  for (uint32 i = 0; i < numConstants; ++i) {
+    auto it = std::lower_bound(
+        defaults.begin(), defaults.end(), constants[i].constantID,
+        [](const auto &a, uint32 id) { return a.constantID < id; });
+    if (it != defaults.end() && it->constantID == constants[i].constantID) {
+      values[it - defaults.begin()] = constants[i].value;
+    }
+  }
+  auto hash = HashValues(values);
+
+  std::unique_lock lock(mutex);
+  auto [it, inserted] =
+      variants.try_emplace(hash, Array<Variant>(createInfo.allocator));
+  for (const auto &variant : it->second) {
+    if (variant.values == values) {
+      statistics.numHits++;
+      return variant.shader;
+    }
+  }
+  statistics.numMisses++;
+
+  Array<SpecializationConstant> specialization(defaults, createInfo.allocator);
+  for (size_t i = 0; i < specialization.size(); ++i) {
+    specialization[i].value = values[i];
+  }
+  auto shaderCI = createInfo.shader;
+  shaderCI.allocator = createInfo.allocator;
+  shaderCI.size = code.size() * sizeof(uint32);
+  shaderCI.data = code.data();
+  shaderCI.entrypoint = entrypoint.c_str();
+  shaderCI.specializationConstants = specialization.data();
+  shaderCI.numSpecializationConstants =
+      static_cast<uint32>(specialization.size());
+  // Compiled under the lock so that a variant is only ever compiled once
+  auto shader = createInfo.device->CreateShader(shaderCI);
+  if (shader == nullptr) {
+    return nullptr;
+  }
+  it->second.push_back({std::move(values), shader});
+  statistics.numVariants++;
+  return shader;
+}
+
+ShaderVariants::Statistics ShaderVariants::GetStatistics() {
+  std::unique_lock lock(mutex);
+  return statistics;
+}
+} // namespace paranoixa
@@ -0,0 +1,500 @@
+#include "spirv_reflection.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+
+namespace paranoixa {
+namespace {
+constexpr uint32 MAGIC = 0x07230203;
+constexpr uint32 HEADER_WORDS = 5;
+// Far above any real shader, guards the id table against corrupt headers
+constexpr uint32 MAX_BOUND = 0x400000;
+
+// Opcodes, storage classes and decorations from the SPIR-V specification
+enum Op : uint32 {
+  OpLine = 8,
+  OpEntryPoint = 15,
+  OpTypeInt = 21,
+  OpTypeFloat = 22,
+  OpTypeVector = 23,
+  OpTypeImage = 25,
+  OpTypeSampledImage = 27,
+  OpTypeArray = 28,
+  OpTypeRuntimeArray = 29,
+  OpTypeStruct = 30,
+  OpTypePointer = 32,
+  OpConstant = 43,
+  OpSpecConstantTrue = 48,
+  OpSpecConstantFalse = 49,
+  OpSpecConstant = 50,
+  OpFunction = 54,
+  OpFunctionEnd = 56,
+  OpFunctionCall = 57,
+  OpVariable = 59,
+  OpDecorate = 71,
+};
+enum StorageClass : uint32 {
+  UniformConstant = 0,
+  Input = 1,
+  Uniform = 2,
+  StorageBuffer = 12,
+};
+enum Decoration : uint32 {
+  SpecId = 1,
+  Block = 2,
+  BufferBlock = 3,
+  BuiltIn = 11,
+  Location = 30,
+  DescriptorSet = 34,
+};
+enum ExecutionModel : uint32 {
+  ExecutionModelVertex = 0,
+  ExecutionModelFragment = 4,
+};
+enum DecorationBit : uint32 {
+  BLOCK_BIT = 1 << 0,
+  BUFFER_BLOCK_BIT = 1 << 1,
+  BUILT_IN_BIT = 1 << 2,
+  LOCATION_BIT = 1 << 3,
+  DESCRIPTOR_SET_BIT = 1 << 4,
+};
+
+// The few operands reflection needs from the instruction defining an id
+struct IdInfo {
+  uint32 opcode;
+  uint32 operands[2];
+  uint32 decorations;
+  uint32 location;
+  uint32 descriptorSet;
+};
+struct EntryPoint {
+  uint32 executionModel;
+  uint32 function;
+  std::string_view name;
+  // Word range of the interface ids
+  uint32 interfaceBegin;
+  uint32 interfaceEnd;
+};
+
+bool ReadHeader(const void *code, size_t size, const uint32 *&words,
+                uint32 &numWords, uint32 &bound) {
+  words = static_cast<const uint32 *>(code);
+  numWords = static_cast<uint32>(size / sizeof(uint32));
+  if (words == nullptr || numWords < HEADER_WORDS || words[0] != MAGIC) {
+    return false;
+  }
+  bound = words[3];
+  return bound != 0 && bound <= MAX_BOUND;
+}
+// Map result ids to their SpecId, NO_SPEC_ID for everything else
+constexpr uint32 NO_SPEC_ID = ~0u;
+bool CollectSpecIds(const uint32 *words, uint32 numWords,
+                    Array<uint32> &specIds) {
+  for (uint32 offset = HEADER_WORDS; offset < numWords;) {
+    auto opcode = words[offset] & 0xFFFF;
+    auto wordCount = words[offset] >> 16;
+    if (wordCount == 0 || offset + wordCount > numWords) {
+      return false;
+    }
+    if (opcode == OpDecorate && wordCount >= 4 &&
+        words[offset + 2] == SpecId && words[offset + 1] < specIds.size()) {
+      specIds[words[offset + 1]] = words[offset + 3];
+    }
+    if (opcode == OpFunction) {
+      break;
+    }
+    offset += wordCount;
+  }
+  return true;
+}
+
+// Strip arrays off a type and multiply their lengths into count
+// Returns 0, which is never a valid id, for malformed types. Array types
+// that nest too deeply (including ones that refer back to themselves) or
+// whose lengths overflow the count are treated as malformed.
+uint32 UnwrapArrays(const Array<IdInfo> &ids, uint32 type, uint32 &count) {
+  constexpr uint32 MAX_ARRAY_DEPTH = 64;
+  uint32 depth = 0;
+  while (type < ids.size() && (ids[type].opcode == OpTypeArray ||
+                               ids[type].opcode == OpTypeRuntimeArray)) {
+    if (++depth > MAX_ARRAY_DEPTH)
+      return 0;
+    if (ids[type].opcode == OpTypeArray) {
+      auto lengthId = ids[type].operands[1];
+      if (lengthId < ids.size() && ids[lengthId].opcode == OpConstant) {
+        auto length = ids[lengthId].operands[0];
+        if (length != 0 && count > UINT32_MAX / length)
+          return 0;
+        count *= length;
+      }
+    }
+    type = ids[type].operands[0];
+  }
+  return type < ids.size() ? type : 0;
+}
+// Record the word range of every function, as operands of its id
+bool CollectFunctions(const uint32 *words, uint32 numWords, uint32 offset,
+                      Array<IdInfo> &ids) {
+  uint32 function = 0, begin = 0;
+  while (offset < numWords) {
+    auto opcode = words[offset] & 0xFFFF;
+    auto wordCount = words[offset] >> 16;
+    if (wordCount == 0 || offset + wordCount > numWords) {
+      return false;
+    }
+    if (opcode == OpFunction && wordCount >= 3) {
+      function = words[offset + 2];
+      begin = offset;
+    } else if (opcode == OpFunctionEnd && function != 0) {
+      if (function < ids.size()) {
+        ids[function].opcode = OpFunction;
+        ids[function].operands[0] = begin;
+        ids[function].operands[1] = offset;
+      }
+      function = 0;
+    }
+    offset += wordCount;
+  }
+  return true;
+}
+// Mark the global variables the function and its callees refer to. Every
+// operand word that names a global variable counts, so a literal that
+// happens to equal one errs on the side of counting it.
+void MarkUsedVariables(const uint32 *words, const Array<IdInfo> &ids,
+                       uint32 entryFunction, Array<uint8> &used) {
+  Array<uint32> functions(used.get_allocator());
+  if (entryFunction < ids.size() && ids[entryFunction].opcode == OpFunction) {
+    used[entryFunction] = 1;
+    functions.push_back(entryFunction);
+  }
+  while (!functions.empty()) {
+    const auto &function = ids[functions.back()];
+    functions.pop_back();
+    for (auto offset = function.operands[0]; offset < function.operands[1];
+         offset += words[offset] >> 16) {
+      auto opcode = words[offset] & 0xFFFF;
+      auto wordCount = words[offset] >> 16;
+      if (opcode == OpLine)
+        continue;
+      for (uint32 i = 1; i < wordCount; ++i) {
+        auto id = words[offset + i];
+        if (id >= ids.size() || used[id])
+          continue;
+        if (ids[id].opcode == OpVariable) {
+          used[id] = 1;
+        } else if (opcode == OpFunctionCall && i == 3 &&
+                   ids[id].opcode == OpFunction) {
+          used[id] = 1;
+          functions.push_back(id);
+        }
+      }
+    }
+  }
+}
+bool GetVertexElementFormat(const Array<IdInfo> &ids, uint32 type,
+                            VertexElementFormat &format) {
+  uint32 numComponents = 1;
+  if (type < ids.size() && ids[type].opcode == OpTypeVector) {
+    numComponents = ids[type].operands[1];
+    type = ids[type].operands[0];
+  }
+  if (type >= ids.size() || ids[type].opcode != OpTypeFloat ||
+      ids[type].operands[0] != 32)
+    return false;
+  constexpr VertexElementFormat floatFormats[] = {Float1, Float2, Float3,
+                                                  Float4};
+  if (numComponents < 1 || numComponents > 4)
+    return false;
+  format = floatFormats[numComponents - 1];
+  return true;
+}
+} // namespace
+
+bool ReflectSPIRV(const void *code, size_t size, const char *entrypoint,
+                  ShaderReflection &reflection) {
+  const uint32 *words;
+  uint32 numWords, bound;
+  if (!ReadHeader(code, size, words, numWords, bound)) {
+    return false;
+  }
+  // Ids are dense, so a flat table indexed by id replaces any map
+  Array<IdInfo> ids(bound, IdInfo{}, reflection.allocator);
+  Array<EntryPoint> entryPoints(reflection.allocator);
+
+  uint32 offset = HEADER_WORDS;
+  while (offset < numWords) {
+    auto opcode = words[offset] & 0xFFFF;
+    auto wordCount = words[offset] >> 16;
+    if (wordCount == 0 || offset + wordCount > numWords) {
+      return false;
+    }
+    const uint32 *operands = words + offset + 1;
+    auto numOperands = wordCount - 1;
+    auto define = [&](uint32 id, uint32 a, uint32 b) {
+      if (id < bound)
+        ids[id] = {opcode, {a, b}, ids[id].decorations, ids[id].location,
+                   ids[id].descriptorSet};
+    };
+    switch (opcode) {
+    case OpEntryPoint: {
+      if (numOperands < 3)
+        return false;
+      auto *name = reinterpret_cast<const char *>(operands + 2);
+      auto maxLength = (numOperands - 2) * sizeof(uint32);
+      std::string_view nameView(name, strnlen(name, maxLength));
+      // The name is nul-terminated and padded to a whole word
+      auto nameWords = static_cast<uint32>(nameView.size() / 4 + 1);
+      entryPoints.push_back({operands[0], operands[1], nameView,
+                             offset + 3 + nameWords, offset + wordCount});
+      break;
+    }
+    case OpDecorate:
+      if (numOperands >= 2 && operands[0] < bound) {
+        auto &info = ids[operands[0]];
+        switch (operands[1]) {
+        case Block:
+          info.decorations |= BLOCK_BIT;
+          break;
+        case BufferBlock:
+          info.decorations |= BUFFER_BLOCK_BIT;
+          break;
+        case BuiltIn:
+          info.decorations |= BUILT_IN_BIT;
+          break;
+        case Location:
+          if (numOperands >= 3) {
+            info.decorations |= LOCATION_BIT;
+            info.location = operands[2];
+          }
+          break;
+        case DescriptorSet:
+          if (numOperands >= 3) {
+            info.decorations |= DESCRIPTOR_SET_BIT;
+            info.descriptorSet = operands[2];
+          }
+          break;
+        }
+      }
+      break;
+    case OpTypeInt:
+    case OpTypeFloat:
+      if (numOperands >= 2)
+        define(operands[0], operands[1], 0);
+      break;
+    case OpTypeVector:
+    case OpTypeArray:
+      if (numOperands >= 3)
+        define(operands[0], operands[1], operands[2]);
+      break;
+    case OpTypeImage:
+      // Sampled is 1 for sampled images and 2 for storage images
+      if (numOperands >= 7)
+        define(operands[0], operands[6], operands[2]);
+      break;
+    case OpTypeSampledImage:
+    case OpTypeRuntimeArray:
+      if (numOperands >= 2)
+        define(operands[0], operands[1], 0);
+      break;
+    case OpTypeStruct:
+      if (numOperands >= 1)
+        define(operands[0], 0, 0);
+      break;
+    case OpTypePointer:
+      if (numOperands >= 3)
+        define(operands[0], operands[1], operands[2]);
+      break;
+    case OpConstant:
+      if (numOperands >= 3)
+        define(operands[1], operands[2], operands[0]);
+      break;
+    case OpVariable:
+      if (numOperands >= 3)
+        define(operands[1], operands[0], operands[2]);
+      break;
+    }
+    // Declarations end at the first function
+    if (opcode == OpFunction) {
+      break;
+    }
+    offset += wordCount;
+  }
+  if (!CollectFunctions(words, numWords, offset, ids)) {
+    return false;
+  }
+
+  auto entryPoint =
+      std::find_if(entryPoints.begin(), entryPoints.end(), [&](auto &e) {
+        return e.name == (entrypoint != nullptr ? entrypoint : "main");
+      });
+  if (entryPoint == entryPoints.end() ||
+      (entryPoint->executionModel != ExecutionModelVertex &&
+       entryPoint->executionModel != ExecutionModelFragment)) {
+    return false;
+  }
+  reflection.stage = entryPoint->executionModel == ExecutionModelVertex
+                         ? ShaderStage::Vertex
+                         : ShaderStage::Fragment;
+  reflection.numSamplers = 0;
+  reflection.numStorageTextures = 0;
+  reflection.numStorageBuffers = 0;
+  reflection.numUniformBuffers = 0;
+  reflection.usesBindlessTable = false;
+  reflection.vertexInputs.clear();
+
+  // Only the resources of the entry point's call tree are bound, not every
+  // global of the module
+  Array<uint8> used(bound, 0, reflection.allocator);
+  MarkUsedVariables(words, ids, entryPoint->function, used);
+  for (uint32 id = 0; id < bound; ++id) {
+    const auto &variable = ids[id];
+    if (variable.opcode != OpVariable || !used[id])
+      continue;
+    auto pointerType = variable.operands[0];
+    auto storageClass = variable.operands[1];
+    if (pointerType >= bound || ids[pointerType].opcode != OpTypePointer)
+      continue;
+    // The bindless table is bound as a whole, not slot by slot
+    if ((variable.decorations & DESCRIPTOR_SET_BIT) &&
+        variable.descriptorSet == BINDLESS_DESCRIPTOR_SET) {
+      reflection.usesBindlessTable = true;
+      continue;
+    }
+    uint32 count = 1;
+    auto type = UnwrapArrays(ids, ids[pointerType].operands[1], count);
+    const auto &typeInfo = ids[type];
+    switch (storageClass) {
+    case UniformConstant:
+      if (typeInfo.opcode == OpTypeSampledImage ||
+          (typeInfo.opcode == OpTypeImage && typeInfo.operands[0] == 1)) {
+        reflection.numSamplers += count;
+      } else if (typeInfo.opcode == OpTypeImage &&
+                 typeInfo.operands[0] == 2) {
+        reflection.numStorageTextures += count;
+      }
+      break;
+    case Uniform:
+      if (typeInfo.decorations & BUFFER_BLOCK_BIT) {
+        reflection.numStorageBuffers += count;
+      } else if (typeInfo.decorations & BLOCK_BIT) {
+        reflection.numUniformBuffers += count;
+      }
+      break;
+    case StorageBuffer:
+      reflection.numStorageBuffers += count;
+      break;
+    }
+  }
+
+  if (reflection.stage == ShaderStage::Vertex) {
+    for (auto i = entryPoint->interfaceBegin; i < entryPoint->interfaceEnd;
+         ++i) {
+      auto id = words[i];
+      if (id >= bound)
+        continue;
+      const auto &variable = ids[id];
+      if (variable.opcode != OpVariable || variable.operands[1] != Input ||
+          (variable.decorations & BUILT_IN_BIT) ||
+          !(variable.decorations & LOCATION_BIT)) {
+        continue;
+      }
+      auto pointerType = variable.operands[0];
+      if (pointerType >= bound)
+        continue;
+      VertexElementFormat format;
+      if (GetVertexElementFormat(ids, ids[pointerType].operands[1], format)) {
+        reflection.vertexInputs.push_back({variable.location, format});
+      }
+    }
+    std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(),
+              [](const auto &a, const auto &b) {
+                return a.location < b.location;
+              });
+  }
+  return true;
+}
+
+bool ReflectSpecializationConstants(
+    const void *code, size_t size, Array<SpecializationConstant> &constants) {
+  const uint32 *words;
+  uint32 numWords, bound;
+  if (!ReadHeader(code, size, words, numWords, bound)) {
+    return false;
+  }
+  Array<uint32> specIds(bound, NO_SPEC_ID, constants.get_allocator());
+  if (!CollectSpecIds(words, numWords, specIds)) {
+    return false;
+  }
+  constants.clear();
+  for (uint32 offset = HEADER_WORDS; offset < numWords;) {
+    auto opcode = words[offset] & 0xFFFF;
+    auto wordCount = words[offset] >> 16;
+    if (opcode == OpFunction) {
+      break;
+    }
+    auto resultId = wordCount >= 3 ? words[offset + 2] : bound;
+    if (resultId < bound && specIds[resultId] != NO_SPEC_ID) {
+      if (opcode == OpSpecConstantTrue || opcode == OpSpecConstantFalse) {
+        constants.push_back(
+            {specIds[resultId], opcode == OpSpecConstantTrue ? 1u : 0u});
+      } else if (opcode == OpSpecConstant && wordCount == 4) {
+        constants.push_back({specIds[resultId], words[offset + 3]});
+      }
+    }
+    offset += wordCount;
+  }
+  std::sort(constants.begin(), constants.end(),
+            [](const auto &a, const auto &b) {
+              return a.constantID < b.constantID;
+            });
+  return true;
+}
+
+bool SpecializeSPIRV(const void *code, size_t size,
+                     const SpecializationConstant *constants,
+                     uint32 numConstants, Array<uint32> &specialized) {
+  const uint32 *words;
+  uint32 numWords, bound;
+  if (!ReadHeader(code, size, words, numWords, bound)) {
+    return false;
+  }
+  Array<uint32> specIds(bound, NO_SPEC_ID, specialized.get_allocator());
+  if (!CollectSpecIds(words, numWords, specIds)) {
+    return false;
+  }
+  specialized.assign(words, words + numWords);
+  auto find = [&](uint32 constantID) -> const SpecializationConstant * {
+    // The last value given for an ID wins
+    for (auto i = numConstants; i-- > 0;) {
+      if (constants[i].constantID == constantID)
+        return &constants[i];
+    }
+    return nullptr;
+  };
+  for (uint32 offset = HEADER_WORDS; offset < numWords;) {
+    auto opcode = words[offset] & 0xFFFF;
+    auto wordCount = words[offset] >> 16;
+    if (opcode == OpFunction) {
+      break;
+    }
+    auto resultId = wordCount >= 3 ? words[offset + 2] : bound;
+    const SpecializationConstant *constant = nullptr;
+    if (resultId < bound && specIds[resultId] != NO_SPEC_ID) {
+      constant = find(specIds[resultId]);
+    }
+    // Only the default values change, the module stays valid as is
+    if (constant != nullptr) {
+      if (opcode == OpSpecConstantTrue || opcode == OpSpecConstantFalse) {
+        auto newOpcode =
+            constant->value != 0 ? OpSpecConstantTrue : OpSpecConstantFalse;
+        specialized[offset] = (wordCount << 16) | newOpcode;
+      } else if (opcode == OpSpecConstant && wordCount == 4) {
+        specialized[offset + 3] = constant->value;
+      }
+    }
+    offset += wordCount;
+  }
+  return true;
+}
+} // namespace paranoixa
@@ -0,0 +1,381 @@
+#include "texture_streamer.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+
+namespace paranoixa {
+namespace {
+constexpr uint32 STAGING_BUFFER_SIZE = 4 * 1024 * 1024;
+
+uint32 GetMipExtent(uint32 extent, uint32 mipLevel) {
+  return std::max(extent >> mipLevel, 1u);
+}
+std::uint64_t GetMipSize(const TextureStreamer::StreamInfo &info,
+                         uint32 mipLevel) {
+  return CalculateTextureSize(info.format, GetMipExtent(info.width, mipLevel),
+                              GetMipExtent(info.height, mipLevel), 1);
+}
+// Max-heap order: higher priority first, then coarser mips first
+constexpr auto JobOrder = [](const auto &a, const auto &b) {
+  if (a.priority != b.priority)
+    return a.priority < b.priority;
+  return a.mipLevel < b.mipLevel;
+};
+} // namespace
+
+TextureStreamer::TextureStreamer(const CreateInfo &createInfo)
+    : createInfo(createInfo),
+      uploadBatcher({createInfo.allocator, createInfo.device,
+                     STAGING_BUFFER_SIZE}),
+      streams(createInfo.allocator), jobs(createInfo.allocator),
+      loaded(createInfo.allocator), workers(createInfo.allocator),
+      nextHandle(1), frame(0), statistics() {
+  assert(createInfo.device != nullptr);
+  auto numThreads = std::max(createInfo.numThreads, 1u);
+  for (uint32 i = 0; i < numThreads; ++i) {
+    workers.emplace_back(
+        [this](std::stop_token stopToken) { WorkerMain(stopToken); });
+  }
+}
+
+TextureStreamer::~TextureStreamer() {
+  // Joins the workers before the state they read goes away
+  workers.clear();
+}
+
+TextureStreamer::Handle TextureStreamer::Stream(const StreamInfo &streamInfo) {
+  assert(streamInfo.numLevels > 0);
+  assert(streamInfo.loader);
+  std::unique_lock lock(mutex);
+  auto handle = nextHandle++;
+  auto &stream = streams[handle];
+  stream.info = streamInfo;
+  stream.texture = nullptr;
+  stream.residentMip = streamInfo.numLevels;
+  stream.targetMip = 0;
+  stream.minMip = 0;
+  stream.lastUsedFrame = frame;
+  stream.loading = false;
+  QueueLoad(handle, stream);
+  return handle;
+}
+
+void TextureStreamer::Release(Handle handle) {
+  std::unique_lock lock(mutex);
+  // Jobs and loaded mips of released streams are dropped when they are
+  // dequeued.
+  streams.erase(handle);
+}
+
+void TextureStreamer::SetPriority(Handle handle, float priority) {
+  std::unique_lock lock(mutex);
+  auto it = streams.find(handle);
+  if (it == streams.end())
+    return;
+  it->second.info.priority = priority;
+  for (auto &job : jobs) {
+    if (job.handle == handle)
+      job.priority = priority;
+  }
+  std::make_heap(jobs.begin(), jobs.end(), JobOrder);
+}
+
+Ptr<Texture> TextureStreamer::GetTexture(Handle handle) {
+  std::unique_lock lock(mutex);
+  auto it = streams.find(handle);
+  if (it == streams.end())
+    return nullptr;
+  auto &stream = it->second;
+  stream.lastUsedFrame = frame;
+  // Evicted mips are streamed back in once the texture is used again
+  if (stream.targetMip != stream.minMip) {
+    stream.targetMip = stream.minMip;
+    QueueLoad(handle, stream);
+  }
+  return stream.texture;
+}
+
+uint32 TextureStreamer::GetResidentMip(Handle handle) {
+  std::unique_lock lock(mutex);
+  auto it = streams.find(handle);
+  return it != streams.end() ? it->second.residentMip : 0;
+}
+
+void TextureStreamer::Update() {
+  // Planned under the lock and recorded without it, so that GetTexture()
+  // and the workers don't wait on the device
+  Array<ResizeJob> resizes(createInfo.allocator);
+  {
+    std::unique_lock lock(mutex);
+    frame++;
+
+    std::sort(loaded.begin(), loaded.end(), [](const auto &a, const auto &b) {
+      return JobOrder(b, a);
+    });
+    HashMap<Handle, uint32> plannedMips(createInfo.allocator);
+    std::uint64_t uploaded = 0;
+    Array<LoadedMip> deferred(createInfo.allocator);
+    for (auto &mip : loaded) {
+      auto it = streams.find(mip.handle);
+      if (it == streams.end())
+        continue;
+      auto &stream = it->second;
+      auto size = GetMipSize(stream.info, mip.mipLevel);
+      // Always let one mip through so that huge mips can't stall forever
+      if (uploaded > 0 && uploaded + size > createInfo.uploadBudgetPerFrame) {
+        deferred.push_back(std::move(mip));
+        continue;
+      }
+      // The stream was evicted while this mip was loading
+      if (mip.mipLevel + 1 != stream.residentMip) {
+        stream.loading = false;
+        QueueLoad(it->first, stream);
+        continue;
+      }
+      // The upload reads a whole mip, so a short buffer is loaded again
+      if (mip.texels.size() != size) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "TextureStreamer: mip %u holds %zu bytes instead of %llu",
+                     mip.mipLevel, mip.texels.size(),
+                     static_cast<unsigned long long>(size));
+        stream.loading = false;
+        QueueLoad(it->first, stream);
+        continue;
+      }
+      // The stream stays loading until the new texture is in place
+      plannedMips[it->first] = mip.mipLevel;
+      resizes.push_back(MakeResizeJob(it->first, stream, mip.mipLevel));
+      resizes.back().texels = std::move(mip.texels);
+      uploaded += size;
+    }
+    loaded.swap(deferred);
+    PlanEvictions(plannedMips, resizes);
+    statistics.uploadedBytes += uploaded;
+  }
+  if (resizes.empty())
+    return;
+
+  struct Result {
+    Ptr<Texture> texture;
+    uint32 residentMip;
+    bool uploaded;
+  };
+  HashMap<Handle, Result> results(createInfo.allocator);
+  Ptr<CommandBuffer> command = nullptr;
+  Ptr<CopyPass> copyPass = nullptr;
+  for (auto &resize : resizes) {
+    // Later resizes of the same stream start from the earlier ones
+    auto &result =
+        results
+            .try_emplace(resize.handle,
+                         Result{resize.texture, resize.residentMip, false})
+            .first->second;
+    auto texture = Resize(command, copyPass, resize, result.texture,
+                          result.residentMip);
+    if (texture == nullptr)
+      continue;
+    result.texture = texture;
+    result.residentMip = resize.newResidentMip;
+    if (!resize.texels.empty()) {
+      TextureRegion region{
+          .texture = texture,
+          .mipLevel = 0,
+          .width = GetMipExtent(resize.width, resize.newResidentMip),
+          .height = GetMipExtent(resize.height, resize.newResidentMip),
+          .depth = 1,
+      };
+      uploadBatcher.UploadTexture(resize.texels.data(),
+                                  static_cast<uint32>(resize.texels.size()),
+                                  region);
+      result.uploaded = true;
+    }
+  }
+  if (command != nullptr) {
+    command->EndCopyPass(copyPass);
+    createInfo.device->SubmitCommandBuffer(command);
+  }
+  // Submitted after the copies above so that a new level 0 lands in a
+  // texture whose coarser levels are already in place.
+  uploadBatcher.Flush();
+
+  std::unique_lock lock(mutex);
+  for (auto &[handle, result] : results) {
+    auto it = streams.find(handle);
+    if (it == streams.end())
+      continue;
+    auto &stream = it->second;
+    stream.texture = result.texture;
+    stream.residentMip = result.residentMip;
+    if (result.uploaded) {
+      stream.loading = false;
+      QueueLoad(handle, stream);
+    }
+  }
+}
+
+TextureStreamer::Statistics TextureStreamer::GetStatistics() {
+  std::unique_lock lock(mutex);
+  statistics.residentBytes = 0;
+  for (auto &[handle, stream] : streams) {
+    statistics.residentBytes += GetResidentSize(stream, stream.residentMip);
+  }
+  statistics.numPendingLoads =
+      static_cast<uint32>(jobs.size() + loaded.size());
+  return statistics;
+}
+
+void TextureStreamer::WorkerMain(std::stop_token stopToken) {
+  while (true) {
+    std::unique_lock lock(mutex);
+    // Returns true with jobs still queued once stop is requested, which are
+    // abandoned rather than run
+    if (!jobAvailable.wait(lock, stopToken, [this] { return !jobs.empty(); }) ||
+        stopToken.stop_requested())
+      return;
+    std::pop_heap(jobs.begin(), jobs.end(), JobOrder);
+    auto job = jobs.back();
+    jobs.pop_back();
+    auto it = streams.find(job.handle);
+    if (it == streams.end())
+      continue;
+    auto loader = it->second.info.loader;
+    lock.unlock();
+
+    // The shared allocator is not thread safe, so texel payloads are
+    // allocated from the global heap.
+    LoadedMip mip{job.handle, job.mipLevel, job.priority,
+                  Array<std::byte>(std::pmr::new_delete_resource())};
+    bool succeeded = loader(job.mipLevel, mip.texels);
+
+    lock.lock();
+    it = streams.find(job.handle);
+    if (it == streams.end())
+      continue;
+    if (!succeeded) {
+      // Keep what is resident and stop streaming finer mips of this texture
+      it->second.loading = false;
+      it->second.minMip = job.mipLevel + 1;
+      it->second.targetMip = it->second.minMip;
+      continue;
+    }
+    loaded.push_back(std::move(mip));
+  }
+}
+
+void TextureStreamer::QueueLoad(Handle handle, StreamState &stream) {
+  if (stream.loading || stream.residentMip == 0 ||
+      stream.residentMip <= stream.targetMip)
+    return;
+  stream.loading = true;
+  jobs.push_back({handle, stream.residentMip - 1, stream.info.priority});
+  std::push_heap(jobs.begin(), jobs.end(), JobOrder);
+  jobAvailable.notify_one();
+}
+
+TextureStreamer::ResizeJob
+TextureStreamer::MakeResizeJob(Handle handle, const StreamState &stream,
+                               uint32 newResidentMip) const {
+  return {
+      .handle = handle,
+      .format = stream.info.format,
+      .width = stream.info.width,
+      .height = stream.info.height,
+      .numLevels = stream.info.numLevels,
+      .texture = stream.texture,
+      .residentMip = stream.residentMip,
+      .newResidentMip = newResidentMip,
+      .texels = Array<std::byte>(std::pmr::new_delete_resource()),
+  };
+}
+
+Ptr<Texture> TextureStreamer::Resize(Ptr<CommandBuffer> &command,
+                                     Ptr<CopyPass> &copyPass,
+                                     const ResizeJob &resize,
+                                     const Ptr<Texture> &oldTexture,
+                                     uint32 oldResidentMip) {
+  auto &device = createInfo.device;
+  Texture::CreateInfo textureCI{
+      .allocator = createInfo.allocator,
+      .type = TextureType::Texture2D,
+      .format = resize.format,
+      .usage = TextureUsage::Sampler,
+      .width = GetMipExtent(resize.width, resize.newResidentMip),
+      .height = GetMipExtent(resize.height, resize.newResidentMip),
+      .layerCountOrDepth = 1,
+      .numLevels = resize.numLevels - resize.newResidentMip,
+      .sampleCount = SampleCount::x1,
+  };
+  auto texture = device->CreateTexture(textureCI);
+  if (texture == nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "TextureStreamer: failed to create texture");
+    return nullptr;
+  }
+  if (oldTexture != nullptr) {
+    if (command == nullptr) {
+      command = device->AcquireCommandBuffer({createInfo.allocator});
+      copyPass = command->BeginCopyPass();
+    }
+    // Carry over the levels both textures have in common
+    auto first = std::max(oldResidentMip, resize.newResidentMip);
+    for (auto mip = first; mip < resize.numLevels; ++mip) {
+      TextureLocation src{
+          .texture = oldTexture,
+          .mipLevel = mip - oldResidentMip,
+      };
+      TextureLocation dst{
+          .texture = texture,
+          .mipLevel = mip - resize.newResidentMip,
+      };
+      copyPass->CopyTexture(src, dst, GetMipExtent(resize.width, mip),
+                            GetMipExtent(resize.height, mip), 1, false);
+    }
+  }
+  return texture;
+}
+
+void TextureStreamer::PlanEvictions(HashMap<Handle, uint32> &plannedMips,
+                                    Array<ResizeJob> &resizes) {
+  auto plannedMip = [&](Handle handle, const StreamState &stream) {
+    auto it = plannedMips.find(handle);
+    return it != plannedMips.end() ? it->second : stream.residentMip;
+  };
+  std::uint64_t resident = 0;
+  for (auto &[handle, stream] : streams) {
+    resident += GetResidentSize(stream, plannedMip(handle, stream));
+  }
+  while (resident > createInfo.memoryBudget) {
+    Handle victimHandle = 0;
+    StreamState *victim = nullptr;
+    for (auto &[handle, stream] : streams) {
+      // Never evict what was drawn last frame or the last remaining mip
+      if (stream.lastUsedFrame + 1 >= frame ||
+          plannedMip(handle, stream) + 1 >= stream.info.numLevels)
+        continue;
+      if (victim == nullptr || stream.lastUsedFrame < victim->lastUsedFrame) {
+        victim = &stream;
+        victimHandle = handle;
+      }
+    }
+    if (victim == nullptr)
+      break;
+    auto mip = plannedMip(victimHandle, *victim);
+    resident -= GetResidentSize(*victim, mip) -
+                GetResidentSize(*victim, mip + 1);
+    plannedMips[victimHandle] = mip + 1;
+    resizes.push_back(MakeResizeJob(victimHandle, *victim, mip + 1));
+    victim->targetMip = mip + 1;
+    statistics.numEvictions++;
+  }
+}
+
+std::uint64_t TextureStreamer::GetResidentSize(const StreamState &stream,
+                                               uint32 residentMip) const {
+  std::uint64_t size = 0;
+  for (auto mip = residentMip; mip < stream.info.numLevels; ++mip) {
+    size += GetMipSize(stream.info, mip);
+  }
+  return size;
+}
+} // namespace paranoixa
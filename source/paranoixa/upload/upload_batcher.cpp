@@ -0,0 +1,268 @@
+#include "upload_batcher.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+
+namespace paranoixa {
+namespace {
+// Satisfies the offset alignment of every texel block and buffer copy
+constexpr uint32 STAGING_ALIGNMENT = 16;
+constexpr uint32 AlignUp(uint32 value, uint32 alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+} // namespace
+
+UploadBatcher::UploadBatcher(const CreateInfo &createInfo)
+    : createInfo(createInfo), pages(createInfo.allocator),
+      freePages(createInfo.allocator), openPages(createInfo.allocator),
+      currentPage(nullptr), copies(createInfo.allocator),
+      inFlight(createInfo.allocator), failedTokens(createInfo.allocator),
+      nextToken(1), completedToken(0), statistics() {
+  assert(createInfo.device != nullptr);
+  assert(createInfo.stagingBufferSize > 0);
+}
+
+UploadBatcher::~UploadBatcher() {
+  Flush();
+  std::unique_lock lock(mutex);
+  Array<Ptr<Fence>> fences(createInfo.allocator);
+  for (auto &batch : inFlight) {
+    fences.push_back(batch.fence);
+  }
+  if (!fences.empty()) {
+    createInfo.device->WaitForFences(fences, true);
+  }
+  inFlight.clear();
+  for (auto *page : freePages) {
+    page->transferBuffer->Unmap();
+  }
+}
+
+UploadBatcher::Token UploadBatcher::UploadBuffer(const void *data,
+                                                 const BufferRegion &dst) {
+  Copy copy{};
+  copy.buffer = dst;
+  copy.isTexture = false;
+  return Upload(dst.size, copy, [&](void *staging) {
+    std::memcpy(staging, data, dst.size);
+  });
+}
+
+UploadBatcher::Token UploadBatcher::UploadTexture(const void *data,
+                                                  uint32 size,
+                                                  const TextureRegion &dst) {
+  Copy copy{};
+  copy.texture = dst;
+  copy.isTexture = true;
+  return Upload(size, copy,
+                [&](void *staging) { std::memcpy(staging, data, size); });
+}
+
+UploadBatcher::Token
+UploadBatcher::UploadTexture(uint32 size, const TextureRegion &dst,
+                             const std::function<void(void *staging)> &writer) {
+  Copy copy{};
+  copy.texture = dst;
+  copy.isTexture = true;
+  return Upload(size, copy, writer);
+}
+
+UploadBatcher::Token
+UploadBatcher::Upload(uint32 size, const Copy &copy,
+                      const std::function<void(void *staging)> &writer) {
+  std::unique_lock lock(mutex);
+  auto alignedSize = AlignUp(size, STAGING_ALIGNMENT);
+  Page *page = nullptr;
+  if (alignedSize > createInfo.stagingBufferSize) {
+    page = AcquirePage(alignedSize);
+    openPages.push_back(page);
+  } else {
+    if (currentPage == nullptr ||
+        currentPage->used + alignedSize > currentPage->size) {
+      currentPage = AcquirePage(createInfo.stagingBufferSize);
+      openPages.push_back(currentPage);
+    }
+    page = currentPage;
+  }
+  auto offset = page->used;
+  page->used += alignedSize;
+  page->writers++;
+
+  auto &queued = copies.emplace_back(copy);
+  queued.page = page;
+  queued.offset = offset;
+  statistics.numUploads++;
+  statistics.numBytes += size;
+  auto token = nextToken;
+
+  // Write outside the lock so that threads filling the same page don't
+  // serialize on each other.
+  lock.unlock();
+  writer(page->mapped + offset);
+  lock.lock();
+  if (--page->writers == 0) {
+    writersDone.notify_all();
+  }
+  return token;
+}
+
+UploadBatcher::Token UploadBatcher::Flush() {
+  std::unique_lock lock(mutex);
+  writersDone.wait(lock, [this] {
+    return std::none_of(openPages.begin(), openPages.end(),
+                        [](Page *page) { return page->writers > 0; });
+  });
+  if (copies.empty()) {
+    return nextToken - 1;
+  }
+
+  for (auto *page : openPages) {
+    page->transferBuffer->Unmap();
+    page->mapped = nullptr;
+  }
+  auto &device = createInfo.device;
+  auto command = device->AcquireCommandBuffer({createInfo.allocator});
+  auto copyPass = command->BeginCopyPass();
+  for (auto &copy : copies) {
+    if (copy.isTexture) {
+      TextureTransferInfo src{
+          .transferBuffer = copy.page->transferBuffer,
+          .offset = copy.offset,
+      };
+      copyPass->UploadTexture(src, copy.texture, false);
+    } else {
+      BufferTransferInfo src{
+          .transferBuffer = copy.page->transferBuffer,
+          .offset = copy.offset,
+      };
+      copyPass->UploadBuffer(src, copy.buffer, false);
+    }
+  }
+  command->EndCopyPass(copyPass);
+  auto fence = device->SubmitCommandBufferAndAcquireFence(command);
+  copies.clear();
+  currentPage = nullptr;
+  if (fence == nullptr) {
+    // The copies are lost and the token never completes, but the pages can
+    // be reused right away
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "UploadBatcher: failed to submit the copy pass");
+    for (auto *page : openPages) {
+      ReleasePage(page);
+    }
+    openPages.clear();
+    failedTokens.push_back(nextToken);
+    Retire();
+    return nextToken++;
+  }
+  statistics.numCopyPasses++;
+
+  Batch batch{nextToken, fence, Array<Page *>(createInfo.allocator)};
+  batch.pages.swap(openPages);
+  inFlight.push_back(std::move(batch));
+  Retire();
+  return nextToken++;
+}
+
+bool UploadBatcher::IsComplete(Token token) {
+  std::unique_lock lock(mutex);
+  Retire();
+  return token <= completedToken && !IsFailed(token);
+}
+
+bool UploadBatcher::HasFailed(Token token) {
+  std::unique_lock lock(mutex);
+  return IsFailed(token);
+}
+
+bool UploadBatcher::IsFailed(Token token) const {
+  return std::find(failedTokens.begin(), failedTokens.end(), token) !=
+         failedTokens.end();
+}
+
+void UploadBatcher::Wait(Token token) {
+  bool needsFlush = false;
+  {
+    std::unique_lock lock(mutex);
+    if (token <= completedToken || IsFailed(token)) {
+      return;
+    }
+    needsFlush = token >= nextToken;
+  }
+  if (needsFlush) {
+    Flush();
+  }
+  Array<Ptr<Fence>> fences(createInfo.allocator);
+  {
+    std::unique_lock lock(mutex);
+    for (auto &batch : inFlight) {
+      if (batch.token <= token) {
+        fences.push_back(batch.fence);
+      }
+    }
+  }
+  // Without the lock, so that other threads keep queueing uploads
+  if (!fences.empty()) {
+    createInfo.device->WaitForFences(fences, true);
+  }
+  std::unique_lock lock(mutex);
+  Retire();
+}
+
+UploadBatcher::Statistics UploadBatcher::GetStatistics() {
+  std::unique_lock lock(mutex);
+  return statistics;
+}
+
+UploadBatcher::Page *UploadBatcher::AcquirePage(uint32 size) {
+  auto it = std::find_if(freePages.begin(), freePages.end(),
+                         [size](Page *page) { return page->size >= size; });
+  if (it != freePages.end()) {
+    auto *page = *it;
+    freePages.erase(it);
+    return page;
+  }
+  TransferBuffer::CreateInfo transferBufferCI{
+      .allocator = createInfo.allocator,
+      .usage = TransferBufferUsage::Upload,
+      .size = size,
+  };
+  auto page = MakePtr<Page>(createInfo.allocator);
+  page->transferBuffer =
+      createInfo.device->CreateTransferBuffer(transferBufferCI);
+  page->mapped = static_cast<std::byte *>(page->transferBuffer->Map(false));
+  page->size = size;
+  page->used = 0;
+  page->writers = 0;
+  pages.push_back(page);
+  statistics.numStagingBuffers++;
+  return page.get();
+}
+
+void UploadBatcher::ReleasePage(Page *page) {
+  // Dedicated pages for oversized uploads are not worth keeping around
+  if (page->size > createInfo.stagingBufferSize) {
+    std::erase_if(pages,
+                  [page](const Ptr<Page> &p) { return p.get() == page; });
+    return;
+  }
+  page->used = 0;
+  page->mapped = static_cast<std::byte *>(page->transferBuffer->Map(false));
+  freePages.push_back(page);
+}
+
+void UploadBatcher::Retire() {
+  auto retired = inFlight.begin();
+  for (; retired != inFlight.end(); ++retired) {
+    if (!createInfo.device->QueryFence(retired->fence)) {
+      break;
+    }
+    completedToken = retired->token;
+    for (auto *page : retired->pages) {
+      ReleasePage(page);
+    }
+  }
+  inFlight.erase(inFlight.begin(), retired);
+}
+} // namespace paranoixa
@@ -0,0 +1,3019 @@
+#include "paranoixa.hpp"
+#ifndef EMSCRIPTEN
+#include "vulkan_backend.hpp"
+#include "pipeline_cache_file.hpp"
+#include "spirv_reflection.hpp"
+#include "vulkan_convert.hpp"
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_vulkan.h>
+
+#include <algorithm>
+#include <cstddef>
+
+namespace paranoixa::vulkan {
+namespace {
+// Uniform data of one command buffer is suballocated from blocks this big
+constexpr uint32 UNIFORM_BLOCK_SIZE = 256 * 1024;
+constexpr uint32 DESCRIPTOR_POOL_SETS = 512;
+
+PipelineCacheIdentity
+GetPipelineCacheIdentity(const VkPhysicalDeviceProperties &properties) {
+  PipelineCacheIdentity identity{
+      .vendorID = properties.vendorID,
+      .deviceID = properties.deviceID,
+      .driverVersion = properties.driverVersion,
+  };
+  std::memcpy(identity.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  return identity;
+}
+uint32 GetLayerCount(const px::Texture::CreateInfo &createInfo) {
+  return createInfo.type == TextureType::Texture3D
+             ? 1
+             : std::max(createInfo.layerCountOrDepth, 1u);
+}
+VkImageCreateInfo
+GetImageCreateInfo(const px::Texture::CreateInfo &createInfo) {
+  return {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .flags = createInfo.type == TextureType::Cube ||
+                       createInfo.type == TextureType::CubeArray
+                   ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT
+                   : 0u,
+      .imageType = convert::ImageTypeFrom(createInfo.type),
+      .format = convert::TextureFormatFrom(createInfo.format),
+      .extent = {createInfo.width, createInfo.height,
+                 createInfo.type == TextureType::Texture3D
+                     ? createInfo.layerCountOrDepth
+                     : 1},
+      .mipLevels = std::max(createInfo.numLevels, 1u),
+      .arrayLayers = GetLayerCount(createInfo),
+      .samples = convert::SampleCountFrom(createInfo.sampleCount),
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = convert::TextureUsageFrom(createInfo.usage),
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+}
+// Copies address one aspect. Depth stencil textures are copied by depth.
+VkImageAspectFlags GetCopyAspect(const Texture &texture) {
+  return texture.GetAspect() & VK_IMAGE_ASPECT_COLOR_BIT
+             ? VK_IMAGE_ASPECT_COLOR_BIT
+             : VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+} // namespace
+
+Ptr<px::Device> Backend::CreateDevice(const Device::CreateInfo &createInfo) {
+  auto device = MakePtr<Device>(createInfo.allocator, createInfo);
+  if (!device->Initialize()) {
+    return nullptr;
+  }
+  return device;
+}
+
+Device::Device(const CreateInfo &createInfo)
+    : px::Device(createInfo), instance(VK_NULL_HANDLE),
+      physicalDevice(VK_NULL_HANDLE), properties(), features(),
+      device(VK_NULL_HANDLE), queueFamilyIndex(0), queue(VK_NULL_HANDLE),
+      memoryAllocator(VK_NULL_HANDLE), frameIndex(0),
+      stagingPool(VK_NULL_HANDLE), pipelineCache(VK_NULL_HANDLE),
+      bindlessSetLayout(VK_NULL_HANDLE), hasSurfaceSupport(false),
+      loadedVulkanLibrary(false), window(nullptr), surface(VK_NULL_HANDLE),
+      surfaceFormat(), presentMode(VK_PRESENT_MODE_FIFO_KHR),
+      swapchain(VK_NULL_HANDLE), swapchainExtent(),
+      swapchainOutOfDate(false),
+      swapchainImages(std::pmr::new_delete_resource()),
+      swapchainViews(std::pmr::new_delete_resource()),
+      presentSemaphores(std::pmr::new_delete_resource()),
+      frameSerials(std::pmr::new_delete_resource()), frameSerialIndex(0),
+      offscreenInfo(),
+      offscreenTargets(std::pmr::new_delete_resource()), offscreenIndex(0),
+      nextSerial(1),
+      openSerials(std::pmr::new_delete_resource()),
+      pendingContexts(std::pmr::new_delete_resource()),
+      pinnedSerials(std::pmr::new_delete_resource()),
+      freeContexts(std::pmr::new_delete_resource()),
+      initialLayouts(std::pmr::new_delete_resource()),
+      garbage(std::pmr::new_delete_resource()),
+      renderTargetPools(std::pmr::new_delete_resource()),
+      defragmentationRequested(false), defragmentationPoolIndex(0),
+      defragmentation(VK_NULL_HANDLE), defragmentationPass(),
+      defragmentationSerial(0), setLayouts(std::pmr::new_delete_resource()) {}
+
+bool Device::Initialize() {
+  if (volkInitialize() != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to load the Vulkan loader");
+    return false;
+  }
+  //------------------------
+  // Create instance
+  //------------------------
+  Array<const char *> extensions(std::pmr::new_delete_resource());
+  if (SDL_WasInit(SDL_INIT_VIDEO) && SDL_Vulkan_LoadLibrary(nullptr)) {
+    loadedVulkanLibrary = true;
+    uint32 count = 0;
+    const char *const *names = SDL_Vulkan_GetInstanceExtensions(&count);
+    if (names != nullptr) {
+      extensions.assign(names, names + count);
+      hasSurfaceSupport = true;
+    }
+  }
+  Array<const char *> layers(std::pmr::new_delete_resource());
+  if (GetCreateInfo().debugMode) {
+    uint32 count = 0;
+    vkEnumerateInstanceLayerProperties(&count, nullptr);
+    Array<VkLayerProperties> available(count, std::pmr::new_delete_resource());
+    vkEnumerateInstanceLayerProperties(&count, available.data());
+    for (const auto &layer : available) {
+      if (std::strcmp(layer.layerName, "VK_LAYER_KHRONOS_validation") == 0) {
+        layers.push_back("VK_LAYER_KHRONOS_validation");
+      }
+    }
+  }
+  VkApplicationInfo appInfo = {
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pApplicationName = "Paranoixa",
+      .applicationVersion = VK_MAKE_API_VERSION(0, 1, 0, 0),
+      .pEngineName = "Paranoixa",
+      .engineVersion = VK_MAKE_API_VERSION(0, 1, 0, 0),
+      .apiVersion = VK_API_VERSION_1_3,
+  };
+  VkInstanceCreateInfo instanceCI = {
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pApplicationInfo = &appInfo,
+      .enabledLayerCount = static_cast<uint32>(layers.size()),
+      .ppEnabledLayerNames = layers.data(),
+      .enabledExtensionCount = static_cast<uint32>(extensions.size()),
+      .ppEnabledExtensionNames = extensions.data(),
+  };
+  if (vkCreateInstance(&instanceCI, nullptr, &instance) != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create Vulkan instance");
+    return false;
+  }
+  volkLoadInstance(instance);
+
+  //------------------------
+  // Pick physical device
+  //------------------------
+  uint32 count = 0;
+  vkEnumeratePhysicalDevices(instance, &count, nullptr);
+  Array<VkPhysicalDevice> physicalDevices(count,
+                                          std::pmr::new_delete_resource());
+  vkEnumeratePhysicalDevices(instance, &count, physicalDevices.data());
+  int bestScore = -1;
+  for (auto candidate : physicalDevices) {
+    VkPhysicalDeviceProperties candidateProperties;
+    vkGetPhysicalDeviceProperties(candidate, &candidateProperties);
+    VkPhysicalDeviceVulkan13Features vulkan13Features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+    VkPhysicalDeviceFeatures2 features2{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &vulkan13Features};
+    vkGetPhysicalDeviceFeatures2(candidate, &features2);
+    if (candidateProperties.apiVersion < VK_API_VERSION_1_3 ||
+        !vulkan13Features.dynamicRendering ||
+        !vulkan13Features.synchronization2) {
+      continue;
+    }
+    uint32 familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, nullptr);
+    Array<VkQueueFamilyProperties> families(familyCount,
+                                            std::pmr::new_delete_resource());
+    vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount,
+                                             families.data());
+    auto graphics = std::find_if(families.begin(), families.end(),
+                                 [](const VkQueueFamilyProperties &family) {
+                                   return family.queueFlags &
+                                          VK_QUEUE_GRAPHICS_BIT;
+                                 });
+    if (graphics == families.end()) {
+      continue;
+    }
+    // Prefer discrete over integrated GPUs, and any GPU over a software
+    // rasterizer like lavapipe
+    int score = 0;
+    switch (candidateProperties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      score = 3;
+      break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      score = 2;
+      break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      score = 1;
+      break;
+    default:
+      break;
+    }
+    if (score > bestScore) {
+      bestScore = score;
+      physicalDevice = candidate;
+      properties = candidateProperties;
+      queueFamilyIndex = static_cast<uint32>(graphics - families.begin());
+    }
+  }
+  if (physicalDevice == VK_NULL_HANDLE) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "No Vulkan 1.3 device with dynamic rendering and "
+                 "synchronization2");
+    return false;
+  }
+
+  //------------------------
+  // Create logical device
+  //------------------------
+  VkPhysicalDeviceVulkan12Features supported12{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  VkPhysicalDeviceFeatures2 supported{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &supported12};
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+  features.depthClamp = supported.features.depthClamp;
+  features.fillModeNonSolid = supported.features.fillModeNonSolid;
+  features.samplerAnisotropy = supported.features.samplerAnisotropy;
+  // Bindless tables need update-after-bind arrays large enough for the
+  // table on top of the per-draw slots
+  VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{
+      .sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES};
+  VkPhysicalDeviceProperties2 properties2{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &indexingProperties};
+  vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+  const auto &indexing = indexingProperties;
+  bool supportsBindless =
+      supported12.runtimeDescriptorArray &&
+      supported12.descriptorBindingPartiallyBound &&
+      supported12.descriptorBindingSampledImageUpdateAfterBind &&
+      supported12.descriptorBindingStorageBufferUpdateAfterBind &&
+      supported12.descriptorBindingUpdateUnusedWhilePending &&
+      supported12.shaderSampledImageArrayNonUniformIndexing &&
+      supported12.shaderStorageBufferArrayNonUniformIndexing &&
+      properties.limits.maxBoundDescriptorSets > BINDLESS_DESCRIPTOR_SET &&
+      indexing.maxPerStageDescriptorUpdateAfterBindSampledImages >=
+          MAX_BINDLESS_TEXTURES + MAX_SAMPLERS &&
+      indexing.maxPerStageDescriptorUpdateAfterBindSamplers >=
+          MAX_BINDLESS_SAMPLERS + MAX_SAMPLERS &&
+      indexing.maxPerStageDescriptorUpdateAfterBindStorageBuffers >=
+          MAX_BINDLESS_BUFFERS &&
+      indexing.maxPerStageUpdateAfterBindResources >=
+          MAX_BINDLESS_TEXTURES + MAX_BINDLESS_SAMPLERS +
+              MAX_BINDLESS_BUFFERS + MAX_SAMPLERS + MAX_UNIFORM_BUFFERS &&
+      indexing.maxDescriptorSetUpdateAfterBindSampledImages >=
+          MAX_BINDLESS_TEXTURES + MAX_SAMPLERS &&
+      indexing.maxDescriptorSetUpdateAfterBindSamplers >=
+          MAX_BINDLESS_SAMPLERS + MAX_SAMPLERS &&
+      indexing.maxDescriptorSetUpdateAfterBindStorageBuffers >=
+          MAX_BINDLESS_BUFFERS;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count,
+                                       nullptr);
+  Array<VkExtensionProperties> available(count,
+                                         std::pmr::new_delete_resource());
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count,
+                                       available.data());
+  auto hasExtension = [&](const char *name) {
+    return std::any_of(available.begin(), available.end(),
+                       [&](const auto &extension) {
+                         return std::strcmp(extension.extensionName, name) == 0;
+                       });
+  };
+  Array<const char *> deviceExtensions(std::pmr::new_delete_resource());
+  if (hasSurfaceSupport) {
+    hasSurfaceSupport = hasExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    if (hasSurfaceSupport) {
+      deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+  }
+  // Lets the allocator report the budget of the driver instead of estimating
+  // it from its own allocations
+  bool hasMemoryBudget = hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (hasMemoryBudget) {
+    deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+  VkPhysicalDeviceVulkan13Features vulkan13Features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .synchronization2 = VK_TRUE,
+      .dynamicRendering = VK_TRUE,
+  };
+  VkPhysicalDeviceVulkan12Features vulkan12Features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .pNext = &vulkan13Features,
+  };
+  if (supportsBindless) {
+    vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    vulkan12Features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+    vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+  }
+  VkPhysicalDeviceFeatures2 features2{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &vulkan12Features,
+      .features = features,
+  };
+  constexpr float queuePriority = 1.0f;
+  VkDeviceQueueCreateInfo queueCI{
+      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+      .queueFamilyIndex = queueFamilyIndex,
+      .queueCount = 1,
+      .pQueuePriorities = &queuePriority,
+  };
+  VkDeviceCreateInfo deviceCI{
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = &features2,
+      .queueCreateInfoCount = 1,
+      .pQueueCreateInfos = &queueCI,
+      .enabledExtensionCount = static_cast<uint32>(deviceExtensions.size()),
+      .ppEnabledExtensionNames = deviceExtensions.data(),
+  };
+  if (vkCreateDevice(physicalDevice, &deviceCI, nullptr, &device) !=
+      VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create Vulkan device");
+    return false;
+  }
+  volkLoadDevice(device);
+  vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+
+  VmaVulkanFunctions vulkanFunctions{
+      .vkGetInstanceProcAddr = vkGetInstanceProcAddr,
+      .vkGetDeviceProcAddr = vkGetDeviceProcAddr,
+  };
+  VmaAllocatorCreateInfo allocatorCI{
+      .flags = hasMemoryBudget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT
+                               : 0u,
+      .physicalDevice = physicalDevice,
+      .device = device,
+      .pVulkanFunctions = &vulkanFunctions,
+      .instance = instance,
+      .vulkanApiVersion = VK_API_VERSION_1_3,
+  };
+  if (vmaCreateAllocator(&allocatorCI, &memoryAllocator) != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create Vulkan memory allocator");
+    return false;
+  }
+  if (!CreateStagingPool()) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "Failed to create staging memory pool, transfer buffers use "
+                "the default pools");
+  }
+  if (supportsBindless && !CreateBindlessSetLayout()) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "Failed to create bindless descriptor set layout, bindless "
+                "tables are disabled");
+  }
+  LoadPipelineCache();
+  return true;
+}
+
+bool Device::CreateStagingPool() {
+  // Upload buffers are mostly short lived and dropped in creation order,
+  // which the linear algorithm serves without searching for free space
+  VkBufferCreateInfo bufferCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = 0x10000,
+      .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+  };
+  VmaAllocationCreateInfo allocationCI{
+      .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+               VMA_ALLOCATION_CREATE_MAPPED_BIT,
+      .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+  };
+  uint32 memoryTypeIndex;
+  if (vmaFindMemoryTypeIndexForBufferInfo(memoryAllocator, &bufferCI,
+                                          &allocationCI,
+                                          &memoryTypeIndex) != VK_SUCCESS) {
+    return false;
+  }
+  VmaPoolCreateInfo poolCI{
+      .memoryTypeIndex = memoryTypeIndex,
+      .flags = VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT,
+      .blockSize = STAGING_BLOCK_SIZE,
+  };
+  return vmaCreatePool(memoryAllocator, &poolCI, &stagingPool) == VK_SUCCESS;
+}
+VmaPool Device::GetRenderTargetPool(const VkImageCreateInfo &imageCI) {
+  VmaAllocationCreateInfo allocationCI{.usage = VMA_MEMORY_USAGE_AUTO};
+  uint32 memoryTypeIndex;
+  if (vmaFindMemoryTypeIndexForImageInfo(memoryAllocator, &imageCI,
+                                         &allocationCI,
+                                         &memoryTypeIndex) != VK_SUCCESS) {
+    return VK_NULL_HANDLE;
+  }
+  std::unique_lock lock(mutex);
+  for (const auto &entry : renderTargetPools) {
+    if (entry.memoryTypeIndex == memoryTypeIndex) {
+      return entry.pool;
+    }
+  }
+  // VMA 3 dropped the buddy algorithm, the default TLSF one keeps
+  // fragmentation of mixed sizes low and defragmentation handles the rest
+  VmaPoolCreateInfo poolCI{
+      .memoryTypeIndex = memoryTypeIndex,
+      .blockSize = RENDER_TARGET_BLOCK_SIZE,
+  };
+  VmaPool pool;
+  if (vmaCreatePool(memoryAllocator, &poolCI, &pool) != VK_SUCCESS) {
+    return VK_NULL_HANDLE;
+  }
+  renderTargetPools.push_back({memoryTypeIndex, pool});
+  return pool;
+}
+bool Device::CreateBindlessSetLayout() {
+  // Partially bound, so unregistered indices may hold stale or no
+  // descriptors, and updatable while command buffers that do not read the
+  // updated indices are pending
+  constexpr VkDescriptorBindingFlags bindingFlags =
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+      VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+  const VkDescriptorBindingFlags flags[3] = {bindingFlags, bindingFlags,
+                                             bindingFlags};
+  constexpr VkShaderStageFlags stages =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  const VkDescriptorSetLayoutBinding bindings[3] = {
+      {0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_BINDLESS_TEXTURES, stages},
+      {1, VK_DESCRIPTOR_TYPE_SAMPLER, MAX_BINDLESS_SAMPLERS, stages},
+      {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_BINDLESS_BUFFERS, stages},
+  };
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI{
+      .sType =
+          VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+      .bindingCount = 3,
+      .pBindingFlags = flags,
+  };
+  VkDescriptorSetLayoutCreateInfo setLayoutCI{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = &bindingFlagsCI,
+      .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+      .bindingCount = 3,
+      .pBindings = bindings,
+  };
+  if (vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr,
+                                  &bindlessSetLayout) != VK_SUCCESS) {
+    bindlessSetLayout = VK_NULL_HANDLE;
+    return false;
+  }
+  return true;
+}
+
+Device::~Device() {
+  if (device != VK_NULL_HANDLE) {
+    vkDeviceWaitIdle(device);
+    ReleaseOffscreenTargets();
+    {
+      std::unique_lock lock(mutex);
+      Collect();
+      assert(pendingContexts.empty() && openSerials.empty());
+      // Collect has destroyed the old images of an open pass
+      if (defragmentation != VK_NULL_HANDLE) {
+        if (defragmentationSerial != 0) {
+          vmaEndDefragmentationPass(memoryAllocator, defragmentation,
+                                    &defragmentationPass);
+        }
+        vmaEndDefragmentation(memoryAllocator, defragmentation, nullptr);
+      }
+    }
+    for (auto &context : freeContexts) {
+      DestroyContext(context);
+    }
+    for (const auto &entry : garbage) {
+      DestroyGarbage(entry);
+    }
+    for (const auto &entry : renderTargetPools) {
+      vmaDestroyPool(memoryAllocator, entry.pool);
+    }
+    vmaDestroyPool(memoryAllocator, stagingPool);
+    DestroySwapchain();
+    for (auto &[key, setLayout] : setLayouts) {
+      vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    }
+    vkDestroyDescriptorSetLayout(device, bindlessSetLayout, nullptr);
+    SavePipelineCache();
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    if (memoryAllocator != VK_NULL_HANDLE) {
+      vmaDestroyAllocator(memoryAllocator);
+    }
+    vkDestroyDevice(device, nullptr);
+  }
+  if (surface != VK_NULL_HANDLE) {
+    SDL_Vulkan_DestroySurface(instance, surface, nullptr);
+  }
+  if (instance != VK_NULL_HANDLE) {
+    vkDestroyInstance(instance, nullptr);
+  }
+  if (loadedVulkanLibrary) {
+    SDL_Vulkan_UnloadLibrary();
+  }
+}
+
+void Device::LoadPipelineCache() {
+  Array<std::byte> data(std::pmr::new_delete_resource());
+  if (GetCreateInfo().cacheDirectory != nullptr) {
+    // The driver validates the blob again and ignores it if it does not match
+    px::LoadPipelineCache(GetCreateInfo().cacheDirectory,
+                          GetPipelineCacheIdentity(properties), data);
+  }
+  VkPipelineCacheCreateInfo pipelineCacheCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .initialDataSize = data.size(),
+      .pInitialData = data.data(),
+  };
+  vkCreatePipelineCache(device, &pipelineCacheCI, nullptr, &pipelineCache);
+}
+void Device::SavePipelineCache() {
+  if (GetCreateInfo().cacheDirectory == nullptr ||
+      pipelineCache == VK_NULL_HANDLE) {
+    return;
+  }
+  size_t size = 0;
+  vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+  Array<std::byte> data(size, std::pmr::new_delete_resource());
+  if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) ==
+      VK_SUCCESS) {
+    px::SavePipelineCache(GetCreateInfo().cacheDirectory,
+                          GetPipelineCacheIdentity(properties), data.data(),
+                          size);
+  }
+}
+
+void Device::ClaimWindow(void *window) {
+  if (!hasSurfaceSupport) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to claim window: the device was created headless");
+    return;
+  }
+  auto *sdlWindow = static_cast<SDL_Window *>(window);
+  if (!SDL_Vulkan_CreateSurface(sdlWindow, instance, nullptr, &surface)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create Vulkan surface: %s", SDL_GetError());
+    return;
+  }
+  VkBool32 supported = VK_FALSE;
+  vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, queueFamilyIndex,
+                                       surface, &supported);
+  if (!supported) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "The graphics queue cannot present to the window");
+    SDL_Vulkan_DestroySurface(instance, surface, nullptr);
+    surface = VK_NULL_HANDLE;
+    return;
+  }
+  uint32 count = 0;
+  vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &count,
+                                       nullptr);
+  Array<VkSurfaceFormatKHR> formats(count, std::pmr::new_delete_resource());
+  vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &count,
+                                       formats.data());
+  surfaceFormat = formats.empty() ? VkSurfaceFormatKHR{} : formats[0];
+  for (auto format : {VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM}) {
+    auto it = std::find_if(formats.begin(), formats.end(), [&](auto &f) {
+      return f.format == format &&
+             f.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    });
+    if (it != formats.end()) {
+      surfaceFormat = *it;
+      break;
+    }
+  }
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &count,
+                                            nullptr);
+  Array<VkPresentModeKHR> presentModes(count, std::pmr::new_delete_resource());
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &count,
+                                            presentModes.data());
+  presentMode = convert::PresentModeFrom(GetCreateInfo().presentMode);
+  if (std::find(presentModes.begin(), presentModes.end(), presentMode) ==
+      presentModes.end()) {
+    // The only mode every surface supports
+    presentMode = VK_PRESENT_MODE_FIFO_KHR;
+  }
+  frameSerials.assign(GetFramesInFlight(), 0);
+  frameSerialIndex = 0;
+  this->window = sdlWindow;
+  std::unique_lock lock(mutex);
+  RecreateSwapchain();
+}
+bool Device::ClaimOffscreen(uint32 width, uint32 height) {
+  if (window != nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to claim offscreen targets: a window has been "
+                 "claimed");
+    return false;
+  }
+  ReleaseOffscreenTargets();
+  offscreenInfo = {
+      .allocator = GetCreateInfo().allocator,
+      .type = TextureType::Texture2D,
+      .format = TextureFormat::R8G8B8A8_UNORM,
+      .usage = TextureUsage::ColorTarget,
+      .width = width,
+      .height = height,
+      .layerCountOrDepth = 1,
+      .numLevels = 1,
+      .sampleCount = SampleCount::x1,
+  };
+  auto imageCI = GetImageCreateInfo(offscreenInfo);
+  VmaAllocationCreateInfo allocationCI{.usage = VMA_MEMORY_USAGE_AUTO};
+  for (uint32 i = 0; i < GetFramesInFlight(); ++i) {
+    OffscreenTarget target;
+    if (vmaCreateImage(memoryAllocator, &imageCI, &allocationCI,
+                       &target.image, &target.allocation,
+                       nullptr) != VK_SUCCESS) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Failed to create offscreen target");
+      ReleaseOffscreenTargets();
+      return false;
+    }
+    if (!CreateTextureViews(offscreenInfo, target.image, target.view,
+                            target.targetView)) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Failed to create offscreen target views");
+      vmaDestroyImage(memoryAllocator, target.image, target.allocation);
+      ReleaseOffscreenTargets();
+      return false;
+    }
+    {
+      std::unique_lock lock(mutex);
+      initialLayouts.push_back({target.image, VK_IMAGE_ASPECT_COLOR_BIT,
+                                Texture::GetRestLayout(offscreenInfo.usage)});
+    }
+    offscreenTargets.push_back(target);
+  }
+  return true;
+}
+void Device::ReleaseOffscreenTargets() {
+  for (const auto &target : offscreenTargets) {
+    Release({.image = target.image,
+             .imageView = target.view,
+             .targetView = target.targetView,
+             .allocation = target.allocation});
+  }
+  offscreenTargets.clear();
+  offscreenIndex = 0;
+}
+bool Device::RecreateSwapchain() {
+  int width = 0, height = 0;
+  SDL_GetWindowSizeInPixels(window, &width, &height);
+  VkSurfaceCapabilitiesKHR capabilities;
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface,
+                                            &capabilities);
+  VkExtent2D extent = capabilities.currentExtent;
+  if (extent.width == UINT32_MAX) {
+    extent.width = std::clamp(static_cast<uint32>(width),
+                              capabilities.minImageExtent.width,
+                              capabilities.maxImageExtent.width);
+    extent.height = std::clamp(static_cast<uint32>(height),
+                               capabilities.minImageExtent.height,
+                               capabilities.maxImageExtent.height);
+  }
+  if (extent.width == 0 || extent.height == 0) {
+    // Minimized. Retried on the next acquire.
+    swapchainOutOfDate = true;
+    return false;
+  }
+  // The old images may still be in use by pending command buffers
+  vkDeviceWaitIdle(device);
+  Collect();
+
+  // One image on screen and one per frame in flight. Mailbox wants another
+  // one to replace while the queued one waits.
+  uint32 imageCount =
+      std::max(capabilities.minImageCount + 1, GetFramesInFlight() + 1);
+  if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+    imageCount = std::max(imageCount, 3u);
+  }
+  if (capabilities.maxImageCount > 0) {
+    imageCount = std::min(imageCount, capabilities.maxImageCount);
+  }
+  VkSwapchainKHR oldSwapchain = swapchain;
+  VkSwapchainCreateInfoKHR swapchainCI{
+      .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+      .surface = surface,
+      .minImageCount = imageCount,
+      .imageFormat = surfaceFormat.format,
+      .imageColorSpace = surfaceFormat.colorSpace,
+      .imageExtent = extent,
+      .imageArrayLayers = 1,
+      .imageUsage = capabilities.supportedUsageFlags &
+                    (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                     VK_IMAGE_USAGE_TRANSFER_DST_BIT),
+      .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .preTransform = capabilities.currentTransform,
+      .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+      .presentMode = presentMode,
+      .clipped = VK_TRUE,
+      .oldSwapchain = oldSwapchain,
+  };
+  VkSwapchainKHR newSwapchain = VK_NULL_HANDLE;
+  auto result =
+      vkCreateSwapchainKHR(device, &swapchainCI, nullptr, &newSwapchain);
+  DestroySwapchain();
+  if (result != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create swapchain: %d", result);
+    return false;
+  }
+  swapchain = newSwapchain;
+  swapchainExtent = extent;
+  swapchainOutOfDate = false;
+
+  vkGetSwapchainImagesKHR(device, swapchain, &imageCount, nullptr);
+  swapchainImages.resize(imageCount);
+  vkGetSwapchainImagesKHR(device, swapchain, &imageCount,
+                          swapchainImages.data());
+  swapchainViews.resize(imageCount);
+  presentSemaphores.resize(imageCount);
+  for (uint32 i = 0; i < imageCount; ++i) {
+    VkImageViewCreateInfo viewCI{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = swapchainImages[i],
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = surfaceFormat.format,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCreateImageView(device, &viewCI, nullptr, &swapchainViews[i]);
+    VkSemaphoreCreateInfo semaphoreCI{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    vkCreateSemaphore(device, &semaphoreCI, nullptr, &presentSemaphores[i]);
+  }
+  return true;
+}
+void Device::DestroySwapchain() {
+  for (auto view : swapchainViews) {
+    vkDestroyImageView(device, view, nullptr);
+  }
+  for (auto semaphore : presentSemaphores) {
+    vkDestroySemaphore(device, semaphore, nullptr);
+  }
+  swapchainViews.clear();
+  presentSemaphores.clear();
+  swapchainImages.clear();
+  if (swapchain != VK_NULL_HANDLE) {
+    vkDestroySwapchainKHR(device, swapchain, nullptr);
+    swapchain = VK_NULL_HANDLE;
+  }
+}
+
+Ptr<px::Buffer> Device::CreateBuffer(const Buffer::CreateInfo &createInfo) {
+  VkBufferCreateInfo bufferCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = createInfo.size,
+      .usage = convert::BufferUsageFrom(createInfo.usage),
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+  };
+  VmaAllocationCreateInfo allocationCI{.usage = VMA_MEMORY_USAGE_AUTO};
+  VkBuffer buffer;
+  VmaAllocation allocation;
+  if (vmaCreateBuffer(memoryAllocator, &bufferCI, &allocationCI, &buffer,
+                      &allocation, nullptr) != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to create buffer");
+    return nullptr;
+  }
+  return MakePtr<Buffer>(createInfo.allocator, createInfo,
+                         DownCast<Device>(GetPtr()), buffer, allocation);
+}
+
+Ptr<px::Texture> Device::CreateTexture(const Texture::CreateInfo &createInfo) {
+  auto imageCI = GetImageCreateInfo(createInfo);
+  VmaAllocationCreateInfo allocationCI{.usage = VMA_MEMORY_USAGE_AUTO};
+  if (createInfo.usage != TextureUsage::Sampler) {
+    allocationCI.pool = GetRenderTargetPool(imageCI);
+  }
+  VkImage image;
+  VmaAllocation allocation;
+  auto result = vmaCreateImage(memoryAllocator, &imageCI, &allocationCI,
+                               &image, &allocation, nullptr);
+  if (result != VK_SUCCESS && allocationCI.pool != VK_NULL_HANDLE) {
+    // Larger than a block of the pool
+    allocationCI.pool = VK_NULL_HANDLE;
+    result = vmaCreateImage(memoryAllocator, &imageCI, &allocationCI, &image,
+                            &allocation, nullptr);
+  }
+  if (result != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to create texture");
+    return nullptr;
+  }
+  VkImageView view, targetView;
+  if (!CreateTextureViews(createInfo, image, view, targetView)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create texture views");
+    vmaDestroyImage(memoryAllocator, image, allocation);
+    return nullptr;
+  }
+  auto aspect = convert::AspectFrom(createInfo.format);
+  {
+    // Moved to the rest layout at the start of the next submit, so every
+    // command buffer finds the texture in it
+    std::unique_lock lock(mutex);
+    initialLayouts.push_back(
+        {image, aspect, Texture::GetRestLayout(createInfo.usage)});
+  }
+  auto texture = MakePtr<Texture>(createInfo.allocator, createInfo,
+                                  DownCast<Device>(GetPtr()), image,
+                                  allocation, view, targetView);
+  if (allocationCI.pool != VK_NULL_HANDLE) {
+    // Lets defragmentation find the texture behind an allocation
+    std::unique_lock lock(mutex);
+    vmaSetAllocationUserData(memoryAllocator, allocation, texture.get());
+  }
+  return texture;
+}
+bool Device::CreateTextureViews(const px::Texture::CreateInfo &createInfo,
+                                VkImage image, VkImageView &view,
+                                VkImageView &targetView) {
+  auto numLevels = std::max(createInfo.numLevels, 1u);
+  auto numLayers = GetLayerCount(createInfo);
+  auto aspect = convert::AspectFrom(createInfo.format);
+  VkImageViewCreateInfo viewCI{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .image = image,
+      .viewType = convert::ImageViewTypeFrom(createInfo.type),
+      .format = convert::TextureFormatFrom(createInfo.format),
+      // Depth stencil textures are sampled by depth
+      .subresourceRange = {aspect & ~VK_IMAGE_ASPECT_STENCIL_BIT, 0,
+                           numLevels, 0, numLayers},
+  };
+  if (vkCreateImageView(device, &viewCI, nullptr, &view) != VK_SUCCESS) {
+    return false;
+  }
+  targetView = view;
+  if (createInfo.usage != TextureUsage::Sampler &&
+      (numLevels > 1 || numLayers > 1 ||
+       createInfo.type != TextureType::Texture2D ||
+       aspect & VK_IMAGE_ASPECT_STENCIL_BIT)) {
+    viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewCI.subresourceRange = {aspect, 0, 1, 0, 1};
+    if (vkCreateImageView(device, &viewCI, nullptr, &targetView) !=
+        VK_SUCCESS) {
+      vkDestroyImageView(device, view, nullptr);
+      return false;
+    }
+  }
+  return true;
+}
+
+Ptr<px::Sampler> Device::CreateSampler(const Sampler::CreateInfo &createInfo) {
+  bool enableAnisotropy =
+      createInfo.enableAnisotropy && features.samplerAnisotropy;
+  VkSamplerCreateInfo samplerCI{
+      .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .magFilter = convert::FilterFrom(createInfo.magFilter),
+      .minFilter = convert::FilterFrom(createInfo.minFilter),
+      .mipmapMode = convert::MipmapModeFrom(createInfo.mipmapMode),
+      .addressModeU = convert::AddressModeFrom(createInfo.addressModeU),
+      .addressModeV = convert::AddressModeFrom(createInfo.addressModeV),
+      .addressModeW = convert::AddressModeFrom(createInfo.addressModeW),
+      .mipLodBias = createInfo.mipLodBias,
+      .anisotropyEnable = enableAnisotropy,
+      .maxAnisotropy =
+          enableAnisotropy
+              ? std::min(createInfo.maxAnisotropy,
+                         properties.limits.maxSamplerAnisotropy)
+              : 1.0f,
+      .compareEnable = createInfo.enableCompare,
+      .compareOp = convert::CompareOpFrom(createInfo.compareOp),
+      .minLod = createInfo.minLod,
+      .maxLod = createInfo.maxLod,
+      .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+  };
+  VkSampler sampler;
+  if (vkCreateSampler(device, &samplerCI, nullptr, &sampler) != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to create sampler");
+    return nullptr;
+  }
+  return MakePtr<Sampler>(createInfo.allocator, createInfo,
+                          DownCast<Device>(GetPtr()), sampler);
+}
+
+Ptr<px::TransferBuffer>
+Device::CreateTransferBuffer(const TransferBuffer::CreateInfo &createInfo) {
+  auto transferBuffer = MakePtr<TransferBuffer>(
+      createInfo.allocator, createInfo, DownCast<Device>(GetPtr()));
+  if (!transferBuffer->CreateBacking()) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create transfer buffer");
+    return nullptr;
+  }
+  return transferBuffer;
+}
+
+Ptr<px::Shader> Device::CreateShader(const Shader::CreateInfo &createInfo) {
+  // The set layouts are derived from the reflected counts, so a shader that
+  // can't be reflected can't be bound
+  const char *entrypoint =
+      createInfo.entrypoint != nullptr ? createInfo.entrypoint : "main";
+  ShaderReflection reflection(createInfo.allocator);
+  if (!ReflectSPIRV(createInfo.data, createInfo.size, entrypoint, reflection)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to reflect shader: invalid SPIR-V or no entry point "
+                 "%s",
+                 entrypoint);
+    return nullptr;
+  }
+  // Constants are passed to the pipeline natively, so the module is used as
+  // it is
+  VkShaderModuleCreateInfo shaderModuleCI{
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = createInfo.size,
+      .pCode = static_cast<const uint32 *>(createInfo.data),
+  };
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &shaderModuleCI, nullptr, &shaderModule) !=
+      VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create shader module");
+    return nullptr;
+  }
+  auto shader = MakePtr<Shader>(createInfo.allocator, createInfo,
+                                DownCast<Device>(GetPtr()), shaderModule);
+  shader->numSamplers = reflection.numSamplers;
+  shader->numStorageTextures = reflection.numStorageTextures;
+  shader->numStorageBuffers = reflection.numStorageBuffers;
+  shader->numUniformBuffers = reflection.numUniformBuffers;
+  shader->usesBindlessTable = reflection.usesBindlessTable;
+  return shader;
+}
+
+VkDescriptorSetLayout Device::GetSetLayout(VkShaderStageFlagBits stage,
+                                           VkDescriptorType type,
+                                           uint32 count) {
+  uint32 key = count | static_cast<uint32>(type) << 8 |
+               static_cast<uint32>(stage) << 16;
+  std::unique_lock lock(setLayoutMutex);
+  if (auto it = setLayouts.find(key); it != setLayouts.end()) {
+    return it->second;
+  }
+  VkDescriptorSetLayoutBinding bindings[MAX_SAMPLERS];
+  for (uint32 i = 0; i < count; ++i) {
+    bindings[i] = {
+        .binding = i,
+        .descriptorType = type,
+        .descriptorCount = 1,
+        .stageFlags = static_cast<VkShaderStageFlags>(stage),
+    };
+  }
+  VkDescriptorSetLayoutCreateInfo setLayoutCI{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = count,
+      .pBindings = bindings,
+  };
+  VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+  vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr, &setLayout);
+  setLayouts.emplace(key, setLayout);
+  return setLayout;
+}
+
+Ptr<px::GraphicsPipeline>
+Device::CreateGraphicsPipeline(const GraphicsPipeline::CreateInfo &createInfo) {
+  auto vertexShader = DownCast<Shader>(createInfo.vertexShader);
+  auto fragmentShader = DownCast<Shader>(createInfo.fragmentShader);
+  // px::RenderPass binds fragment samplers and uniforms only
+  if (vertexShader->numSamplers > 0 || vertexShader->numStorageTextures > 0 ||
+      vertexShader->numStorageBuffers > 0 ||
+      fragmentShader->numStorageTextures > 0 ||
+      fragmentShader->numStorageBuffers > 0 ||
+      fragmentShader->numSamplers > MAX_SAMPLERS ||
+      vertexShader->numUniformBuffers > MAX_UNIFORM_BUFFERS ||
+      fragmentShader->numUniformBuffers > MAX_UNIFORM_BUFFERS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create graphics pipeline: the shaders use "
+                 "resources a render pass cannot bind");
+    return nullptr;
+  }
+  bool usesBindlessTable =
+      vertexShader->usesBindlessTable || fragmentShader->usesBindlessTable;
+  if (usesBindlessTable && bindlessSetLayout == VK_NULL_HANDLE) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create graphics pipeline: the shaders use a "
+                 "bindless table, which the device does not support");
+    return nullptr;
+  }
+
+  // Specialization constants are handed to the driver as they are, instead
+  // of being patched into a copy of the module
+  Array<VkSpecializationMapEntry> mapEntries[2] = {
+      Array<VkSpecializationMapEntry>(std::pmr::new_delete_resource()),
+      Array<VkSpecializationMapEntry>(std::pmr::new_delete_resource())};
+  Array<uint32> specializationData[2] = {
+      Array<uint32>(std::pmr::new_delete_resource()),
+      Array<uint32>(std::pmr::new_delete_resource())};
+  VkSpecializationInfo specializationInfos[2];
+  VkPipelineShaderStageCreateInfo stages[2];
+  for (uint32 i = 0; i < 2; ++i) {
+    const auto &shader = i == 0 ? *vertexShader : *fragmentShader;
+    const auto &constants = shader.GetSpecializationConstants();
+    auto numConstants = static_cast<uint32>(constants.size());
+    mapEntries[i].reserve(numConstants);
+    specializationData[i].reserve(numConstants);
+    for (uint32 j = 0; j < numConstants; ++j) {
+      mapEntries[i].push_back({constants[j].constantID, j * 4, 4});
+      specializationData[i].push_back(constants[j].value);
+    }
+    specializationInfos[i] = {
+        .mapEntryCount = numConstants,
+        .pMapEntries = mapEntries[i].data(),
+        .dataSize = numConstants * 4,
+        .pData = specializationData[i].data(),
+    };
+    stages[i] = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = i == 0 ? VK_SHADER_STAGE_VERTEX_BIT
+                        : VK_SHADER_STAGE_FRAGMENT_BIT,
+        .module = shader.GetNative(),
+        .pName = shader.GetEntrypoint(),
+        .pSpecializationInfo =
+            numConstants > 0 ? &specializationInfos[i] : nullptr,
+    };
+  }
+
+  const auto &vertexInputState = createInfo.vertexInputState;
+  VkVertexInputBindingDescription bindings[MAX_VERTEX_BUFFERS];
+  bool hasStepRate = false;
+  for (uint32 i = 0; i < vertexInputState.vertexBufferDescriptions.size();
+       ++i) {
+    const auto &desc = vertexInputState.vertexBufferDescriptions[i];
+    bindings[i] = {
+        .binding = desc.slot,
+        .stride = desc.pitch,
+        .inputRate = convert::VertexInputRateFrom(desc.inputRate),
+    };
+    hasStepRate |= desc.inputRate == VertexInputRate::Instance &&
+                   desc.instanceStepRate > 1;
+  }
+  if (hasStepRate) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "Instance step rates are not supported, using 1");
+  }
+  VkVertexInputAttributeDescription attributes[MAX_VERTEX_ATTRIBUTES];
+  for (uint32 i = 0; i < vertexInputState.vertexAttributes.size(); ++i) {
+    const auto &attribute = vertexInputState.vertexAttributes[i];
+    attributes[i] = {
+        .location = attribute.location,
+        .binding = attribute.bufferSlot,
+        .format = convert::VertexElementFormatFrom(attribute.format),
+        .offset = attribute.offset,
+    };
+  }
+  VkPipelineVertexInputStateCreateInfo vertexInputCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+      .vertexBindingDescriptionCount =
+          vertexInputState.vertexBufferDescriptions.size(),
+      .pVertexBindingDescriptions = bindings,
+      .vertexAttributeDescriptionCount =
+          vertexInputState.vertexAttributes.size(),
+      .pVertexAttributeDescriptions = attributes,
+  };
+  VkPipelineInputAssemblyStateCreateInfo inputAssemblyCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = convert::PrimitiveTypeFrom(createInfo.primitiveType),
+  };
+  VkPipelineViewportStateCreateInfo viewportCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .scissorCount = 1,
+  };
+  const auto &rasterizerState = createInfo.rasterizerState;
+  VkPipelineRasterizationStateCreateInfo rasterizationCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .depthClampEnable =
+          !rasterizerState.enableDepthClip && features.depthClamp,
+      .polygonMode = convert::FillModeFrom(rasterizerState.fillMode),
+      .cullMode = convert::CullModeFrom(rasterizerState.cullMode),
+      .frontFace = convert::FrontFaceFrom(rasterizerState.frontFace),
+      .depthBiasEnable = rasterizerState.enableDepthBias,
+      .depthBiasConstantFactor = rasterizerState.depthBiasConstantFactor,
+      .depthBiasClamp = rasterizerState.depthBiasClamp,
+      .depthBiasSlopeFactor = rasterizerState.depthBiasSlopeFactor,
+      .lineWidth = 1.0f,
+  };
+  const auto &multiSampleState = createInfo.multiSampleState;
+  VkSampleMask sampleMask = multiSampleState.sampleMask;
+  VkPipelineMultisampleStateCreateInfo multisampleCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .rasterizationSamples =
+          convert::SampleCountFrom(multiSampleState.sampleCount),
+      .pSampleMask = multiSampleState.enableMask ? &sampleMask : nullptr,
+  };
+  const auto &depthStencilState = createInfo.depthStencilState;
+  auto stencilOpState = [&](const StencilOpState &state) {
+    return VkStencilOpState{
+        .failOp = convert::StencilOpFrom(state.failOp),
+        .passOp = convert::StencilOpFrom(state.passOp),
+        .depthFailOp = convert::StencilOpFrom(state.depthFailOp),
+        .compareOp = convert::CompareOpFrom(state.compareOp),
+        .compareMask = depthStencilState.compareMask,
+        .writeMask = depthStencilState.writeMask,
+    };
+  };
+  VkPipelineDepthStencilStateCreateInfo depthStencilCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+      .depthTestEnable = depthStencilState.enableDepthTest,
+      .depthWriteEnable = depthStencilState.enableDepthWrite,
+      .depthCompareOp = convert::CompareOpFrom(depthStencilState.compareOp),
+      .stencilTestEnable = depthStencilState.enableStencilTest,
+      .front = stencilOpState(depthStencilState.frontStencilState),
+      .back = stencilOpState(depthStencilState.backStencilState),
+  };
+  const auto &targetInfo = createInfo.targetInfo;
+  VkPipelineColorBlendAttachmentState blendAttachments[MAX_COLOR_TARGETS];
+  VkFormat colorFormats[MAX_COLOR_TARGETS];
+  for (uint32 i = 0; i < targetInfo.colorTargetDescriptions.size(); ++i) {
+    const auto &desc = targetInfo.colorTargetDescriptions[i];
+    const auto &blend = desc.blendState;
+    colorFormats[i] = convert::TextureFormatFrom(desc.format);
+    blendAttachments[i] = {
+        .blendEnable = blend.enableBlend,
+        .srcColorBlendFactor =
+            convert::BlendFactorFrom(blend.srcColorBlendFactor),
+        .dstColorBlendFactor =
+            convert::BlendFactorFrom(blend.dstColorBlendFactor),
+        .colorBlendOp = convert::BlendOpFrom(blend.colorBlendOp),
+        .srcAlphaBlendFactor =
+            convert::BlendFactorFrom(blend.srcAlphaBlendFactor),
+        .dstAlphaBlendFactor =
+            convert::BlendFactorFrom(blend.dstAlphaBlendFactor),
+        .alphaBlendOp = convert::BlendOpFrom(blend.alphaBlendOp),
+        .colorWriteMask = blend.enableColorWriteMask
+                              ? blend.colorWriteMask
+                              : static_cast<VkColorComponentFlags>(0xF),
+    };
+  }
+  VkPipelineColorBlendStateCreateInfo colorBlendCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .attachmentCount = targetInfo.colorTargetDescriptions.size(),
+      .pAttachments = blendAttachments,
+  };
+  constexpr VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                              VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = static_cast<uint32>(std::size(dynamicStates)),
+      .pDynamicStates = dynamicStates,
+  };
+  auto depthStencilFormat =
+      targetInfo.hasDepthStencilTarget
+          ? convert::TextureFormatFrom(targetInfo.depthStencilTargetFormat)
+          : VK_FORMAT_UNDEFINED;
+  VkPipelineRenderingCreateInfo renderingCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+      .colorAttachmentCount = targetInfo.colorTargetDescriptions.size(),
+      .pColorAttachmentFormats = colorFormats,
+      .depthAttachmentFormat = depthStencilFormat,
+      .stencilAttachmentFormat =
+          targetInfo.hasDepthStencilTarget &&
+                  convert::AspectFrom(targetInfo.depthStencilTargetFormat) &
+                      VK_IMAGE_ASPECT_STENCIL_BIT
+              ? depthStencilFormat
+              : VK_FORMAT_UNDEFINED,
+  };
+
+  VkDescriptorSetLayout setLayouts[5] = {
+      GetSetLayout(VK_SHADER_STAGE_VERTEX_BIT,
+                   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0),
+      GetSetLayout(VK_SHADER_STAGE_VERTEX_BIT,
+                   VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                   vertexShader->numUniformBuffers),
+      GetSetLayout(VK_SHADER_STAGE_FRAGMENT_BIT,
+                   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                   fragmentShader->numSamplers),
+      GetSetLayout(VK_SHADER_STAGE_FRAGMENT_BIT,
+                   VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                   fragmentShader->numUniformBuffers),
+      bindlessSetLayout,
+  };
+  VkPipelineLayoutCreateInfo layoutCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = usesBindlessTable ? BINDLESS_DESCRIPTOR_SET + 1
+                                          : BINDLESS_DESCRIPTOR_SET,
+      .pSetLayouts = setLayouts,
+  };
+  VkPipelineLayout layout;
+  if (vkCreatePipelineLayout(device, &layoutCI, nullptr, &layout) !=
+      VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create pipeline layout");
+    return nullptr;
+  }
+
+  VkGraphicsPipelineCreateInfo pipelineCI{
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .pNext = &renderingCI,
+      .stageCount = 2,
+      .pStages = stages,
+      .pVertexInputState = &vertexInputCI,
+      .pInputAssemblyState = &inputAssemblyCI,
+      .pViewportState = &viewportCI,
+      .pRasterizationState = &rasterizationCI,
+      .pMultisampleState = &multisampleCI,
+      .pDepthStencilState = &depthStencilCI,
+      .pColorBlendState = &colorBlendCI,
+      .pDynamicState = &dynamicCI,
+      .layout = layout,
+  };
+  VkPipeline pipeline;
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI,
+                                nullptr, &pipeline) != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create graphics pipeline");
+    vkDestroyPipelineLayout(device, layout, nullptr);
+    return nullptr;
+  }
+  auto graphicsPipeline =
+      MakePtr<GraphicsPipeline>(createInfo.allocator, createInfo,
+                                DownCast<Device>(GetPtr()), pipeline, layout);
+  std::copy(setLayouts, setLayouts + 4, graphicsPipeline->setLayouts);
+  graphicsPipeline->numVertexUniformBuffers = vertexShader->numUniformBuffers;
+  graphicsPipeline->numFragmentSamplers = fragmentShader->numSamplers;
+  graphicsPipeline->numFragmentUniformBuffers =
+      fragmentShader->numUniformBuffers;
+  graphicsPipeline->usesBindlessTable = usesBindlessTable;
+  return graphicsPipeline;
+}
+Ptr<px::ComputePipeline>
+Device::CreateComputePipeline(const ComputePipeline::CreateInfo &createInfo) {
+  return MakePtr<ComputePipeline>(createInfo.allocator, createInfo,
+                                  DownCast<Device>(GetPtr()));
+}
+
+Ptr<px::BindlessTable>
+Device::CreateBindlessTable(const BindlessTable::CreateInfo &createInfo) {
+  if (bindlessSetLayout == VK_NULL_HANDLE) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Bindless tables are not supported by the device");
+    return nullptr;
+  }
+  VkDescriptorPoolSize poolSizes[] = {
+      {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_BINDLESS_TEXTURES},
+      {VK_DESCRIPTOR_TYPE_SAMPLER, MAX_BINDLESS_SAMPLERS},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_BINDLESS_BUFFERS},
+  };
+  VkDescriptorPoolCreateInfo poolCI{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+      .maxSets = 1,
+      .poolSizeCount = static_cast<uint32>(std::size(poolSizes)),
+      .pPoolSizes = poolSizes,
+  };
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(device, &poolCI, nullptr, &pool) != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to create bindless descriptor pool");
+    return nullptr;
+  }
+  VkDescriptorSetAllocateInfo allocateInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = pool,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &bindlessSetLayout,
+  };
+  VkDescriptorSet set;
+  if (vkAllocateDescriptorSets(device, &allocateInfo, &set) != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to allocate bindless descriptor set");
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    return nullptr;
+  }
+  return MakePtr<BindlessTable>(createInfo.allocator, createInfo,
+                                DownCast<Device>(GetPtr()), pool, set);
+}
+
+bool Device::CreateContext(CommandContext &context) {
+  VkCommandPoolCreateInfo commandPoolCI{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      .queueFamilyIndex = queueFamilyIndex,
+  };
+  if (vkCreateCommandPool(device, &commandPoolCI, nullptr,
+                          &context.commandPool) != VK_SUCCESS) {
+    return false;
+  }
+  VkCommandBufferAllocateInfo allocateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = context.commandPool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  VkFenceCreateInfo fenceCI{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VkSemaphoreCreateInfo semaphoreCI{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  return vkAllocateCommandBuffers(device, &allocateInfo,
+                                  &context.commandBuffer) == VK_SUCCESS &&
+         vkCreateFence(device, &fenceCI, nullptr, &context.fence) ==
+             VK_SUCCESS &&
+         vkCreateSemaphore(device, &semaphoreCI, nullptr,
+                           &context.acquireSemaphore) == VK_SUCCESS;
+}
+void Device::ResetContext(CommandContext &context) {
+  vkResetCommandPool(device, context.commandPool, 0);
+  vkResetFences(device, 1, &context.fence);
+  for (auto pool : context.descriptorPools) {
+    vkResetDescriptorPool(device, pool, 0);
+  }
+  context.descriptorPoolIndex = 0;
+  context.uniformBlockIndex = 0;
+  context.uniformOffset = 0;
+  context.swapchainImageIndex = UINT32_MAX;
+}
+void Device::DestroyContext(CommandContext &context) {
+  for (auto pool : context.descriptorPools) {
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  }
+  for (auto &block : context.uniformBlocks) {
+    vmaDestroyBuffer(memoryAllocator, block.buffer, block.allocation);
+  }
+  vkDestroySemaphore(device, context.acquireSemaphore, nullptr);
+  vkDestroyFence(device, context.fence, nullptr);
+  vkDestroyCommandPool(device, context.commandPool, nullptr);
+}
+bool Device::CreateUniformBlock(CommandContext::UniformBlock &block) {
+  VkBufferCreateInfo bufferCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = UNIFORM_BLOCK_SIZE,
+      .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+  };
+  VmaAllocationCreateInfo allocationCI{
+      .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+               VMA_ALLOCATION_CREATE_MAPPED_BIT,
+      .usage = VMA_MEMORY_USAGE_AUTO,
+  };
+  VmaAllocationInfo allocationInfo;
+  if (vmaCreateBuffer(memoryAllocator, &bufferCI, &allocationCI,
+                      &block.buffer, &block.allocation,
+                      &allocationInfo) != VK_SUCCESS) {
+    return false;
+  }
+  block.mapped = static_cast<std::byte *>(allocationInfo.pMappedData);
+  return true;
+}
+VkDescriptorPool Device::CreateDescriptorPool() {
+  VkDescriptorPoolSize poolSizes[] = {
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DESCRIPTOR_POOL_SETS * 4},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, DESCRIPTOR_POOL_SETS * 2},
+  };
+  VkDescriptorPoolCreateInfo poolCI{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .maxSets = DESCRIPTOR_POOL_SETS,
+      .poolSizeCount = static_cast<uint32>(std::size(poolSizes)),
+      .pPoolSizes = poolSizes,
+  };
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+  vkCreateDescriptorPool(device, &poolCI, nullptr, &pool);
+  return pool;
+}
+
+std::uint64_t Device::GetOldestPendingSerial() const {
+  auto oldest = nextSerial;
+  for (auto serial : openSerials) {
+    oldest = std::min(oldest, serial);
+  }
+  for (const auto &context : pendingContexts) {
+    oldest = std::min(oldest, context.serial);
+  }
+  return oldest;
+}
+void Device::Collect() {
+  for (size_t i = 0; i < pendingContexts.size();) {
+    auto &context = pendingContexts[i];
+    bool pinned = std::find(pinnedSerials.begin(), pinnedSerials.end(),
+                            context.serial) != pinnedSerials.end();
+    if (!pinned && vkGetFenceStatus(device, context.fence) == VK_SUCCESS) {
+      ResetContext(context);
+      freeContexts.push_back(std::move(context));
+      pendingContexts.erase(pendingContexts.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+  auto oldest = GetOldestPendingSerial();
+  auto end = std::partition(
+      garbage.begin(), garbage.end(),
+      [&](const Garbage &entry) { return entry.serial > oldest; });
+  for (auto it = end; it != garbage.end(); ++it) {
+    DestroyGarbage(*it);
+  }
+  garbage.erase(end, garbage.end());
+}
+void Device::Release(Garbage entry) {
+  std::unique_lock lock(mutex);
+  ReleaseLocked(entry);
+}
+void Device::ReleaseTexture(const Texture &texture) {
+  std::unique_lock lock(mutex);
+  // ReleaseLocked clears the user data of render targets, so no later pass
+  // sees the texture
+  ReleaseLocked({.image = texture.GetNative(),
+                 .imageView = texture.GetView(),
+                 .targetView = texture.GetTargetView(),
+                 .allocation = texture.GetAllocation()});
+}
+void Device::ReleaseLocked(Garbage entry) {
+  // Every command buffer acquired so far may reference the handles
+  entry.serial = nextSerial;
+  if (entry.image != VK_NULL_HANDLE) {
+    std::erase_if(initialLayouts, [&](const InitialLayout &layout) {
+      return layout.image == entry.image;
+    });
+  }
+  if (entry.image != VK_NULL_HANDLE && entry.allocation != VK_NULL_HANDLE) {
+    VmaAllocationInfo allocationInfo;
+    vmaGetAllocationInfo(memoryAllocator, entry.allocation, &allocationInfo);
+    if (allocationInfo.pUserData != nullptr) {
+      // A render target, whose memory block may now be partly empty
+      vmaSetAllocationUserData(memoryAllocator, entry.allocation, nullptr);
+      defragmentationRequested = true;
+    }
+    for (uint32 i = 0; defragmentationSerial != 0 &&
+                       i < defragmentationPass.moveCount;
+         ++i) {
+      auto &move = defragmentationPass.pMoves[i];
+      if (move.srcAllocation == entry.allocation) {
+        // Moved by the open pass, which frees the allocation when it ends.
+        // It must not end before the image is gone.
+        move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+        entry.allocation = VK_NULL_HANDLE;
+        defragmentationSerial = std::max(defragmentationSerial, entry.serial);
+      }
+    }
+  }
+  if (entry.serial <= GetOldestPendingSerial()) {
+    DestroyGarbage(entry);
+    return;
+  }
+  garbage.push_back(entry);
+}
+void Device::DestroyGarbage(const Garbage &entry) {
+  vkDestroyDescriptorPool(device, entry.descriptorPool, nullptr);
+  vkDestroyPipeline(device, entry.pipeline, nullptr);
+  vkDestroyPipelineLayout(device, entry.pipelineLayout, nullptr);
+  vkDestroyShaderModule(device, entry.shaderModule, nullptr);
+  vkDestroySampler(device, entry.sampler, nullptr);
+  if (entry.targetView != entry.imageView) {
+    vkDestroyImageView(device, entry.targetView, nullptr);
+  }
+  vkDestroyImageView(device, entry.imageView, nullptr);
+  if (entry.image != VK_NULL_HANDLE) {
+    vmaDestroyImage(memoryAllocator, entry.image, entry.allocation);
+  } else if (entry.buffer != VK_NULL_HANDLE) {
+    vmaDestroyBuffer(memoryAllocator, entry.buffer, entry.allocation);
+  }
+}
+bool Device::IsPending(std::uint64_t serial) {
+  std::unique_lock lock(mutex);
+  return serial >= GetOldestPendingSerial();
+}
+std::uint64_t Device::GetLatestSerial() {
+  std::unique_lock lock(mutex);
+  return nextSerial - 1;
+}
+
+Ptr<px::CommandBuffer>
+Device::AcquireCommandBuffer(const CommandBuffer::CreateInfo &createInfo) {
+  CommandContext context;
+  {
+    std::unique_lock lock(mutex);
+    Collect();
+    if (!freeContexts.empty()) {
+      context = std::move(freeContexts.back());
+      freeContexts.pop_back();
+    } else if (!CreateContext(context)) {
+      DestroyContext(context);
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Failed to create command buffer");
+      return nullptr;
+    }
+    context.serial = nextSerial++;
+    openSerials.push_back(context.serial);
+  }
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  vkBeginCommandBuffer(context.commandBuffer, &beginInfo);
+  return MakePtr<CommandBuffer>(createInfo.allocator, createInfo,
+                                DownCast<Device>(GetPtr()),
+                                std::move(context));
+}
+void Device::ReleaseContext(CommandContext &&context) {
+  std::unique_lock lock(mutex);
+  std::erase(openSerials, context.serial);
+  ResetContext(context);
+  freeContexts.push_back(std::move(context));
+}
+void Device::RecordInitialLayouts(CommandContext &context) {
+  if (context.setupCommandBuffer == VK_NULL_HANDLE) {
+    VkCommandBufferAllocateInfo allocateInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = context.commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    vkAllocateCommandBuffers(device, &allocateInfo,
+                             &context.setupCommandBuffer);
+  }
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  vkBeginCommandBuffer(context.setupCommandBuffer, &beginInfo);
+  Array<VkImageMemoryBarrier2> barriers(std::pmr::new_delete_resource());
+  barriers.reserve(initialLayouts.size());
+  for (const auto &initial : initialLayouts) {
+    barriers.push_back({
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .dstAccessMask =
+            VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = initial.layout,
+        .image = initial.image,
+        .subresourceRange = {initial.aspect, 0, VK_REMAINING_MIP_LEVELS, 0,
+                             VK_REMAINING_ARRAY_LAYERS},
+    });
+  }
+  VkDependencyInfo dependencyInfo{
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .imageMemoryBarrierCount = static_cast<uint32>(barriers.size()),
+      .pImageMemoryBarriers = barriers.data(),
+  };
+  vkCmdPipelineBarrier2(context.setupCommandBuffer, &dependencyInfo);
+  vkEndCommandBuffer(context.setupCommandBuffer);
+}
+std::uint64_t Device::Submit(Ptr<px::CommandBuffer> commandBuffer) {
+  auto context = DownCast<CommandBuffer>(commandBuffer)->TakeContext();
+  vkEndCommandBuffer(context.commandBuffer);
+
+  std::unique_lock lock(mutex);
+  VkCommandBufferSubmitInfo commandBufferInfos[2];
+  uint32 numCommandBuffers = 0;
+  if (!initialLayouts.empty()) {
+    RecordInitialLayouts(context);
+    commandBufferInfos[numCommandBuffers++] = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .commandBuffer = context.setupCommandBuffer,
+    };
+  }
+  commandBufferInfos[numCommandBuffers++] = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+      .commandBuffer = context.commandBuffer,
+  };
+  bool present = context.swapchainImageIndex != UINT32_MAX;
+  VkSemaphoreSubmitInfo waitInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+      .semaphore = context.acquireSemaphore,
+      .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+  };
+  VkSemaphoreSubmitInfo signalInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+      .semaphore = present ? presentSemaphores[context.swapchainImageIndex]
+                           : VK_NULL_HANDLE,
+      .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+  };
+  VkSubmitInfo2 submitInfo{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+      .waitSemaphoreInfoCount = present ? 1u : 0u,
+      .pWaitSemaphoreInfos = &waitInfo,
+      .commandBufferInfoCount = numCommandBuffers,
+      .pCommandBufferInfos = commandBufferInfos,
+      .signalSemaphoreInfoCount = present ? 1u : 0u,
+      .pSignalSemaphoreInfos = &signalInfo,
+  };
+  std::erase(openSerials, context.serial);
+  auto serial = context.serial;
+  auto result = vkQueueSubmit2(queue, 1, &submitInfo, context.fence);
+  if (result != VK_SUCCESS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to submit command buffer: %d", result);
+    // The initial layouts stay queued for the next submit
+    ResetContext(context);
+    if (present) {
+      // The acquire semaphore is signaled but never waited on, and the
+      // image is never presented. Replace the semaphore and recreate the
+      // swapchain to get the image back.
+      vkDestroySemaphore(device, context.acquireSemaphore, nullptr);
+      context.acquireSemaphore = VK_NULL_HANDLE;
+      swapchainOutOfDate = true;
+      VkSemaphoreCreateInfo semaphoreCI{
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+      if (vkCreateSemaphore(device, &semaphoreCI, nullptr,
+                            &context.acquireSemaphore) != VK_SUCCESS) {
+        DestroyContext(context);
+        return 0;
+      }
+    }
+    freeContexts.push_back(std::move(context));
+    return 0;
+  }
+  initialLayouts.clear();
+  if (present) {
+    VkPresentInfoKHR presentInfo{
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &presentSemaphores[context.swapchainImageIndex],
+        .swapchainCount = 1,
+        .pSwapchains = &swapchain,
+        .pImageIndices = &context.swapchainImageIndex,
+    };
+    result = vkQueuePresentKHR(queue, &presentInfo);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+      swapchainOutOfDate = true;
+    }
+  }
+  pendingContexts.push_back(std::move(context));
+  Collect();
+  return serial;
+}
+void Device::SubmitCommandBuffer(Ptr<px::CommandBuffer> commandBuffer) {
+  Submit(commandBuffer);
+}
+Ptr<px::Fence> Device::SubmitCommandBufferAndAcquireFence(
+    Ptr<px::CommandBuffer> commandBuffer) {
+  auto serial = Submit(commandBuffer);
+  if (serial == 0) {
+    return nullptr;
+  }
+  return MakePtr<Fence>(GetCreateInfo().allocator, DownCast<Device>(GetPtr()),
+                        serial);
+}
+bool Device::QueryFence(Ptr<px::Fence> fence) {
+  auto serial = DownCast<Fence>(fence)->GetSerial();
+  std::unique_lock lock(mutex);
+  Collect();
+  return std::none_of(
+      pendingContexts.begin(), pendingContexts.end(),
+      [&](const CommandContext &context) { return context.serial == serial; });
+}
+void Device::WaitForFences(const Array<Ptr<px::Fence>> &fences, bool waitAll) {
+  Array<VkFence> nativeFences(std::pmr::new_delete_resource());
+  Array<std::uint64_t> serials(std::pmr::new_delete_resource());
+  {
+    std::unique_lock lock(mutex);
+    for (const auto &fence : fences) {
+      auto serial = DownCast<Fence>(fence)->GetSerial();
+      auto it = std::find_if(pendingContexts.begin(), pendingContexts.end(),
+                             [&](const CommandContext &context) {
+                               return context.serial == serial;
+                             });
+      if (it != pendingContexts.end()) {
+        nativeFences.push_back(it->fence);
+        serials.push_back(serial);
+      } else if (!waitAll) {
+        // Already signaled
+        nativeFences.clear();
+        serials.clear();
+        break;
+      }
+    }
+    // Pinned, so that Collect does not reset and reuse the fences while
+    // waiting without the lock
+    pinnedSerials.insert(pinnedSerials.end(), serials.begin(), serials.end());
+  }
+  if (!nativeFences.empty()) {
+    vkWaitForFences(device, static_cast<uint32>(nativeFences.size()),
+                    nativeFences.data(), waitAll, UINT64_MAX);
+  }
+  std::unique_lock lock(mutex);
+  for (auto serial : serials) {
+    pinnedSerials.erase(
+        std::find(pinnedSerials.begin(), pinnedSerials.end(), serial));
+  }
+  Collect();
+}
+
+bool Device::WaitForSerial(std::uint64_t serial, std::uint64_t timeout) {
+  Array<VkFence> fences(std::pmr::new_delete_resource());
+  for (const auto &context : pendingContexts) {
+    if (context.serial <= serial) {
+      fences.push_back(context.fence);
+    }
+  }
+  bool completed = true;
+  if (!fences.empty()) {
+    completed = vkWaitForFences(device, static_cast<uint32>(fences.size()),
+                                fences.data(), VK_TRUE,
+                                timeout) == VK_SUCCESS;
+  }
+  Collect();
+  return completed;
+}
+
+Ptr<px::Texture>
+Device::AcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer) {
+  return AcquireSwapchainTexture(commandBuffer, true);
+}
+Ptr<px::Texture>
+Device::TryAcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer) {
+  return AcquireSwapchainTexture(commandBuffer, false);
+}
+Ptr<px::Texture>
+Device::AcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer,
+                                bool wait) {
+  auto cb = DownCast<CommandBuffer>(commandBuffer);
+  if (swapchain == VK_NULL_HANDLE && !offscreenTargets.empty()) {
+    return AcquireOffscreenTarget(
+        cb->GetContext(), commandBuffer->GetCreateInfo().allocator, wait);
+  }
+  if (swapchain == VK_NULL_HANDLE && !swapchainOutOfDate) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "No window has been claimed for the device");
+    return nullptr;
+  }
+  // Refreshes the memory budget
+  vmaSetCurrentFrameIndex(memoryAllocator, ++frameIndex);
+  int width = 0, height = 0;
+  SDL_GetWindowSizeInPixels(window, &width, &height);
+  if (static_cast<uint32>(width) != swapchainExtent.width ||
+      static_cast<uint32>(height) != swapchainExtent.height) {
+    swapchainOutOfDate = true;
+  }
+  auto &context = cb->GetContext();
+  auto timeout = wait ? UINT64_MAX : 0;
+  {
+    // Bounds how far the CPU records ahead of the GPU, whatever the number
+    // of swapchain images
+    std::unique_lock lock(mutex);
+    if (!WaitForSerial(frameSerials[frameSerialIndex], timeout)) {
+      return nullptr;
+    }
+  }
+  uint32 imageIndex = UINT32_MAX;
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    if (swapchainOutOfDate) {
+      std::unique_lock lock(mutex);
+      if (!RecreateSwapchain()) {
+        return nullptr;
+      }
+    }
+    auto result =
+        vkAcquireNextImageKHR(device, swapchain, timeout,
+                              context.acquireSemaphore, VK_NULL_HANDLE,
+                              &imageIndex);
+    if (result == VK_SUCCESS) {
+      break;
+    }
+    if (result == VK_NOT_READY || result == VK_TIMEOUT) {
+      return nullptr;
+    }
+    if (result == VK_SUBOPTIMAL_KHR) {
+      // Usable, but recreated on the next acquire
+      swapchainOutOfDate = true;
+      break;
+    }
+    imageIndex = UINT32_MAX;
+    if (result != VK_ERROR_OUT_OF_DATE_KHR) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Failed to acquire swapchain image: %d", result);
+      return nullptr;
+    }
+    swapchainOutOfDate = true;
+  }
+  if (imageIndex == UINT32_MAX) {
+    return nullptr;
+  }
+  context.swapchainImageIndex = imageIndex;
+  frameSerials[frameSerialIndex] = context.serial;
+  frameSerialIndex = (frameSerialIndex + 1) % frameSerials.size();
+
+  Texture::CreateInfo ci{
+      .allocator = commandBuffer->GetCreateInfo().allocator,
+      .type = TextureType::Texture2D,
+      .format = convert::TextureFormatFrom(surfaceFormat.format),
+      .usage = TextureUsage::ColorTarget,
+      .width = swapchainExtent.width,
+      .height = swapchainExtent.height,
+      .layerCountOrDepth = 1,
+      .numLevels = 1,
+      .sampleCount = SampleCount::x1,
+  };
+  auto texture = MakePtr<Texture>(
+      ci.allocator, ci, DownCast<Device>(GetPtr()), swapchainImages[imageIndex],
+      VK_NULL_HANDLE, swapchainViews[imageIndex], swapchainViews[imageIndex],
+      true);
+  // The previous contents are not kept
+  cb->TransitionTexture(*texture, VK_IMAGE_LAYOUT_UNDEFINED,
+                        texture->GetRestLayout());
+  return texture;
+}
+Ptr<px::Texture> Device::AcquireOffscreenTarget(CommandContext &context,
+                                                Allocator *allocator,
+                                                bool wait) {
+  auto &target = offscreenTargets[offscreenIndex];
+  {
+    // Takes the place of vsync, the CPU stays at most one round of targets
+    // ahead of the GPU
+    std::unique_lock lock(mutex);
+    if (!WaitForSerial(target.serial, wait ? UINT64_MAX : 0)) {
+      return nullptr;
+    }
+  }
+  offscreenIndex = (offscreenIndex + 1) % offscreenTargets.size();
+  target.serial = context.serial;
+  vmaSetCurrentFrameIndex(memoryAllocator, ++frameIndex);
+  auto createInfo = offscreenInfo;
+  createInfo.allocator = allocator;
+  return MakePtr<Texture>(allocator, createInfo, DownCast<Device>(GetPtr()),
+                          target.image, target.allocation, target.view,
+                          target.targetView, false, true);
+}
+px::TextureFormat Device::GetSwapchainFormat() const {
+  if (swapchain == VK_NULL_HANDLE && !offscreenTargets.empty()) {
+    return offscreenInfo.format;
+  }
+  return convert::TextureFormatFrom(surfaceFormat.format);
+}
+void Device::WaitForGPUIdle() {
+  std::unique_lock lock(mutex);
+  vkDeviceWaitIdle(device);
+  Collect();
+}
+bool Device::GetMemoryBudgets(Array<MemoryHeapBudget> &budgets) {
+  const VkPhysicalDeviceMemoryProperties *memoryProperties;
+  vmaGetMemoryProperties(memoryAllocator, &memoryProperties);
+  VmaBudget heapBudgets[VK_MAX_MEMORY_HEAPS];
+  vmaGetHeapBudgets(memoryAllocator, heapBudgets);
+  budgets.clear();
+  for (uint32 i = 0; i < memoryProperties->memoryHeapCount; ++i) {
+    const auto &heapBudget = heapBudgets[i];
+    budgets.push_back({
+        .blockBytes = heapBudget.statistics.blockBytes,
+        .allocationBytes = heapBudget.statistics.allocationBytes,
+        .usage = heapBudget.usage,
+        .budget = heapBudget.budget,
+        .deviceLocal = (memoryProperties->memoryHeaps[i].flags &
+                        VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+    });
+  }
+  return true;
+}
+bool Device::ShouldDefragment(VmaPool pool) {
+  VmaStatistics statistics;
+  vmaGetPoolStatistics(memoryAllocator, pool, &statistics);
+  // Only worth it when compacting can free a whole block
+  return statistics.blockCount > 1 &&
+         statistics.blockBytes - statistics.allocationBytes >=
+             RENDER_TARGET_BLOCK_SIZE;
+}
+void Device::DefragmentMemory(float timeBudgetMs) {
+  using Clock = std::chrono::steady_clock;
+  auto deadline = Clock::now() +
+                  std::chrono::duration_cast<Clock::duration>(
+                      std::chrono::duration<float, std::milli>(timeBudgetMs));
+  std::unique_lock lock(mutex);
+  Collect();
+  if (defragmentationSerial != 0) {
+    // Collect destroys the old images once the copies have completed
+    if (defragmentationSerial > GetOldestPendingSerial()) {
+      return;
+    }
+    defragmentationSerial = 0;
+    if (vmaEndDefragmentationPass(memoryAllocator, defragmentation,
+                                  &defragmentationPass) == VK_SUCCESS) {
+      vmaEndDefragmentation(memoryAllocator, defragmentation, nullptr);
+      defragmentation = VK_NULL_HANDLE;
+    }
+  }
+  // Moving a texture swaps its handles under command buffers being recorded
+  if (!openSerials.empty() || Clock::now() >= deadline) {
+    return;
+  }
+  if (defragmentation == VK_NULL_HANDLE) {
+    if (!defragmentationRequested) {
+      return;
+    }
+    defragmentationRequested = false;
+    // One pool at a time, taking turns
+    for (size_t i = 0; i < renderTargetPools.size(); ++i) {
+      auto pool = renderTargetPools[defragmentationPoolIndex].pool;
+      defragmentationPoolIndex =
+          (defragmentationPoolIndex + 1) % renderTargetPools.size();
+      if (ShouldDefragment(pool)) {
+        VmaDefragmentationInfo defragmentationInfo{
+            .pool = pool,
+            .maxBytesPerPass = DEFRAGMENTATION_BYTES_PER_PASS,
+            .maxAllocationsPerPass = DEFRAGMENTATION_MOVES_PER_PASS,
+        };
+        vmaBeginDefragmentation(memoryAllocator, &defragmentationInfo,
+                                &defragmentation);
+        break;
+      }
+    }
+    if (defragmentation == VK_NULL_HANDLE) {
+      return;
+    }
+  }
+  if (vmaBeginDefragmentationPass(memoryAllocator, defragmentation,
+                                  &defragmentationPass) == VK_INCOMPLETE) {
+    RelocateTextures(defragmentationPass, deadline);
+    if (defragmentationSerial != 0) {
+      return;
+    }
+    // Nothing could be moved, pinned textures for example
+    vmaEndDefragmentationPass(memoryAllocator, defragmentation,
+                              &defragmentationPass);
+  }
+  vmaEndDefragmentation(memoryAllocator, defragmentation, nullptr);
+  defragmentation = VK_NULL_HANDLE;
+}
+void Device::RelocateTextures(VmaDefragmentationPassMoveInfo &pass,
+                              std::chrono::steady_clock::time_point deadline) {
+  struct Relocation {
+    Texture *texture;
+    VkImage image;
+    VkImageView view;
+    VkImageView targetView;
+  };
+  Array<Relocation> relocations(std::pmr::new_delete_resource());
+  for (uint32 i = 0; i < pass.moveCount; ++i) {
+    auto &move = pass.pMoves[i];
+    VmaAllocationInfo allocationInfo;
+    vmaGetAllocationInfo(memoryAllocator, move.srcAllocation, &allocationInfo);
+    auto *texture = static_cast<Texture *>(allocationInfo.pUserData);
+    // Released textures are freed soon anyway, and textures still waiting
+    // for their initial layout have no rest layout to copy from. At least
+    // one texture moves per pass, however short the budget.
+    bool movable =
+        texture != nullptr && texture->numPins == 0 &&
+        (relocations.empty() || std::chrono::steady_clock::now() < deadline) &&
+        std::none_of(initialLayouts.begin(), initialLayouts.end(),
+                     [&](const InitialLayout &layout) {
+                       return layout.image == texture->GetNative();
+                     });
+    Relocation relocation{texture};
+    if (movable) {
+      auto imageCI = GetImageCreateInfo(texture->getCreateInfo());
+      movable = vkCreateImage(device, &imageCI, nullptr, &relocation.image) ==
+                VK_SUCCESS;
+      if (movable &&
+          (vmaBindImageMemory(memoryAllocator, move.dstTmpAllocation,
+                              relocation.image) != VK_SUCCESS ||
+           !CreateTextureViews(texture->getCreateInfo(), relocation.image,
+                               relocation.view, relocation.targetView))) {
+        vkDestroyImage(device, relocation.image, nullptr);
+        movable = false;
+      }
+    }
+    if (!movable) {
+      move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+      continue;
+    }
+    relocations.push_back(relocation);
+  }
+  if (relocations.empty()) {
+    return;
+  }
+
+  CommandContext context;
+  if (!freeContexts.empty()) {
+    context = std::move(freeContexts.back());
+    freeContexts.pop_back();
+  } else if (!CreateContext(context)) {
+    DestroyContext(context);
+    context.commandBuffer = VK_NULL_HANDLE;
+  }
+  if (context.commandBuffer != VK_NULL_HANDLE) {
+    context.serial = nextSerial++;
+    VkCommandBufferBeginInfo beginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(context.commandBuffer, &beginInfo);
+    Array<VkImageMemoryBarrier2> barriers(std::pmr::new_delete_resource());
+    for (const auto &relocation : relocations) {
+      auto range = VkImageSubresourceRange{relocation.texture->GetAspect(), 0,
+                                           VK_REMAINING_MIP_LEVELS, 0,
+                                           VK_REMAINING_ARRAY_LAYERS};
+      // Waits for every earlier submit that used the texture
+      barriers.push_back({
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+          .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+          .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+          .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+          .dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+          .oldLayout = relocation.texture->GetRestLayout(),
+          .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          .image = relocation.texture->GetNative(),
+          .subresourceRange = range,
+      });
+      barriers.push_back({
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+          .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+          .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+          .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+          .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          .image = relocation.image,
+          .subresourceRange = range,
+      });
+    }
+    VkDependencyInfo dependencyInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = static_cast<uint32>(barriers.size()),
+        .pImageMemoryBarriers = barriers.data(),
+    };
+    vkCmdPipelineBarrier2(context.commandBuffer, &dependencyInfo);
+    barriers.clear();
+    Array<VkImageCopy2> regions(std::pmr::new_delete_resource());
+    for (const auto &relocation : relocations) {
+      const auto &createInfo = relocation.texture->getCreateInfo();
+      regions.clear();
+      for (uint32 level = 0; level < std::max(createInfo.numLevels, 1u);
+           ++level) {
+        VkImageSubresourceLayers subresource{relocation.texture->GetAspect(),
+                                             level, 0,
+                                             GetLayerCount(createInfo)};
+        regions.push_back({
+            .sType = VK_STRUCTURE_TYPE_IMAGE_COPY_2,
+            .srcSubresource = subresource,
+            .dstSubresource = subresource,
+            .extent = {std::max(createInfo.width >> level, 1u),
+                       std::max(createInfo.height >> level, 1u),
+                       createInfo.type == TextureType::Texture3D
+                           ? std::max(createInfo.layerCountOrDepth >> level,
+                                      1u)
+                           : 1u},
+        });
+      }
+      VkCopyImageInfo2 copyInfo{
+          .sType = VK_STRUCTURE_TYPE_COPY_IMAGE_INFO_2,
+          .srcImage = relocation.texture->GetNative(),
+          .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          .dstImage = relocation.image,
+          .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          .regionCount = static_cast<uint32>(regions.size()),
+          .pRegions = regions.data(),
+      };
+      vkCmdCopyImage2(context.commandBuffer, &copyInfo);
+      barriers.push_back({
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+          .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+          .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+          .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+          .dstAccessMask =
+              VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+          .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          .newLayout = relocation.texture->GetRestLayout(),
+          .image = relocation.image,
+          .subresourceRange = {relocation.texture->GetAspect(), 0,
+                               VK_REMAINING_MIP_LEVELS, 0,
+                               VK_REMAINING_ARRAY_LAYERS},
+      });
+    }
+    dependencyInfo.imageMemoryBarrierCount =
+        static_cast<uint32>(barriers.size());
+    dependencyInfo.pImageMemoryBarriers = barriers.data();
+    vkCmdPipelineBarrier2(context.commandBuffer, &dependencyInfo);
+    vkEndCommandBuffer(context.commandBuffer);
+    VkCommandBufferSubmitInfo commandBufferInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .commandBuffer = context.commandBuffer,
+    };
+    VkSubmitInfo2 submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &commandBufferInfo,
+    };
+    if (vkQueueSubmit2(queue, 1, &submitInfo, context.fence) == VK_SUCCESS) {
+      pendingContexts.push_back(std::move(context));
+      // The old images go once the copies and every command buffer
+      // recorded before them have completed
+      for (const auto &relocation : relocations) {
+        auto *texture = relocation.texture;
+        garbage.push_back({
+            .serial = nextSerial,
+            .image = texture->GetNative(),
+            .imageView = texture->GetView(),
+            .targetView = texture->GetTargetView(),
+        });
+        texture->Relocate(relocation.image, relocation.view,
+                          relocation.targetView);
+      }
+      defragmentationSerial = nextSerial;
+      return;
+    }
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to submit defragmentation copies");
+    ResetContext(context);
+    freeContexts.push_back(std::move(context));
+  }
+  for (uint32 i = 0; i < pass.moveCount; ++i) {
+    pass.pMoves[i].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+  }
+  for (const auto &relocation : relocations) {
+    DestroyGarbage({.image = relocation.image,
+                    .imageView = relocation.view,
+                    .targetView = relocation.targetView});
+  }
+}
+VkImageView Device::PinTexture(const Ptr<px::Texture> &texture) {
+  auto &vulkanTexture = *DownCast<Texture>(texture);
+  std::unique_lock lock(mutex);
+  ++vulkanTexture.numPins;
+  return vulkanTexture.GetView();
+}
+void Device::UnpinTexture(const Ptr<px::Texture> &texture) {
+  auto &vulkanTexture = *DownCast<Texture>(texture);
+  std::unique_lock lock(mutex);
+  assert(vulkanTexture.numPins > 0);
+  --vulkanTexture.numPins;
+}
+String Device::GetDriver() const {
+  return String("vulkan", GetCreateInfo().allocator);
+}
+
+Texture::Texture(const CreateInfo &createInfo, const Ptr<Device> &device,
+                 VkImage image, VmaAllocation allocation, VkImageView view,
+                 VkImageView targetView, bool isSwapchainTexture,
+                 bool isBorrowed)
+    : px::Texture(createInfo), device(device), image(image),
+      allocation(allocation), view(view), targetView(targetView),
+      aspect(convert::AspectFrom(createInfo.format)),
+      restLayout(isSwapchainTexture ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+                                    : GetRestLayout(createInfo.usage)),
+      isSwapchainTexture(isSwapchainTexture), isBorrowed(isBorrowed) {}
+Texture::~Texture() {
+  if (!isSwapchainTexture && !isBorrowed) {
+    device->ReleaseTexture(*this);
+  }
+}
+void Texture::Relocate(VkImage image, VkImageView view,
+                       VkImageView targetView) {
+  this->image = image;
+  this->view = view;
+  this->targetView = targetView;
+}
+VkImageLayout Texture::GetRestLayout(TextureUsage usage) {
+  switch (usage) {
+  case TextureUsage::DepthStencilTarget:
+    return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  default:
+    // Color targets are sampled after rendering more often than not
+    return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  }
+}
+
+Sampler::~Sampler() { device->Release({.sampler = sampler}); }
+
+TransferBuffer::TransferBuffer(const CreateInfo &createInfo,
+                               const Ptr<Device> &device)
+    : px::TransferBuffer(createInfo), device(device),
+      backings(createInfo.allocator), current(0) {}
+TransferBuffer::~TransferBuffer() {
+  for (const auto &backing : backings) {
+    device->Release(
+        {.buffer = backing.buffer, .allocation = backing.allocation});
+  }
+}
+bool TransferBuffer::CreateBacking() {
+  bool upload = GetCreateInfo().usage == TransferBufferUsage::Upload;
+  VkBufferCreateInfo bufferCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = GetCreateInfo().size,
+      .usage = upload ? VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                      : VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+  };
+  VmaAllocationCreateInfo allocationCI{
+      .flags = (upload ? VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
+                       : VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT) |
+               VMA_ALLOCATION_CREATE_MAPPED_BIT,
+      .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+      .pool = upload && bufferCI.size <= STAGING_BLOCK_SIZE
+                  ? device->GetStagingPool()
+                  : VK_NULL_HANDLE,
+  };
+  Backing backing{};
+  VmaAllocationInfo allocationInfo;
+  auto result =
+      vmaCreateBuffer(device->GetMemoryAllocator(), &bufferCI, &allocationCI,
+                      &backing.buffer, &backing.allocation, &allocationInfo);
+  if (result != VK_SUCCESS && allocationCI.pool != VK_NULL_HANDLE) {
+    allocationCI.pool = VK_NULL_HANDLE;
+    result =
+        vmaCreateBuffer(device->GetMemoryAllocator(), &bufferCI, &allocationCI,
+                        &backing.buffer, &backing.allocation, &allocationInfo);
+  }
+  if (result != VK_SUCCESS) {
+    return false;
+  }
+  backing.mapped = allocationInfo.pMappedData;
+  current = static_cast<uint32>(backings.size());
+  backings.push_back(backing);
+  return true;
+}
+void TransferBuffer::MarkUsed(std::uint64_t serial) {
+  auto &backing = backings[current];
+  backing.lastUsedSerial = std::max(backing.lastUsedSerial, serial);
+}
+void *TransferBuffer::Map(bool cycle) {
+  if (cycle && device->IsPending(backings[current].lastUsedSerial)) {
+    // Write into a backing no pending command buffer reads instead of
+    // waiting for the GPU
+    auto it = std::find_if(
+        backings.begin(), backings.end(), [&](const Backing &backing) {
+          return !device->IsPending(backing.lastUsedSerial);
+        });
+    if (it != backings.end()) {
+      current = static_cast<uint32>(it - backings.begin());
+    } else if (!CreateBacking()) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Failed to cycle transfer buffer");
+    }
+  }
+  auto &backing = backings[current];
+  if (GetCreateInfo().usage == TransferBufferUsage::Download) {
+    vmaInvalidateAllocation(device->GetMemoryAllocator(), backing.allocation,
+                            0, VK_WHOLE_SIZE);
+  }
+  return backing.mapped;
+}
+void TransferBuffer::Unmap() {
+  if (GetCreateInfo().usage == TransferBufferUsage::Upload) {
+    vmaFlushAllocation(device->GetMemoryAllocator(),
+                       backings[current].allocation, 0, VK_WHOLE_SIZE);
+  }
+}
+
+Buffer::~Buffer() {
+  device->Release({.buffer = buffer, .allocation = allocation});
+}
+
+Shader::Shader(const CreateInfo &createInfo, const Ptr<Device> &device,
+               VkShaderModule shaderModule)
+    : px::Shader(createInfo), numSamplers(createInfo.numSamplers),
+      numStorageTextures(createInfo.numStorageTextures),
+      numStorageBuffers(createInfo.numStorageBuffers),
+      numUniformBuffers(createInfo.numUniformBuffers),
+      usesBindlessTable(false), device(device),
+      shaderModule(shaderModule),
+      entrypoint(createInfo.entrypoint != nullptr ? createInfo.entrypoint
+                                                  : "main",
+                 createInfo.allocator),
+      stage(createInfo.stage),
+      specializationConstants(createInfo.specializationConstants,
+                              createInfo.specializationConstants +
+                                  createInfo.numSpecializationConstants,
+                              createInfo.allocator) {}
+Shader::~Shader() { device->Release({.shaderModule = shaderModule}); }
+
+BindlessTable::BindlessTable(const CreateInfo &createInfo,
+                             const Ptr<Device> &device, VkDescriptorPool pool,
+                             VkDescriptorSet set)
+    : px::BindlessTable(createInfo), device(device), pool(pool), set(set),
+      textures(MAX_BINDLESS_TEXTURES, createInfo.allocator),
+      samplers(MAX_BINDLESS_SAMPLERS, createInfo.allocator),
+      buffers(MAX_BINDLESS_BUFFERS, createInfo.allocator) {}
+BindlessTable::~BindlessTable() {
+  for (const auto &texture : textures.resources) {
+    if (texture != nullptr) {
+      device->UnpinTexture(texture);
+    }
+  }
+  // Freeing the pool frees the set, which pending command buffers may read
+  device->Release({.descriptorPool = pool});
+}
+template <typename T>
+uint32 BindlessTable::Allocate(Slots<T> &slots, Ptr<T> resource) {
+  if (slots.free.empty()) {
+    // Retired in serial order, so the completed ones come first
+    auto completed = std::find_if(
+        slots.retired.begin(), slots.retired.end(),
+        [&](const auto &retired) { return device->IsPending(retired.serial); });
+    for (auto it = slots.retired.begin(); it != completed; ++it) {
+      slots.free.push_back(it->index);
+    }
+    slots.retired.erase(slots.retired.begin(), completed);
+  }
+  if (!slots.free.empty()) {
+    auto index = slots.free.back();
+    slots.free.pop_back();
+    slots.resources[index] = std::move(resource);
+    return index;
+  }
+  if (slots.resources.size() < slots.capacity) {
+    slots.resources.push_back(std::move(resource));
+    return static_cast<uint32>(slots.resources.size() - 1);
+  }
+  return INVALID_INDEX;
+}
+template <typename T>
+void BindlessTable::Retire(Slots<T> &slots, uint32 index) {
+  if (index >= slots.resources.size() || slots.resources[index] == nullptr) {
+    assert(false && "Index is not registered");
+    return;
+  }
+  // The device defers destroying the native handles on its own
+  slots.resources[index] = nullptr;
+  slots.retired.push_back({index, device->GetLatestSerial()});
+}
+void BindlessTable::Write(uint32 binding, uint32 index, VkDescriptorType type,
+                          const VkDescriptorImageInfo *imageInfo,
+                          const VkDescriptorBufferInfo *bufferInfo) {
+  VkWriteDescriptorSet write{
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = set,
+      .dstBinding = binding,
+      .dstArrayElement = index,
+      .descriptorCount = 1,
+      .descriptorType = type,
+      .pImageInfo = imageInfo,
+      .pBufferInfo = bufferInfo,
+  };
+  vkUpdateDescriptorSets(device->GetNative(), 1, &write, 0, nullptr);
+}
+uint32 BindlessTable::RegisterTexture(Ptr<px::Texture> texture) {
+  auto vulkanTexture = DownCast<Texture>(texture);
+  // Shaders sample the texture in its rest layout, like bound samplers
+  if (texture->getCreateInfo().type != TextureType::Texture2D ||
+      vulkanTexture->GetRestLayout() !=
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to register texture: only sampled 2D textures can "
+                 "be registered");
+    return INVALID_INDEX;
+  }
+  // Defragmentation leaves the texture in place while the table refers to
+  // its view
+  VkDescriptorImageInfo imageInfo{
+      .imageView = device->PinTexture(texture),
+      .imageLayout = vulkanTexture->GetRestLayout(),
+  };
+  std::unique_lock lock(mutex);
+  auto index = Allocate(textures, texture);
+  if (index == INVALID_INDEX) {
+    device->UnpinTexture(texture);
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to register texture: the bindless table is full");
+    return INVALID_INDEX;
+  }
+  Write(0, index, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &imageInfo, nullptr);
+  return index;
+}
+uint32 BindlessTable::RegisterSampler(Ptr<px::Sampler> sampler) {
+  VkDescriptorImageInfo imageInfo{
+      .sampler = DownCast<Sampler>(sampler)->GetNative(),
+  };
+  std::unique_lock lock(mutex);
+  auto index = Allocate(samplers, std::move(sampler));
+  if (index == INVALID_INDEX) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to register sampler: the bindless table is full");
+    return INVALID_INDEX;
+  }
+  Write(1, index, VK_DESCRIPTOR_TYPE_SAMPLER, &imageInfo, nullptr);
+  return index;
+}
+uint32 BindlessTable::RegisterBuffer(Ptr<px::Buffer> buffer) {
+  if (buffer->getCreateInfo().usage != BufferUsage::Storage) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to register buffer: only storage buffers can be "
+                 "registered");
+    return INVALID_INDEX;
+  }
+  VkDescriptorBufferInfo bufferInfo{
+      .buffer = DownCast<Buffer>(buffer)->GetNative(),
+      .offset = 0,
+      .range = VK_WHOLE_SIZE,
+  };
+  std::unique_lock lock(mutex);
+  auto index = Allocate(buffers, std::move(buffer));
+  if (index == INVALID_INDEX) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Failed to register buffer: the bindless table is full");
+    return INVALID_INDEX;
+  }
+  Write(2, index, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &bufferInfo);
+  return index;
+}
+void BindlessTable::UnregisterTexture(uint32 index) {
+  std::unique_lock lock(mutex);
+  if (index < textures.resources.size() &&
+      textures.resources[index] != nullptr) {
+    device->UnpinTexture(textures.resources[index]);
+  }
+  Retire(textures, index);
+}
+void BindlessTable::UnregisterSampler(uint32 index) {
+  std::unique_lock lock(mutex);
+  Retire(samplers, index);
+}
+void BindlessTable::UnregisterBuffer(uint32 index) {
+  std::unique_lock lock(mutex);
+  Retire(buffers, index);
+}
+
+GraphicsPipeline::~GraphicsPipeline() {
+  device->Release({.pipeline = pipeline, .pipelineLayout = layout});
+}
+
+CommandBuffer::CommandBuffer(const CreateInfo &createInfo,
+                             const Ptr<Device> &device,
+                             CommandContext &&context)
+    : px::CommandBuffer(createInfo), device(device),
+      context(std::move(context)), submitted(false), uniformSlots(),
+      uniformVersion(0) {}
+CommandBuffer::~CommandBuffer() {
+  if (!submitted) {
+    device->ReleaseContext(std::move(context));
+  }
+}
+CommandContext CommandBuffer::TakeContext() {
+  assert(!submitted && "Command buffer submitted twice");
+  submitted = true;
+  // Host writes to uniform blocks become visible to the submit
+  for (uint32 i = 0; i <= context.uniformBlockIndex &&
+                     i < context.uniformBlocks.size();
+       ++i) {
+    vmaFlushAllocation(device->GetMemoryAllocator(),
+                       context.uniformBlocks[i].allocation, 0, VK_WHOLE_SIZE);
+  }
+  return std::move(context);
+}
+void CommandBuffer::TransitionTexture(const Texture &texture,
+                                      VkImageLayout oldLayout,
+                                      VkImageLayout newLayout,
+                                      uint32 baseLevel, uint32 numLevels,
+                                      uint32 baseLayer, uint32 numLayers) {
+  VkImageMemoryBarrier2 barrier{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .dstAccessMask =
+          VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+      .oldLayout = oldLayout,
+      .newLayout = newLayout,
+      .image = texture.GetNative(),
+      .subresourceRange = {texture.GetAspect(), baseLevel, numLevels,
+                           baseLayer, numLayers},
+  };
+  VkDependencyInfo dependencyInfo{
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .imageMemoryBarrierCount = 1,
+      .pImageMemoryBarriers = &barrier,
+  };
+  vkCmdPipelineBarrier2(context.commandBuffer, &dependencyInfo);
+}
+void CommandBuffer::GlobalBarrier() {
+  VkMemoryBarrier2 barrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+      // Downloads are read by the host once the fence is signaled
+      .dstStageMask =
+          VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_2_HOST_BIT,
+      .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT |
+                       VK_ACCESS_2_MEMORY_WRITE_BIT |
+                       VK_ACCESS_2_HOST_READ_BIT,
+  };
+  VkDependencyInfo dependencyInfo{
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &barrier,
+  };
+  vkCmdPipelineBarrier2(context.commandBuffer, &dependencyInfo);
+}
+
+Ptr<px::CopyPass> CommandBuffer::BeginCopyPass() {
+  GlobalBarrier();
+  return MakePtr<CopyPass>(GetCreateInfo().allocator, *this);
+}
+void CommandBuffer::EndCopyPass(Ptr<px::CopyPass> copyPass) {
+  GlobalBarrier();
+}
+void CopyPass::UploadTexture(const TextureTransferInfo &src,
+                             const TextureRegion &dst, bool cycle) {
+  // Ordered after prior use by barriers, so cycling is never needed
+  auto transferBuffer = DownCast<TransferBuffer>(src.transferBuffer);
+  auto texture = DownCast<Texture>(dst.texture);
+  transferBuffer->MarkUsed(commandBuffer.GetSerial());
+  commandBuffer.TransitionTexture(*texture, texture->GetRestLayout(),
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  dst.mipLevel, 1, dst.layer, 1);
+  VkBufferImageCopy region{
+      .bufferOffset = src.offset,
+      .bufferRowLength = src.pixelsPerRow,
+      .bufferImageHeight = src.rowsPerLayer,
+      .imageSubresource = {GetCopyAspect(*texture), dst.mipLevel, dst.layer,
+                           1},
+      .imageOffset = {static_cast<int32>(dst.x), static_cast<int32>(dst.y),
+                      static_cast<int32>(dst.z)},
+      .imageExtent = {dst.width, dst.height, std::max(dst.depth, 1u)},
+  };
+  vkCmdCopyBufferToImage(commandBuffer.GetNative(),
+                         transferBuffer->GetNative(), texture->GetNative(),
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  commandBuffer.TransitionTexture(
+      *texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture->GetRestLayout(),
+      dst.mipLevel, 1, dst.layer, 1);
+}
+void CopyPass::DownloadTexture(const TextureRegion &src,
+                               const TextureTransferInfo &dst) {
+  auto transferBuffer = DownCast<TransferBuffer>(dst.transferBuffer);
+  auto texture = DownCast<Texture>(src.texture);
+  transferBuffer->MarkUsed(commandBuffer.GetSerial());
+  commandBuffer.TransitionTexture(*texture, texture->GetRestLayout(),
+                                  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                  src.mipLevel, 1, src.layer, 1);
+  VkBufferImageCopy region{
+      .bufferOffset = dst.offset,
+      .bufferRowLength = dst.pixelsPerRow,
+      .bufferImageHeight = dst.rowsPerLayer,
+      .imageSubresource = {GetCopyAspect(*texture), src.mipLevel, src.layer,
+                           1},
+      .imageOffset = {static_cast<int32>(src.x), static_cast<int32>(src.y),
+                      static_cast<int32>(src.z)},
+      .imageExtent = {src.width, src.height, std::max(src.depth, 1u)},
+  };
+  vkCmdCopyImageToBuffer(commandBuffer.GetNative(), texture->GetNative(),
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         transferBuffer->GetNative(), 1, &region);
+  commandBuffer.TransitionTexture(
+      *texture, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->GetRestLayout(),
+      src.mipLevel, 1, src.layer, 1);
+}
+void CopyPass::UploadBuffer(const BufferTransferInfo &src,
+                            const BufferRegion &dst, bool cycle) {
+  auto transferBuffer = DownCast<TransferBuffer>(src.transferBuffer);
+  transferBuffer->MarkUsed(commandBuffer.GetSerial());
+  VkBufferCopy region{
+      .srcOffset = src.offset,
+      .dstOffset = dst.offset,
+      .size = dst.size,
+  };
+  vkCmdCopyBuffer(commandBuffer.GetNative(), transferBuffer->GetNative(),
+                  DownCast<Buffer>(dst.buffer)->GetNative(), 1, &region);
+}
+void CopyPass::DownloadBuffer(const BufferRegion &src,
+                              const BufferTransferInfo &dst) {
+  auto transferBuffer = DownCast<TransferBuffer>(dst.transferBuffer);
+  transferBuffer->MarkUsed(commandBuffer.GetSerial());
+  VkBufferCopy region{
+      .srcOffset = src.offset,
+      .dstOffset = dst.offset,
+      .size = src.size,
+  };
+  vkCmdCopyBuffer(commandBuffer.GetNative(),
+                  DownCast<Buffer>(src.buffer)->GetNative(),
+                  transferBuffer->GetNative(), 1, &region);
+}
+void CopyPass::CopyTexture(const TextureLocation &src,
+                           const TextureLocation &dst, uint32 width,
+                           uint32 height, uint32 depth, bool cycle) {
+  auto srcTexture = DownCast<Texture>(src.texture);
+  auto dstTexture = DownCast<Texture>(dst.texture);
+  commandBuffer.TransitionTexture(*srcTexture, srcTexture->GetRestLayout(),
+                                  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                  src.mipLevel, 1, src.layer, 1);
+  commandBuffer.TransitionTexture(*dstTexture, dstTexture->GetRestLayout(),
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  dst.mipLevel, 1, dst.layer, 1);
+  VkImageCopy region{
+      .srcSubresource = {GetCopyAspect(*srcTexture), src.mipLevel, src.layer,
+                         1},
+      .srcOffset = {static_cast<int32>(src.x), static_cast<int32>(src.y),
+                    static_cast<int32>(src.z)},
+      .dstSubresource = {GetCopyAspect(*dstTexture), dst.mipLevel, dst.layer,
+                         1},
+      .dstOffset = {static_cast<int32>(dst.x), static_cast<int32>(dst.y),
+                    static_cast<int32>(dst.z)},
+      .extent = {width, height, std::max(depth, 1u)},
+  };
+  vkCmdCopyImage(commandBuffer.GetNative(), srcTexture->GetNative(),
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstTexture->GetNative(),
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  commandBuffer.TransitionTexture(
+      *srcTexture, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      srcTexture->GetRestLayout(), src.mipLevel, 1, src.layer, 1);
+  commandBuffer.TransitionTexture(
+      *dstTexture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      dstTexture->GetRestLayout(), dst.mipLevel, 1, dst.layer, 1);
+}
+
+Ptr<px::RenderPass>
+CommandBuffer::BeginRenderPass(const Array<ColorTargetInfo> &infos,
+                               const DepthStencilTargetInfo &depthStencilInfo,
+                               float r, float g, float b, float a) {
+  auto allocator = GetCreateInfo().allocator;
+  Array<Ptr<px::Texture>> targets(allocator);
+  VkRenderingAttachmentInfo colorAttachments[MAX_COLOR_TARGETS];
+  assert(infos.size() <= MAX_COLOR_TARGETS);
+  for (size_t i = 0; i < infos.size(); ++i) {
+    auto texture = DownCast<Texture>(infos[i].texture);
+    // Contents that are cleared need not be preserved by the transition
+    TransitionTexture(*texture,
+                      infos[i].loadOp == LoadOp::Load
+                          ? texture->GetRestLayout()
+                          : VK_IMAGE_LAYOUT_UNDEFINED,
+                      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 0, 1, 0, 1);
+    colorAttachments[i] = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = texture->GetTargetView(),
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .loadOp = convert::LoadOpFrom(infos[i].loadOp),
+        .storeOp = convert::StoreOpFrom(infos[i].storeOp),
+        .clearValue = {.color = {.float32 = {r, g, b, a}}},
+    };
+    targets.push_back(texture);
+  }
+  VkRenderingAttachmentInfo depthAttachment{
+      .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+  VkRenderingAttachmentInfo stencilAttachment{
+      .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+  bool hasDepth = false, hasStencil = false;
+  if (depthStencilInfo.texture != nullptr) {
+    auto texture = DownCast<Texture>(depthStencilInfo.texture);
+    // Same layout, but orders the writes of previous passes
+    TransitionTexture(*texture, texture->GetRestLayout(),
+                      texture->GetRestLayout(), 0, 1, 0, 1);
+    VkClearValue clearValue{
+        .depthStencil = {depthStencilInfo.clearDepth,
+                         depthStencilInfo.clearStencil}};
+    depthAttachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = texture->GetTargetView(),
+        .imageLayout = texture->GetRestLayout(),
+        .loadOp = convert::LoadOpFrom(depthStencilInfo.loadOp),
+        .storeOp = convert::StoreOpFrom(depthStencilInfo.storeOp),
+        .clearValue = clearValue,
+    };
+    hasDepth = true;
+    if (texture->GetAspect() & VK_IMAGE_ASPECT_STENCIL_BIT) {
+      stencilAttachment = depthAttachment;
+      stencilAttachment.loadOp =
+          convert::LoadOpFrom(depthStencilInfo.stencilLoadOp);
+      stencilAttachment.storeOp =
+          convert::StoreOpFrom(depthStencilInfo.stencilStoreOp);
+      hasStencil = true;
+    }
+    targets.push_back(texture);
+  }
+  assert(!targets.empty());
+  const auto &extent = targets[0]->getCreateInfo();
+  VkRenderingInfo renderingInfo{
+      .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+      .renderArea = {{0, 0}, {extent.width, extent.height}},
+      .layerCount = 1,
+      .colorAttachmentCount = static_cast<uint32>(infos.size()),
+      .pColorAttachments = colorAttachments,
+      .pDepthAttachment = hasDepth ? &depthAttachment : nullptr,
+      .pStencilAttachment = hasStencil ? &stencilAttachment : nullptr,
+  };
+  vkCmdBeginRendering(context.commandBuffer, &renderingInfo);
+
+  auto renderPass = MakePtr<RenderPass>(allocator, allocator, *this, targets);
+  renderPass->SetViewport({0.0f, 0.0f, static_cast<float>(extent.width),
+                           static_cast<float>(extent.height), 0.0f, 1.0f});
+  renderPass->SetScissor(0, 0, static_cast<int32>(extent.width),
+                         static_cast<int32>(extent.height));
+  return renderPass;
+}
+void CommandBuffer::EndRenderPass(Ptr<px::RenderPass> renderPass) {
+  vkCmdEndRendering(context.commandBuffer);
+  for (const auto &target : DownCast<RenderPass>(renderPass)->GetTargets()) {
+    auto texture = DownCast<Texture>(target);
+    if (texture->GetAspect() & VK_IMAGE_ASPECT_COLOR_BIT) {
+      TransitionTexture(*texture, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        texture->GetRestLayout(), 0, 1, 0, 1);
+    }
+  }
+}
+
+void CommandBuffer::PushUniformData(uint32 slot, const void *data,
+                                    size_t size) {
+  assert(slot < MAX_UNIFORM_BUFFERS && size <= MAX_UNIFORM_SIZE);
+  auto alignment = static_cast<uint32>(
+      GetDevice().GetProperties().limits.minUniformBufferOffsetAlignment);
+  auto offset = (context.uniformOffset + alignment - 1) & ~(alignment - 1);
+  // Every slot binds MAX_UNIFORM_SIZE bytes, which must fit in the block
+  if (context.uniformBlocks.empty() ||
+      offset + MAX_UNIFORM_SIZE > UNIFORM_BLOCK_SIZE) {
+    if (!context.uniformBlocks.empty()) {
+      context.uniformBlockIndex++;
+    }
+    if (context.uniformBlockIndex >= context.uniformBlocks.size()) {
+      CommandContext::UniformBlock block;
+      if (!device->CreateUniformBlock(block)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to allocate uniform data");
+        return;
+      }
+      context.uniformBlocks.push_back(block);
+    }
+    offset = 0;
+  }
+  auto &block = context.uniformBlocks[context.uniformBlockIndex];
+  std::memcpy(block.mapped + offset, data, size);
+  context.uniformOffset = offset + static_cast<uint32>(size);
+  uniformSlots[slot] = {block.buffer, offset};
+  uniformVersion++;
+}
+void CommandBuffer::EnsureUniforms(uint32 count) {
+  static constexpr std::byte zeros[MAX_UNIFORM_SIZE] = {};
+  for (uint32 slot = 0; slot < count; ++slot) {
+    if (uniformSlots[slot].buffer == VK_NULL_HANDLE) {
+      PushUniformData(slot, zeros, sizeof(zeros));
+    }
+  }
+}
+VkDescriptorSet
+CommandBuffer::AllocateDescriptorSet(VkDescriptorSetLayout layout) {
+  while (true) {
+    if (context.descriptorPoolIndex >= context.descriptorPools.size()) {
+      auto pool = device->CreateDescriptorPool();
+      if (pool == VK_NULL_HANDLE) {
+        return VK_NULL_HANDLE;
+      }
+      context.descriptorPools.push_back(pool);
+    }
+    VkDescriptorSetAllocateInfo allocateInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = context.descriptorPools[context.descriptorPoolIndex],
+        .descriptorSetCount = 1,
+        .pSetLayouts = &layout,
+    };
+    VkDescriptorSet set;
+    auto result =
+        vkAllocateDescriptorSets(device->GetNative(), &allocateInfo, &set);
+    if (result == VK_SUCCESS) {
+      return set;
+    }
+    if (result != VK_ERROR_OUT_OF_POOL_MEMORY &&
+        result != VK_ERROR_FRAGMENTED_POOL) {
+      return VK_NULL_HANDLE;
+    }
+    // Full, continue with the next pool
+    context.descriptorPoolIndex++;
+  }
+}
+
+void CommandBuffer::GenerateMipmaps(Ptr<px::Texture> texture) {
+  auto vkTexture = DownCast<Texture>(texture);
+  const auto &ci = vkTexture->getCreateInfo();
+  if (ci.numLevels <= 1) {
+    return;
+  }
+  if (GetTextureFormatInfo(ci.format).blockWidth != 1) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Cannot generate mipmaps of a block-compressed texture");
+    return;
+  }
+  auto numLayers = GetLayerCount(ci);
+  auto restLayout = vkTexture->GetRestLayout();
+  TransitionTexture(*vkTexture, restLayout,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, 1);
+  TransitionTexture(*vkTexture, VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                    ci.numLevels - 1);
+  auto mipExtent = [&](uint32 extent, uint32 level) {
+    return static_cast<int32>(std::max(extent >> level, 1u));
+  };
+  auto depth = ci.type == TextureType::Texture3D ? ci.layerCountOrDepth : 1;
+  for (uint32 level = 1; level < ci.numLevels; ++level) {
+    VkImageBlit region{
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, numLayers},
+        .srcOffsets = {{0, 0, 0},
+                       {mipExtent(ci.width, level - 1),
+                        mipExtent(ci.height, level - 1),
+                        mipExtent(depth, level - 1)}},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, numLayers},
+        .dstOffsets = {{0, 0, 0},
+                       {mipExtent(ci.width, level),
+                        mipExtent(ci.height, level), mipExtent(depth, level)}},
+    };
+    vkCmdBlitImage(context.commandBuffer, vkTexture->GetNative(),
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   vkTexture->GetNative(),
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+                   VK_FILTER_LINEAR);
+    TransitionTexture(*vkTexture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, level, 1);
+  }
+  TransitionTexture(*vkTexture, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    restLayout);
+}
+void CommandBuffer::Blit(const BlitInfo &blitInfo) {
+  // BlitInfo carries no clear color, so loadOp is treated as Load
+  const auto &src = blitInfo.source;
+  const auto &dst = blitInfo.destination;
+  auto srcTexture = DownCast<Texture>(src.texture);
+  auto dstTexture = DownCast<Texture>(dst.texture);
+  auto subresource = [](const Texture &texture, const BlitRegion &region,
+                        int32 &z) {
+    bool is3D = texture.getCreateInfo().type == TextureType::Texture3D;
+    z = is3D ? static_cast<int32>(region.layerOrDepthPlane) : 0;
+    return VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT,
+                                    region.mipLevel,
+                                    is3D ? 0 : region.layerOrDepthPlane, 1};
+  };
+  int32 srcZ, dstZ;
+  VkImageBlit region{.srcSubresource = subresource(*srcTexture, src, srcZ),
+                     .dstSubresource = subresource(*dstTexture, dst, dstZ)};
+  region.srcOffsets[0] = {static_cast<int32>(src.x), static_cast<int32>(src.y),
+                          srcZ};
+  region.srcOffsets[1] = {static_cast<int32>(src.x + src.width),
+                          static_cast<int32>(src.y + src.height), srcZ + 1};
+  region.dstOffsets[0] = {static_cast<int32>(dst.x), static_cast<int32>(dst.y),
+                          dstZ};
+  region.dstOffsets[1] = {static_cast<int32>(dst.x + dst.width),
+                          static_cast<int32>(dst.y + dst.height), dstZ + 1};
+  auto srcLayer = region.srcSubresource.baseArrayLayer;
+  auto dstLayer = region.dstSubresource.baseArrayLayer;
+  TransitionTexture(*srcTexture, srcTexture->GetRestLayout(),
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, src.mipLevel, 1,
+                    srcLayer, 1);
+  TransitionTexture(*dstTexture, dstTexture->GetRestLayout(),
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, dst.mipLevel, 1,
+                    dstLayer, 1);
+  vkCmdBlitImage(context.commandBuffer, srcTexture->GetNative(),
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstTexture->GetNative(),
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+                 convert::FilterFrom(blitInfo.filter));
+  TransitionTexture(*srcTexture, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    srcTexture->GetRestLayout(), src.mipLevel, 1, srcLayer,
+                    1);
+  TransitionTexture(*dstTexture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    dstTexture->GetRestLayout(), dst.mipLevel, 1, dstLayer,
+                    1);
+}
+
+void RenderPass::BindGraphicsPipeline(Ptr<px::GraphicsPipeline> pipeline) {
+  this->pipeline = DownCast<GraphicsPipeline>(pipeline).get();
+  vkCmdBindPipeline(commandBuffer.GetNative(),
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    this->pipeline->GetNative());
+  // Sets stay compatible across pipelines, but new ones may read more
+  samplersDirty = true;
+  uniformSets[0] = uniformSets[1] = VK_NULL_HANDLE;
+  // Set layouts below the table differ between pipelines, which disturbs it
+  bindlessDirty = true;
+}
+void RenderPass::BindVertexBuffers(uint32 startSlot,
+                                   const Array<BufferBinding> &bindings) {
+  VkBuffer buffers[MAX_VERTEX_BUFFERS];
+  VkDeviceSize offsets[MAX_VERTEX_BUFFERS];
+  assert(bindings.size() <= MAX_VERTEX_BUFFERS);
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    buffers[i] = DownCast<Buffer>(bindings[i].buffer)->GetNative();
+    offsets[i] = bindings[i].offset;
+  }
+  vkCmdBindVertexBuffers(commandBuffer.GetNative(), startSlot,
+                         static_cast<uint32>(bindings.size()), buffers,
+                         offsets);
+}
+void RenderPass::BindIndexBuffer(const BufferBinding &binding,
+                                 IndexElementSize indexElementSize) {
+  vkCmdBindIndexBuffer(commandBuffer.GetNative(),
+                       DownCast<Buffer>(binding.buffer)->GetNative(),
+                       binding.offset,
+                       indexElementSize == IndexElementSize::Uint16
+                           ? VK_INDEX_TYPE_UINT16
+                           : VK_INDEX_TYPE_UINT32);
+}
+void RenderPass::BindFragmentSamplers(
+    uint32 startSlot, const Array<TextureSamplerBinding> &bindings) {
+  assert(startSlot + bindings.size() <= MAX_SAMPLERS);
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    auto texture = DownCast<Texture>(bindings[i].texture);
+    samplers[startSlot + i] = {
+        .sampler = DownCast<Sampler>(bindings[i].sampler)->GetNative(),
+        .imageView = texture->GetView(),
+        .imageLayout = texture->GetRestLayout(),
+    };
+  }
+  samplersDirty = true;
+}
+void RenderPass::BindBindlessTable(Ptr<px::BindlessTable> bindlessTable) {
+  this->bindlessTable = DownCast<BindlessTable>(bindlessTable);
+  bindlessDirty = true;
+}
+void RenderPass::SetViewport(const Viewport &viewport) {
+  // Flipped like SDL_gpu, so that clip space points up on every backend
+  VkViewport vp{
+      .x = viewport.x,
+      .y = viewport.y + viewport.height,
+      .width = viewport.width,
+      .height = -viewport.height,
+      .minDepth = viewport.minDepth,
+      .maxDepth = viewport.maxDepth,
+  };
+  vkCmdSetViewport(commandBuffer.GetNative(), 0, 1, &vp);
+}
+void RenderPass::SetScissor(int32 x, int32 y, int32 width, int32 height) {
+  VkRect2D rect{{x, y},
+                {static_cast<uint32>(width), static_cast<uint32>(height)}};
+  vkCmdSetScissor(commandBuffer.GetNative(), 0, 1, &rect);
+}
+bool RenderPass::PrepareDraw() {
+  if (pipeline == nullptr) {
+    assert(false && "No graphics pipeline bound");
+    return false;
+  }
+  auto cmd = commandBuffer.GetNative();
+  auto layout = pipeline->GetLayout();
+  if (pipeline->usesBindlessTable && bindlessDirty) {
+    if (bindlessTable == nullptr) {
+      assert(false && "No bindless table bound");
+      return false;
+    }
+    auto set = bindlessTable->GetNative();
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout,
+                            BINDLESS_DESCRIPTOR_SET, 1, &set, 0, nullptr);
+    bindlessDirty = false;
+  }
+  if (samplersDirty && pipeline->numFragmentSamplers > 0) {
+    auto set = commandBuffer.AllocateDescriptorSet(pipeline->setLayouts[2]);
+    if (set == VK_NULL_HANDLE) {
+      return false;
+    }
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = 0,
+        .descriptorCount = pipeline->numFragmentSamplers,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = samplers,
+    };
+    vkUpdateDescriptorSets(commandBuffer.GetDevice().GetNative(), 1, &write,
+                           0, nullptr);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 2,
+                            1, &set, 0, nullptr);
+  }
+  samplersDirty = false;
+
+  // Uniform sets point at whole blocks, and pushes only move the dynamic
+  // offsets. New sets are needed only when a slot moves to another block.
+  const uint32 numUniformBuffers[2] = {pipeline->numVertexUniformBuffers,
+                                       pipeline->numFragmentUniformBuffers};
+  commandBuffer.EnsureUniforms(
+      std::max(numUniformBuffers[0], numUniformBuffers[1]));
+  bool rebind = uniformVersion != commandBuffer.GetUniformVersion();
+  const auto *slots = commandBuffer.GetUniformSlots();
+  for (uint32 stage = 0; stage < 2; ++stage) {
+    auto count = numUniformBuffers[stage];
+    if (count == 0) {
+      continue;
+    }
+    bool stale = uniformSets[stage] == VK_NULL_HANDLE;
+    for (uint32 slot = 0; slot < count; ++slot) {
+      stale |= uniformSetBuffers[stage][slot] != slots[slot].buffer;
+    }
+    if (stale) {
+      auto set = commandBuffer.AllocateDescriptorSet(
+          pipeline->setLayouts[stage == 0 ? 1 : 3]);
+      if (set == VK_NULL_HANDLE) {
+        return false;
+      }
+      VkDescriptorBufferInfo bufferInfos[MAX_UNIFORM_BUFFERS];
+      for (uint32 slot = 0; slot < count; ++slot) {
+        bufferInfos[slot] = {slots[slot].buffer, 0, MAX_UNIFORM_SIZE};
+        uniformSetBuffers[stage][slot] = slots[slot].buffer;
+      }
+      VkWriteDescriptorSet write{
+          .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+          .dstSet = set,
+          .dstBinding = 0,
+          .descriptorCount = count,
+          .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+          .pBufferInfo = bufferInfos,
+      };
+      vkUpdateDescriptorSets(commandBuffer.GetDevice().GetNative(), 1, &write,
+                             0, nullptr);
+      uniformSets[stage] = set;
+    }
+    if (stale || rebind) {
+      uint32 offsets[MAX_UNIFORM_BUFFERS];
+      for (uint32 slot = 0; slot < count; ++slot) {
+        offsets[slot] = slots[slot].offset;
+      }
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout,
+                              stage == 0 ? 1 : 3, 1, &uniformSets[stage],
+                              count, offsets);
+    }
+  }
+  uniformVersion = commandBuffer.GetUniformVersion();
+  return true;
+}
+void RenderPass::DrawPrimitives(uint32 vertexCount, uint32 instanceCount,
+                                uint32 firstVertex, uint32 firstInstance) {
+  if (PrepareDraw()) {
+    vkCmdDraw(commandBuffer.GetNative(), vertexCount, instanceCount,
+              firstVertex, firstInstance);
+  }
+}
+void RenderPass::DrawIndexedPrimitives(uint32 indexCount, uint32 instanceCount,
+                                       uint32 firstIndex, uint32 vertexOffset,
+                                       uint32 firstInstance) {
+  if (PrepareDraw()) {
+    vkCmdDrawIndexed(commandBuffer.GetNative(), indexCount, instanceCount,
+                     firstIndex, static_cast<int32>(vertexOffset),
+                     firstInstance);
+  }
+}
+} // namespace paranoixa::vulkan
+#endif // EMSCRIPTEN
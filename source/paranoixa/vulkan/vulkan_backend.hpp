@@ -0,0 +1,658 @@
+#ifndef EMSCRIPTEN
+#ifndef PARANOIXA_VULKAN_BACKEND_HPP
+#define PARANOIXA_VULKAN_BACKEND_HPP
+#include <paranoixa.hpp>
+
+#include <volk.h>
+
+#include "vma.hpp"
+
+#include <chrono>
+#include <mutex>
+
+struct SDL_Window;
+
+namespace paranoixa::vulkan {
+namespace px = paranoixa;
+// Resource limits of one shader stage, the same as SDL_gpu
+constexpr uint32 MAX_SAMPLERS = 16;
+constexpr uint32 MAX_UNIFORM_BUFFERS = 4;
+// Bytes visible through one uniform buffer slot
+constexpr uint32 MAX_UNIFORM_SIZE = 4096;
+// Block sizes of the custom memory pools. Larger allocations fall back to
+// the default pools.
+constexpr VkDeviceSize STAGING_BLOCK_SIZE = 64ull * 1024 * 1024;
+constexpr VkDeviceSize RENDER_TARGET_BLOCK_SIZE = 256ull * 1024 * 1024;
+// Bytes and render targets moved by one defragmentation pass at most, which
+// bounds the GPU time of its copies
+constexpr VkDeviceSize DEFRAGMENTATION_BYTES_PER_PASS = 64ull * 1024 * 1024;
+constexpr uint32 DEFRAGMENTATION_MOVES_PER_PASS = 32;
+
+/**
+ * @brief Native objects behind one px::CommandBuffer. They are reset and
+ * reused once the GPU has finished with them.
+ */
+struct CommandContext {
+  struct UniformBlock {
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    std::byte *mapped;
+  };
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  // Records the initial layouts of textures created since the last submit
+  VkCommandBuffer setupCommandBuffer = VK_NULL_HANDLE;
+  VkFence fence = VK_NULL_HANDLE;
+  VkSemaphore acquireSemaphore = VK_NULL_HANDLE;
+  Array<VkDescriptorPool> descriptorPools{std::pmr::new_delete_resource()};
+  uint32 descriptorPoolIndex = 0;
+  Array<UniformBlock> uniformBlocks{std::pmr::new_delete_resource()};
+  uint32 uniformBlockIndex = 0;
+  uint32 uniformOffset = 0;
+  // Order of acquisition. Resources released while a command buffer is
+  // pending are destroyed once every older command buffer has completed.
+  std::uint64_t serial = 0;
+  // Index of the acquired swapchain image, UINT32_MAX if none
+  uint32 swapchainImageIndex = UINT32_MAX;
+};
+
+class Texture;
+class Device : public px::Device {
+public:
+  Device(const CreateInfo &createInfo);
+  virtual ~Device() override;
+  /**
+   * @brief Create the instance, pick a physical device and create the
+   * logical device. Without a video subsystem, the device runs headless.
+   * @return false if no device supports Vulkan 1.3 with dynamic rendering
+   * and synchronization2
+   */
+  bool Initialize();
+
+  VkDevice GetNative() const { return device; }
+  VmaAllocator GetMemoryAllocator() const { return memoryAllocator; }
+  const VkPhysicalDeviceProperties &GetProperties() const {
+    return properties;
+  }
+  VkPipelineCache GetPipelineCache() const { return pipelineCache; }
+  // Linear pool for transfer buffers, VK_NULL_HANDLE if it is unavailable
+  VmaPool GetStagingPool() const { return stagingPool; }
+  // VK_NULL_HANDLE if the device does not support bindless tables
+  VkDescriptorSetLayout GetBindlessSetLayout() const {
+    return bindlessSetLayout;
+  }
+
+  virtual void ClaimWindow(void *window) override;
+  virtual bool ClaimOffscreen(uint32 width, uint32 height) override;
+  virtual Ptr<px::Buffer>
+  CreateBuffer(const Buffer::CreateInfo &createInfo) override;
+  virtual Ptr<px::Texture>
+  CreateTexture(const px::Texture::CreateInfo &createInfo) override;
+  virtual Ptr<px::Sampler>
+  CreateSampler(const Sampler::CreateInfo &createInfo) override;
+  virtual Ptr<px::TransferBuffer>
+  CreateTransferBuffer(const TransferBuffer::CreateInfo &createInfo) override;
+  virtual Ptr<px::Shader>
+  CreateShader(const Shader::CreateInfo &createInfo) override;
+  virtual Ptr<px::BindlessTable>
+  CreateBindlessTable(const BindlessTable::CreateInfo &createInfo) override;
+  virtual Ptr<px::CommandBuffer>
+  AcquireCommandBuffer(const CommandBuffer::CreateInfo &createInfo) override;
+  virtual Ptr<px::GraphicsPipeline> CreateGraphicsPipeline(
+      const GraphicsPipeline::CreateInfo &createInfo) override;
+  virtual Ptr<px::ComputePipeline>
+  CreateComputePipeline(const ComputePipeline::CreateInfo &createInfo) override;
+  virtual void
+  SubmitCommandBuffer(Ptr<px::CommandBuffer> commandBuffer) override;
+  virtual Ptr<px::Fence> SubmitCommandBufferAndAcquireFence(
+      Ptr<px::CommandBuffer> commandBuffer) override;
+  virtual bool QueryFence(Ptr<px::Fence> fence) override;
+  virtual void WaitForFences(const Array<Ptr<px::Fence>> &fences,
+                             bool waitAll) override;
+  virtual Ptr<px::Texture>
+  AcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer) override;
+  virtual Ptr<px::Texture>
+  TryAcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer) override;
+  virtual px::TextureFormat GetSwapchainFormat() const override;
+  virtual void WaitForGPUIdle() override;
+  virtual bool GetMemoryBudgets(Array<MemoryHeapBudget> &budgets) override;
+  virtual void DefragmentMemory(float timeBudgetMs) override;
+  virtual String GetDriver() const override;
+
+  /**
+   * @brief Native handles destroyed once no pending command buffer can
+   * reference them
+   */
+  struct Garbage {
+    std::uint64_t serial = 0;
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkImageView targetView = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  };
+  void Release(Garbage garbage);
+  /**
+   * @brief Release the native objects of texture. They are read under the
+   * lock, because a defragmentation pass may relocate the texture until then.
+   */
+  void ReleaseTexture(const Texture &texture);
+  /**
+   * @return true if a command buffer acquired at serial or later may still
+   * be executing
+   */
+  bool IsPending(std::uint64_t serial);
+  // Serial of the most recently acquired command buffer
+  std::uint64_t GetLatestSerial();
+  /**
+   * @brief Shared by every pipeline, so descriptor sets stay compatible
+   * across pipeline changes
+   */
+  VkDescriptorSetLayout GetSetLayout(VkShaderStageFlagBits stage,
+                                     VkDescriptorType type, uint32 count);
+  void ReleaseContext(CommandContext &&context);
+  bool CreateUniformBlock(CommandContext::UniformBlock &block);
+  VkDescriptorPool CreateDescriptorPool();
+  /**
+   * @brief Keep the texture in place while a bindless table refers to its
+   * view
+   * @return the view to write into the table
+   */
+  VkImageView PinTexture(const Ptr<px::Texture> &texture);
+  void UnpinTexture(const Ptr<px::Texture> &texture);
+
+private:
+  std::uint64_t Submit(Ptr<px::CommandBuffer> commandBuffer);
+  bool CreateContext(CommandContext &context);
+  void ResetContext(CommandContext &context);
+  void DestroyContext(CommandContext &context);
+  void DestroyGarbage(const Garbage &garbage);
+  // The caller holds mutex
+  void Collect();
+  std::uint64_t GetOldestPendingSerial() const;
+  void RecordInitialLayouts(CommandContext &context);
+  bool CreateBindlessSetLayout();
+  bool CreateStagingPool();
+  VmaPool GetRenderTargetPool(const VkImageCreateInfo &imageCI);
+  bool CreateTextureViews(const px::Texture::CreateInfo &createInfo,
+                          VkImage image, VkImageView &view,
+                          VkImageView &targetView);
+  // The caller holds mutex
+  bool ShouldDefragment(VmaPool pool);
+  void RelocateTextures(VmaDefragmentationPassMoveInfo &pass,
+                        std::chrono::steady_clock::time_point deadline);
+  bool RecreateSwapchain();
+  void DestroySwapchain();
+  void ReleaseOffscreenTargets();
+  // Release with mutex held by the caller
+  void ReleaseLocked(Garbage entry);
+  Ptr<px::Texture> AcquireSwapchainTexture(Ptr<px::CommandBuffer> commandBuffer,
+                                           bool wait);
+  Ptr<px::Texture> AcquireOffscreenTarget(CommandContext &context,
+                                          Allocator *allocator, bool wait);
+  // Wait for the command buffers up to serial. The caller holds mutex.
+  // Returns false if they did not complete within timeout nanoseconds.
+  bool WaitForSerial(std::uint64_t serial, std::uint64_t timeout = UINT64_MAX);
+  void LoadPipelineCache();
+  void SavePipelineCache();
+
+  VkInstance instance;
+  VkPhysicalDevice physicalDevice;
+  VkPhysicalDeviceProperties properties;
+  VkPhysicalDeviceFeatures features;
+  VkDevice device;
+  uint32 queueFamilyIndex;
+  VkQueue queue;
+  VmaAllocator memoryAllocator;
+  std::uint32_t frameIndex;
+  VmaPool stagingPool;
+  VkPipelineCache pipelineCache;
+  VkDescriptorSetLayout bindlessSetLayout;
+  bool hasSurfaceSupport;
+  bool loadedVulkanLibrary;
+
+  SDL_Window *window;
+  VkSurfaceKHR surface;
+  VkSurfaceFormatKHR surfaceFormat;
+  VkPresentModeKHR presentMode;
+  VkSwapchainKHR swapchain;
+  VkExtent2D swapchainExtent;
+  bool swapchainOutOfDate;
+  Array<VkImage> swapchainImages;
+  Array<VkImageView> swapchainViews;
+  // Signaled by the submit that renders into the image, waited on by present
+  Array<VkSemaphore> presentSemaphores;
+  // Serials of the command buffers that acquired the latest swapchain
+  // images, one per frame in flight. Acquiring waits for the oldest.
+  Array<std::uint64_t> frameSerials;
+  uint32 frameSerialIndex;
+  // Stand in for the swapchain when no window is claimed, one per frame in
+  // flight
+  struct OffscreenTarget {
+    VkImage image = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkImageView targetView = VK_NULL_HANDLE;
+    // Serial of the command buffer that acquired the target last
+    std::uint64_t serial = 0;
+  };
+  px::Texture::CreateInfo offscreenInfo;
+  Array<OffscreenTarget> offscreenTargets;
+  uint32 offscreenIndex;
+
+  // Guards the queue and everything below. Device-internal containers use
+  // the thread-safe new_delete_resource, because resources are released
+  // and pipelines are created from worker threads.
+  std::mutex mutex;
+  std::uint64_t nextSerial;
+  Array<std::uint64_t> openSerials;
+  Array<CommandContext> pendingContexts;
+  // Serials of pending contexts whose fences are waited on without the lock.
+  // They stay pending until the wait returns.
+  Array<std::uint64_t> pinnedSerials;
+  Array<CommandContext> freeContexts;
+  struct InitialLayout {
+    VkImage image;
+    VkImageAspectFlags aspect;
+    VkImageLayout layout;
+  };
+  Array<InitialLayout> initialLayouts;
+  Array<Garbage> garbage;
+
+  // Render targets come and go with resolution and quality changes, so they
+  // get pools of their own which defragmentation compacts. One per memory
+  // type, in creation order.
+  struct RenderTargetPool {
+    uint32 memoryTypeIndex;
+    VmaPool pool;
+  };
+  Array<RenderTargetPool> renderTargetPools;
+  // Set when a render target is released, the only time a pool can become
+  // fragmented
+  bool defragmentationRequested;
+  uint32 defragmentationPoolIndex;
+  VmaDefragmentationContext defragmentation;
+  VmaDefragmentationPassMoveInfo defragmentationPass;
+  // Serial from which on the copies of the open pass have completed, 0 if
+  // no pass is open
+  std::uint64_t defragmentationSerial;
+
+  std::mutex setLayoutMutex;
+  HashMap<uint32, VkDescriptorSetLayout> setLayouts;
+};
+
+class Texture : public px::Texture {
+public:
+  Texture(const CreateInfo &createInfo, const Ptr<Device> &device,
+          VkImage image, VmaAllocation allocation, VkImageView view,
+          VkImageView targetView, bool isSwapchainTexture = false,
+          bool isBorrowed = false);
+  virtual ~Texture() override;
+
+  inline VkImage GetNative() const { return image; }
+  inline VmaAllocation GetAllocation() const { return allocation; }
+  inline VkImageView GetView() const { return view; }
+  // Level 0 and layer 0 as a 2D view, for use as a render target
+  inline VkImageView GetTargetView() const { return targetView; }
+  inline VkImageAspectFlags GetAspect() const { return aspect; }
+  /**
+   * @brief Layout of the texture between operations. Every command moves
+   * the texture out of it and back, so recording needs no layout tracking.
+   */
+  inline VkImageLayout GetRestLayout() const { return restLayout; }
+  static VkImageLayout GetRestLayout(TextureUsage usage);
+  /**
+   * @brief Point the texture at a copy of its image made by
+   * defragmentation. The allocation stays the same.
+   */
+  void Relocate(VkImage image, VkImageView view, VkImageView targetView);
+
+  // Bindless table slots referring to the view, guarded by the device mutex
+  uint32 numPins = 0;
+
+private:
+  Ptr<Device> device;
+  VkImage image;
+  VmaAllocation allocation;
+  VkImageView view;
+  VkImageView targetView;
+  VkImageAspectFlags aspect;
+  VkImageLayout restLayout;
+  bool isSwapchainTexture;
+  // The device owns the native objects, offscreen targets for example
+  bool isBorrowed;
+};
+
+class Sampler : public px::Sampler {
+public:
+  Sampler(const CreateInfo &createInfo, const Ptr<Device> &device,
+          VkSampler sampler)
+      : px::Sampler(createInfo), device(device), sampler(sampler) {}
+  ~Sampler() override;
+
+  inline VkSampler GetNative() const { return sampler; }
+
+private:
+  Ptr<Device> device;
+  VkSampler sampler;
+};
+
+class TransferBuffer : public px::TransferBuffer {
+public:
+  TransferBuffer(const CreateInfo &createInfo, const Ptr<Device> &device);
+  ~TransferBuffer() override;
+
+  bool CreateBacking();
+  inline VkBuffer GetNative() const { return backings[current].buffer; }
+  /**
+   * @brief Note that the command buffer of serial reads or writes the
+   * current backing, so Map(true) moves on to another one
+   */
+  void MarkUsed(std::uint64_t serial);
+
+  void *Map(bool cycle) override;
+  void Unmap() override;
+
+private:
+  struct Backing {
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    void *mapped;
+    std::uint64_t lastUsedSerial;
+  };
+  Ptr<Device> device;
+  Array<Backing> backings;
+  uint32 current;
+};
+
+class Buffer : public px::Buffer {
+public:
+  Buffer(const CreateInfo &createInfo, const Ptr<Device> &device,
+         VkBuffer buffer, VmaAllocation allocation)
+      : px::Buffer(createInfo), device(device), buffer(buffer),
+        allocation(allocation) {}
+  ~Buffer() override;
+
+  inline VkBuffer GetNative() const { return buffer; }
+
+private:
+  Ptr<Device> device;
+  VkBuffer buffer;
+  VmaAllocation allocation;
+};
+
+class Fence : public px::Fence {
+public:
+  Fence(const Ptr<Device> &device, std::uint64_t serial)
+      : px::Fence(), device(device), serial(serial) {}
+
+  inline std::uint64_t GetSerial() const { return serial; }
+
+private:
+  Ptr<Device> device;
+  std::uint64_t serial;
+};
+
+class Backend : public px::Backend {
+public:
+  virtual Ptr<px::Device>
+  CreateDevice(const px::Device::CreateInfo &createInfo) override;
+};
+
+class Shader : public px::Shader {
+public:
+  Shader(const CreateInfo &createInfo, const Ptr<Device> &device,
+         VkShaderModule shaderModule);
+  ~Shader() override;
+
+  inline VkShaderModule GetNative() const { return shaderModule; }
+  inline const char *GetEntrypoint() const { return entrypoint.c_str(); }
+  inline ShaderStage GetStage() const { return stage; }
+  inline const Array<SpecializationConstant> &
+  GetSpecializationConstants() const {
+    return specializationConstants;
+  }
+
+  uint32 numSamplers;
+  uint32 numStorageTextures;
+  uint32 numStorageBuffers;
+  uint32 numUniformBuffers;
+  bool usesBindlessTable;
+
+private:
+  Ptr<Device> device;
+  VkShaderModule shaderModule;
+  String entrypoint;
+  ShaderStage stage;
+  Array<SpecializationConstant> specializationConstants;
+};
+
+class BindlessTable : public px::BindlessTable {
+public:
+  BindlessTable(const CreateInfo &createInfo, const Ptr<Device> &device,
+                VkDescriptorPool pool, VkDescriptorSet set);
+  ~BindlessTable() override;
+
+  inline VkDescriptorSet GetNative() const { return set; }
+
+  uint32 RegisterTexture(Ptr<px::Texture> texture) override;
+  uint32 RegisterSampler(Ptr<px::Sampler> sampler) override;
+  uint32 RegisterBuffer(Ptr<px::Buffer> buffer) override;
+  void UnregisterTexture(uint32 index) override;
+  void UnregisterSampler(uint32 index) override;
+  void UnregisterBuffer(uint32 index) override;
+
+private:
+  /**
+   * @brief Indices of one binding. Unregistered indices are retired until
+   * every command buffer that may read them has completed.
+   */
+  template <typename T> struct Slots {
+    struct Retired {
+      uint32 index;
+      std::uint64_t serial;
+    };
+    Slots(uint32 capacity, Allocator *allocator)
+        : capacity(capacity), resources(allocator), free(allocator),
+          retired(allocator) {}
+    uint32 capacity;
+    // Held so that registered resources outlive the descriptors
+    Array<Ptr<T>> resources;
+    Array<uint32> free;
+    Array<Retired> retired;
+  };
+  // The caller holds mutex
+  template <typename T> uint32 Allocate(Slots<T> &slots, Ptr<T> resource);
+  template <typename T> void Retire(Slots<T> &slots, uint32 index);
+  void Write(uint32 binding, uint32 index, VkDescriptorType type,
+             const VkDescriptorImageInfo *imageInfo,
+             const VkDescriptorBufferInfo *bufferInfo);
+
+  Ptr<Device> device;
+  VkDescriptorPool pool;
+  VkDescriptorSet set;
+  std::mutex mutex;
+  Slots<px::Texture> textures;
+  Slots<px::Sampler> samplers;
+  Slots<px::Buffer> buffers;
+};
+
+class CommandBuffer;
+class CopyPass : public px::CopyPass {
+public:
+  CopyPass(CommandBuffer &commandBuffer)
+      : px::CopyPass(), commandBuffer(commandBuffer) {}
+
+  virtual void UploadTexture(const TextureTransferInfo &src,
+                             const TextureRegion &dst, bool cycle) override;
+  virtual void DownloadTexture(const TextureRegion &src,
+                               const TextureTransferInfo &dst) override;
+  virtual void UploadBuffer(const BufferTransferInfo &src,
+                            const BufferRegion &dst, bool cycle) override;
+  virtual void DownloadBuffer(const BufferRegion &src,
+                              const BufferTransferInfo &dst) override;
+
+  virtual void CopyTexture(const TextureLocation &src,
+                           const TextureLocation &dst, uint32 width,
+                           uint32 height, uint32 depth, bool cycle) override;
+
+private:
+  CommandBuffer &commandBuffer;
+};
+
+class GraphicsPipeline;
+class RenderPass : public px::RenderPass {
+public:
+  RenderPass(Allocator *allocator, CommandBuffer &commandBuffer,
+             const Array<Ptr<px::Texture>> &targets)
+      : px::RenderPass(), allocator(allocator), commandBuffer(commandBuffer),
+        targets(targets, allocator), pipeline(nullptr), samplers(),
+        samplersDirty(true), uniformSets(), uniformSetBuffers(),
+        uniformVersion(0), bindlessTable(nullptr), bindlessDirty(true) {}
+
+  inline const Array<Ptr<px::Texture>> &GetTargets() const { return targets; }
+
+  void BindGraphicsPipeline(Ptr<px::GraphicsPipeline> pipeline) override;
+  void BindVertexBuffers(uint32 startSlot,
+                         const Array<BufferBinding> &bindings) override;
+  void BindIndexBuffer(const BufferBinding &binding,
+                       IndexElementSize indexElementSize) override;
+  void
+  BindFragmentSamplers(uint32 startSlot,
+                       const Array<TextureSamplerBinding> &bindings) override;
+  void BindBindlessTable(Ptr<px::BindlessTable> bindlessTable) override;
+  void SetViewport(const Viewport &viewport) override;
+  void SetScissor(int32 x, int32 y, int32 width, int32 height) override;
+  void DrawPrimitives(uint32 vertexCount, uint32 instanceCount,
+                      uint32 firstVertex, uint32 firstInstance) override;
+  void DrawIndexedPrimitives(uint32 indexCount, uint32 instanceCount,
+                             uint32 firstIndex, uint32 vertexOffset,
+                             uint32 firstInstance) override;
+
+private:
+  // Bind the descriptor sets the pipeline reads
+  bool PrepareDraw();
+
+  Allocator *allocator;
+  CommandBuffer &commandBuffer;
+  // Color targets followed by the depth stencil target
+  Array<Ptr<px::Texture>> targets;
+  GraphicsPipeline *pipeline;
+  VkDescriptorImageInfo samplers[MAX_SAMPLERS];
+  bool samplersDirty;
+  // Indexed by 0 for the vertex and 1 for the fragment stage
+  VkDescriptorSet uniformSets[2];
+  VkBuffer uniformSetBuffers[2][MAX_UNIFORM_BUFFERS];
+  std::uint64_t uniformVersion;
+  Ptr<BindlessTable> bindlessTable;
+  bool bindlessDirty;
+};
+
+class CommandBuffer : public px::CommandBuffer {
+public:
+  CommandBuffer(const CreateInfo &createInfo, const Ptr<Device> &device,
+                CommandContext &&context);
+  ~CommandBuffer() override;
+
+  inline VkCommandBuffer GetNative() const { return context.commandBuffer; }
+  inline std::uint64_t GetSerial() const { return context.serial; }
+  inline CommandContext &GetContext() { return context; }
+  inline Device &GetDevice() { return *device; }
+  /**
+   * @brief Hand the native objects over to the device for submission
+   */
+  CommandContext TakeContext();
+
+  Ptr<px::CopyPass> BeginCopyPass() override;
+  void EndCopyPass(Ptr<px::CopyPass> copyPass) override;
+  Ptr<px::RenderPass>
+  BeginRenderPass(const Array<px::ColorTargetInfo> &infos,
+                  const DepthStencilTargetInfo &depthStencilInfo, float r = 0.f,
+                  float g = 0.f, float b = 0.f, float a = 1.f) override;
+  void EndRenderPass(Ptr<px::RenderPass> renderPass) override;
+
+  void PushUniformData(uint32 slot, const void *data, size_t size) override;
+
+  void GenerateMipmaps(Ptr<px::Texture> texture) override;
+  void Blit(const BlitInfo &blitInfo) override;
+
+  struct UniformSlot {
+    VkBuffer buffer;
+    uint32 offset;
+  };
+  inline const UniformSlot *GetUniformSlots() const { return uniformSlots; }
+  // Incremented by every push, so passes know when to rebind
+  inline std::uint64_t GetUniformVersion() const { return uniformVersion; }
+  /**
+   * @brief Give never pushed slots below count zeroed data
+   */
+  void EnsureUniforms(uint32 count);
+  VkDescriptorSet AllocateDescriptorSet(VkDescriptorSetLayout layout);
+
+  /**
+   * @brief Move subresources of a texture between layouts. Waits on all
+   * prior commands, which the barrier batching of later work refines.
+   */
+  void TransitionTexture(const Texture &texture, VkImageLayout oldLayout,
+                         VkImageLayout newLayout, uint32 baseLevel = 0,
+                         uint32 numLevels = VK_REMAINING_MIP_LEVELS,
+                         uint32 baseLayer = 0,
+                         uint32 numLayers = VK_REMAINING_ARRAY_LAYERS);
+  void GlobalBarrier();
+
+private:
+  Ptr<Device> device;
+  CommandContext context;
+  bool submitted;
+  UniformSlot uniformSlots[MAX_UNIFORM_BUFFERS];
+  std::uint64_t uniformVersion;
+};
+
+class GraphicsPipeline : public px::GraphicsPipeline {
+public:
+  GraphicsPipeline(const CreateInfo &createInfo, const Ptr<Device> &device,
+                   VkPipeline pipeline, VkPipelineLayout layout)
+      : px::GraphicsPipeline(createInfo), setLayouts(),
+        numVertexUniformBuffers(0), numFragmentSamplers(0),
+        numFragmentUniformBuffers(0), usesBindlessTable(false), device(device),
+        pipeline(pipeline),
+        layout(layout) {}
+  ~GraphicsPipeline() override;
+
+  inline VkPipeline GetNative() const { return pipeline; }
+  inline VkPipelineLayout GetLayout() const { return layout; }
+
+  // Same sets as SDL_gpu, so shaders written for it run unchanged:
+  // 0 vertex resources, 1 vertex uniforms, 2 fragment resources and
+  // 3 fragment uniforms
+  VkDescriptorSetLayout setLayouts[4];
+  uint32 numVertexUniformBuffers;
+  uint32 numFragmentSamplers;
+  uint32 numFragmentUniformBuffers;
+  // Set BINDLESS_DESCRIPTOR_SET follows the four above
+  bool usesBindlessTable;
+
+private:
+  Ptr<Device> device;
+  VkPipeline pipeline;
+  VkPipelineLayout layout;
+};
+
+class ComputePipeline : public px::ComputePipeline {
+public:
+  ComputePipeline(const CreateInfo &createInfo, const Ptr<Device> &device)
+      : px::ComputePipeline(createInfo), device(device) {}
+  ~ComputePipeline() override {}
+
+private:
+  Ptr<Device> device;
+};
+
+} // namespace paranoixa::vulkan
+#endif // PARANOIXA_VULKAN_BACKEND_HPP
+#endif // EMSCRIPTEN
@@ -0,0 +1,337 @@
+#ifndef EMSCRIPTEN
+#include "vulkan_convert.hpp"
+namespace paranoixa::vulkan {
+namespace convert {
+VkAttachmentLoadOp LoadOpFrom(LoadOp loadOp) {
+  switch (loadOp) {
+  case LoadOp::Clear:
+    return VK_ATTACHMENT_LOAD_OP_CLEAR;
+  case LoadOp::Load:
+    return VK_ATTACHMENT_LOAD_OP_LOAD;
+  case LoadOp::DontCare:
+    return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  }
+  return VK_ATTACHMENT_LOAD_OP_LOAD;
+}
+VkAttachmentStoreOp StoreOpFrom(StoreOp storeOp) {
+  switch (storeOp) {
+  case StoreOp::Store:
+    return VK_ATTACHMENT_STORE_OP_STORE;
+  case StoreOp::DontCare:
+    return VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  }
+  return VK_ATTACHMENT_STORE_OP_STORE;
+}
+VkPolygonMode FillModeFrom(FillMode fillMode) {
+  switch (fillMode) {
+  case FillMode::Fill:
+    return VK_POLYGON_MODE_FILL;
+  case FillMode::Line:
+    return VK_POLYGON_MODE_LINE;
+  default:
+    assert(false && "Invalid fill mode");
+    return VK_POLYGON_MODE_FILL;
+  }
+}
+VkCullModeFlags CullModeFrom(CullMode cullMode) {
+  switch (cullMode) {
+  case CullMode::None:
+    return VK_CULL_MODE_NONE;
+  case CullMode::Front:
+    return VK_CULL_MODE_FRONT_BIT;
+  case CullMode::Back:
+    return VK_CULL_MODE_BACK_BIT;
+  }
+  return VK_CULL_MODE_NONE;
+}
+VkFrontFace FrontFaceFrom(FrontFace frontFace) {
+  switch (frontFace) {
+  case FrontFace::Clockwise:
+    return VK_FRONT_FACE_CLOCKWISE;
+  case FrontFace::CounterClockwise:
+    return VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  }
+  return VK_FRONT_FACE_CLOCKWISE;
+}
+VkPrimitiveTopology PrimitiveTypeFrom(PrimitiveType primitiveType) {
+  switch (primitiveType) {
+  case PrimitiveType::TriangleList:
+    return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  case PrimitiveType::TriangleStrip:
+    return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+  case PrimitiveType::LineList:
+    return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+  case PrimitiveType::LineStrip:
+    return VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
+  case PrimitiveType::PointList:
+    return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+  }
+  return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+}
+VkFormat TextureFormatFrom(TextureFormat textureFormat) {
+  switch (textureFormat) {
+  case TextureFormat::R8G8B8A8_UNORM:
+    return VK_FORMAT_R8G8B8A8_UNORM;
+  case TextureFormat::B8G8R8A8_UNORM:
+    return VK_FORMAT_B8G8R8A8_UNORM;
+  case TextureFormat::R32G32B32A32_FLOAT:
+    return VK_FORMAT_R32G32B32A32_SFLOAT;
+  case TextureFormat::BC1_RGBA_UNORM:
+    return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  case TextureFormat::BC3_RGBA_UNORM:
+    return VK_FORMAT_BC3_UNORM_BLOCK;
+  case TextureFormat::BC4_R_UNORM:
+    return VK_FORMAT_BC4_UNORM_BLOCK;
+  case TextureFormat::BC5_RG_UNORM:
+    return VK_FORMAT_BC5_UNORM_BLOCK;
+  case TextureFormat::BC7_RGBA_UNORM:
+    return VK_FORMAT_BC7_UNORM_BLOCK;
+  case TextureFormat::D32_FLOAT_S8_UINT:
+    return VK_FORMAT_D32_SFLOAT_S8_UINT;
+  default:
+    return VK_FORMAT_UNDEFINED;
+  }
+}
+TextureFormat TextureFormatFrom(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_R8G8B8A8_UNORM:
+    return TextureFormat::R8G8B8A8_UNORM;
+  case VK_FORMAT_B8G8R8A8_UNORM:
+    return TextureFormat::B8G8R8A8_UNORM;
+  case VK_FORMAT_R32G32B32A32_SFLOAT:
+    return TextureFormat::R32G32B32A32_FLOAT;
+  case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    return TextureFormat::D32_FLOAT_S8_UINT;
+  default:
+    return TextureFormat::Invalid;
+  }
+}
+VkFormat VertexElementFormatFrom(VertexElementFormat vertexElementFormat) {
+  switch (vertexElementFormat) {
+  case VertexElementFormat::Float1:
+    return VK_FORMAT_R32_SFLOAT;
+  case VertexElementFormat::Float2:
+    return VK_FORMAT_R32G32_SFLOAT;
+  case VertexElementFormat::Float3:
+    return VK_FORMAT_R32G32B32_SFLOAT;
+  case VertexElementFormat::Float4:
+    return VK_FORMAT_R32G32B32A32_SFLOAT;
+  case VertexElementFormat::UByte4_NORM:
+    return VK_FORMAT_R8G8B8A8_UNORM;
+  }
+  return VK_FORMAT_UNDEFINED;
+}
+VkVertexInputRate VertexInputRateFrom(VertexInputRate vertexInputRate) {
+  switch (vertexInputRate) {
+  case VertexInputRate::Vertex:
+    return VK_VERTEX_INPUT_RATE_VERTEX;
+  case VertexInputRate::Instance:
+    return VK_VERTEX_INPUT_RATE_INSTANCE;
+  }
+  return VK_VERTEX_INPUT_RATE_VERTEX;
+}
+VkImageType ImageTypeFrom(TextureType textureType) {
+  switch (textureType) {
+  case TextureType::Texture3D:
+    return VK_IMAGE_TYPE_3D;
+  default:
+    return VK_IMAGE_TYPE_2D;
+  }
+}
+VkImageViewType ImageViewTypeFrom(TextureType textureType) {
+  switch (textureType) {
+  case TextureType::Texture2D:
+    return VK_IMAGE_VIEW_TYPE_2D;
+  case TextureType::Texture2DArray:
+    return VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+  case TextureType::Texture3D:
+    return VK_IMAGE_VIEW_TYPE_3D;
+  case TextureType::Cube:
+    return VK_IMAGE_VIEW_TYPE_CUBE;
+  case TextureType::CubeArray:
+    return VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
+  }
+  return VK_IMAGE_VIEW_TYPE_2D;
+}
+VkImageUsageFlags TextureUsageFrom(TextureUsage textureUsage) {
+  // Every texture can be copied and blitted, like in SDL_gpu
+  VkImageUsageFlags usage =
+      VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  switch (textureUsage) {
+  case TextureUsage::Sampler:
+    return usage | VK_IMAGE_USAGE_SAMPLED_BIT;
+  case TextureUsage::ColorTarget:
+    return usage | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+           VK_IMAGE_USAGE_SAMPLED_BIT;
+  case TextureUsage::DepthStencilTarget:
+    return usage | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  }
+  return usage;
+}
+VkImageAspectFlags AspectFrom(TextureFormat textureFormat) {
+  if (textureFormat == TextureFormat::D32_FLOAT_S8_UINT) {
+    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+  return VK_IMAGE_ASPECT_COLOR_BIT;
+}
+VkSampleCountFlagBits SampleCountFrom(SampleCount sampleCount) {
+  switch (sampleCount) {
+  case SampleCount::x1:
+    return VK_SAMPLE_COUNT_1_BIT;
+  case SampleCount::x2:
+    return VK_SAMPLE_COUNT_2_BIT;
+  case SampleCount::x4:
+    return VK_SAMPLE_COUNT_4_BIT;
+  case SampleCount::x8:
+    return VK_SAMPLE_COUNT_8_BIT;
+  }
+  return VK_SAMPLE_COUNT_1_BIT;
+}
+VkFilter FilterFrom(Filter filter) {
+  switch (filter) {
+  case Filter::Nearest:
+    return VK_FILTER_NEAREST;
+  case Filter::Linear:
+    return VK_FILTER_LINEAR;
+  }
+  return VK_FILTER_NEAREST;
+}
+VkSamplerMipmapMode MipmapModeFrom(MipmapMode mipmapMode) {
+  switch (mipmapMode) {
+  case MipmapMode::Nearest:
+    return VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  case MipmapMode::Linear:
+    return VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  }
+  return VK_SAMPLER_MIPMAP_MODE_NEAREST;
+}
+VkSamplerAddressMode AddressModeFrom(AddressMode addressMode) {
+  switch (addressMode) {
+  case AddressMode::Repeat:
+    return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  case AddressMode::MirroredRepeat:
+    return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+  case AddressMode::ClampToEdge:
+    return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  }
+  return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+}
+VkCompareOp CompareOpFrom(CompareOp compareOp) {
+  switch (compareOp) {
+  case CompareOp::Never:
+    return VK_COMPARE_OP_NEVER;
+  case CompareOp::Less:
+    return VK_COMPARE_OP_LESS;
+  case CompareOp::Equal:
+    return VK_COMPARE_OP_EQUAL;
+  case CompareOp::LessOrEqual:
+    return VK_COMPARE_OP_LESS_OR_EQUAL;
+  case CompareOp::Greater:
+    return VK_COMPARE_OP_GREATER;
+  case CompareOp::NotEqual:
+    return VK_COMPARE_OP_NOT_EQUAL;
+  case CompareOp::GreaterOrEqual:
+    return VK_COMPARE_OP_GREATER_OR_EQUAL;
+  case CompareOp::Always:
+    return VK_COMPARE_OP_ALWAYS;
+  default:
+    return VK_COMPARE_OP_NEVER;
+  }
+}
+VkStencilOp StencilOpFrom(StencilOp op) {
+  switch (op) {
+  case StencilOp::Keep:
+    return VK_STENCIL_OP_KEEP;
+  case StencilOp::Zero:
+    return VK_STENCIL_OP_ZERO;
+  case StencilOp::Replace:
+    return VK_STENCIL_OP_REPLACE;
+  case StencilOp::IncrementAndClamp:
+    return VK_STENCIL_OP_INCREMENT_AND_CLAMP;
+  case StencilOp::DecrementAndClamp:
+    return VK_STENCIL_OP_DECREMENT_AND_CLAMP;
+  case StencilOp::Invert:
+    return VK_STENCIL_OP_INVERT;
+  case StencilOp::IncrementAndWrap:
+    return VK_STENCIL_OP_INCREMENT_AND_WRAP;
+  case StencilOp::DecrementAndWrap:
+    return VK_STENCIL_OP_DECREMENT_AND_WRAP;
+  default:
+    return VK_STENCIL_OP_KEEP;
+  }
+}
+VkBufferUsageFlags BufferUsageFrom(BufferUsage bufferUsage) {
+  VkBufferUsageFlags usage =
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  switch (bufferUsage) {
+  case BufferUsage::Vertex:
+    return usage | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  case BufferUsage::Index:
+    return usage | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+  case BufferUsage::Indirect:
+    return usage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+  case BufferUsage::Storage:
+    return usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  }
+  return usage;
+}
+VkBlendFactor BlendFactorFrom(BlendFactor blendFactor) {
+  switch (blendFactor) {
+  case BlendFactor::Zero:
+    return VK_BLEND_FACTOR_ZERO;
+  case BlendFactor::One:
+    return VK_BLEND_FACTOR_ONE;
+  case BlendFactor::SrcColor:
+    return VK_BLEND_FACTOR_SRC_COLOR;
+  case BlendFactor::OneMinusSrcColor:
+    return VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+  case BlendFactor::DstColor:
+    return VK_BLEND_FACTOR_DST_COLOR;
+  case BlendFactor::OneMinusDstColor:
+    return VK_BLEND_FACTOR_ONE_MINUS_DST_COLOR;
+  case BlendFactor::SrcAlpha:
+    return VK_BLEND_FACTOR_SRC_ALPHA;
+  case BlendFactor::OneMinusSrcAlpha:
+    return VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  case BlendFactor::DstAlpha:
+    return VK_BLEND_FACTOR_DST_ALPHA;
+  case BlendFactor::OneMinusDstAlpha:
+    return VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA;
+  case BlendFactor::ConstantColor:
+    return VK_BLEND_FACTOR_CONSTANT_COLOR;
+  case BlendFactor::OneMinusConstantColor:
+    return VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR;
+  case BlendFactor::SrcAlphaSaturate:
+    return VK_BLEND_FACTOR_SRC_ALPHA_SATURATE;
+  }
+  return VK_BLEND_FACTOR_ZERO;
+}
+VkBlendOp BlendOpFrom(BlendOp blendOp) {
+  switch (blendOp) {
+  case BlendOp::Add:
+    return VK_BLEND_OP_ADD;
+  case BlendOp::Subtract:
+    return VK_BLEND_OP_SUBTRACT;
+  case BlendOp::ReverseSubtract:
+    return VK_BLEND_OP_REVERSE_SUBTRACT;
+  case BlendOp::Min:
+    return VK_BLEND_OP_MIN;
+  case BlendOp::Max:
+    return VK_BLEND_OP_MAX;
+  }
+  return VK_BLEND_OP_ADD;
+}
+VkPresentModeKHR PresentModeFrom(PresentMode presentMode) {
+  switch (presentMode) {
+  case PresentMode::Fifo:
+    return VK_PRESENT_MODE_FIFO_KHR;
+  case PresentMode::Mailbox:
+    return VK_PRESENT_MODE_MAILBOX_KHR;
+  case PresentMode::Immediate:
+    return VK_PRESENT_MODE_IMMEDIATE_KHR;
+  }
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+} // namespace convert
+} // namespace paranoixa::vulkan
+#endif // EMSCRIPTEN
@@ -0,0 +1,35 @@
+#ifndef EMSCRIPTEN
+#ifndef PARANOIXA_VULKAN_CONVERT_HPP
+#define PARANOIXA_VULKAN_CONVERT_HPP
+#include <paranoixa.hpp>
+#include <volk.h>
+namespace paranoixa::vulkan {
+namespace convert {
+VkAttachmentLoadOp LoadOpFrom(LoadOp loadOp);
+VkAttachmentStoreOp StoreOpFrom(StoreOp storeOp);
+VkPolygonMode FillModeFrom(FillMode fillMode);
+VkCullModeFlags CullModeFrom(CullMode cullMode);
+VkFrontFace FrontFaceFrom(FrontFace frontFace);
+VkPrimitiveTopology PrimitiveTypeFrom(PrimitiveType primitiveType);
+VkFormat TextureFormatFrom(TextureFormat textureFormat);
+TextureFormat TextureFormatFrom(VkFormat format);
+VkFormat VertexElementFormatFrom(VertexElementFormat vertexElementFormat);
+VkVertexInputRate VertexInputRateFrom(VertexInputRate vertexInputRate);
+VkImageType ImageTypeFrom(TextureType textureType);
+VkImageViewType ImageViewTypeFrom(TextureType textureType);
+VkImageUsageFlags TextureUsageFrom(TextureUsage textureUsage);
+VkImageAspectFlags AspectFrom(TextureFormat textureFormat);
+VkSampleCountFlagBits SampleCountFrom(SampleCount sampleCount);
+VkFilter FilterFrom(Filter filter);
+VkSamplerMipmapMode MipmapModeFrom(MipmapMode mipmapMode);
+VkSamplerAddressMode AddressModeFrom(AddressMode addressMode);
+VkCompareOp CompareOpFrom(CompareOp compareOp);
+VkStencilOp StencilOpFrom(StencilOp op);
+VkBufferUsageFlags BufferUsageFrom(BufferUsage bufferUsage);
+VkBlendFactor BlendFactorFrom(BlendFactor blendFactor);
+VkBlendOp BlendOpFrom(BlendOp blendOp);
+VkPresentModeKHR PresentModeFrom(PresentMode presentMode);
+} // namespace convert
+} // namespace paranoixa::vulkan
+#endif // !PARANOIXA_VULKAN_CONVERT_HPP
+#endif // EMSCRIPTEN
@@ -16,8 +16,11 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstring>
 #include <fstream>
 
+#include "image.hpp"
+#include "pipeline_cache_file.hpp"
 #include "vulkan_renderer.hpp"
 
 #ifndef _countof
@@ -30,17 +33,37 @@ VulkanRenderer::VulkanRenderer()
     : instance(VK_NULL_HANDLE), physicalDevice(VK_NULL_HANDLE),
       physicalDeviceMemoryProperties(), graphicsQueueIndex(0),
       device(VK_NULL_HANDLE), graphicsQueue(VK_NULL_HANDLE),
-      surface(VK_NULL_HANDLE), surfaceFormat(), swapchain(VK_NULL_HANDLE),
+      transferQueueIndex(0), transferQueue(VK_NULL_HANDLE),
+      surface(VK_NULL_HANDLE), surfaceFormat(),
+      presentMode(VK_PRESENT_MODE_FIFO_RELAXED_KHR), swapchain(VK_NULL_HANDLE),
       swapchainState(), commandPool(VK_NULL_HANDLE),
       descriptorPool(VK_NULL_HANDLE), pipelineLayout(VK_NULL_HANDLE),
-      pipeline(VK_NULL_HANDLE), vertexBuffer(), width(0), height(0), frames(),
-      currentFrameIndex(0), swapchainImageIndex(0) {}
+      pipeline(VK_NULL_HANDLE), pipelineCache(VK_NULL_HANDLE), vertexBuffer(),
+      width(0), height(0), framesInFlight(DEFAULT_FRAMES_IN_FLIGHT), frames(),
+      currentFrameIndex(0), swapchainImageIndex(0), timeline(VK_NULL_HANDLE),
+      submittedValue(0), completedValue(0), uploadCommandPool(VK_NULL_HANDLE),
+      uploadTimeline(VK_NULL_HANDLE), uploadSubmittedValue(0),
+      uploadWaitValue(0), barrierCount(0), lastFrameBarrierCount(0) {}
 VulkanRenderer::~VulkanRenderer() { Finalize(); }
 void VulkanRenderer::Finalize() {
   vkDeviceWaitIdle(device);
+  // Everything has completed, including destroys waiting for a next submit
+  for (auto &deferred : deferredDestroys) {
+    deferred.destroy();
+  }
+  deferredDestroys.clear();
+  submittedUploads.push_back(std::move(recordingUpload));
+  for (auto &batch : submittedUploads) {
+    for (auto &staging : batch.stagingBuffers) {
+      vmaDestroyBuffer(allocator, staging.buffer, staging.allocation);
+    }
+  }
+  submittedUploads.clear();
 
   ImGui_ImplVulkan_Shutdown();
-  ImGui_ImplSDL3_Shutdown();
+  if (pWindow != nullptr) {
+    ImGui_ImplSDL3_Shutdown();
+  }
   ImGui::DestroyContext();
 
   vkDestroySampler(device, sampler, nullptr);
@@ -56,62 +79,85 @@ void VulkanRenderer::Finalize() {
 
   for (auto &state : swapchainState) {
     vkDestroyImageView(device, state.view, nullptr);
+    if (state.allocation != VK_NULL_HANDLE) {
+      vmaDestroyImage(allocator, state.image, state.allocation);
+    }
   }
 
   vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
   vkDestroyPipeline(device, pipeline, nullptr);
+  SavePipelineCache();
+  vkDestroyPipelineCache(device, pipelineCache, nullptr);
   for (auto &frame : frames) {
-    vkDestroyFence(device, frame.inFlightFence, nullptr);
     vkDestroySemaphore(device, frame.presentCompleted, nullptr);
     vkDestroySemaphore(device, frame.renderCompleted, nullptr);
   }
+  vkDestroySemaphore(device, timeline, nullptr);
+  vkDestroySemaphore(device, uploadTimeline, nullptr);
   vkDestroyDescriptorPool(device, descriptorPoolForImGui, nullptr);
   vkDestroyDescriptorPool(device, descriptorPool, nullptr);
   vkDestroyCommandPool(device, commandPool, nullptr);
+  vkDestroyCommandPool(device, uploadCommandPool, nullptr);
   vmaDestroyAllocator(allocator);
-  vkDestroySwapchainKHR(device, swapchain, nullptr);
-  SDL_Vulkan_DestroySurface(instance, surface, nullptr);
+  if (swapchain != VK_NULL_HANDLE) {
+    vkDestroySwapchainKHR(device, swapchain, nullptr);
+    SDL_Vulkan_DestroySurface(instance, surface, nullptr);
+  }
   vkDestroyDevice(device, nullptr);
   vkDestroyInstance(instance, nullptr);
 }
-void VulkanRenderer::Initialize(void *window) {
+void VulkanRenderer::SetFramesInFlight(uint32_t count) {
+  assert(frames.empty() && "Set before Initialize");
+  framesInFlight = std::clamp(count, 1u, MAX_FRAMES_IN_FLIGHT);
+}
+void VulkanRenderer::InitializeHeadless(int width, int height,
+                                        const char *cacheDirectory) {
+  this->width = width;
+  this->height = height;
+  Initialize(nullptr, cacheDirectory);
+}
+void VulkanRenderer::Initialize(void *window, const char *cacheDirectory) {
   pWindow = window;
+  if (cacheDirectory != nullptr) {
+    this->cacheDirectory = cacheDirectory;
+  }
   auto *sdlWindow = static_cast<SDL_Window *>(window);
-  SDL_GetWindowSize(sdlWindow, &width, &height);
+  if (sdlWindow != nullptr) {
+    SDL_GetWindowSize(sdlWindow, &width, &height);
+  }
   volkInitialize();
   CreateInstance(window);
-  CreateDevice();
-  CreateSurface(window);
-
-  RecreateSwapchain(width, height);
+  CreateDevice(sdlWindow == nullptr);
+  CreatePipelineCache();
+  if (sdlWindow != nullptr) {
+    CreateSurface(window);
+    RecreateSwapchain(width, height);
+  }
   CreateAllocator();
+  if (sdlWindow == nullptr) {
+    CreateOffscreenImages();
+  }
   CreateCommandPool();
   CreateDescriptorPool(descriptorPool);
+  frames.resize(framesInFlight);
   CreateSemaphores();
   CreateCommandBuffers();
   CreateSampler();
   // Load texture from SDL
   SDL_Surface *surface = SDL_LoadBMP("res/texture.bmp");
 
-  std::vector<uint8_t> data;
-  data.resize(surface->w * surface->h * 4);
-
-  for (int y = 0; y < surface->h; ++y) {
-    for (int x = 0; x < surface->w; ++x) {
-      auto pixel =
-          static_cast<uint32_t *>(surface->pixels) + y * surface->w + x;
-      auto r = (*pixel & 0x00FF0000) >> 16;
-      auto g = (*pixel & 0x0000FF00) >> 8;
-      auto b = (*pixel & 0x000000FF);
-      auto a = (*pixel & 0xFF000000) >> 24;
-      auto index = (y * surface->w + x) * 4;
-      data[index + 0] = r;
-      data[index + 1] = g;
-      data[index + 2] = b;
-      data[index + 3] = a;
-    }
-  }
-  texture = CreateTexture(data.data(), data.size(), surface->w, surface->h);
+  // Swizzled straight into the staging buffer
+  texture = CreateTexture(
+      surface->w, surface->h, [&](void *texels, std::size_t rowPitch) {
+        image::ParallelForRows(
+            surface->h, image::GetThreadCount(rowPitch * surface->h),
+            [&](uint32 y) {
+              image::SwizzleBGRAToRGBA(
+                  static_cast<uint8_t *>(texels) + y * rowPitch,
+                  static_cast<uint8_t *>(surface->pixels) + y * surface->pitch,
+                  surface->w);
+            });
+      });
   SDL_DestroySurface(surface);
   CreateDescriptorSetLayout();
   CreateDescriptorSet();
@@ -127,7 +173,9 @@ void VulkanRenderer::Initialize(void *window) {
   io.WantCaptureMouse = true;
   io.IniFilename = nullptr;
   ImGui::StyleColorsDark();
-  ImGui_ImplSDL3_InitForVulkan(sdlWindow);
+  if (sdlWindow != nullptr) {
+    ImGui_ImplSDL3_InitForVulkan(sdlWindow);
+  }
   ImGui_ImplVulkan_LoadFunctions(
       [](const char *functionName, void *userArgs) {
         auto renderer = static_cast<VulkanRenderer *>(userArgs);
@@ -149,8 +197,8 @@ void VulkanRenderer::Initialize(void *window) {
       .Queue = graphicsQueue,
       .DescriptorPool = descriptorPoolForImGui,
       .RenderPass = VK_NULL_HANDLE,
-      .MinImageCount = MAX_FRAMES_IN_FLIGHT,
-      .ImageCount = MAX_FRAMES_IN_FLIGHT,
+      .MinImageCount = 2,
+      .ImageCount = std::max(framesInFlight, 2u),
       .MSAASamples = VK_SAMPLE_COUNT_1_BIT,
   };
   vulkanInfo.UseDynamicRendering = true;
@@ -165,12 +213,17 @@ void VulkanRenderer::Initialize(void *window) {
   PrepareTexture();
 }
 void VulkanRenderer::ProcessEvent(void *event) {
+  if (pWindow == nullptr) {
+    return;
+  }
   ImGui_ImplSDL3_ProcessEvent(static_cast<SDL_Event *>(event));
 }
 void VulkanRenderer::BeginFrame() {
-  int newWidth, newHeight;
+  int newWidth = width, newHeight = height;
   auto *sdlWindow = reinterpret_cast<SDL_Window *>(pWindow);
-  SDL_GetWindowSize(sdlWindow, &newWidth, &newHeight);
+  if (sdlWindow != nullptr) {
+    SDL_GetWindowSize(sdlWindow, &newWidth, &newHeight);
+  }
   if (width != newWidth || height != newHeight) {
     this->RecreateSwapchain(newWidth, newHeight);
     width = newWidth;
@@ -184,20 +237,62 @@ void VulkanRenderer::EndFrame() {
   auto &frameInfo = frames[currentFrameIndex];
   vkEndCommandBuffer(frameInfo.commandBuffer);
 
-  VkPipelineStageFlags waitStage{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  VkSubmitInfo submitInfo{
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .waitSemaphoreCount = 1,
-      .pWaitSemaphores = &frameInfo.presentCompleted,
-      .pWaitDstStageMask = &waitStage,
-      .commandBufferCount = 1,
-      .pCommandBuffers = &frameInfo.commandBuffer,
-      .signalSemaphoreCount = 1,
-      .pSignalSemaphores = &frameInfo.renderCompleted,
+  frameInfo.submittedValue = ++submittedValue;
+  // Uploads are only sampled by fragment shaders, earlier stages of the
+  // frame overlap with them
+  VkSemaphoreSubmitInfo waitInfos[] = {
+      {
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+          .semaphore = frameInfo.presentCompleted,
+          .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+          .semaphore = uploadTimeline,
+          .value = uploadWaitValue,
+          .stageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+      },
   };
-  vkQueueSubmit(graphicsQueue, 1, &submitInfo, frameInfo.inFlightFence);
+  VkSemaphoreSubmitInfo signalInfos[] = {
+      {
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+          .semaphore = frameInfo.renderCompleted,
+          .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+          .semaphore = timeline,
+          .value = frameInfo.submittedValue,
+          .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      },
+  };
+  VkCommandBufferSubmitInfo commandBufferInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+      .commandBuffer = frameInfo.commandBuffer,
+  };
+  VkSubmitInfo2 submitInfo{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+      .waitSemaphoreInfoCount = uploadWaitValue != 0 ? 2u : 1u,
+      .pWaitSemaphoreInfos = waitInfos,
+      .commandBufferInfoCount = 1,
+      .pCommandBufferInfos = &commandBufferInfo,
+      .signalSemaphoreInfoCount = static_cast<uint32_t>(std::size(signalInfos)),
+      .pSignalSemaphoreInfos = signalInfos,
+  };
+  if (swapchain == VK_NULL_HANDLE) {
+    // Nothing is acquired or presented without a window
+    submitInfo.waitSemaphoreInfoCount -= 1;
+    submitInfo.pWaitSemaphoreInfos = waitInfos + 1;
+    submitInfo.signalSemaphoreInfoCount -= 1;
+    submitInfo.pSignalSemaphoreInfos = signalInfos + 1;
+  }
+  vkQueueSubmit2(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+  uploadWaitValue = 0;
 
-  currentFrameIndex = (++currentFrameIndex) % this->MAX_FRAMES_IN_FLIGHT;
+  currentFrameIndex = (currentFrameIndex + 1) % frames.size();
+  if (swapchain == VK_NULL_HANDLE) {
+    return;
+  }
 
   VkPresentInfoKHR presentInfo{.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
                                .waitSemaphoreCount = 1,
@@ -211,23 +306,160 @@ void VulkanRenderer::AddGuiUpdateCallBack(std::function<void()> callBack) {
   this->guiCallBacks.push_back(callBack);
 }
 
+bool VulkanRenderer::IsCompleted(uint64_t value) {
+  if (value <= completedValue.load(std::memory_order_acquire)) {
+    return true;
+  }
+  uint64_t current = 0;
+  vkGetSemaphoreCounterValue(device, timeline, &current);
+  UpdateCompletedValue(current);
+  return value <= current;
+}
+void VulkanRenderer::WaitForValue(uint64_t value) {
+  if (IsCompleted(value)) {
+    return;
+  }
+  VkSemaphoreWaitInfo waitInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      .semaphoreCount = 1,
+      .pSemaphores = &timeline,
+      .pValues = &value,
+  };
+  vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+  UpdateCompletedValue(value);
+}
+void VulkanRenderer::UpdateCompletedValue(uint64_t value) {
+  // Another thread may have cached a newer value meanwhile
+  auto cached = completedValue.load(std::memory_order_relaxed);
+  while (cached < value &&
+         !completedValue.compare_exchange_weak(cached, value,
+                                               std::memory_order_release)) {
+  }
+}
+void VulkanRenderer::DeferDestroy(std::function<void()> destroy) {
+  deferredDestroys.push_back({submittedValue + 1, std::move(destroy)});
+}
+void VulkanRenderer::CollectDeferredDestroys() {
+  // Deferred in submit order, so the completed ones come first
+  auto end = std::find_if(
+      deferredDestroys.begin(), deferredDestroys.end(),
+      [&](const DeferredDestroy &deferred) {
+        return !IsCompleted(deferred.value);
+      });
+  for (auto it = deferredDestroys.begin(); it != end; ++it) {
+    it->destroy();
+  }
+  deferredDestroys.erase(deferredDestroys.begin(), end);
+}
+void VulkanRenderer::FlushUploads() {
+  auto &batch = recordingUpload;
+  if (batch.commandBuffer == VK_NULL_HANDLE) {
+    return;
+  }
+  // Releases of the batch to the graphics family
+  FlushBarriers(batch.commandBuffer, uploadBarriers);
+  vkEndCommandBuffer(batch.commandBuffer);
+  batch.submittedValue = ++uploadSubmittedValue;
+  VkSemaphoreSubmitInfo signalInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+      .semaphore = uploadTimeline,
+      .value = batch.submittedValue,
+      .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+  };
+  VkCommandBufferSubmitInfo commandBufferInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+      .commandBuffer = batch.commandBuffer,
+  };
+  VkSubmitInfo2 submitInfo{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+      .commandBufferInfoCount = 1,
+      .pCommandBufferInfos = &commandBufferInfo,
+      .signalSemaphoreInfoCount = 1,
+      .pSignalSemaphoreInfos = &signalInfo,
+  };
+  vkQueueSubmit2(transferQueue, 1, &submitInfo, VK_NULL_HANDLE);
+  uploadWaitValue = batch.submittedValue;
+  submittedUploads.push_back(std::move(batch));
+  batch = {};
+}
+VkCommandBuffer VulkanRenderer::GetUploadCommandBuffer() {
+  auto &batch = recordingUpload;
+  if (batch.commandBuffer != VK_NULL_HANDLE) {
+    return batch.commandBuffer;
+  }
+  CollectUploads();
+  if (freeUploadCommandBuffers.empty()) {
+    VkCommandBufferAllocateInfo commandBufferAI{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = uploadCommandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    vkAllocateCommandBuffers(device, &commandBufferAI, &batch.commandBuffer);
+  } else {
+    batch.commandBuffer = freeUploadCommandBuffers.back();
+    freeUploadCommandBuffers.pop_back();
+  }
+  VkCommandBufferBeginInfo commandBufferBI{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  vkBeginCommandBuffer(batch.commandBuffer, &commandBufferBI);
+  return batch.commandBuffer;
+}
+void VulkanRenderer::CollectUploads() {
+  uint64_t completed = 0;
+  vkGetSemaphoreCounterValue(device, uploadTimeline, &completed);
+  auto end = std::find_if(submittedUploads.begin(), submittedUploads.end(),
+                          [&](const UploadBatch &batch) {
+                            return batch.submittedValue > completed;
+                          });
+  for (auto it = submittedUploads.begin(); it != end; ++it) {
+    for (auto &staging : it->stagingBuffers) {
+      vmaDestroyBuffer(allocator, staging.buffer, staging.allocation);
+    }
+    vkResetCommandBuffer(it->commandBuffer, 0);
+    freeUploadCommandBuffers.push_back(it->commandBuffer);
+  }
+  submittedUploads.erase(submittedUploads.begin(), end);
+}
+
 void VulkanRenderer::NewFrame() {
   auto &frameInfo = this->frames[currentFrameIndex];
-  auto fence = frameInfo.inFlightFence;
-  vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-  auto res = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
-                                   frameInfo.presentCompleted, VK_NULL_HANDLE,
-                                   &swapchainImageIndex);
-  if (res == VK_ERROR_OUT_OF_DATE_KHR) {
-    return;
+  // The command buffer and acquire semaphore of the frame are free again
+  // once its previous submit has completed
+  WaitForValue(frameInfo.submittedValue);
+  lastFrameBarrierCount = barrierCount;
+  barrierCount = 0;
+  if (swapchain == VK_NULL_HANDLE) {
+    // The offscreen image of the frame was last used by the submit waited
+    // for above
+    swapchainImageIndex = currentFrameIndex;
+  } else {
+    auto res = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
+                                     frameInfo.presentCompleted,
+                                     VK_NULL_HANDLE, &swapchainImageIndex);
+    if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+      return;
+    }
+    // The first barrier chains with the acquire semaphore, which is waited
+    // on at color attachment output. The previous contents are cleared
+    // anyway.
+    imageStates[swapchainState[swapchainImageIndex].image] = {
+        .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .queueFamily = graphicsQueueIndex,
+    };
   }
-  vkResetFences(device, 1, &fence);
+  CollectDeferredDestroys();
 
   vkResetCommandBuffer(frameInfo.commandBuffer, 0);
   VkCommandBufferBeginInfo commandBeginInfo{
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
   };
   vkBeginCommandBuffer(frameInfo.commandBuffer, &commandBeginInfo);
+
+  // Textures created since the last frame become visible to this one
+  FlushUploads();
 }
 void VulkanRenderer::ProcessFrame() {
   auto commandBuffer = this->frames[this->currentFrameIndex].commandBuffer;
@@ -236,9 +468,17 @@ void VulkanRenderer::ProcessFrame() {
       VkClearColorValue{1.0f, 0.4f, 0.0f, 1.0f},
   };
 
-  TransitionLayoutSwapchainImage(commandBuffer,
-                                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                 VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+  // Everything the pass uses, in one barrier
+  RequireImageState(frameBarriers, swapchainState[swapchainImageIndex].image,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    graphicsQueueIndex);
+  RequireImageState(frameBarriers, texture.image, VK_IMAGE_LAYOUT_GENERAL,
+                    VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                    VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+                    graphicsQueueIndex);
+  FlushBarriers(commandBuffer, frameBarriers);
   VkRenderingAttachmentInfo colorAttachmentInfo{
       .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
       .imageView = this->swapchainState[this->swapchainImageIndex].view,
@@ -269,7 +509,14 @@ void VulkanRenderer::ProcessFrame() {
                           pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
   vkCmdDraw(commandBuffer, 6, 1, 0, 0);
 
-  ImGui_ImplSDL3_NewFrame();
+  if (pWindow != nullptr) {
+    ImGui_ImplSDL3_NewFrame();
+  } else {
+    auto &io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(static_cast<float>(width),
+                            static_cast<float>(height));
+    io.DeltaTime = 1.f / 60.f;
+  }
   ImGui_ImplVulkan_NewFrame();
   ImGui::NewFrame();
   for (auto &callBack : this->guiCallBacks) {
@@ -280,14 +527,27 @@ void VulkanRenderer::ProcessFrame() {
 
   vkCmdEndRendering(commandBuffer);
 
-  TransitionLayoutSwapchainImage(commandBuffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-                                 VK_ACCESS_2_NONE);
+  // Offscreen images are left ready to be copied out
+  if (swapchain != VK_NULL_HANDLE) {
+    RequireImageState(frameBarriers, swapchainState[swapchainImageIndex].image,
+                      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_ACCESS_2_NONE,
+                      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                      graphicsQueueIndex);
+  } else {
+    RequireImageState(frameBarriers, swapchainState[swapchainImageIndex].image,
+                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                      VK_ACCESS_2_TRANSFER_READ_BIT,
+                      VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+                      graphicsQueueIndex);
+  }
+  FlushBarriers(commandBuffer, frameBarriers);
 }
 void VulkanRenderer::Submit() {}
 
 void VulkanRenderer::CreateInstance(void *window) {
   auto *sdlWindow = static_cast<SDL_Window *>(window);
-  const char *appName = SDL_GetWindowTitle(sdlWindow);
+  const char *appName =
+      sdlWindow != nullptr ? SDL_GetWindowTitle(sdlWindow) : "Paranoixa";
   VkApplicationInfo appInfo = {
       .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
       .pNext = nullptr,
@@ -310,7 +570,7 @@ void VulkanRenderer::CreateInstance(void *window) {
 
   std::vector<const char *> layers;
   std::vector<const char *> extensions;
-  {
+  if (sdlWindow != nullptr) {
     uint32_t count;
     const char *const *extensionNames =
         SDL_Vulkan_GetInstanceExtensions(&count);
@@ -318,7 +578,20 @@ void VulkanRenderer::CreateInstance(void *window) {
                     [&](auto v) { extensions.push_back(v); });
   }
 #if 1
-  layers.push_back("VK_LAYER_KHRONOS_validation");
+  {
+    // CI machines running lavapipe rarely have the SDK installed
+    constexpr const char *validationLayer = "VK_LAYER_KHRONOS_validation";
+    uint32_t count = 0;
+    vkEnumerateInstanceLayerProperties(&count, nullptr);
+    std::vector<VkLayerProperties> properties(count);
+    vkEnumerateInstanceLayerProperties(&count, properties.data());
+    for (const auto &props : properties) {
+      if (std::strcmp(props.layerName, validationLayer) == 0) {
+        layers.push_back(validationLayer);
+        break;
+      }
+    }
+  }
 #endif
   createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
   createInfo.ppEnabledExtensionNames = extensions.data();
@@ -329,7 +602,7 @@ void VulkanRenderer::CreateInstance(void *window) {
     volkLoadInstance(instance);
   }
 }
-void VulkanRenderer::CreateDevice() {
+void VulkanRenderer::CreateDevice(bool headless) {
   //------------------------
   // Create physical device
   //------------------------
@@ -358,30 +631,54 @@ void VulkanRenderer::CreateDevice() {
   }
   assert(gfxQueueIndex != UINT32_MAX);
   graphicsQueueIndex = gfxQueueIndex;
+  // Transfer only families are backed by copy engines that run alongside
+  // the graphics queue
+  transferQueueIndex = graphicsQueueIndex;
+  for (uint32_t i = 0; const auto &props : queueFamilyProps) {
+    if ((props.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+        !(props.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      transferQueueIndex = i;
+      break;
+    }
+    ++i;
+  }
 
   //------------------------
   // Create logic device
   //------------------------
-  std::vector<const char *> extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  std::vector<const char *> extensions;
+  if (!headless) {
+    extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  }
   VkPhysicalDeviceFeatures2 physFeatures2{
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  VkPhysicalDeviceVulkan12Features vulkan12Features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
   VkPhysicalDeviceVulkan13Features vulkan13Features{
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
-  physFeatures2.pNext = &vulkan13Features;
+  physFeatures2.pNext = &vulkan12Features;
+  vulkan12Features.pNext = &vulkan13Features;
   vulkan13Features.dynamicRendering = VK_TRUE;
   vulkan13Features.synchronization2 = VK_TRUE;
   vulkan13Features.maintenance4 = VK_TRUE;
   vkGetPhysicalDeviceFeatures2(physicalDevice, &physFeatures2);
+  // Required by Vulkan 1.2, so every 1.3 device has it
+  assert(vulkan12Features.timelineSemaphore);
   constexpr float queuePriorities[] = {1.f};
-  VkDeviceQueueCreateInfo deviceQueueCreateInfo{
-      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-      .queueFamilyIndex = graphicsQueueIndex,
-      .queueCount = 1,
-      .pQueuePriorities = queuePriorities};
+  VkDeviceQueueCreateInfo deviceQueueCreateInfos[] = {
+      {.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+       .queueFamilyIndex = graphicsQueueIndex,
+       .queueCount = 1,
+       .pQueuePriorities = queuePriorities},
+      {.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+       .queueFamilyIndex = transferQueueIndex,
+       .queueCount = 1,
+       .pQueuePriorities = queuePriorities}};
   VkDeviceCreateInfo deviceCreateInfo{
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-      .queueCreateInfoCount = 1,
-      .pQueueCreateInfos = &deviceQueueCreateInfo,
+      .queueCreateInfoCount =
+          transferQueueIndex != graphicsQueueIndex ? 2u : 1u,
+      .pQueueCreateInfos = deviceQueueCreateInfos,
       .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
       .ppEnabledExtensionNames = extensions.data()};
   deviceCreateInfo.pNext = &physFeatures2;
@@ -390,6 +687,47 @@ void VulkanRenderer::CreateDevice() {
   if (result == VK_SUCCESS) {
     volkLoadDevice(device);
     vkGetDeviceQueue(device, graphicsQueueIndex, 0, &graphicsQueue);
+    vkGetDeviceQueue(device, transferQueueIndex, 0, &transferQueue);
+  }
+}
+static PipelineCacheIdentity
+GetPipelineCacheIdentity(VkPhysicalDevice physicalDevice) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  PipelineCacheIdentity identity{
+      .vendorID = properties.vendorID,
+      .deviceID = properties.deviceID,
+      .driverVersion = properties.driverVersion,
+  };
+  std::memcpy(identity.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  return identity;
+}
+void VulkanRenderer::CreatePipelineCache() {
+  Array<std::byte> data;
+  if (!cacheDirectory.empty()) {
+    // The driver validates the blob again and ignores it if it does not match
+    LoadPipelineCache(cacheDirectory, GetPipelineCacheIdentity(physicalDevice),
+                      data);
+  }
+  VkPipelineCacheCreateInfo pipelineCacheCI{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .initialDataSize = data.size(),
+      .pInitialData = data.data(),
+  };
+  vkCreatePipelineCache(device, &pipelineCacheCI, nullptr, &pipelineCache);
+}
+void VulkanRenderer::SavePipelineCache() {
+  if (cacheDirectory.empty() || pipelineCache == VK_NULL_HANDLE) {
+    return;
+  }
+  size_t size = 0;
+  vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+  std::vector<std::byte> data(size);
+  if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) ==
+      VK_SUCCESS) {
+    px::SavePipelineCache(cacheDirectory,
+                          GetPipelineCacheIdentity(physicalDevice), data.data(),
+                          size);
   }
 }
 void VulkanRenderer::CreateSurface(void *window) {
@@ -450,11 +788,28 @@ void VulkanRenderer::RecreateSwapchain(int width, int height) {
                                surfaceCapabilities.minImageExtent.height,
                                surfaceCapabilities.maxImageExtent.height);
   }
+  uint32_t count = 0;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &count,
+                                            nullptr);
+  std::vector<VkPresentModeKHR> presentModes(count);
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &count,
+                                            presentModes.data());
+  auto mode = presentMode;
+  if (std::find(presentModes.begin(), presentModes.end(), mode) ==
+      presentModes.end()) {
+    mode = VK_PRESENT_MODE_FIFO_KHR;
+  }
+  // One image on screen and one per frame in flight
+  uint32_t imageCount =
+      std::max(surfaceCapabilities.minImageCount, framesInFlight + 1);
+  if (surfaceCapabilities.maxImageCount > 0) {
+    imageCount = std::min(imageCount, surfaceCapabilities.maxImageCount);
+  }
   VkSwapchainKHR oldSwapchain = this->swapchain;
   VkSwapchainCreateInfoKHR swapchainCreateInfo{
       .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
       .surface = surface,
-      .minImageCount = surfaceCapabilities.minImageCount,
+      .minImageCount = imageCount,
       .imageFormat = surfaceFormat.format,
       .imageColorSpace = surfaceFormat.colorSpace,
       .imageExtent = extent,
@@ -465,12 +820,12 @@ void VulkanRenderer::RecreateSwapchain(int width, int height) {
       .pQueueFamilyIndices = nullptr,
       .preTransform = surfaceCapabilities.currentTransform,
       .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-      .presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+      .presentMode = mode,
       .clipped = VK_TRUE,
       .oldSwapchain = oldSwapchain};
   vkCreateSwapchainKHR(device, &swapchainCreateInfo, nullptr, &this->swapchain);
 
-  uint32_t count = 0;
+  count = 0;
   vkGetSwapchainImagesKHR(this->device, this->swapchain, &count, nullptr);
   std::vector<VkImage> swapchainImages(count);
   vkGetSwapchainImagesKHR(this->device, this->swapchain, &count,
@@ -501,8 +856,6 @@ void VulkanRenderer::RecreateSwapchain(int width, int height) {
         }};
     vkCreateImageView(device, &imageViewCI, nullptr, &state.view);
     state.image = image;
-    state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
-    state.accessFlags = VK_ACCESS_2_NONE;
     ++i;
   }
   swapchainState.swap(this->swapchainState);
@@ -510,6 +863,7 @@ void VulkanRenderer::RecreateSwapchain(int width, int height) {
   if (oldSwapchain != VK_NULL_HANDLE) {
     for (auto &state : swapchainState) {
       vkDestroyImageView(device, state.view, nullptr);
+      imageStates.erase(state.image);
     }
     vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
   }
@@ -523,6 +877,37 @@ void VulkanRenderer::RecreateSwapchain(int width, int height) {
   }
   assert(supportPresent[graphicsQueueIndex] == VK_TRUE);
 }
+void VulkanRenderer::CreateOffscreenImages() {
+  surfaceFormat = {
+      .format = VK_FORMAT_R8G8B8A8_UNORM,
+      .colorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR,
+  };
+  // One image per frame in flight, so a frame never waits on another
+  swapchainState.resize(framesInFlight);
+  for (auto &state : swapchainState) {
+    state.image = CreateImage(static_cast<uint32_t>(width),
+                              static_cast<uint32_t>(height),
+                              surfaceFormat.format,
+                              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                              VMA_MEMORY_USAGE_AUTO, state.allocation,
+                              nullptr);
+    assert(state.image != VK_NULL_HANDLE);
+    VkImageViewCreateInfo imageViewCI{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = state.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = surfaceFormat.format,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        }};
+    vkCreateImageView(device, &imageViewCI, nullptr, &state.view);
+  }
+}
 VmaVulkanFunctions VulkanRenderer::GetVulkanFunctions() {
   VmaVulkanFunctions vmaVulkanFunctions{};
   vmaVulkanFunctions.vkAllocateMemory = vkAllocateMemory;
@@ -573,6 +958,10 @@ void VulkanRenderer::CreateCommandPool() {
   VkCommandPool commandPool;
   vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr,
                       &this->commandPool);
+  commandPoolCreateInfo.flags |= VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  commandPoolCreateInfo.queueFamilyIndex = transferQueueIndex;
+  vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr,
+                      &uploadCommandPool);
 }
 void VulkanRenderer::CreateDescriptorPool(VkDescriptorPool &pool) {
   constexpr uint32_t POOL_SIZE = 256;
@@ -602,15 +991,19 @@ void VulkanRenderer::CreateSemaphores() {
     vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr,
                       &frame.presentCompleted);
   }
+  VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = 0,
+  };
+  VkSemaphoreCreateInfo timelineCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &semaphoreTypeCreateInfo,
+  };
+  vkCreateSemaphore(device, &timelineCreateInfo, nullptr, &timeline);
+  vkCreateSemaphore(device, &timelineCreateInfo, nullptr, &uploadTimeline);
 }
 void VulkanRenderer::CreateCommandBuffers() {
-  VkFenceCreateInfo fenceCI{
-      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-      .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-  };
-  for (auto &frame : this->frames) {
-    vkCreateFence(device, &fenceCI, nullptr, &frame.inFlightFence);
-  }
   VkCommandBufferAllocateInfo commandBufferAllocateInfo{
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
       .commandPool = commandPool,
@@ -835,7 +1228,7 @@ void VulkanRenderer::PrepareTriangle() {
   };
   pipelineCreateInfo.pNext = &renderingCI;
   auto res = vkCreateGraphicsPipelines(
-      device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &this->pipeline);
+      device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &this->pipeline);
   if (res != VK_SUCCESS) {
   }
   for (auto &m : shaderStages) {
@@ -1011,7 +1404,7 @@ void VulkanRenderer::PrepareTexture() {
   };
   pipelineCreateInfo.pNext = &renderingCI;
   auto res = vkCreateGraphicsPipelines(
-      device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &this->pipeline);
+      device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &this->pipeline);
   if (res != VK_SUCCESS) {
   }
   for (auto &m : shaderStages) {
@@ -1031,46 +1424,11 @@ VkShaderModule VulkanRenderer::CreateShaderModule(const void *code,
 void VulkanRenderer::DestroyShaderModule(VkShaderModule shaderModule) {
   vkDestroyShaderModule(device, shaderModule, nullptr);
 }
-void VulkanRenderer::TransitionLayoutSwapchainImage(
-    VkCommandBuffer commandBuffer, VkImageLayout newLayout,
-    VkAccessFlags2 newAccessFlags) {
-  auto &swapchainState = this->swapchainState[swapchainImageIndex];
-  VkImageMemoryBarrier2 barrierToRT{
-      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-      .pNext = nullptr,
-      .srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-      .srcAccessMask = swapchainState.accessFlags,
-      .dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-      .dstAccessMask = newAccessFlags,
-      .oldLayout = swapchainState.layout,
-      .newLayout = newLayout,
-      .image = swapchainState.image,
-      .subresourceRange = {
-          .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-          .baseMipLevel = 0,
-          .levelCount = 1,
-          .baseArrayLayer = 0,
-          .layerCount = 1,
-      }};
-
-  VkDependencyInfo info{
-      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-      .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT,
-      .imageMemoryBarrierCount = 1,
-      .pImageMemoryBarriers = &barrierToRT,
-  };
-
-  if (vkCmdPipelineBarrier2) {
-    vkCmdPipelineBarrier2(commandBuffer, &info);
-  } else {
-    vkCmdPipelineBarrier2KHR(commandBuffer, &info);
-  }
-  swapchainState.layout = newLayout;
-  swapchainState.accessFlags = newAccessFlags;
-}
-VulkanRenderer::Texture VulkanRenderer::CreateTexture(const void *data,
-                                                      size_t size, int width,
-                                                      int height) {
+VulkanRenderer::Texture
+VulkanRenderer::CreateTexture(int width, int height,
+                              const TexelWriter &writeTexels) {
+  auto rowPitch = static_cast<size_t>(width) * 4;
+  auto size = rowPitch * height;
   Texture texture;
   VmaAllocationInfo allocationInfo;
   texture.image =
@@ -1092,51 +1450,17 @@ VulkanRenderer::Texture VulkanRenderer::CreateTexture(const void *data,
                   &stagingAllocation, nullptr);
   void *mappedData;
   vmaMapMemory(allocator, stagingAllocation, &mappedData);
-  memcpy(mappedData, data, size);
+  writeTexels(mappedData, rowPitch);
   vmaUnmapMemory(allocator, stagingAllocation);
+  // Freed once the upload retires
+  recordingUpload.stagingBuffers.push_back({stagingBuffer, stagingAllocation});
 
-  VkCommandBufferAllocateInfo commandBufferAI{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .commandPool = commandPool,
-      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = 1,
-  };
-  VkCommandBuffer commandBuffer;
-  vkAllocateCommandBuffers(device, &commandBufferAI, &commandBuffer);
-
-  VkCommandBufferBeginInfo commandBufferBI{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-  };
-  vkBeginCommandBuffer(commandBuffer, &commandBufferBI);
-
-  VkImageMemoryBarrier imageBarrier{
-      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-      .srcAccessMask = 0,
-      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-      .image = texture.image,
-      .subresourceRange =
-          {
-              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-              .baseMipLevel = 0,
-              .levelCount = 1,
-              .baseArrayLayer = 0,
-              .layerCount = 1,
-          },
-  };
-  /*
-  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
-                       nullptr, 1, &imageBarrier);
-                       */
-  TransitionLayoutImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_UNDEFINED,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_2_NONE,
-                        VK_ACCESS_TRANSFER_WRITE_BIT,
-                        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-                        VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT);
+  auto commandBuffer = GetUploadCommandBuffer();
+  RequireImageState(uploadBarriers, texture.image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, transferQueueIndex);
+  FlushBarriers(commandBuffer, uploadBarriers);
 
   VkBufferImageCopy bufferImageCopy{
 
@@ -1158,28 +1482,11 @@ VulkanRenderer::Texture VulkanRenderer::CreateTexture(const void *data,
                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
                          &bufferImageCopy);
 
-  imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-  TransitionLayoutImage(
-      commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_TRANSFER_WRITE_BIT,
-      VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
-      VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
-
-  vkEndCommandBuffer(commandBuffer);
-
-  VkSubmitInfo submitInfo{
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .commandBufferCount = 1,
-      .pCommandBuffers = &commandBuffer,
-  };
-  vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue);
-
-  vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-  vmaDestroyBuffer(allocator, stagingBuffer, stagingAllocation);
+  // Sampled in GENERAL. A separate transfer family releases the image with
+  // the next flush of the uploads, and the first use in a frame acquires it.
+  RequireImageState(uploadBarriers, texture.image, VK_IMAGE_LAYOUT_GENERAL,
+                    VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_NONE,
+                    graphicsQueueIndex);
 
   VkImageViewCreateInfo imageViewCI{
       .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -1234,20 +1541,32 @@ VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height,
   }
   return image;
 }
-void VulkanRenderer::TransitionLayoutImage(
-    VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout,
-    VkImageLayout newLayout, VkAccessFlags2 oldAccessFlags,
-    VkAccessFlags2 newAccessFlags, VkPipelineStageFlags2 srcStageMask,
-    VkPipelineStageFlags2 dstStageMask) {
+void VulkanRenderer::RequireImageState(BarrierBatch &batch, VkImage image,
+                                       VkImageLayout layout,
+                                       VkAccessFlags2 accessFlags,
+                                       VkPipelineStageFlags2 stageMask,
+                                       uint32_t queueFamily) {
+  constexpr VkAccessFlags2 writeAccess =
+      VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+      VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+      VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+      VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT |
+      VK_ACCESS_2_MEMORY_WRITE_BIT;
+  auto &state = imageStates[image];
+  if (state.queueFamily == VK_QUEUE_FAMILY_IGNORED) {
+    state.queueFamily = queueFamily;
+  }
   VkImageMemoryBarrier2 barrier{
       .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-      .pNext = nullptr,
-      .srcStageMask = srcStageMask,
-      .srcAccessMask = oldAccessFlags,
-      .dstStageMask = dstStageMask,
-      .dstAccessMask = newAccessFlags,
-      .oldLayout = oldLayout,
-      .newLayout = newLayout,
+      // Earlier reads only need to finish, earlier writes to be visible
+      .srcStageMask = state.stageMask,
+      .srcAccessMask = state.accessFlags & writeAccess,
+      .dstStageMask = stageMask,
+      .dstAccessMask = accessFlags,
+      .oldLayout = state.layout,
+      .newLayout = layout,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
       .image = image,
       .subresourceRange =
           {
@@ -1258,12 +1577,58 @@ void VulkanRenderer::TransitionLayoutImage(
               .layerCount = 1,
           },
   };
-
+  if (state.releasedFamily != VK_QUEUE_FAMILY_IGNORED) {
+    assert(queueFamily == state.queueFamily && layout == state.layout);
+    // The release has to reach its queue before the frame that acquires
+    FlushUploads();
+    // Repeats the release but for the destination scope. The source stage
+    // chains with the upload semaphore wait, which covers the first use.
+    barrier.srcStageMask = stageMask;
+    barrier.srcAccessMask = VK_ACCESS_2_NONE;
+    barrier.oldLayout = state.releasedLayout;
+    barrier.srcQueueFamilyIndex = state.releasedFamily;
+    barrier.dstQueueFamilyIndex = queueFamily;
+    state.releasedFamily = VK_QUEUE_FAMILY_IGNORED;
+  } else if (queueFamily != state.queueFamily) {
+    // The destination scope belongs to the acquire
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    barrier.dstAccessMask = VK_ACCESS_2_NONE;
+    barrier.srcQueueFamilyIndex = state.queueFamily;
+    barrier.dstQueueFamilyIndex = queueFamily;
+    state = {
+        .layout = layout,
+        .queueFamily = queueFamily,
+        .releasedFamily = state.queueFamily,
+        .releasedLayout = state.layout,
+    };
+    batch.push_back(barrier);
+    return;
+  } else if (state.layout == layout &&
+             ((state.accessFlags | accessFlags) & writeAccess) == 0) {
+    state.accessFlags |= accessFlags;
+    state.stageMask |= stageMask;
+    return;
+  }
+  // One barrier per image and batch, the ones of a batch are unordered
+  assert(std::none_of(batch.begin(), batch.end(),
+                      [&](const VkImageMemoryBarrier2 &pending) {
+                        return pending.image == image;
+                      }));
+  state.layout = layout;
+  state.accessFlags = accessFlags;
+  state.stageMask = stageMask;
+  batch.push_back(barrier);
+}
+void VulkanRenderer::FlushBarriers(VkCommandBuffer commandBuffer,
+                                   BarrierBatch &batch) {
+  if (batch.empty()) {
+    return;
+  }
   VkDependencyInfo info{
       .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
       .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT,
-      .imageMemoryBarrierCount = 1,
-      .pImageMemoryBarriers = &barrier,
+      .imageMemoryBarrierCount = static_cast<uint32_t>(batch.size()),
+      .pImageMemoryBarriers = batch.data(),
   };
 
   if (vkCmdPipelineBarrier2) {
@@ -1271,6 +1636,8 @@ void VulkanRenderer::TransitionLayoutImage(
   } else {
     vkCmdPipelineBarrier2KHR(commandBuffer, &info);
   }
+  barrierCount += static_cast<uint32_t>(batch.size());
+  batch.clear();
 }
 } // namespace paranoixa
 #endif
\ No newline at end of file
@@ -10,21 +10,70 @@
 #include "vma.hpp"
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <unordered_map>
 namespace paranoixa {
 
 class VulkanRenderer {
 public:
   VulkanRenderer();
   ~VulkanRenderer();
-  void Initialize(void *window);
+  /**
+   * @brief Frames the CPU may record ahead of the GPU, clamped to 1 to
+   * MAX_FRAMES_IN_FLIGHT. Fewer frames lower input latency at the cost of
+   * throughput. Takes effect on Initialize.
+   */
+  void SetFramesInFlight(uint32_t count);
+  /**
+   * @brief Falls back to FIFO when the surface does not support the mode.
+   * Takes effect on the next swapchain recreation.
+   */
+  void SetPresentMode(VkPresentModeKHR mode) { presentMode = mode; }
+  void Initialize(void *window, const char *cacheDirectory = nullptr);
+  /**
+   * @brief Initialize without a window, for servers without a display.
+   * Frames render into offscreen images, one per frame in flight, and are
+   * paced by the timeline alone. Software drivers like lavapipe work too.
+   */
+  void InitializeHeadless(int width, int height,
+                          const char *cacheDirectory = nullptr);
   void ProcessEvent(void *event);
   void BeginFrame();
   void EndFrame();
 
   void AddGuiUpdateCallBack(std::function<void()> callBack);
+
+  /**
+   * @brief Value of the device timeline semaphore signaled by the latest
+   * submit. Every submit signals the next value.
+   */
+  uint64_t GetSubmittedValue() const { return submittedValue; }
+  /**
+   * @brief Whether the GPU has finished all work up to value. Safe to call
+   * from any thread, and only queries the driver when the cached value is
+   * behind.
+   */
+  bool IsCompleted(uint64_t value);
+  void WaitForValue(uint64_t value);
+  /**
+   * @brief Run destroy once the next submit, and so every submit before it,
+   * has completed
+   */
+  void DeferDestroy(std::function<void()> destroy);
+  /**
+   * @brief Submit the uploads recorded since the last flush. The next frame
+   * waits for them, NewFrame flushes on its own.
+   */
+  void FlushUploads();
+  /**
+   * @brief Image barriers recorded during the previous frame, uploads
+   * included
+   */
+  uint32_t GetBarrierCount() const { return lastFrameBarrierCount; }
   struct Texture {
     Texture() = default;
     ~Texture() = default;
@@ -36,15 +85,22 @@ public:
 private:
   void Finalize();
   void CreateInstance(void *window);
-  void CreateDevice();
+  void CreateDevice(bool headless);
+  void CreatePipelineCache();
+  void SavePipelineCache();
   void CreateSurface(void *window);
   void RecreateSwapchain(int width, int height);
+  void CreateOffscreenImages();
   VmaVulkanFunctions GetVulkanFunctions();
   void CreateAllocator();
   void CreateCommandPool();
   void CreateDescriptorPool(VkDescriptorPool &pool);
   void CreateSemaphores();
+  void UpdateCompletedValue(uint64_t value);
+  void CollectDeferredDestroys();
   void CreateCommandBuffers();
+  VkCommandBuffer GetUploadCommandBuffer();
+  void CollectUploads();
   void CreateSampler();
   void CreateDescriptorSetLayout();
   void CreateDescriptorSet();
@@ -57,33 +113,45 @@ private:
   void DestroyShaderModule(VkShaderModule shaderModule);
   uint32_t GetMemoryTypeIndex(VkMemoryRequirements reqs,
                               VkMemoryPropertyFlags memoryPropFlags);
-  void TransitionLayoutSwapchainImage(VkCommandBuffer commandBuffer,
-                                      VkImageLayout newLayout,
-                                      VkAccessFlags2 newAccessFlags);
-  Texture CreateTexture(const void *data, size_t size, int width, int height);
+  // Writes the RGBA8 rows, rowPitch bytes apart, into mapped staging memory
+  using TexelWriter = std::function<void(void *texels, size_t rowPitch)>;
+  Texture CreateTexture(int width, int height, const TexelWriter &writeTexels);
   VkImage CreateImage(uint32_t width, uint32_t height, VkFormat format,
                       VkImageUsageFlags usage, VmaMemoryUsage memoryUsage,
                       VmaAllocation &allocation,
                       VmaAllocationInfo *allocationInfo);
-  void TransitionLayoutImage(VkCommandBuffer commandBuffer, VkImage image,
-                             VkImageLayout oldLayout, VkImageLayout newLayout,
-                             VkAccessFlags2 oldAccessFlags,
-                             VkAccessFlags2 newAccessFlags,
-                             VkPipelineStageFlags2 srcStageMask,
-                             VkPipelineStageFlags2 dstStageMask);
+  // Barriers required since the last pass boundary of one command buffer
+  using BarrierBatch = std::vector<VkImageMemoryBarrier2>;
+  /**
+   * @brief State the next use of the image, the barrier from its last use
+   * is worked out and added to the batch. Reads after reads in the same
+   * layout need none. A different queue family releases the image, and its
+   * first use on that family acquires it.
+   */
+  void RequireImageState(BarrierBatch &batch, VkImage image,
+                         VkImageLayout layout, VkAccessFlags2 accessFlags,
+                         VkPipelineStageFlags2 stageMask,
+                         uint32_t queueFamily);
+  // Record the batch as one barrier, at a pass boundary
+  void FlushBarriers(VkCommandBuffer commandBuffer, BarrierBatch &batch);
   VkInstance instance;
   VkPhysicalDevice physicalDevice;
   VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
   uint32_t graphicsQueueIndex;
   VkDevice device;
   VkQueue graphicsQueue;
+  // A transfer only family when the device has one, the graphics one if not
+  uint32_t transferQueueIndex;
+  VkQueue transferQueue;
   VkSurfaceKHR surface;
   VkSurfaceFormatKHR surfaceFormat;
+  VkPresentModeKHR presentMode;
+  // Swapchain images, or the offscreen images that stand in for them
+  // without a window
   struct SwapchainState {
     VkImage image = VK_NULL_HANDLE;
     VkImageView view = VK_NULL_HANDLE;
-    VkAccessFlags2 accessFlags = VK_ACCESS_2_NONE;
-    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VmaAllocation allocation = VK_NULL_HANDLE;
   };
   VkSwapchainKHR swapchain;
   std::vector<SwapchainState> swapchainState;
@@ -98,11 +166,14 @@ private:
   Texture texture;
   VkPipelineLayout pipelineLayout;
   VkPipeline pipeline;
+  VkPipelineCache pipelineCache;
+  std::filesystem::path cacheDirectory;
   struct Frame {
-    VkSemaphore renderCompleted;
-    VkSemaphore presentCompleted;
-    VkFence inFlightFence;
-    VkCommandBuffer commandBuffer;
+    VkSemaphore renderCompleted = VK_NULL_HANDLE;
+    VkSemaphore presentCompleted = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    // Timeline value signaled when the last submit of the frame completes
+    uint64_t submittedValue = 0;
   };
   struct VertexBuffer {
     VertexBuffer() : buffer(VK_NULL_HANDLE), memory(VK_NULL_HANDLE) {}
@@ -111,11 +182,63 @@ private:
   } vertexBuffer;
   void *pWindow;
   int width, height;
-  static constexpr size_t MAX_FRAMES_IN_FLIGHT = 2;
-  Frame frames[MAX_FRAMES_IN_FLIGHT];
+  static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+  static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+  // Any count works, the timeline paces the frames
+  uint32_t framesInFlight;
+  std::vector<Frame> frames;
   int currentFrameIndex = 0;
   uint32_t swapchainImageIndex = 0;
 
+  // One semaphore tracks every submit. Binary semaphores remain only for
+  // the swapchain, which cannot wait on or signal timelines.
+  VkSemaphore timeline;
+  uint64_t submittedValue;
+  std::atomic<uint64_t> completedValue;
+  struct DeferredDestroy {
+    uint64_t value;
+    std::function<void()> destroy;
+  };
+  std::vector<DeferredDestroy> deferredDestroys;
+
+  // Texture uploads are recorded into one command buffer per flush and run
+  // on the transfer queue. Its own timeline orders them, signals from two
+  // queues on one timeline could arrive out of order.
+  struct StagingBuffer {
+    VkBuffer buffer;
+    VmaAllocation allocation;
+  };
+  struct UploadBatch {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    uint64_t submittedValue = 0;
+    std::vector<StagingBuffer> stagingBuffers;
+  };
+  VkCommandPool uploadCommandPool;
+  UploadBatch recordingUpload;
+  std::vector<UploadBatch> submittedUploads;
+  std::vector<VkCommandBuffer> freeUploadCommandBuffers;
+  VkSemaphore uploadTimeline;
+  uint64_t uploadSubmittedValue;
+  // Upload value the next frame submit waits on, 0 when there is none
+  uint64_t uploadWaitValue;
+
+  // Last use of every image, which the next barrier starts from
+  struct ImageState {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkAccessFlags2 accessFlags = VK_ACCESS_2_NONE;
+    VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_NONE;
+    // VK_QUEUE_FAMILY_IGNORED until the first use
+    uint32_t queueFamily = VK_QUEUE_FAMILY_IGNORED;
+    // Family and layout of a release the owning family has yet to acquire
+    uint32_t releasedFamily = VK_QUEUE_FAMILY_IGNORED;
+    VkImageLayout releasedLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+  std::unordered_map<VkImage, ImageState> imageStates;
+  BarrierBatch frameBarriers;
+  BarrierBatch uploadBarriers;
+  uint32_t barrierCount;
+  uint32_t lastFrameBarrierCount;
+
   std::vector<std::function<void()>> guiCallBacks;
 };
 } // namespace paranoixa
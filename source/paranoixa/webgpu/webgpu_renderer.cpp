@@ -18,6 +18,7 @@
 #include <windows.h>
 #endif
 
+#include "image.hpp"
 #include "webgpu_renderer.hpp"
 #include <iostream>
 
@@ -64,25 +65,18 @@ void WebGPURenderer::Initialize(void *window) {
   // Load texture from SDL
   SDL_Surface *surface = SDL_LoadBMP("res/texture.bmp");
 
-  std::vector<uint8_t> data;
-  data.resize(surface->w * surface->h * 4);
-
-  for (int y = 0; y < surface->h; ++y) {
-    for (int x = 0; x < surface->w; ++x) {
-      auto pixel =
-          static_cast<uint32_t *>(surface->pixels) + y * surface->w + x;
-      auto r = (*pixel & 0x00FF0000) >> 16;
-      auto g = (*pixel & 0x0000FF00) >> 8;
-      auto b = (*pixel & 0x000000FF);
-      auto a = (*pixel & 0xFF000000) >> 24;
-      auto index = (y * surface->w + x) * 4;
-      data[index + 0] = r;
-      data[index + 1] = g;
-      data[index + 2] = b;
-      data[index + 3] = a;
-    }
-  }
-  texture = CreateTexture(data.data(), data.size(), surface->w, surface->h);
+  // Swizzled straight into the staging buffer
+  texture = CreateTexture(
+      surface->w, surface->h, [&](void *texels, std::size_t rowPitch) {
+        image::ParallelForRows(
+            surface->h, image::GetThreadCount(rowPitch * surface->h),
+            [&](uint32 y) {
+              image::SwizzleBGRAToRGBA(
+                  static_cast<uint8_t *>(texels) + y * rowPitch,
+                  static_cast<uint8_t *>(surface->pixels) + y * surface->pitch,
+                  surface->w);
+            });
+      });
   SDL_DestroySurface(surface);
   PrepareSampler();
 
@@ -390,9 +384,9 @@ void WebGPURenderer::ConfigSurface(uint32_t width, uint32_t height) {
   config.alphaMode = WGPUCompositeAlphaMode_Auto;
   wgpuSurfaceConfigure(surface, &config);
 }
-WebGPURenderer::Texture WebGPURenderer::CreateTexture(const void *data,
-                                                      size_t size, int width,
-                                                      int height) {
+WebGPURenderer::Texture
+WebGPURenderer::CreateTexture(int width, int height,
+                              const TexelWriter &writeTexels) {
   Texture texture{};
   WGPUTextureFormat format = WGPUTextureFormat_RGBA8Unorm;
   WGPUTextureDescriptor descriptor{
@@ -416,17 +410,36 @@ WebGPURenderer::Texture WebGPURenderer::CreateTexture(const void *data,
       .aspect = WGPUTextureAspect_All,
   };
 
-  WGPUTextureDataLayout layout{
-      .offset = 0,
-      .bytesPerRow = 4 * static_cast<uint32_t>(width),
-      .rowsPerImage = static_cast<uint32_t>(height),
+  // Buffer to texture copies need rows aligned to 256 bytes
+  auto rowPitch = (4 * static_cast<uint32_t>(width) + 255) & ~255u;
+  auto size = static_cast<uint64_t>(rowPitch) * height;
+  auto staging = CreateBuffer(size, WGPUBufferUsage_CopySrc);
+  writeTexels(wgpuBufferGetMappedRange(staging, 0, size), rowPitch);
+  wgpuBufferUnmap(staging);
+
+  WGPUImageCopyBuffer imageCopyBuffer{
+      .layout =
+          {
+              .offset = 0,
+              .bytesPerRow = rowPitch,
+              .rowsPerImage = static_cast<uint32_t>(height),
+          },
+      .buffer = staging,
   };
 
   WGPUExtent3D extent{.width = static_cast<uint32_t>(width),
                       .height = static_cast<uint32_t>(height),
                       .depthOrArrayLayers = 1};
 
-  wgpuQueueWriteTexture(queue, &imageCopyTexture, data, size, &layout, &extent);
+  auto copyEncoder = wgpuDeviceCreateCommandEncoder(device, nullptr);
+  wgpuCommandEncoderCopyBufferToTexture(copyEncoder, &imageCopyBuffer,
+                                        &imageCopyTexture, &extent);
+  auto copyCommands = wgpuCommandEncoderFinish(copyEncoder, nullptr);
+  wgpuCommandEncoderRelease(copyEncoder);
+  wgpuQueueSubmit(queue, 1, &copyCommands);
+  wgpuCommandBufferRelease(copyCommands);
+  // The queue keeps the buffer alive until the copy is done
+  wgpuBufferRelease(staging);
 
   WGPUTextureViewDescriptor viewDescriptor{
       .nextInChain = nullptr,
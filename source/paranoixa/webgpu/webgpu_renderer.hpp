@@ -34,7 +34,9 @@ private:
   void PrepareQueue();
 
   void ConfigSurface(uint32_t width, uint32_t height);
-  Texture CreateTexture(const void *data, size_t size, int width, int height);
+  // Writes the RGBA8 rows, rowPitch bytes apart, into mapped staging memory
+  using TexelWriter = std::function<void(void *texels, size_t rowPitch)>;
+  Texture CreateTexture(int width, int height, const TexelWriter &writeTexels);
   WGPUBuffer CreateBuffer(uint64_t size, WGPUBufferUsage usage);
   void PrepareSampler();
   void InitializePipeline();
@@ -0,0 +1,126 @@
+// Build-time host tool of paranoixa_add_shaders(): reflects a SPIR-V binary
+// and writes it to a C++ header as a constexpr paranoixa::EmbeddedShader.
+//
+// Usage: paranoixa_shader_embed <input.spv> <output.hpp> <namespace>
+//                               <symbol> <entrypoint>
+#include "embedded_shader.hpp"
+#include "spirv_reflection.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+
+namespace px = paranoixa;
+
+namespace {
+const char *ToString(px::VertexElementFormat format) {
+  switch (format) {
+  case px::VertexElementFormat::Float1:
+    return "Float1";
+  case px::VertexElementFormat::Float2:
+    return "Float2";
+  case px::VertexElementFormat::Float3:
+    return "Float3";
+  case px::VertexElementFormat::Float4:
+    return "Float4";
+  case px::VertexElementFormat::UByte4_NORM:
+    return "UByte4_NORM";
+  }
+  return "Float4";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 6) {
+    std::cerr << "usage: " << argv[0]
+              << " <input.spv> <output.hpp> <namespace> <symbol> "
+                 "<entrypoint>\n";
+    return 1;
+  }
+  const char *inputPath = argv[1];
+  const char *outputPath = argv[2];
+  const char *ns = argv[3];
+  const std::string symbol = argv[4];
+  const char *entrypoint = argv[5];
+  auto *allocator = std::pmr::new_delete_resource();
+
+  std::ifstream input(inputPath, std::ios::binary);
+  if (!input) {
+    std::cerr << inputPath << ": cannot open\n";
+    return 1;
+  }
+  px::Array<char> bytes(std::istreambuf_iterator<char>(input), {}, allocator);
+  if (bytes.empty() || bytes.size() % sizeof(px::uint32) != 0) {
+    std::cerr << inputPath << ": not a SPIR-V binary\n";
+    return 1;
+  }
+  px::Array<px::uint32> words(bytes.size() / sizeof(px::uint32), allocator);
+  std::memcpy(words.data(), bytes.data(), bytes.size());
+
+  px::ShaderReflection reflection(allocator);
+  if (!px::ReflectSPIRV(words.data(), bytes.size(), entrypoint,
+                        reflection)) {
+    std::cerr << inputPath << ": no vertex or fragment entry point '"
+              << entrypoint << "'\n";
+    return 1;
+  }
+  auto hash = px::HashShaderCode(words.data(), words.size(), entrypoint);
+
+  std::ofstream output(outputPath, std::ios::binary);
+  output << "// Generated by paranoixa_add_shaders() from " << inputPath
+         << "\n// Do not edit.\n"
+         << "#pragma once\n"
+         << "#include <paranoixa/embedded_shader.hpp>\n\n"
+         << "namespace " << ns << " {\n"
+         << "inline constexpr paranoixa::uint32 " << symbol
+         << "_code[] = {" << std::hex << std::setfill('0');
+  for (size_t i = 0; i < words.size(); ++i) {
+    output << (i % 6 == 0 ? "\n    " : " ") << "0x" << std::setw(8)
+           << words[i] << ",";
+  }
+  output << std::dec << std::setfill(' ') << "\n};\n";
+
+  std::string vertexInputs = "nullptr";
+  if (!reflection.vertexInputs.empty()) {
+    vertexInputs = symbol + "_vertex_inputs";
+    output << "inline constexpr paranoixa::EmbeddedShader::VertexInput "
+           << vertexInputs << "[] = {\n";
+    for (const auto &vertexInput : reflection.vertexInputs) {
+      output << "    {" << vertexInput.location
+             << ", paranoixa::VertexElementFormat::"
+             << ToString(vertexInput.format) << "},\n";
+    }
+    output << "};\n";
+  }
+
+  output << "inline constexpr paranoixa::EmbeddedShader " << symbol
+         << " = {\n"
+         << "    .code = " << symbol << "_code,\n"
+         << "    .size = sizeof(" << symbol << "_code),\n"
+         << "    .hash = 0x" << std::hex << std::setfill('0')
+         << std::setw(16) << hash << std::dec << "ull,\n"
+         << "    .entrypoint = \"" << entrypoint << "\",\n"
+         << "    .stage = paranoixa::ShaderStage::"
+         << (reflection.stage == px::ShaderStage::Vertex ? "Vertex"
+                                                         : "Fragment")
+         << ",\n"
+         << "    .numSamplers = " << reflection.numSamplers << ",\n"
+         << "    .numStorageTextures = " << reflection.numStorageTextures
+         << ",\n"
+         << "    .numStorageBuffers = " << reflection.numStorageBuffers
+         << ",\n"
+         << "    .numUniformBuffers = " << reflection.numUniformBuffers
+         << ",\n"
+         << "    .vertexInputs = " << vertexInputs << ",\n"
+         << "    .numVertexInputs = " << reflection.vertexInputs.size()
+         << ",\n"
+         << "};\n"
+         << "} // namespace " << ns << "\n";
+  output.close();
+  if (!output) {
+    std::cerr << outputPath << ": cannot write\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,874 @@
+#include <paranoixa/image.hpp>
+#include <paranoixa/mapped_file.hpp>
+#include <paranoixa/paranoixa.hpp>
+#include <paranoixa/pipeline_cache_file.hpp>
+#include <paranoixa/spirv_reflection.hpp>
+#include <paranoixa/upload_batcher.hpp>
+
+#include <SDL3/SDL.h>
+
+#include <volk.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+static double ElapsedSeconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void UploadThroughputBenchmark(px::Allocator *allocator,
+                               px::Ptr<px::Device> device);
+void FileLoadBenchmark(px::Allocator *allocator, px::Ptr<px::Device> device);
+void ImageConversionBenchmark();
+void PipelineCacheBenchmark();
+void TextureUploadBenchmark();
+void ShaderReflectionBenchmark(px::Allocator *allocator);
+
+int main() {
+  using namespace paranoixa;
+
+  auto allocator = Paranoixa::CreateAllocator(0x1000000);
+  if (!SDL_Init(SDL_INIT_EVENTS)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not initialize SDL: %s",
+                 SDL_GetError());
+    return 1;
+  }
+  {
+    auto backend = Paranoixa::CreateBackend(allocator, GraphicsAPI::SDLGPU);
+    auto device = backend->CreateDevice({allocator, false});
+    if (device == nullptr) {
+      return 1;
+    }
+    std::cout << "Driver: " << device->GetDriver() << std::endl;
+
+    UploadThroughputBenchmark(allocator, device);
+    FileLoadBenchmark(allocator, device);
+    ImageConversionBenchmark();
+  }
+  PipelineCacheBenchmark();
+  TextureUploadBenchmark();
+  ShaderReflectionBenchmark(allocator);
+  SDL_Quit();
+  return 0;
+}
+
+void UploadThroughputBenchmark(px::Allocator *allocator,
+                               px::Ptr<px::Device> device) {
+  using namespace paranoixa;
+  std::cout << "---------------UploadThroughputBenchmark------------"
+            << std::endl;
+  constexpr uint32 totalSize = 32 * 1024 * 1024;
+  constexpr uint32 maxUploads = 8192;
+  constexpr uint32 payloadSizes[] = {256, 4096, 65536, 1024 * 1024};
+
+  Buffer::CreateInfo bufferCI{
+      .allocator = allocator,
+      .usage = BufferUsage::Vertex,
+      .size = totalSize,
+  };
+  auto buffer = device->CreateBuffer(bufferCI);
+  // Larger than the device allocator, which may not grow
+  Array<std::byte> payload(totalSize, std::byte{0x5a},
+                           std::pmr::new_delete_resource());
+
+  for (auto payloadSize : payloadSizes) {
+    auto numUploads = std::min(totalSize / payloadSize, maxUploads);
+    auto numBytes = static_cast<double>(numUploads) * payloadSize;
+
+    // One transfer buffer, copy pass and submit per upload
+    auto start = Clock::now();
+    for (uint32 i = 0; i < numUploads; ++i) {
+      TransferBuffer::CreateInfo transferBufferCI{
+          .allocator = allocator,
+          .usage = TransferBufferUsage::Upload,
+          .size = payloadSize,
+      };
+      auto transferBuffer = device->CreateTransferBuffer(transferBufferCI);
+      std::memcpy(transferBuffer->Map(false), payload.data(), payloadSize);
+      transferBuffer->Unmap();
+      auto command = device->AcquireCommandBuffer({allocator});
+      auto copyPass = command->BeginCopyPass();
+      copyPass->UploadBuffer({transferBuffer, 0},
+                             {buffer, i * payloadSize, payloadSize}, false);
+      command->EndCopyPass(copyPass);
+      device->SubmitCommandBuffer(command);
+    }
+    device->WaitForGPUIdle();
+    auto naive = ElapsedSeconds(start);
+
+    start = Clock::now();
+    {
+      UploadBatcher batcher({
+          .allocator = allocator,
+          .device = device,
+          .stagingBufferSize = 8 * 1024 * 1024,
+      });
+      UploadBatcher::Token token = 0;
+      for (uint32 i = 0; i < numUploads; ++i) {
+        token = batcher.UploadBuffer(payload.data(),
+                                     {buffer, i * payloadSize, payloadSize});
+      }
+      batcher.Wait(token);
+    }
+    auto batched = ElapsedSeconds(start);
+
+    std::print("payload {:>8} B x {:>5}: naive {:>9.1f} MB/s, batched "
+               "{:>9.1f} MB/s\n",
+               payloadSize, numUploads, numBytes / naive / 1.0e6,
+               numBytes / batched / 1.0e6);
+  }
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void FileLoadBenchmark(px::Allocator *allocator, px::Ptr<px::Device> device) {
+  using namespace paranoixa;
+  std::cout << "---------------FileLoadBenchmark------------" << std::endl;
+  // Roughly a large shader module, a 2K texture and a 4K texture with mips
+  constexpr uint32 fileSizes[] = {1024 * 1024, 16 * 1024 * 1024,
+                                  96 * 1024 * 1024};
+  constexpr int numIterations = 4;
+  auto directory = std::filesystem::temp_directory_path();
+
+  for (auto fileSize : fileSizes) {
+    auto fileName = "paranoixa_bench_" + std::to_string(fileSize) + ".bin";
+    auto path = (directory / fileName).string();
+    {
+      std::vector<char> contents(fileSize, 0x5a);
+      std::ofstream file(path, std::ios::binary);
+      file.write(contents.data(), contents.size());
+    }
+
+    // SDL_LoadFile into a heap buffer, then copy into staging memory
+    auto start = Clock::now();
+    for (int i = 0; i < numIterations; ++i) {
+      size_t size = 0;
+      void *data = SDL_LoadFile(path.c_str(), &size);
+      std::vector<char> fileData(size);
+      std::memcpy(fileData.data(), data, size);
+      SDL_free(data);
+      TransferBuffer::CreateInfo transferBufferCI{
+          .allocator = allocator,
+          .usage = TransferBufferUsage::Upload,
+          .size = static_cast<uint32>(size),
+      };
+      auto transferBuffer = device->CreateTransferBuffer(transferBufferCI);
+      std::memcpy(transferBuffer->Map(false), fileData.data(), size);
+      transferBuffer->Unmap();
+    }
+    auto buffered = ElapsedSeconds(start) / numIterations;
+
+    // Mapped file copied once into staging memory
+    start = Clock::now();
+    for (int i = 0; i < numIterations; ++i) {
+      MappedFile file;
+      file.Open(path.c_str());
+      auto transferBuffer = file.CreateTransferBuffer(allocator, device);
+    }
+    auto mapped = ElapsedSeconds(start) / numIterations;
+
+    std::print("file {:>10} B: buffered {:>8.2f} ms, mapped {:>8.2f} ms\n",
+               fileSize, buffered * 1.0e3, mapped * 1.0e3);
+    std::filesystem::remove(path);
+  }
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void ImageConversionBenchmark() {
+  using namespace paranoixa;
+  std::cout << "---------------ImageConversionBenchmark------------"
+            << std::endl;
+  constexpr uint32 width = 4096;
+  constexpr uint32 height = 4096;
+  constexpr int numIterations = 8;
+  auto numThreads = std::thread::hardware_concurrency();
+  std::vector<uint8_t> bgra(width * height * 4);
+  std::vector<uint8_t> rgb(width * height * 3);
+  std::vector<uint8_t> rgba(width * height * 4);
+  for (size_t i = 0; i < bgra.size(); ++i) {
+    bgra[i] = static_cast<uint8_t>(i * 7);
+  }
+  auto report = [](const char *name, double seconds) {
+    std::print("{:<32}: {:>9.1f} Mpixel/s\n", name,
+               width * height / seconds / 1.0e6);
+  };
+  auto measure = [](auto &&func) {
+    auto start = Clock::now();
+    for (int i = 0; i < numIterations; ++i) {
+      func();
+    }
+    return ElapsedSeconds(start) / numIterations;
+  };
+
+  // The per-pixel mask-and-shift loop the renderers used to run
+  report("swizzle scalar", measure([&] {
+           for (uint32 y = 0; y < height; ++y) {
+             for (uint32 x = 0; x < width; ++x) {
+               auto pixel =
+                   reinterpret_cast<uint32_t *>(bgra.data()) + y * width + x;
+               auto index = (y * width + x) * 4;
+               rgba[index + 0] = (*pixel & 0x00FF0000) >> 16;
+               rgba[index + 1] = (*pixel & 0x0000FF00) >> 8;
+               rgba[index + 2] = (*pixel & 0x000000FF);
+               rgba[index + 3] = (*pixel & 0xFF000000) >> 24;
+             }
+           }
+         }));
+  report("swizzle simd", measure([&] {
+           image::SwizzleBGRAToRGBA(rgba.data(), bgra.data(), width * height);
+         }));
+  report("swizzle simd, row parallel", measure([&] {
+           image::ParallelForRows(height, numThreads, [&](uint32 y) {
+             image::SwizzleBGRAToRGBA(rgba.data() + y * width * 4,
+                                      bgra.data() + y * width * 4, width);
+           });
+         }));
+  report("rgb to rgba simd", measure([&] {
+           image::ExpandRGBToRGBA(rgba.data(), rgb.data(), width * height);
+         }));
+  report("premultiply alpha simd", measure([&] {
+           image::PremultiplyAlpha(rgba.data(), bgra.data(), width * height);
+         }));
+
+  // One float channel per pixel
+  std::vector<float> floats(width * height);
+  std::vector<std::uint16_t> halves(width * height);
+  for (size_t i = 0; i < floats.size(); ++i) {
+    floats[i] = static_cast<float>(i % 1000) * 0.01f;
+  }
+  report("float to half", measure([&] {
+           image::FloatToHalf(halves.data(), floats.data(), floats.size());
+         }));
+  report("linear to srgb", measure([&] {
+           image::LinearToSRGB(rgba.data(), floats.data(), floats.size());
+         }));
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void PipelineCacheBenchmark() {
+  using namespace paranoixa;
+  std::cout << "---------------PipelineCacheBenchmark------------"
+            << std::endl;
+  // Blend, cull and topology permutations of the test shaders, roughly the
+  // material permutations of a small scene
+  constexpr uint32 numPipelines = 96;
+  if (volkInitialize() != VK_SUCCESS) {
+    std::cout << "Vulkan is not available" << std::endl;
+    return;
+  }
+  MappedFile vertexShader, fragmentShader;
+  if (!vertexShader.Open("res/shader.vert.spv") ||
+      !fragmentShader.Open("res/shader.frag.spv")) {
+    std::cout << "Shaders not found" << std::endl;
+    return;
+  }
+  VkApplicationInfo appInfo{
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pEngineName = "Paranoixa",
+      .apiVersion = VK_API_VERSION_1_3,
+  };
+  VkInstanceCreateInfo instanceCI{
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pApplicationInfo = &appInfo,
+  };
+  VkInstance instance;
+  if (vkCreateInstance(&instanceCI, nullptr, &instance) != VK_SUCCESS) {
+    std::cout << "Failed to create a Vulkan instance" << std::endl;
+    return;
+  }
+  volkLoadInstance(instance);
+  uint32 count = 1;
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  vkEnumeratePhysicalDevices(instance, &count, &physicalDevice);
+  if (physicalDevice == VK_NULL_HANDLE) {
+    vkDestroyInstance(instance, nullptr);
+    return;
+  }
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  PipelineCacheIdentity identity{
+      .vendorID = properties.vendorID,
+      .deviceID = properties.deviceID,
+      .driverVersion = properties.driverVersion,
+  };
+  std::memcpy(identity.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  auto cacheDirectory =
+      std::filesystem::temp_directory_path() / "paranoixa_bench_cache";
+  std::filesystem::remove_all(cacheDirectory);
+
+  // Device creation, cache load, compiling every pipeline and cache save
+  auto startup = [&](bool useCache) {
+    auto start = Clock::now();
+    VkPhysicalDeviceVulkan13Features vulkan13Features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+        .dynamicRendering = VK_TRUE,
+    };
+    constexpr float queuePriority = 1.0f;
+    // Nothing is submitted, so any queue family will do
+    VkDeviceQueueCreateInfo queueCI{
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = 0,
+        .queueCount = 1,
+        .pQueuePriorities = &queuePriority,
+    };
+    VkDeviceCreateInfo deviceCI{
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = &vulkan13Features,
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &queueCI,
+    };
+    VkDevice device;
+    vkCreateDevice(physicalDevice, &deviceCI, nullptr, &device);
+    volkLoadDevice(device);
+
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    if (useCache) {
+      Array<std::byte> data;
+      LoadPipelineCache(cacheDirectory, identity, data);
+      VkPipelineCacheCreateInfo pipelineCacheCI{
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+          .initialDataSize = data.size(),
+          .pInitialData = data.data(),
+      };
+      vkCreatePipelineCache(device, &pipelineCacheCI, nullptr, &pipelineCache);
+    }
+
+    auto createShaderModule = [&](const MappedFile &file) {
+      VkShaderModuleCreateInfo shaderModuleCI{
+          .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+          .codeSize = file.GetSize(),
+          .pCode = reinterpret_cast<const uint32_t *>(file.GetData()),
+      };
+      VkShaderModule shaderModule;
+      vkCreateShaderModule(device, &shaderModuleCI, nullptr, &shaderModule);
+      return shaderModule;
+    };
+    VkPipelineShaderStageCreateInfo stages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = createShaderModule(vertexShader),
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = createShaderModule(fragmentShader),
+            .pName = "main",
+        },
+    };
+    // The fragment shader samples set 2, binding 0
+    VkDescriptorSetLayoutBinding samplerBinding{
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+    };
+    VkDescriptorSetLayoutCreateInfo emptyLayoutCI{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    };
+    auto samplerLayoutCI = emptyLayoutCI;
+    samplerLayoutCI.bindingCount = 1;
+    samplerLayoutCI.pBindings = &samplerBinding;
+    VkDescriptorSetLayout emptyLayout, samplerLayout;
+    vkCreateDescriptorSetLayout(device, &emptyLayoutCI, nullptr, &emptyLayout);
+    vkCreateDescriptorSetLayout(device, &samplerLayoutCI, nullptr,
+                                &samplerLayout);
+    VkDescriptorSetLayout setLayouts[] = {emptyLayout, emptyLayout,
+                                          samplerLayout};
+    VkPipelineLayoutCreateInfo layoutCI{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 3,
+        .pSetLayouts = setLayouts,
+    };
+    VkPipelineLayout pipelineLayout;
+    vkCreatePipelineLayout(device, &layoutCI, nullptr, &pipelineLayout);
+
+    VkVertexInputBindingDescription vertexBinding{
+        .binding = 0,
+        .stride = sizeof(float) * 8,
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    };
+    VkVertexInputAttributeDescription vertexAttributes[] = {
+        {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0},
+        {1, 0, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 3},
+        {2, 0, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 5},
+    };
+    VkPipelineVertexInputStateCreateInfo vertexInput{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &vertexBinding,
+        .vertexAttributeDescriptionCount = 3,
+        .pVertexAttributeDescriptions = vertexAttributes,
+    };
+    VkPipelineViewportStateCreateInfo viewportState{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                      VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates,
+    };
+    VkPipelineMultisampleStateCreateInfo multisampleState{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    VkPipelineDepthStencilStateCreateInfo depthStencilState{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+    };
+    VkFormat colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    VkPipelineRenderingCreateInfo renderingCI{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &colorFormat,
+    };
+    constexpr VkBlendFactor blendFactors[] = {
+        VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_SRC_ALPHA,
+        VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA, VK_BLEND_FACTOR_DST_COLOR};
+    constexpr VkCullModeFlags cullModes[] = {
+        VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT};
+    constexpr VkPrimitiveTopology topologies[] = {
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP};
+
+    std::vector<VkPipeline> pipelines(numPipelines);
+    for (uint32 i = 0; i < numPipelines; ++i) {
+      VkPipelineInputAssemblyStateCreateInfo inputAssembly{
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+          .topology = topologies[i % 2],
+      };
+      VkPipelineRasterizationStateCreateInfo rasterizationState{
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+          .cullMode = cullModes[i / 2 % 3],
+          .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+          .lineWidth = 1.0f,
+      };
+      VkPipelineColorBlendAttachmentState blendAttachment{
+          .blendEnable = VK_TRUE,
+          .srcColorBlendFactor = blendFactors[i / 6 % 4],
+          .dstColorBlendFactor = blendFactors[i / 24 % 4],
+          .colorBlendOp = VK_BLEND_OP_ADD,
+          .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+          .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+          .alphaBlendOp = VK_BLEND_OP_ADD,
+          .colorWriteMask = 0xF,
+      };
+      VkPipelineColorBlendStateCreateInfo blendState{
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+          .attachmentCount = 1,
+          .pAttachments = &blendAttachment,
+      };
+      VkGraphicsPipelineCreateInfo pipelineCI{
+          .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+          .pNext = &renderingCI,
+          .stageCount = 2,
+          .pStages = stages,
+          .pVertexInputState = &vertexInput,
+          .pInputAssemblyState = &inputAssembly,
+          .pViewportState = &viewportState,
+          .pRasterizationState = &rasterizationState,
+          .pMultisampleState = &multisampleState,
+          .pDepthStencilState = &depthStencilState,
+          .pColorBlendState = &blendState,
+          .pDynamicState = &dynamicState,
+          .layout = pipelineLayout,
+      };
+      vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr,
+                                &pipelines[i]);
+    }
+
+    if (useCache) {
+      size_t size = 0;
+      vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+      std::vector<std::byte> data(size);
+      vkGetPipelineCacheData(device, pipelineCache, &size, data.data());
+      SavePipelineCache(cacheDirectory, identity, data.data(), size);
+    }
+    auto elapsed = ElapsedSeconds(start);
+
+    for (auto pipeline : pipelines) {
+      vkDestroyPipeline(device, pipeline, nullptr);
+    }
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, samplerLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, emptyLayout, nullptr);
+    for (auto &stage : stages) {
+      vkDestroyShaderModule(device, stage.module, nullptr);
+    }
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    vkDestroyDevice(device, nullptr);
+    return elapsed;
+  };
+
+  // Drivers with their own shader cache hide part of the difference
+  auto none = startup(false);
+  auto cold = startup(true);
+  auto warm = startup(true);
+  std::print("{} pipelines: no cache {:>8.2f} ms, cold cache {:>8.2f} ms, "
+             "warm cache {:>8.2f} ms\n",
+             numPipelines, none * 1.0e3, cold * 1.0e3, warm * 1.0e3);
+  std::filesystem::remove_all(cacheDirectory);
+  vkDestroyInstance(instance, nullptr);
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void TextureUploadBenchmark() {
+  using namespace paranoixa;
+  std::cout << "---------------TextureUploadBenchmark------------"
+            << std::endl;
+  // A scene's worth of small textures, where the per texture round trip
+  // dominates the copy itself
+  constexpr uint32 numTextures = 1000;
+  constexpr uint32 extent = 64;
+  constexpr VkDeviceSize textureSize = extent * extent * 4;
+  if (volkInitialize() != VK_SUCCESS) {
+    std::cout << "Vulkan is not available" << std::endl;
+    return;
+  }
+  VkApplicationInfo appInfo{
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pEngineName = "Paranoixa",
+      .apiVersion = VK_API_VERSION_1_3,
+  };
+  VkInstanceCreateInfo instanceCI{
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pApplicationInfo = &appInfo,
+  };
+  VkInstance instance;
+  if (vkCreateInstance(&instanceCI, nullptr, &instance) != VK_SUCCESS) {
+    std::cout << "Failed to create a Vulkan instance" << std::endl;
+    return;
+  }
+  volkLoadInstance(instance);
+  uint32 count = 1;
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  vkEnumeratePhysicalDevices(instance, &count, &physicalDevice);
+  if (physicalDevice == VK_NULL_HANDLE) {
+    vkDestroyInstance(instance, nullptr);
+    return;
+  }
+
+  // Same queue selection as VulkanRenderer
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(count);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count,
+                                           families.data());
+  uint32 graphicsFamily = 0, transferFamily = UINT32_MAX;
+  for (uint32 i = 0; i < count; ++i) {
+    if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+      graphicsFamily = i;
+      break;
+    }
+  }
+  for (uint32 i = 0; i < count; ++i) {
+    if ((families[i].queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+        !(families[i].queueFlags &
+          (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      transferFamily = i;
+      break;
+    }
+  }
+  if (transferFamily == UINT32_MAX) {
+    transferFamily = graphicsFamily;
+  }
+
+  VkPhysicalDeviceVulkan13Features vulkan13Features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .synchronization2 = VK_TRUE,
+  };
+  VkPhysicalDeviceVulkan12Features vulkan12Features{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .pNext = &vulkan13Features,
+      .timelineSemaphore = VK_TRUE,
+  };
+  constexpr float queuePriority = 1.0f;
+  VkDeviceQueueCreateInfo queueCIs[] = {
+      {
+          .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          .queueFamilyIndex = graphicsFamily,
+          .queueCount = 1,
+          .pQueuePriorities = &queuePriority,
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          .queueFamilyIndex = transferFamily,
+          .queueCount = 1,
+          .pQueuePriorities = &queuePriority,
+      },
+  };
+  VkDeviceCreateInfo deviceCI{
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = &vulkan12Features,
+      .queueCreateInfoCount = transferFamily != graphicsFamily ? 2u : 1u,
+      .pQueueCreateInfos = queueCIs,
+  };
+  VkDevice device;
+  if (vkCreateDevice(physicalDevice, &deviceCI, nullptr, &device) !=
+      VK_SUCCESS) {
+    vkDestroyInstance(instance, nullptr);
+    return;
+  }
+  volkLoadDevice(device);
+  VkQueue graphicsQueue, transferQueue;
+  vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
+  vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
+
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+  auto allocate = [&](VkMemoryRequirements requirements,
+                      VkMemoryPropertyFlags flags) {
+    VkMemoryAllocateInfo allocateInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+    };
+    for (uint32 i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+      if ((requirements.memoryTypeBits & (1u << i)) &&
+          (memoryProperties.memoryTypes[i].propertyFlags & flags) == flags) {
+        allocateInfo.memoryTypeIndex = i;
+        break;
+      }
+    }
+    VkDeviceMemory memory;
+    vkAllocateMemory(device, &allocateInfo, nullptr, &memory);
+    return memory;
+  };
+
+  // One staging buffer shared by every texture, so only submission differs
+  VkBufferCreateInfo stagingCI{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = textureSize * numTextures,
+      .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+  };
+  VkBuffer staging;
+  vkCreateBuffer(device, &stagingCI, nullptr, &staging);
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(device, staging, &requirements);
+  auto stagingMemory =
+      allocate(requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  vkBindBufferMemory(device, staging, stagingMemory, 0);
+  void *mapped;
+  vkMapMemory(device, stagingMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+  std::memset(mapped, 0x80, stagingCI.size);
+  vkUnmapMemory(device, stagingMemory);
+
+  VkImageCreateInfo imageCI{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = VK_FORMAT_R8G8B8A8_UNORM,
+      .extent = {extent, extent, 1},
+      .mipLevels = 1,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+  };
+  std::vector<VkImage> images(numTextures);
+  for (auto &image : images) {
+    vkCreateImage(device, &imageCI, nullptr, &image);
+  }
+  vkGetImageMemoryRequirements(device, images[0], &requirements);
+  auto stride = (requirements.size + requirements.alignment - 1) /
+                requirements.alignment * requirements.alignment;
+  auto imageRequirements = requirements;
+  imageRequirements.size = stride * numTextures;
+  auto imageMemory =
+      allocate(imageRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  for (uint32 i = 0; i < numTextures; ++i) {
+    vkBindImageMemory(device, images[i], imageMemory, stride * i);
+  }
+
+  auto recordUpload = [&](VkCommandBuffer commandBuffer, uint32 i) {
+    VkImageMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = images[i],
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    VkDependencyInfo dependencyInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+    VkBufferImageCopy copy{
+        .bufferOffset = textureSize * i,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageExtent = {extent, extent, 1},
+    };
+    vkCmdCopyBufferToImage(commandBuffer, staging, images[i],
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+    // Nothing samples the images here, so no ownership transfer follows
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    barrier.dstAccessMask = VK_ACCESS_2_NONE;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+  };
+  auto createCommandPool = [&](uint32 family) {
+    VkCommandPoolCreateInfo commandPoolCI{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = family,
+    };
+    VkCommandPool commandPool;
+    vkCreateCommandPool(device, &commandPoolCI, nullptr, &commandPool);
+    return commandPool;
+  };
+  auto allocateCommandBuffer = [&](VkCommandPool commandPool) {
+    VkCommandBufferAllocateInfo commandBufferAI{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(device, &commandBufferAI, &commandBuffer);
+    VkCommandBufferBeginInfo commandBufferBI{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(commandBuffer, &commandBufferBI);
+    return commandBuffer;
+  };
+
+  // What VulkanRenderer::CreateTexture used to do: a command buffer, a
+  // submit and a queue idle per texture
+  auto perTexture = [&] {
+    auto commandPool = createCommandPool(graphicsFamily);
+    auto start = Clock::now();
+    for (uint32 i = 0; i < numTextures; ++i) {
+      auto commandBuffer = allocateCommandBuffer(commandPool);
+      recordUpload(commandBuffer, i);
+      vkEndCommandBuffer(commandBuffer);
+      VkSubmitInfo submitInfo{
+          .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+          .commandBufferCount = 1,
+          .pCommandBuffers = &commandBuffer,
+      };
+      vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+      vkQueueWaitIdle(graphicsQueue);
+      vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    }
+    auto elapsed = ElapsedSeconds(start);
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    return elapsed;
+  };
+
+  // One upload command buffer on the transfer queue and one timeline wait
+  VkSemaphoreTypeCreateInfo semaphoreTypeCI{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+  };
+  VkSemaphoreCreateInfo semaphoreCI{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &semaphoreTypeCI,
+  };
+  VkSemaphore timeline;
+  vkCreateSemaphore(device, &semaphoreCI, nullptr, &timeline);
+  uint64_t timelineValue = 0;
+  auto batched = [&] {
+    auto commandPool = createCommandPool(transferFamily);
+    auto start = Clock::now();
+    auto commandBuffer = allocateCommandBuffer(commandPool);
+    for (uint32 i = 0; i < numTextures; ++i) {
+      recordUpload(commandBuffer, i);
+    }
+    vkEndCommandBuffer(commandBuffer);
+    VkSemaphoreSubmitInfo signalInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = timeline,
+        .value = ++timelineValue,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    };
+    VkCommandBufferSubmitInfo commandBufferInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .commandBuffer = commandBuffer,
+    };
+    VkSubmitInfo2 submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &commandBufferInfo,
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos = &signalInfo,
+    };
+    vkQueueSubmit2(transferQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    VkSemaphoreWaitInfo waitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &timeline,
+        .pValues = &timelineValue,
+    };
+    vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+    auto elapsed = ElapsedSeconds(start);
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    return elapsed;
+  };
+
+  // Warm up the driver before either measurement
+  perTexture();
+  batched();
+  auto perTextureSeconds = perTexture();
+  auto batchedSeconds = batched();
+  std::print("{} textures {}x{}: wait per texture {:>8.2f} ms, "
+             "batched {:>8.2f} ms ({})\n",
+             numTextures, extent, extent, perTextureSeconds * 1.0e3,
+             batchedSeconds * 1.0e3,
+             transferFamily != graphicsFamily ? "transfer queue"
+                                              : "graphics queue");
+
+  vkDestroySemaphore(device, timeline, nullptr);
+  for (auto image : images) {
+    vkDestroyImage(device, image, nullptr);
+  }
+  vkFreeMemory(device, imageMemory, nullptr);
+  vkDestroyBuffer(device, staging, nullptr);
+  vkFreeMemory(device, stagingMemory, nullptr);
+  vkDestroyDevice(device, nullptr);
+  vkDestroyInstance(instance, nullptr);
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void ShaderReflectionBenchmark(px::Allocator *allocator) {
+  using namespace paranoixa;
+  std::cout << "---------------ShaderReflectionBenchmark------------"
+            << std::endl;
+  constexpr int numIterations = 10000;
+  // Every SPIR-V module the test app ships
+  for (const auto &entry : std::filesystem::directory_iterator("res")) {
+    if (entry.path().extension() != ".spv")
+      continue;
+    MappedFile file;
+    if (!file.Open(entry.path().string().c_str()))
+      continue;
+    ShaderReflection reflection(allocator);
+    auto start = Clock::now();
+    for (int i = 0; i < numIterations; ++i) {
+      ReflectSPIRV(file.GetData(), file.GetSize(), "main", reflection);
+    }
+    auto seconds = ElapsedSeconds(start) / numIterations;
+    std::print("{:<20} {:>6} B: {:>7.2f} us, {:>8.1f} MB/s, {} samplers, "
+               "{} uniform buffers, {} vertex inputs\n",
+               entry.path().filename().string(), file.GetSize(),
+               seconds * 1.0e6, file.GetSize() / seconds / 1.0e6,
+               reflection.numSamplers, reflection.numUniformBuffers,
+               reflection.vertexInputs.size());
+  }
+  std::cout << "---------------------------------" << std::endl;
+}
@@ -1,62 +1,49 @@
 #include "../library/imgui/imgui.h"
 
+#include <paranoixa/embedded_shader.hpp>
+#include <paranoixa/image.hpp>
+#include <paranoixa/ktx2_loader.hpp>
+#include <paranoixa/offset_allocator.hpp>
 #include <paranoixa/paranoixa.hpp>
+#include <paranoixa/pipeline_compiler.hpp>
+#include <paranoixa/spirv_reflection.hpp>
+#include <paranoixa/texture_atlas.hpp>
+#include <paranoixa/upload_batcher.hpp>
 
 #include <SDL3/SDL.h>
 
 #include <imgui.h>
 #include <imnodes.h>
 
+#ifdef __EMSCRIPTEN__
+#include <paranoixa/mapped_file.hpp>
+#else
+#include <shaders/shader_frag.hpp>
+#include <shaders/shader_vert.hpp>
+#endif
+
 #include <backends/imgui_impl_sdl3.h>
 #include <imgui_impl_paranoixa.hpp>
 
+#include <algorithm>
 #include <iostream>
 
 void MemoryAllocatorTest();
 void PtrTest();
+void OffsetAllocatorTest();
+void VulkanHeadlessTest();
+void BindlessTableTest();
+void MemoryBudgetTest();
+void OffscreenRenderingTest();
+void NonBlockingAcquireTest();
+void KTX2LoaderTest();
+void TextureAtlasTest();
+void PipelineCompilerTest();
+void SPIRVReflectionTest();
 
 #ifndef _countof
 #define _countof(x) (sizeof(x) / sizeof(x[0]))
 #endif
-class FileLoader {
-public:
-  bool Load(const char *filePath, std::vector<char> &fileData,
-            std::ios_base::openmode openMode = std::ios::in | std::ios::binary);
-};
-
-std::unique_ptr<FileLoader> &GetFileLoader();
-
-static std::unique_ptr<FileLoader> gFileLoader = nullptr;
-
-std::unique_ptr<FileLoader> &GetFileLoader() {
-  if (gFileLoader == nullptr) {
-    gFileLoader = std::make_unique<FileLoader>();
-  }
-  return gFileLoader;
-}
-
-bool FileLoader::Load(const char *filePath, std::vector<char> &fileData,
-                      std::ios_base::openmode openMode) {
-  std::string openModeStr;
-
-  if (openMode & std::ios::in) {
-    openModeStr += "r";
-  }
-  if (openMode & std::ios::binary) {
-    openModeStr += "b";
-  }
-
-  auto file = SDL_IOFromFile(filePath, openModeStr.c_str());
-  size_t size;
-  void *data = SDL_LoadFile_IO(file, &size, true);
-
-  if (data) {
-    fileData.resize(size);
-    memcpy(fileData.data(), data, size);
-    return true;
-  }
-  return false;
-}
 
 int main() {
 
@@ -65,6 +52,16 @@ int main() {
   // TODO: Add unit tests
   MemoryAllocatorTest();
   PtrTest();
+  OffsetAllocatorTest();
+  VulkanHeadlessTest();
+  BindlessTableTest();
+  MemoryBudgetTest();
+  OffscreenRenderingTest();
+  NonBlockingAcquireTest();
+  KTX2LoaderTest();
+  TextureAtlasTest();
+  PipelineCompilerTest();
+  SPIRVReflectionTest();
   auto allocator = Paranoixa::CreateAllocator(0x8000);
   {
     if (!SDL_Init(SDL_INIT_EVENTS | SDL_INIT_AUDIO)) {
@@ -101,74 +98,56 @@ int main() {
       init_info.MSAASamples = px::SampleCount::x1;
       ImGui_ImplParanoixa_Init(&init_info);
 
-      std::vector<uint8_t> data;
-      data.resize(surface->w * surface->h * 4);
-      for (int y = 0; y < surface->h; ++y) {
-        for (int x = 0; x < surface->w; ++x) {
-          auto pixel =
-              static_cast<uint32_t *>(surface->pixels) + y * surface->w + x;
-          auto r = (*pixel & 0x00FF0000) >> 16;
-          auto g = (*pixel & 0x0000FF00) >> 8;
-          auto b = (*pixel & 0x000000FF);
-          auto a = (*pixel & 0xFF000000) >> 24;
-          auto index = (y * surface->w + x) * 4;
-          data[index + 0] = r;
-          data[index + 1] = g;
-          data[index + 2] = b;
-          data[index + 3] = a;
-        }
-      }
       Texture::CreateInfo textureCreateInfo{};
       textureCreateInfo.allocator = allocator;
       textureCreateInfo.width = static_cast<uint32_t>(surface->w);
       textureCreateInfo.height = static_cast<uint32_t>(surface->h);
-      textureCreateInfo.layerCountOrDepth = 1, textureCreateInfo.numLevels = 1;
+      textureCreateInfo.layerCountOrDepth = 1;
+      textureCreateInfo.numLevels =
+          CalculateMipLevelCount(textureCreateInfo.width,
+                                 textureCreateInfo.height);
       textureCreateInfo.sampleCount = SampleCount::x1;
       textureCreateInfo.format = TextureFormat::R8G8B8A8_UNORM;
       textureCreateInfo.type = TextureType::Texture2D;
       textureCreateInfo.usage = TextureUsage::Sampler;
+      textureCreateInfo.generateMipmaps = true;
       auto texture = device->CreateTexture(textureCreateInfo);
 
-      TransferBuffer::CreateInfo stagingTextureBufferCI = {
+      UploadBatcher uploadBatcher({
           .allocator = allocator,
-          .usage = TransferBufferUsage::Upload,
-          .size = textureCreateInfo.width * textureCreateInfo.height * 4,
-      };
-      auto stagingTextureBuffer =
-          device->CreateTransferBuffer(stagingTextureBufferCI);
-      auto mapped = stagingTextureBuffer->Map(false);
-      memcpy(mapped, data.data(), data.size());
-      stagingTextureBuffer->Unmap();
-
-      auto &fileLoader = GetFileLoader();
-      std::vector<char> vertCode, fragCode;
-      // load in plain
-      fileLoader->Load("res/shader.vert.spv", vertCode);
-      fileLoader->Load("res/shader.frag.spv", fragCode);
+          .device = device,
+          .stagingBufferSize = 0x400000,
+      });
+
+#ifdef __EMSCRIPTEN__
+      MappedFile vertCode, fragCode;
+      vertCode.Open("res/shader.vert.spv");
+      fragCode.Open("res/shader.frag.spv");
 
       Shader::CreateInfo vsci = {
           .allocator = allocator,
-          .size = vertCode.size(),
-          .data = vertCode.data(),
+          .size = vertCode.GetSize(),
+          .data = vertCode.GetData(),
           .entrypoint = "main",
           .stage = ShaderStage::Vertex,
-          .numSamplers = 0,
-          .numStorageTextures = 0,
-          .numUniformBuffers = 0,
       };
       auto vs = device->CreateShader(vsci);
 
       Shader::CreateInfo fsci = {
           .allocator = allocator,
-          .size = fragCode.size(),
-          .data = fragCode.data(),
+          .size = fragCode.GetSize(),
+          .data = fragCode.GetData(),
           .entrypoint = "main",
           .stage = ShaderStage::Fragment,
-          .numSamplers = 1,
-          .numStorageTextures = 0,
-          .numUniformBuffers = 2,
       };
       auto fs = device->CreateShader(fsci);
+#else
+      // Compiled and embedded at build time by paranoixa_add_shaders()
+      auto vs = device->CreateShader(
+          shaders::shader_vert.GetCreateInfo(allocator));
+      auto fs = device->CreateShader(
+          shaders::shader_frag.GetCreateInfo(allocator));
+#endif
 
       /*
      (-1, -1)  (1, -1)
@@ -193,97 +172,90 @@ int main() {
           .size = sizeof(triangleVerts),
       };
       auto vertexBuffer = device->CreateBuffer(vbci);
-      TransferBuffer::CreateInfo stagingVertexBufferCI = {
-          .allocator = allocator,
-          .usage = TransferBufferUsage::Upload,
-          .size = vbci.size,
-      };
-      auto stagingVertexBuffer =
-          device->CreateTransferBuffer(stagingVertexBufferCI);
-      mapped = stagingVertexBuffer->Map(false);
-      memcpy(mapped, triangleVerts, vbci.size);
-      stagingVertexBuffer->Unmap();
 
       // transfer texture/vertex buffer to gpu
-      auto command = device->AcquireCommandBuffer({allocator});
-      auto copyPass = command->BeginCopyPass();
-
       {
-
-        TextureTransferInfo info{
-            .transferBuffer = stagingTextureBuffer,
-            .offset = 0,
-        };
         TextureRegion region{
             .texture = texture,
             .width = textureCreateInfo.width,
             .height = textureCreateInfo.height,
             .depth = 1,
         };
-        copyPass->UploadTexture(info, region, false);
+        // Swizzle the BGRA surface straight into staging memory
+        auto rowSize = textureCreateInfo.width * 4;
+        uploadBatcher.UploadTexture(
+            rowSize * textureCreateInfo.height, region, [&](void *staging) {
+              image::ParallelForRows(
+                  textureCreateInfo.height,
+                  image::GetThreadCount(rowSize * textureCreateInfo.height),
+                  [&](uint32 y) {
+                    image::SwizzleBGRAToRGBA(
+                        static_cast<std::byte *>(staging) + y * rowSize,
+                        static_cast<std::byte *>(surface->pixels) +
+                            y * surface->pitch,
+                        textureCreateInfo.width);
+                  });
+            });
       }
       {
-        BufferTransferInfo location{
-            .transferBuffer = stagingVertexBuffer,
-            .offset = 0,
-        };
         BufferRegion region{
             .buffer = vertexBuffer,
             .offset = 0,
             .size = vbci.size,
         };
-        copyPass->UploadBuffer(location, region, false);
+        uploadBatcher.UploadBuffer(triangleVerts, region);
+      }
+      uploadBatcher.Flush();
+      {
+        auto command = device->AcquireCommandBuffer({allocator});
+        command->GenerateMipmaps(texture);
+        device->SubmitCommandBuffer(command);
       }
-      command->EndCopyPass(copyPass);
-      device->SubmitCommandBuffer(command);
 
       VertexBufferDescription vbDesc = {};
       vbDesc.inputRate = VertexInputRate::Vertex;
       vbDesc.instanceStepRate = 0;
       vbDesc.pitch = sizeof(float) * 8;
       vbDesc.slot = 0;
-      Array<VertexBufferDescription> vbDescs(allocator);
-      vbDescs.push_back(vbDesc);
 
-      Array<VertexAttribute> vertexAttributes(allocator);
-      {
-        vertexAttributes.push_back({0, 0, VertexElementFormat::Float3, 0});
-        vertexAttributes.push_back(
-            {1, 0, VertexElementFormat::Float2, sizeof(float) * 3});
-        vertexAttributes.push_back(
-            {2, 0, VertexElementFormat::Float3, sizeof(float) * 5});
-      };
       ColorTargetDescription colorTargetDescription = {
           .format = TextureFormat::B8G8R8A8_UNORM,
           .blendState = ColorTargetBlendState{},
       };
-      Array<ColorTargetDescription> colorTargetDescriptions(allocator);
-      colorTargetDescriptions.push_back(colorTargetDescription);
       GraphicsPipeline::CreateInfo pipelineCreateInfo{allocator};
       pipelineCreateInfo.allocator = allocator;
       pipelineCreateInfo.vertexShader = vs;
       pipelineCreateInfo.fragmentShader = fs;
-      pipelineCreateInfo.vertexInputState.vertexBufferDescriptions = vbDescs;
-      pipelineCreateInfo.vertexInputState.vertexAttributes = vertexAttributes;
+      {
+        auto &vertexInputState = pipelineCreateInfo.vertexInputState;
+        vertexInputState.vertexBufferDescriptions.push_back(vbDesc);
+        vertexInputState.vertexAttributes.push_back(
+            {0, 0, VertexElementFormat::Float3, 0});
+        vertexInputState.vertexAttributes.push_back(
+            {1, 0, VertexElementFormat::Float2, sizeof(float) * 3});
+        vertexInputState.vertexAttributes.push_back(
+            {2, 0, VertexElementFormat::Float3, sizeof(float) * 5});
+      }
       pipelineCreateInfo.primitiveType = PrimitiveType::TriangleList;
       pipelineCreateInfo.rasterizerState.fillMode = FillMode::Fill;
       pipelineCreateInfo.rasterizerState.cullMode = CullMode::None;
       pipelineCreateInfo.rasterizerState.frontFace = FrontFace::Clockwise;
       pipelineCreateInfo.multiSampleState = {};
       pipelineCreateInfo.depthStencilState = {};
-      pipelineCreateInfo.targetInfo = {allocator};
-      pipelineCreateInfo.targetInfo.colorTargetDescriptions =
-          colorTargetDescriptions;
+      pipelineCreateInfo.targetInfo = {};
+      pipelineCreateInfo.targetInfo.colorTargetDescriptions.push_back(
+          colorTargetDescription);
       auto pipeline = device->CreateGraphicsPipeline(pipelineCreateInfo);
 
       Sampler::CreateInfo samplerCI{};
       samplerCI.allocator = allocator;
       samplerCI.minFilter = Filter::Linear;
       samplerCI.magFilter = Filter::Linear;
-      samplerCI.mipmapMode = MipmapMode::Nearest;
+      samplerCI.mipmapMode = MipmapMode::Linear;
       samplerCI.addressModeU = AddressMode::ClampToEdge;
       samplerCI.addressModeV = AddressMode::ClampToEdge;
       samplerCI.addressModeW = AddressMode::ClampToEdge;
+      samplerCI.maxLod = static_cast<float>(textureCreateInfo.numLevels);
       auto sampler = device->CreateSampler(samplerCI);
 
       Ptr<Texture> swapchainTexture = nullptr;
@@ -372,4 +344,430 @@ void PtrTest() {
     }
   }
   std::cout << "---------------------------------" << std::endl;
-}
\ No newline at end of file
+}
+
+void OffsetAllocatorTest() {
+  using namespace paranoixa;
+  std::cout << "-----------OffsetAllocatorTest-----------" << std::endl;
+  {
+    auto allocator = Paranoixa::CreateAllocator(0x10000);
+    OffsetAllocator offsetAllocator(allocator, 0x100000, 256);
+    auto a = offsetAllocator.Allocate(1000);
+    auto b = offsetAllocator.Allocate(2000);
+    auto c = offsetAllocator.Allocate(3000);
+    std::cout << a.offset << " " << b.offset << " " << c.offset << std::endl;
+    offsetAllocator.Free(b);
+    // The freed range is reused
+    auto d = offsetAllocator.Allocate(1500);
+    std::cout << d.offset << std::endl;
+    offsetAllocator.Free(a);
+    offsetAllocator.Free(c);
+    offsetAllocator.Free(d);
+    std::cout << offsetAllocator.GetFreeSize() << std::endl;
+  }
+  std::cout << "---------------------------------" << std::endl;
+}
+
+// Run test on a headless Vulkan device, or skip it without a Vulkan 1.3
+// device
+void RunOnHeadlessDevice(
+    const std::function<void(paranoixa::Allocator *allocator,
+                             const paranoixa::Ptr<paranoixa::Device> &device)>
+        &test) {
+  using namespace paranoixa;
+  auto allocator = Paranoixa::CreateAllocator(0x100000);
+  {
+    auto backend = Paranoixa::CreateBackend(allocator, GraphicsAPI::Vulkan);
+    // Runs before SDL_Init, so the device is created without a window system
+    auto device = backend != nullptr
+                      ? backend->CreateDevice({allocator, false})
+                      : nullptr;
+    if (device == nullptr) {
+      std::cout << "No Vulkan 1.3 device, skipped" << std::endl;
+    } else {
+      test(allocator, device);
+    }
+  }
+  delete allocator;
+}
+
+paranoixa::Ptr<paranoixa::Texture>
+CreateTestRenderTarget(paranoixa::Allocator *allocator,
+                       const paranoixa::Ptr<paranoixa::Device> &device) {
+  using namespace paranoixa;
+  return device->CreateTexture({
+      .allocator = allocator,
+      .type = TextureType::Texture2D,
+      .format = TextureFormat::R8G8B8A8_UNORM,
+      .usage = TextureUsage::ColorTarget,
+      .width = 4,
+      .height = 4,
+      .layerCountOrDepth = 1,
+      .numLevels = 1,
+      .sampleCount = SampleCount::x1,
+  });
+}
+
+void VulkanHeadlessTest() {
+  using namespace paranoixa;
+  std::cout << "-----------VulkanHeadlessTest-----------" << std::endl;
+  RunOnHeadlessDevice([](Allocator *allocator, const Ptr<Device> &device) {
+    auto target = CreateTestRenderTarget(allocator, device);
+    auto download = device->CreateTransferBuffer({
+        .allocator = allocator,
+        .usage = TransferBufferUsage::Download,
+        .size = 4 * 4 * 4,
+    });
+    auto cmdbuf = device->AcquireCommandBuffer({allocator});
+    Array<ColorTargetInfo> colorTargets(allocator);
+    colorTargets.push_back({target, LoadOp::Clear, StoreOp::Store});
+    auto renderPass =
+        cmdbuf->BeginRenderPass(colorTargets, {}, 1.f, 0.f, 0.f, 1.f);
+    cmdbuf->EndRenderPass(renderPass);
+    auto copyPass = cmdbuf->BeginCopyPass();
+    copyPass->DownloadTexture(
+        {.texture = target, .width = 4, .height = 4, .depth = 1},
+        {.transferBuffer = download});
+    cmdbuf->EndCopyPass(copyPass);
+    auto fence = device->SubmitCommandBufferAndAcquireFence(cmdbuf);
+    device->WaitForFences(Array<Ptr<Fence>>({fence}, allocator), true);
+    auto *pixel = static_cast<const uint8 *>(download->Map(false));
+    std::cout << device->GetDriver() << ": " << int(pixel[0]) << " "
+              << int(pixel[1]) << " " << int(pixel[2]) << " "
+              << int(pixel[3]) << std::endl;
+    assert(pixel[0] == 255 && pixel[1] == 0 && pixel[2] == 0 &&
+           pixel[3] == 255);
+    download->Unmap();
+  });
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void BindlessTableTest() {
+  using namespace paranoixa;
+  std::cout << "-----------BindlessTableTest-----------" << std::endl;
+  RunOnHeadlessDevice([](Allocator *allocator, const Ptr<Device> &device) {
+    auto table = device->CreateBindlessTable({allocator});
+    if (table == nullptr) {
+      std::cout << "No bindless support, skipped" << std::endl;
+      return;
+    }
+    // Nothing is pending, so the index is reused at once
+    auto target = CreateTestRenderTarget(allocator, device);
+    [[maybe_unused]] auto index = table->RegisterTexture(target);
+    assert(index != BindlessTable::INVALID_INDEX);
+    table->UnregisterTexture(index);
+    [[maybe_unused]] auto reused = table->RegisterTexture(target);
+    assert(reused == index);
+  });
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void MemoryBudgetTest() {
+  using namespace paranoixa;
+  std::cout << "-----------MemoryBudgetTest-----------" << std::endl;
+  RunOnHeadlessDevice([](Allocator *allocator, const Ptr<Device> &device) {
+    auto target = CreateTestRenderTarget(allocator, device);
+    Array<MemoryHeapBudget> budgets(allocator);
+    [[maybe_unused]] bool hasBudgets = device->GetMemoryBudgets(budgets);
+    assert(hasBudgets && !budgets.empty());
+    for (const auto &budget : budgets) {
+      std::cout << (budget.deviceLocal ? "device local" : "host")
+                << " heap: " << budget.usage << " of " << budget.budget
+                << " bytes" << std::endl;
+    }
+    // A single render target leaves nothing to compact
+    device->DefragmentMemory(1.f);
+    device->DefragmentMemory(1.f);
+  });
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void OffscreenRenderingTest() {
+  using namespace paranoixa;
+  std::cout << "-----------OffscreenRenderingTest-----------" << std::endl;
+  RunOnHeadlessDevice([](Allocator *allocator, const Ptr<Device> &device) {
+    // Offscreen targets stand in for the swapchain without a window
+    [[maybe_unused]] bool hasOffscreen = device->ClaimOffscreen(4, 4);
+    assert(hasOffscreen);
+    for (int i = 0; i < 3; ++i) {
+      auto frame = device->AcquireCommandBuffer({allocator});
+      auto backbuffer = device->AcquireSwapchainTexture(frame);
+      assert(backbuffer != nullptr);
+      Array<ColorTargetInfo> backbufferTargets(allocator);
+      backbufferTargets.push_back({backbuffer, LoadOp::Clear, StoreOp::Store});
+      auto pass =
+          frame->BeginRenderPass(backbufferTargets, {}, 0.f, 0.f, 0.f, 1.f);
+      frame->EndRenderPass(pass);
+      device->SubmitCommandBuffer(frame);
+    }
+    device->WaitForGPUIdle();
+  });
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void NonBlockingAcquireTest() {
+  using namespace paranoixa;
+  std::cout << "-----------NonBlockingAcquireTest-----------" << std::endl;
+  RunOnHeadlessDevice([](Allocator *allocator, const Ptr<Device> &device) {
+    [[maybe_unused]] bool hasOffscreen = device->ClaimOffscreen(4, 4);
+    assert(hasOffscreen);
+    // Every target is free on an idle device, so nothing blocks
+    auto frame = device->AcquireCommandBuffer({allocator});
+    [[maybe_unused]] auto backbuffer =
+        device->TryAcquireSwapchainTexture(frame);
+    assert(backbuffer != nullptr);
+    device->SubmitCommandBuffer(frame);
+    device->WaitForGPUIdle();
+  });
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void KTX2LoaderTest() {
+  using namespace paranoixa;
+  std::cout << "-----------KTX2LoaderTest-----------" << std::endl;
+  RunOnHeadlessDevice([](Allocator *allocator, const Ptr<Device> &device) {
+    KTX2Loader loader({.allocator = allocator, .device = device});
+    // Header of a 4x4 R8G8B8A8_UNORM texture with one level, followed by
+    // its level index
+    std::uint8_t file[80 + 24] = {0xAB, 'K', 'T',  'X',  ' ', '2',
+                                  '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+    auto write32 = [&](std::size_t offset, std::uint32_t value) {
+      std::memcpy(file + offset, &value, sizeof(value));
+    };
+    auto write64 = [&](std::size_t offset, std::uint64_t value) {
+      std::memcpy(file + offset, &value, sizeof(value));
+    };
+    write32(12, 37); // vkFormat
+    write32(20, 4);  // pixelWidth
+    write32(24, 4);  // pixelHeight
+    write32(36, 1);  // faceCount
+    write32(40, 1);  // levelCount
+
+    // Cut off in the middle of the header, then before the level index
+    [[maybe_unused]] auto truncatedHeader = loader.Load(file, 40, nullptr);
+    assert(truncatedHeader == nullptr);
+    [[maybe_unused]] auto truncatedIndex = loader.Load(file, 80, nullptr);
+    assert(truncatedIndex == nullptr);
+
+    // Level data in bounds, but mips to be generated
+    write64(80, 0);
+    write64(88, 64);
+    write32(40, 0);
+    [[maybe_unused]] auto noLevels = loader.Load(file, sizeof(file), nullptr);
+    assert(noLevels == nullptr);
+    write32(40, 1);
+    // A 1x1x2 3D texture with two layers
+    write32(20, 1);
+    write32(24, 1);
+    write32(28, 2); // pixelDepth
+    write32(32, 2); // layerCount
+    write64(88, 16);
+    [[maybe_unused]] auto layered3D = loader.Load(file, sizeof(file), nullptr);
+    assert(layered3D == nullptr);
+    write32(20, 4);
+    write32(24, 4);
+    write32(28, 0);
+    write32(32, 0);
+
+    // byteOffset + byteLength wraps around to a small value
+    write64(80, UINT64_MAX - 15);
+    write64(88, 64);
+    [[maybe_unused]] auto wrapped = loader.Load(file, sizeof(file), nullptr);
+    assert(wrapped == nullptr);
+    // Larger than the whole image, however the sizes are multiplied
+    write32(20, UINT32_MAX);
+    write32(24, UINT32_MAX);
+    write64(80, 0);
+    [[maybe_unused]] auto oversized = loader.Load(file, sizeof(file), nullptr);
+    assert(oversized == nullptr);
+    std::cout << "Rejected malformed files" << std::endl;
+  });
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void TextureAtlasTest() {
+  using namespace paranoixa;
+  std::cout << "-----------TextureAtlasTest-----------" << std::endl;
+  RunOnHeadlessDevice([](Allocator *allocator, const Ptr<Device> &device) {
+    constexpr uint32 layerSize = 8;
+    TextureAtlas atlas({
+        .allocator = allocator,
+        .device = device,
+        .format = TextureFormat::R8G8B8A8_UNORM,
+        .width = layerSize,
+        .height = layerSize,
+        .numLayers = 1,
+        .padding = 1,
+    });
+    // 2x2 image whose texels differ in the red channel
+    const std::uint8_t image[] = {10, 0, 0, 255, 20, 0, 0, 255,
+                                  30, 0, 0, 255, 40, 0, 0, 255};
+    auto handle = atlas.Add(image, 2, 2);
+    assert(handle != TextureAtlas::INVALID_HANDLE);
+    atlas.Update();
+
+    auto download = device->CreateTransferBuffer({
+        .allocator = allocator,
+        .usage = TransferBufferUsage::Download,
+        .size = layerSize * layerSize * 4,
+    });
+    auto cmdbuf = device->AcquireCommandBuffer({allocator});
+    auto copyPass = cmdbuf->BeginCopyPass();
+    copyPass->DownloadTexture({.texture = atlas.GetTexture(),
+                               .width = layerSize,
+                               .height = layerSize,
+                               .depth = 1},
+                              {.transferBuffer = download});
+    cmdbuf->EndCopyPass(copyPass);
+    auto fence = device->SubmitCommandBufferAndAcquireFence(cmdbuf);
+    device->WaitForFences(Array<Ptr<Fence>>({fence}, allocator), true);
+
+    // Every texel of the padded 4x4 rect repeats the nearest image texel
+    const auto *entry = atlas.Get(handle);
+    auto *texels = static_cast<const std::uint8_t *>(download->Map(false));
+    for (uint32 y = 0; y < 4; ++y) {
+      for (uint32 x = 0; x < 4; ++x) {
+        [[maybe_unused]] auto imageX = std::clamp(x, 1u, 2u) - 1;
+        [[maybe_unused]] auto imageY = std::clamp(y, 1u, 2u) - 1;
+        auto texelX = entry->x - 1 + x;
+        auto texelY = entry->y - 1 + y;
+        [[maybe_unused]] auto red = texels[(texelY * layerSize + texelX) * 4];
+        assert(red == image[(imageY * 2 + imageX) * 4]);
+      }
+    }
+    download->Unmap();
+    std::cout << "Padding holds the edge texels" << std::endl;
+  });
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void PipelineCompilerTest() {
+  using namespace paranoixa;
+  std::cout << "-----------PipelineCompilerTest-----------" << std::endl;
+#ifdef __EMSCRIPTEN__
+  std::cout << "No embedded shaders, skipped" << std::endl;
+#else
+  RunOnHeadlessDevice([](Allocator *allocator, const Ptr<Device> &device) {
+    auto vs =
+        device->CreateShader(shaders::shader_vert.GetCreateInfo(allocator));
+    auto fs =
+        device->CreateShader(shaders::shader_frag.GetCreateInfo(allocator));
+    GraphicsPipeline::CreateInfo pipelineCI{allocator};
+    pipelineCI.vertexShader = vs;
+    pipelineCI.fragmentShader = fs;
+    {
+      auto &vertexInputState = pipelineCI.vertexInputState;
+      vertexInputState.vertexBufferDescriptions.push_back(
+          {0, sizeof(float) * 8, VertexInputRate::Vertex, 0});
+      vertexInputState.vertexAttributes.push_back(
+          {0, 0, VertexElementFormat::Float3, 0});
+      vertexInputState.vertexAttributes.push_back(
+          {1, 0, VertexElementFormat::Float2, sizeof(float) * 3});
+      vertexInputState.vertexAttributes.push_back(
+          {2, 0, VertexElementFormat::Float3, sizeof(float) * 5});
+    }
+    pipelineCI.primitiveType = PrimitiveType::TriangleList;
+    pipelineCI.rasterizerState.fillMode = FillMode::Fill;
+    pipelineCI.rasterizerState.cullMode = CullMode::None;
+    pipelineCI.targetInfo.colorTargetDescriptions.push_back(
+        {.format = TextureFormat::R8G8B8A8_UNORM,
+         .blendState = ColorTargetBlendState{}});
+
+    PipelineCompiler compiler({
+        .allocator = allocator,
+        .device = device,
+        .numThreads = 2,
+    });
+    auto asyncPipeline = compiler.CreateGraphicsPipelineAsync(pipelineCI);
+    // The compiler keeps its own references to the shaders
+    vs = nullptr;
+    fs = nullptr;
+    [[maybe_unused]] auto pipeline = compiler.Wait(asyncPipeline);
+    assert(pipeline != nullptr && asyncPipeline->Get() == pipeline);
+
+    auto target = CreateTestRenderTarget(allocator, device);
+    auto cmdbuf = device->AcquireCommandBuffer({allocator});
+    Array<ColorTargetInfo> colorTargets(allocator);
+    colorTargets.push_back({target, LoadOp::Clear, StoreOp::Store});
+    auto renderPass = cmdbuf->BeginRenderPass(colorTargets, {});
+    [[maybe_unused]] bool bound =
+        renderPass->BindAsyncGraphicsPipeline(*asyncPipeline);
+    assert(bound);
+    cmdbuf->EndRenderPass(renderPass);
+    device->SubmitCommandBuffer(cmdbuf);
+    device->WaitForGPUIdle();
+
+    [[maybe_unused]] auto statistics = compiler.GetStatistics();
+    assert(statistics.numCompiled == 1 && statistics.numFailed == 0 &&
+           statistics.numPending == 0);
+    std::cout << "Compiled in " << statistics.compileSeconds * 1000.0
+              << " ms, waited " << statistics.waitSeconds * 1000.0 << " ms"
+              << std::endl;
+  });
+#endif
+  std::cout << "---------------------------------" << std::endl;
+}
+
+void SPIRVReflectionTest() {
+  using namespace paranoixa;
+  std::cout << "-----------SPIRVReflectionTest-----------" << std::endl;
+  {
+    auto allocator = Paranoixa::CreateAllocator(0x10000);
+    {
+      // Fragment entry points a and b. a samples %9, b calls %19, which
+      // reads the uniform block %13. %10 is never used.
+      Array<uint32> code({0x07230203, 0x00010000, 0, 22, 0}, allocator);
+      auto op = [&](uint32 opcode, std::initializer_list<uint32> operands) {
+        code.push_back(static_cast<uint32>(operands.size() + 1) << 16 |
+                       opcode);
+        code.insert(code.end(), operands);
+      };
+      op(17, {1});                      // OpCapability Shader
+      op(14, {0, 1});                   // OpMemoryModel Logical GLSL450
+      op(15, {4, 1, 'a'});              // OpEntryPoint Fragment %1 "a"
+      op(15, {4, 2, 'b'});              // OpEntryPoint Fragment %2 "b"
+      op(71, {11, 2});                  // OpDecorate %11 Block
+      op(19, {3});                      // %3 = OpTypeVoid
+      op(33, {4, 3});                   // %4 = OpTypeFunction %3
+      op(22, {5, 32});                  // %5 = OpTypeFloat 32
+      op(25, {6, 5, 1, 0, 0, 0, 1, 0}); // %6 = OpTypeImage %5 2D sampled
+      op(27, {7, 6});                   // %7 = OpTypeSampledImage %6
+      op(32, {8, 0, 7});                // %8 = OpTypePointer UniformConstant %7
+      op(59, {8, 9, 0});                // %9 = OpVariable %8 UniformConstant
+      op(59, {8, 10, 0});               // %10 = OpVariable %8 UniformConstant
+      op(30, {11, 5});                  // %11 = OpTypeStruct %5
+      op(32, {12, 2, 11});              // %12 = OpTypePointer Uniform %11
+      op(59, {12, 13, 2});              // %13 = OpVariable %12 Uniform
+      op(54, {3, 1, 0, 4});             // %1 = OpFunction %3 None %4
+      op(248, {15});                    // %15 = OpLabel
+      op(61, {7, 16, 9});               // %16 = OpLoad %7 %9
+      op(253, {});                      // OpReturn
+      op(56, {});                       // OpFunctionEnd
+      op(54, {3, 2, 0, 4});             // %2 = OpFunction %3 None %4
+      op(248, {17});                    // %17 = OpLabel
+      op(57, {3, 18, 19});              // %18 = OpFunctionCall %3 %19
+      op(253, {});                      // OpReturn
+      op(56, {});                       // OpFunctionEnd
+      op(54, {3, 19, 0, 4});            // %19 = OpFunction %3 None %4
+      op(248, {20});                    // %20 = OpLabel
+      op(61, {11, 21, 13});             // %21 = OpLoad %11 %13
+      op(253, {});                      // OpReturn
+      op(56, {});                       // OpFunctionEnd
+
+      ShaderReflection reflection(allocator);
+      auto size = code.size() * sizeof(uint32);
+      [[maybe_unused]] bool reflectedA =
+          ReflectSPIRV(code.data(), size, "a", reflection);
+      assert(reflectedA && reflection.stage == ShaderStage::Fragment &&
+             reflection.numSamplers == 1 &&
+             reflection.numUniformBuffers == 0);
+      [[maybe_unused]] bool reflectedB =
+          ReflectSPIRV(code.data(), size, "b", reflection);
+      assert(reflectedB && reflection.numSamplers == 0 &&
+             reflection.numUniformBuffers == 1);
+      std::cout << "Counted the resources of each entry point" << std::endl;
+    }
+    delete allocator;
+  }
+  std::cout << "---------------------------------" << std::endl;
+}